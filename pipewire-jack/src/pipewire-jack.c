@@ -53,11 +53,12 @@
 #include "extensions/metadata.h"
 #include "pipewire-jack-extensions.h"
 
+#include "../../spa/plugins/audiomixer/mix-ops.h"
+
 #define JACK_DEFAULT_VIDEO_TYPE	"32 bit float RGBA video"
 
 #define JACK_CLIENT_NAME_SIZE		64
 #define JACK_PORT_NAME_SIZE		256
-#define JACK_PORT_MAX			4096
 #define JACK_PORT_TYPE_SIZE             32
 #define CONNECTION_NUM_FOR_PORT		1024
 
@@ -90,16 +91,31 @@ static struct globals globals;
 static bool mlock_warned = false;
 
 #define OBJECT_CHUNK	8
+#define NAME_HASH_SIZE	256u	/* power of 2 */
+#define REGEX_CACHE_SIZE	8
+
+static struct mix_ops mix_ops;
 
-typedef void (*mix2_func) (float *dst, float *src1, float *src2, int n_samples);
+struct object;
 
-static mix2_func mix2;
+struct object_name {
+	struct spa_list link;		/* link in a name hash bucket */
+	struct object *object;
+	const char *name;		/* NULL when not in a bucket */
+};
 
 struct object {
 	struct spa_list link;
 
 	struct client *client;
 
+#define NAME_Name	0
+#define NAME_Alias1	1
+#define NAME_Alias2	2
+#define NAME_System	3
+#define N_NAMES		4
+	struct object_name names[N_NAMES];
+
 #define INTERFACE_Port	0
 #define INTERFACE_Node	1
 #define INTERFACE_Link	2
@@ -217,6 +233,13 @@ struct link {
 	int signalfd;
 };
 
+struct regex_cache {
+	char *pattern;
+	regex_t regex;
+	int res;			/**< result of regcomp */
+	uint32_t used;
+};
+
 struct context {
 	struct pw_loop *l;
 	struct pw_thread_loop *loop;	/* thread_lock protects all below */
@@ -229,6 +252,10 @@ struct context {
 	struct spa_list ports;
 	struct spa_list nodes;
 	struct spa_list links;
+	struct spa_list node_names[NAME_HASH_SIZE];
+	struct spa_list port_names[NAME_HASH_SIZE];	/* names, aliases and system names */
+	struct regex_cache regex[REGEX_CACHE_SIZE];
+	uint32_t regex_used;
 };
 
 #define GET_DIRECTION(f)	((f) & JackPortIsInput ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT)
@@ -352,6 +379,7 @@ struct client {
 	unsigned int timeowner_pending:1;
 	unsigned int timeowner_conditional:1;
 	unsigned int merge_monitor:1;
+	unsigned int spin_activation:1;
 
 	jack_position_t jack_position;
 	jack_transport_state_t jack_state;
@@ -388,10 +416,69 @@ static struct object * alloc_object(struct client *c)
 	return o;
 }
 
+static uint32_t name_hash(const char *name)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * 16777619u;
+	return hash & (NAME_HASH_SIZE - 1);
+}
+
+static void object_unlink_names(struct object *o)
+{
+	uint32_t i;
+
+	for (i = 0; i < N_NAMES; i++) {
+		struct object_name *n = &o->names[i];
+		if (n->name != NULL) {
+			spa_list_remove(&n->link);
+			n->name = NULL;
+		}
+	}
+}
+
+/* (re)index the names of a node or port, call this with the context lock
+ * held after changing any of them */
+static void object_update_names(struct client *c, struct object *o)
+{
+	const char *names[N_NAMES] = { NULL, };
+	struct spa_list *table;
+	uint32_t i;
+
+	object_unlink_names(o);
+
+	switch (o->type) {
+	case INTERFACE_Node:
+		table = c->context.node_names;
+		names[NAME_Name] = o->node.name;
+		break;
+	case INTERFACE_Port:
+		table = c->context.port_names;
+		names[NAME_Name] = o->port.name;
+		names[NAME_Alias1] = o->port.alias1;
+		names[NAME_Alias2] = o->port.alias2;
+		names[NAME_System] = o->port.system;
+		break;
+	default:
+		return;
+	}
+	for (i = 0; i < N_NAMES; i++) {
+		struct object_name *n = &o->names[i];
+
+		if (names[i] == NULL || names[i][0] == '\0')
+			continue;
+		n->object = o;
+		n->name = names[i];
+		spa_list_append(&table[name_hash(n->name)], &n->link);
+	}
+}
+
 static void free_object(struct client *c, struct object *o)
 {
 	pthread_mutex_lock(&c->context.lock);
         spa_list_remove(&o->link);
+	object_unlink_names(o);
 	pthread_mutex_unlock(&c->context.lock);
 	spa_list_append(&c->context.free_objects, &o->link);
 }
@@ -537,28 +624,30 @@ static void free_port(struct client *c, struct port *p)
 
 static struct object *find_node(struct client *c, const char *name)
 {
-	struct object *o;
+	struct object_name *n;
 
-	spa_list_for_each(o, &c->context.nodes, link) {
-		if (!strcmp(o->node.name, name))
-			return o;
+	spa_list_for_each(n, &c->context.node_names[name_hash(name)], link) {
+		if (!strcmp(n->name, name))
+			return n->object;
 	}
 	return NULL;
 }
 
 static struct object *find_port(struct client *c, const char *name)
 {
+	struct object_name *n;
 	struct object *o;
 
-	spa_list_for_each(o, &c->context.ports, link) {
-		if (strcmp(o->port.name, name) == 0 ||
-		    strcmp(o->port.alias1, name) == 0 ||
-		    strcmp(o->port.alias2, name) == 0)
+	spa_list_for_each(n, &c->context.port_names[name_hash(name)], link) {
+		if (strcmp(n->name, name) != 0)
+			continue;
+		o = n->object;
+		/* the system name only refers to the ports of the default devices */
+		if (n != &o->names[NAME_System])
 			return o;
 		if (c->metadata &&
 		    (o->port.node_id == c->metadata->default_audio_source ||
-		     o->port.node_id == c->metadata->default_audio_sink) &&
-		    strcmp(o->port.system, name) == 0)
+		     o->port.node_id == c->metadata->default_audio_sink))
 			return o;
 	}
 	return NULL;
@@ -591,42 +680,6 @@ static struct buffer *dequeue_buffer(struct mix *mix)
 	return b;
 }
 
-#if defined (__SSE__)
-#include <xmmintrin.h>
-static void mix2_sse(float *dst, float *src1, float *src2, int n_samples)
-{
-	int n, unrolled;
-	__m128 in[2];
-
-	if (SPA_IS_ALIGNED(src1, 16) &&
-	    SPA_IS_ALIGNED(src2, 16) &&
-	    SPA_IS_ALIGNED(dst, 16))
-		unrolled = n_samples / 4;
-	else
-		unrolled = 0;
-
-	for (n = 0; unrolled--; n += 4) {
-		in[0] = _mm_load_ps(&src1[n]),
-		in[1] = _mm_load_ps(&src2[n]),
-		in[0] = _mm_add_ps(in[0], in[1]);
-		_mm_store_ps(&dst[n], in[0]);
-	}
-	for (; n < n_samples; n++) {
-		in[0] = _mm_load_ss(&src1[n]),
-		in[1] = _mm_load_ss(&src2[n]),
-		in[0] = _mm_add_ss(in[0], in[1]);
-		_mm_store_ss(&dst[n], in[0]);
-	}
-}
-#endif
-
-static void mix2_c(float *dst, float *src1, float *src2, int n_samples)
-{
-	int i;
-	for (i = 0; i < n_samples; i++)
-		dst[i] = src1[i] + src2[i];
-}
-
 SPA_EXPORT
 void jack_get_version(int *major_ptr, int *minor_ptr, int *micro_ptr, int *proto_ptr)
 {
@@ -1081,14 +1134,11 @@ static inline void check_sample_rate(struct client *c, struct spa_io_position *p
 	}
 }
 
-static inline uint32_t cycle_run(struct client *c)
+static inline bool cycle_wakeup(struct client *c)
 {
 	uint64_t cmd;
-	struct timespec ts;
 	int fd = c->socket_source->fd;
-	struct spa_io_position *pos = c->rt.position;
 	struct pw_node_activation *activation = c->activation;
-	struct pw_node_activation *driver = c->rt.driver_activation;
 
 	/* this is blocking if nothing ready */
 	while (true) {
@@ -1096,13 +1146,26 @@ static inline uint32_t cycle_run(struct client *c)
 			if (errno == EINTR)
 				continue;
 			if (errno == EWOULDBLOCK || errno == EAGAIN)
-				return 0;
+				return false;
 			pw_log_warn(NAME" %p: read failed %m", c);
 		}
 		break;
 	}
-	if (SPA_UNLIKELY(cmd > 1))
-		pw_log_warn(NAME" %p: missed %"PRIu64" wakeups", c, cmd - 1);
+	if (SPA_LIKELY(!c->spin_activation || activation->spin_wait == 0)) {
+		if (SPA_UNLIKELY(cmd > 1))
+			pw_log_warn(NAME" %p: missed %"PRIu64" wakeups", c, cmd - 1);
+		return true;
+	}
+	/* woken up early by the driver, spin until our peers trigger us */
+	return pw_node_activation_spin(activation);
+}
+
+static inline uint32_t cycle_run(struct client *c)
+{
+	struct timespec ts;
+	struct spa_io_position *pos = c->rt.position;
+	struct pw_node_activation *activation = c->activation;
+	struct pw_node_activation *driver = c->rt.driver_activation;
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	activation->status = PW_NODE_ACTIVATION_AWAKE;
@@ -1146,11 +1209,14 @@ static inline uint32_t cycle_wait(struct client *c)
 {
 	int res;
 
-	res = pw_data_loop_wait(c->loop, -1);
-	if (SPA_UNLIKELY(res <= 0)) {
-		pw_log_warn(NAME" %p: wait error %m", c);
-		return 0;
-	}
+	do {
+		res = pw_data_loop_wait(c->loop, -1);
+		if (SPA_UNLIKELY(res <= 0)) {
+			pw_log_warn(NAME" %p: wait error %m", c);
+			return 0;
+		}
+	} while (!cycle_wakeup(c));
+
 	return cycle_run(c);
 }
 
@@ -1186,7 +1252,9 @@ static inline void signal_sync(struct client *c)
 
 			pw_log_trace_fp(NAME" %p: signal %p %p", c, l, state);
 
-			if (SPA_UNLIKELY(write(l->signalfd, &cmd, sizeof(cmd)) != sizeof(cmd)))
+			if (SPA_LIKELY(!c->spin_activation ||
+			    pw_node_activation_need_wakeup(l->activation)) &&
+			    SPA_UNLIKELY(write(l->signalfd, &cmd, sizeof(cmd)) != sizeof(cmd)))
 				pw_log_warn(NAME" %p: write failed %m", c);
 		}
 	}
@@ -1237,6 +1305,9 @@ on_rtsocket_condition(void *data, int fd, uint32_t mask)
 		uint32_t buffer_frames;
 		int status = 0;
 
+		if (SPA_UNLIKELY(!cycle_wakeup(c)))
+			return;
+
 		buffer_frames = cycle_run(c);
 
 		if (!ATOMIC_LOAD(c->pending) && c->process_callback)
@@ -1296,6 +1367,18 @@ static int client_node_transport(void *object,
 	}
 	c->activation = c->mem->ptr;
 
+	/* we publish our spin time, older servers don't have room for it */
+	c->spin_activation = PW_NODE_ACTIVATION_HAS_SPIN(size);
+	if (c->spin_activation) {
+		const char *str = pw_properties_get(c->props, PW_KEY_NODE_SPIN_WAIT);
+		int spin_wait = str ? pw_properties_parse_int(str) : 0;
+		if (spin_wait < 0) {
+			pw_log_warn(NAME" %p: invalid spin-wait %s, disabled", c, str);
+			spin_wait = 0;
+		}
+		c->activation->spin_wait = spin_wait;
+	}
+
 	pw_log_debug(NAME" %p: create client transport with fds %d %d for node %u",
 			c, readfd, writefd, c->node_id);
 
@@ -2291,6 +2374,7 @@ static void registry_event_global(void *data, uint32_t id,
         while (id > size)
 		pw_map_insert_at(&c->context.globals, size++, NULL);
 	pw_map_insert_at(&c->context.globals, id, o);
+	object_update_names(c, o);
 	pthread_mutex_unlock(&c->context.lock);
 
 	pw_thread_loop_unlock(c->context.loop);
@@ -2398,7 +2482,7 @@ jack_client_t * jack_client_open (const char *client_name,
 {
 	struct client *client;
 	const struct spa_support *support;
-	uint32_t n_support;
+	uint32_t n_support, i;
 	const char *str;
 	struct spa_cpu *cpu_iface;
 	struct spa_node_info ni;
@@ -2460,18 +2544,19 @@ jack_client_t * jack_client_open (const char *client_name,
 	spa_list_init(&client->context.nodes);
 	spa_list_init(&client->context.ports);
 	spa_list_init(&client->context.links);
+	for (i = 0; i < NAME_HASH_SIZE; i++) {
+		spa_list_init(&client->context.node_names[i]);
+		spa_list_init(&client->context.port_names[i]);
+	}
 
 	support = pw_context_get_support(client->context.context, &n_support);
 
-	mix2 = mix2_c;
 	cpu_iface = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
-	if (cpu_iface) {
-#if defined (__SSE__)
-		uint32_t flags = spa_cpu_get_flags(cpu_iface);
-		if (flags & SPA_CPU_FLAG_SSE)
-			mix2 = mix2_sse;
-#endif
-	}
+	mix_ops.fmt = SPA_AUDIO_FORMAT_F32;
+	mix_ops.n_channels = 1;
+	mix_ops.cpu_flags = cpu_iface ? spa_cpu_get_flags(cpu_iface) : 0;
+	/* never fails, there is always a C function for F32 */
+	mix_ops_init(&mix_ops);
 	client->loop = client->context.context->data_loop_impl;
 
 	spa_list_init(&client->links);
@@ -2609,6 +2694,7 @@ SPA_EXPORT
 int jack_client_close (jack_client_t *client)
 {
 	struct client *c = (struct client *) client;
+	uint32_t i;
 	int res;
 
 	spa_return_val_if_fail(c != NULL, -EINVAL);
@@ -2632,6 +2718,14 @@ int jack_client_close (jack_client_t *client)
 	pw_thread_loop_destroy(c->context.loop);
 
 	pw_log_debug(NAME" %p: free", client);
+	for (i = 0; i < REGEX_CACHE_SIZE; i++) {
+		struct regex_cache *r = &c->context.regex[i];
+		if (r->pattern == NULL)
+			continue;
+		if (r->res == 0)
+			regfree(&r->regex);
+		free(r->pattern);
+	}
 	pthread_mutex_destroy(&c->context.lock);
 	pw_properties_free(c->props);
 	free(c);
@@ -2666,14 +2760,10 @@ char *jack_get_uuid_for_client_name (jack_client_t *client,
 	spa_return_val_if_fail(client_name != NULL, NULL);
 
 	pthread_mutex_lock(&c->context.lock);
-
-	spa_list_for_each(o, &c->context.nodes, link) {
-		if (strcmp(o->node.name, client_name) == 0) {
-			uuid = spa_aprintf( "%" PRIu64, client_make_uuid(o->id));
-			pw_log_debug(NAME" %p: name %s -> %s",
-					client, client_name, uuid);
-			break;
-		}
+	if ((o = find_node(c, client_name)) != NULL) {
+		uuid = spa_aprintf( "%" PRIu64, client_make_uuid(o->id));
+		pw_log_debug(NAME" %p: name %s -> %s",
+				client, client_name, uuid);
 	}
 	pthread_mutex_unlock(&c->context.lock);
 	return uuid;
@@ -3265,9 +3355,13 @@ jack_port_t * jack_port_register (jack_client_t *client,
 
 	o = p->object;
 	o->port.flags = flags;
-	snprintf(o->port.name, sizeof(o->port.name), "%s:%s", c->name, port_name);
 	o->port.type_id = type_id;
 
+	pthread_mutex_lock(&c->context.lock);
+	snprintf(o->port.name, sizeof(o->port.name), "%s:%s", c->name, port_name);
+	object_update_names(c, o);
+	pthread_mutex_unlock(&c->context.lock);
+
 	init_buffer(p);
 
 	if (direction == SPA_DIRECTION_INPUT) {
@@ -3392,8 +3486,9 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 	struct mix *mix;
 	struct buffer *b;
 	struct spa_io_buffers *io;
-	int layer = 0;
-	void *ptr = NULL;
+	const void *src[CONNECTION_NUM_FOR_PORT];
+	uint32_t n_src = 0;
+	void *ptr;
 
 	spa_list_for_each(mix, &p->mix, port_link) {
 		pw_log_trace_fp(NAME" %p: port %p mix %d.%d get buffer %d",
@@ -3406,16 +3501,19 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 
 		io->status = SPA_STATUS_NEED_DATA;
 		b = &mix->buffers[io->buffer_id];
-		if (layer++ == 0)
-			ptr = b->datas[0].data;
-		else  {
-			mix2(p->emptyptr, ptr, b->datas[0].data, frames);
-			ptr = p->emptyptr;
-			p->zeroed = false;
-		}
+		if (n_src < CONNECTION_NUM_FOR_PORT)
+			src[n_src++] = b->datas[0].data;
 	}
-	if (ptr == NULL)
+	if (n_src == 0) {
 		ptr = init_buffer(p);
+	} else if (n_src == 1) {
+		ptr = (void*)src[0];
+	} else {
+		/* sum all connections in one pass */
+		ptr = p->emptyptr;
+		mix_ops_process(&mix_ops, ptr, src, n_src, frames);
+		p->zeroed = false;
+	}
 	return ptr;
 }
 
@@ -3744,6 +3842,7 @@ int jack_port_set_alias (jack_port_t *port, const char *alias)
 
 	pw_thread_loop_lock(c->context.loop);
 
+	pthread_mutex_lock(&c->context.lock);
 	if (o->port.alias1[0] == '\0') {
 		key = PW_KEY_OBJECT_PATH;
 		snprintf(o->port.alias1, sizeof(o->port.alias1), "%s", alias);
@@ -3753,6 +3852,12 @@ int jack_port_set_alias (jack_port_t *port, const char *alias)
 		snprintf(o->port.alias2, sizeof(o->port.alias2), "%s", alias);
 	}
 	else
+		key = NULL;
+	if (key != NULL)
+		object_update_names(c, o);
+	pthread_mutex_unlock(&c->context.lock);
+
+	if (key == NULL)
 		goto error;
 
 	p = GET_PORT(c, GET_DIRECTION(o->port.flags), o->port.port_id);
@@ -4245,6 +4350,39 @@ static int port_compare_func(const void *v1, const void *v2)
 	return res;
 }
 
+/* get a compiled regex for pattern, call this with the context lock held.
+ * The REGEX_CACHE_SIZE most recently used patterns are kept compiled. */
+static regex_t *get_regex(struct client *c, const char *pattern)
+{
+	struct regex_cache *r, *lru = NULL;
+	uint32_t i;
+
+	for (i = 0; i < REGEX_CACHE_SIZE; i++) {
+		r = &c->context.regex[i];
+		if (r->pattern != NULL && strcmp(r->pattern, pattern) == 0)
+			goto done;
+		if (lru == NULL || r->used < lru->used)
+			lru = r;
+	}
+
+	r = lru;
+	if (r->pattern != NULL) {
+		if (r->res == 0)
+			regfree(&r->regex);
+		free(r->pattern);
+	}
+	if ((r->pattern = strdup(pattern)) == NULL) {
+		r->used = 0;
+		return NULL;
+	}
+	r->res = regcomp(&r->regex, pattern, REG_EXTENDED | REG_NOSUB);
+	if (r->res != 0)
+		pw_log_warn(NAME" %p: invalid regex '%s': %d", c, pattern, r->res);
+done:
+	r->used = ++c->context.regex_used;
+	return r->res == 0 ? &r->regex : NULL;
+}
+
 SPA_EXPORT
 const char ** jack_get_ports (jack_client_t *client,
                               const char *port_name_pattern,
@@ -4253,11 +4391,11 @@ const char ** jack_get_ports (jack_client_t *client,
 {
 	struct client *c = (struct client *) client;
 	const char **res;
-	struct object *o;
-	struct object *tmp[JACK_PORT_MAX];
+	struct object *o, **tmp;
+	struct pw_array ports;
 	const char *str;
 	uint32_t i, count, id;
-	regex_t port_regex, type_regex;
+	regex_t *port_regex = NULL, *type_regex = NULL;
 
 	spa_return_val_if_fail(c != NULL, NULL);
 
@@ -4266,22 +4404,24 @@ const char ** jack_get_ports (jack_client_t *client,
 	else
 		id = SPA_ID_INVALID;
 
-	if (port_name_pattern && port_name_pattern[0])
-		regcomp(&port_regex, port_name_pattern, REG_EXTENDED | REG_NOSUB);
-	if (type_name_pattern && type_name_pattern[0])
-		regcomp(&type_regex, type_name_pattern, REG_EXTENDED | REG_NOSUB);
-
-
 	pw_log_debug(NAME" %p: ports id:%d name:%s type:%s flags:%08lx", c, id,
 			port_name_pattern, type_name_pattern, flags);
 
+	pw_array_init(&ports, 64 * sizeof(struct object *));
+
 	pthread_mutex_lock(&c->context.lock);
-	count = 0;
+	if (port_name_pattern && port_name_pattern[0]) {
+		if ((port_regex = get_regex(c, port_name_pattern)) == NULL)
+			goto done;
+	}
+	if (type_name_pattern && type_name_pattern[0]) {
+		if ((type_regex = get_regex(c, type_name_pattern)) == NULL)
+			goto done;
+	}
+
 	spa_list_for_each(o, &c->context.ports, link) {
 		pw_log_debug(NAME" %p: check port type:%d flags:%08lx name:%s", c,
 				o->port.type_id, o->port.flags, o->port.name);
-		if (count == JACK_PORT_MAX)
-			break;
 		if (o->port.type_id > TYPE_ID_VIDEO)
 			continue;
 		if (!SPA_FLAG_IS_SET(o->port.flags, flags))
@@ -4289,37 +4429,40 @@ const char ** jack_get_ports (jack_client_t *client,
 		if (id != SPA_ID_INVALID && o->port.node_id != id)
 			continue;
 
-		if (port_name_pattern && port_name_pattern[0]) {
-			if (regexec(&port_regex, o->port.name, 0, NULL, 0) == REG_NOMATCH)
+		if (port_regex) {
+			if (regexec(port_regex, o->port.name, 0, NULL, 0) == REG_NOMATCH)
 				continue;
 		}
-		if (type_name_pattern && type_name_pattern[0]) {
-			if (regexec(&type_regex, type_to_string(o->port.type_id),
+		if (type_regex) {
+			if (regexec(type_regex, type_to_string(o->port.type_id),
 						0, NULL, 0) == REG_NOMATCH)
 				continue;
 		}
 
-		pw_log_debug(NAME" %p: port %s prio:%d matches (%d)",
-				c, o->port.name, o->port.priority, count);
-		tmp[count++] = o;
+		pw_log_debug(NAME" %p: port %s prio:%d matches", c, o->port.name,
+				o->port.priority);
+		if ((tmp = pw_array_add(&ports, sizeof(struct object *))) == NULL)
+			break;
+		*tmp = o;
 	}
+done:
 	pthread_mutex_unlock(&c->context.lock);
 
+	count = pw_array_get_len(&ports, struct object *);
 	if (count > 0) {
+		tmp = ports.data;
 		qsort(tmp, count, sizeof(struct object *), port_compare_func);
 
 		res = malloc(sizeof(char*) * (count + 1));
-		for (i = 0; i < count; i++)
-			res[i] = tmp[i]->port.name;
-		res[count] = NULL;
+		if (res != NULL) {
+			for (i = 0; i < count; i++)
+				res[i] = tmp[i]->port.name;
+			res[count] = NULL;
+		}
 	} else {
 		res = NULL;
 	}
-
-	if (port_name_pattern && port_name_pattern[0])
-		regfree(&port_regex);
-	if (type_name_pattern && type_name_pattern[0])
-		regfree(&type_regex);
+	pw_array_clear(&ports);
 
 	return res;
 }
@@ -78,6 +78,15 @@ enum spa_profiler {
 							  *      Int : status,
 							  *      Fraction : latency))  */
 
+	SPA_PROFILER_START_Context	= 0x30000,	/**< context related profiler properties */
+	SPA_PROFILER_formatCache,			/**< format negotiation cache, only
+							  *  when the counters changed
+							  *  (Struct(
+							  *      Long : hits,
+							  *      Long : misses,
+							  *      Long : nsec spent in misses,
+							  *      Long : nsec saved by hits))  */
+
 	SPA_PROFILER_START_CUSTOM	= 0x1000000,
 };
 
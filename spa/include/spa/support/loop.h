@@ -87,7 +87,15 @@ struct spa_loop_methods {
 	int (*remove_source) (void *object,
 			struct spa_source *source);
 
-	/** invoke a function in the context of this loop */
+	/** invoke a function in the context of this loop
+	 *
+	 * When \a block is false, the data is copied into a preallocated
+	 * pool of the loop and -ENOSPC is returned when the pool is full
+	 * or the data is too large. No memory is allocated and no lock
+	 * is taken, this can be called from realtime threads.
+	 *
+	 * When \a block is true, the data stays with the caller, which
+	 * waits on a semaphore until the function has run. */
 	int (*invoke) (void *object,
 		       spa_invoke_func_t func,
 		       uint32_t seq,
@@ -143,13 +151,24 @@ struct spa_loop_control_hooks {
 		spa_callbacks_call(&_h->cb, struct spa_loop_control_hooks, after, 0);	\
 })
 
+/** Counters of a loop, see spa_loop_control_get_stats() */
+struct spa_loop_stats {
+	uint64_t iterations;		/**< number of iterations */
+	uint64_t events;		/**< number of dispatched events */
+	uint32_t max_events;		/**< most events in one iteration */
+	uint32_t batch_size;		/**< current size of the event batch */
+	uint64_t dispatch_time;		/**< time spent in the callbacks in nsec */
+	uint64_t deferred;		/**< events deferred to the next iteration
+					  *  because the dispatch budget was used up */
+};
+
 /**
  * Control an event loop
  */
 struct spa_loop_control_methods {
 	/* the version of this structure. This can be used to expand this
 	 * structure in the future */
-#define SPA_VERSION_LOOP_CONTROL_METHODS	0
+#define SPA_VERSION_LOOP_CONTROL_METHODS	1
 	uint32_t version;
 
 	int (*get_fd) (void *object);
@@ -191,6 +210,16 @@ struct spa_loop_control_methods {
 	 * The number of dispatched fds is returned.
 	 */
 	int (*iterate) (void *object, int timeout);
+
+	/** Get the counters of the loop. Since version 1.
+	 * \param ctrl the control
+	 * \param stats the counters to fill
+	 *
+	 * This can be called from any thread, the counters are updated
+	 * without locking. Each counter is read atomically but together
+	 * they are not a consistent snapshot of the loop.
+	 */
+	int (*get_stats) (void *object, struct spa_loop_stats *stats);
 };
 
 #define spa_loop_control_method_v(o,method,version,...)			\
@@ -216,6 +245,7 @@ struct spa_loop_control_methods {
 #define spa_loop_control_enter(l)		spa_loop_control_method_v(l,enter,0)
 #define spa_loop_control_leave(l)		spa_loop_control_method_v(l,leave,0)
 #define spa_loop_control_iterate(l,...)		spa_loop_control_method_r(l,iterate,0,__VA_ARGS__)
+#define spa_loop_control_get_stats(l,...)	spa_loop_control_method_r(l,get_stats,1,__VA_ARGS__)
 
 typedef void (*spa_source_io_func_t) (void *data, int fd, uint32_t mask);
 typedef void (*spa_source_idle_func_t) (void *data);
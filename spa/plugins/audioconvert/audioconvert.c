@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/log.h>
@@ -42,11 +43,15 @@
 #include <spa/debug/pod.h>
 #include <spa/debug/types.h>
 
+#include "fused-ops.h"
+
 #define NAME "audioconvert"
 
 #define MAX_PORTS	SPA_AUDIO_MAX_CHANNELS
+#define MAX_BUFFERS	32u
 
 struct buffer {
+	uint32_t id;
 	struct spa_list link;
 #define BUFFER_FLAG_OUT		(1 << 0)
 	uint32_t flags;
@@ -54,6 +59,15 @@ struct buffer {
 	struct spa_meta_header *h;
 };
 
+/* the buffers of the external port 0, used when converting in one pass */
+struct port {
+	struct spa_io_buffers *io;
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	uint32_t offset;
+	struct spa_list queue;
+};
+
 struct link {
 	struct spa_node *out_node;
 	uint32_t out_port;
@@ -75,6 +89,7 @@ struct impl {
 	struct spa_log *log;
 	struct spa_cpu *cpu;
 
+	uint32_t cpu_flags;
 	uint32_t max_align;
 
 	struct spa_hook_list hooks;
@@ -115,8 +130,27 @@ struct impl {
 
 	struct spa_hook listener[2];
 
+	struct spa_io_position *io_position;
+	struct spa_io_rate_match *io_rate_match;
+
+	struct port ports[2];
+
+	int quality;
+	uint32_t filter;
+	uint32_t dither;
+	uint32_t mix_options;
+#define MODE_SPLIT	0
+#define MODE_MERGE	1
+#define MODE_CONVERT	2
+	int resample_mode;
+	struct fused fused;
+
 	unsigned int started:1;
 	unsigned int add_listener:1;
+	unsigned int peaks:1;
+	unsigned int fuse:1;
+	unsigned int use_fused:1;
+	unsigned int drained:1;
 };
 
 #define IS_MONITOR_PORT(this,dir,port_id) (dir == SPA_DIRECTION_OUTPUT && port_id > 0 &&	\
@@ -306,6 +340,131 @@ static int setup_convert(struct impl *this)
 	return 0;
 }
 
+static int port_get_format(struct impl *this, struct spa_node *node,
+		enum spa_direction direction, struct spa_audio_info_raw *info)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *format;
+	uint32_t state = 0;
+
+	if (spa_node_port_enum_params_sync(node, direction, 0,
+			SPA_PARAM_Format, &state, NULL, &format, &b) != 1)
+		return -EIO;
+
+	spa_zero(*info);
+	return spa_format_audio_raw_parse(format, info);
+}
+
+static void sync_fused_volume(struct impl *this)
+{
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *props;
+	const struct spa_pod_prop *prop;
+	float volume = 1.0f, channel_volumes[SPA_AUDIO_MAX_CHANNELS];
+	bool mute = false;
+	uint32_t n_channel_volumes = 0, state = 0;
+
+	if (spa_node_enum_params_sync(this->channelmix,
+			SPA_PARAM_Props, &state, NULL, &props, &b) != 1)
+		return;
+
+	spa_pod_parse_object(props,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_volume,	SPA_POD_OPT_Float(&volume),
+			SPA_PROP_mute,		SPA_POD_OPT_Bool(&mute));
+
+	if ((prop = spa_pod_find_prop(props, NULL, SPA_PROP_channelVolumes)) != NULL)
+		n_channel_volumes = spa_pod_copy_array(&prop->value, SPA_TYPE_Float,
+				channel_volumes, SPA_AUDIO_MAX_CHANNELS);
+
+	fused_set_volume(&this->fused, volume, mute, n_channel_volumes, channel_volumes);
+}
+
+/* The dither method is applied by the fmtconvert node on the output side,
+ * or by the fused converter when it is in use. It can change while running
+ * because the converters only swap their dither functions. */
+static void set_dither(struct impl *this, const struct spa_pod *param)
+{
+	uint32_t dither = this->dither;
+	int res;
+
+	if (spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_ditherType,	SPA_POD_OPT_Id(&dither)) < 0 ||
+	    dither == this->dither)
+		return;
+
+	spa_log_debug(this->log, NAME " %p: dither method %u -> %u", this,
+			this->dither, dither);
+
+	this->dither = dither;
+	spa_node_set_param(this->convert_in, SPA_PARAM_Props, 0, param);
+	spa_node_set_param(this->convert_out, SPA_PARAM_Props, 0, param);
+	if (this->use_fused &&
+	    (res = fused_set_dither(&this->fused, dither)) < 0)
+		spa_log_warn(this->log, NAME " %p: can't set dither method %u: %s",
+				this, dither, spa_strerror(res));
+
+	this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+	this->params[IDX_Props].user++;
+	emit_node_info(this, false);
+}
+
+static void clean_fused(struct impl *this)
+{
+	if (!this->use_fused)
+		return;
+	fused_free(&this->fused);
+	this->use_fused = false;
+}
+
+/* When both sides are in convert mode, the fmtconvert, channelmix, resample
+ * and fmtconvert nodes are only used to negotiate the formats. The data is
+ * then converted in one pass over small blocks with the same settings. */
+static int setup_fused(struct impl *this)
+{
+	struct fused *f = &this->fused;
+	int res;
+
+	if (this->use_fused || !this->fuse || this->peaks ||
+	    this->fmt[SPA_DIRECTION_INPUT] != this->convert_in ||
+	    this->fmt[SPA_DIRECTION_OUTPUT] != this->convert_out)
+		return 0;
+
+	spa_zero(*f);
+	if ((res = port_get_format(this, this->convert_in, SPA_DIRECTION_INPUT, &f->src_info)) < 0 ||
+	    (res = port_get_format(this, this->channelmix, SPA_DIRECTION_INPUT, &f->mix_info[0])) < 0 ||
+	    (res = port_get_format(this, this->channelmix, SPA_DIRECTION_OUTPUT, &f->mix_info[1])) < 0 ||
+	    (res = port_get_format(this, this->convert_out, SPA_DIRECTION_OUTPUT, &f->dst_info)) < 0)
+		return res;
+
+	f->cpu_flags = this->cpu_flags;
+	f->options = this->mix_options;
+	f->quality = this->quality;
+	f->filter = this->filter;
+	f->dither = this->dither;
+	f->log = this->log;
+
+	if ((res = fused_init(f)) < 0) {
+		spa_log_warn(this->log, NAME " %p: can't fuse conversion: %s",
+				this, spa_strerror(res));
+		return res;
+	}
+	sync_fused_volume(this);
+
+	this->ports[SPA_DIRECTION_INPUT].offset = 0;
+	this->ports[SPA_DIRECTION_OUTPUT].offset = 0;
+	this->drained = false;
+	this->use_fused = true;
+
+	spa_log_debug(this->log, NAME " %p: fused conversion %d/%d@%d->%d/%d@%d", this,
+			f->src_info.format, f->src_info.channels, f->src_info.rate,
+			f->dst_info.format, f->dst_info.channels, f->dst_info.rate);
+	return 0;
+}
+
 static int negotiate_link_buffers(struct impl *this, struct link *link)
 {
 	uint8_t buffer[4096];
@@ -410,6 +569,13 @@ static void flush_convert(struct impl *this)
 	spa_log_debug(this->log, NAME " %p: %d", this, this->n_links);
 	for (i = 0; i < this->n_links; i++)
 		this->links[i].io.status = SPA_STATUS_OK;
+
+	if (this->use_fused) {
+		fused_reset(&this->fused);
+		this->ports[SPA_DIRECTION_INPUT].offset = 0;
+		this->ports[SPA_DIRECTION_OUTPUT].offset = 0;
+		this->drained = false;
+	}
 }
 
 static void clean_convert(struct impl *this)
@@ -421,6 +587,8 @@ static void clean_convert(struct impl *this)
 	for (i = 0; i < this->n_links; i++)
 		clean_link(this, &this->links[i]);
 	this->n_links = 0;
+
+	clean_fused(this);
 }
 
 static int setup_buffers(struct impl *this, enum spa_direction direction)
@@ -453,7 +621,7 @@ static int impl_node_enum_params(void *object, int seq,
 	struct impl *this = object;
 	struct spa_pod *param;
 	struct spa_pod_builder b = { 0 };
-	uint8_t buffer[1024];
+	uint8_t buffer[4096];
 	struct spa_result_node_params result;
 	uint32_t count = 0;
 
@@ -519,13 +687,69 @@ static int impl_node_enum_params(void *object, int seq,
 		break;
 
 	case SPA_PARAM_PropInfo:
-		return spa_node_enum_params(this->channelmix, seq, id, start, num, filter);
-
+	{
+		struct spa_pod_frame f[2];
+		uint32_t idx;
+
+		/* the dither method, followed by the channelmix properties */
+		if (result.index > 0) {
+			idx = result.index - 1;
+			if (spa_node_enum_params_sync(this->channelmix,
+					id, &idx, NULL, &param, &b) != 1)
+				return 0;
+			break;
+		}
+		spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_PropInfo, id);
+		spa_pod_builder_add(&b,
+			SPA_PROP_INFO_id,   SPA_POD_Id(SPA_PROP_ditherType),
+			SPA_PROP_INFO_name, SPA_POD_String("Dither method"),
+			SPA_PROP_INFO_type, SPA_POD_Id(this->dither),
+			0);
+		spa_pod_builder_prop(&b, SPA_PROP_INFO_labels, 0);
+		spa_pod_builder_push_struct(&b, &f[1]);
+		spa_pod_builder_id(&b, DITHER_METHOD_NONE);
+		spa_pod_builder_string(&b, "none");
+		spa_pod_builder_id(&b, DITHER_METHOD_RECTANGULAR);
+		spa_pod_builder_string(&b, "rectangular");
+		spa_pod_builder_id(&b, DITHER_METHOD_TRIANGULAR);
+		spa_pod_builder_string(&b, "triangular");
+		spa_pod_builder_id(&b, DITHER_METHOD_SHAPED);
+		spa_pod_builder_string(&b, "shaped");
+		spa_pod_builder_pop(&b, &f[1]);
+		param = spa_pod_builder_pop(&b, &f[0]);
+		break;
+	}
 	case SPA_PARAM_Props:
+	{
+		struct spa_pod_frame f;
+		struct spa_pod *props;
+		struct spa_pod_object *obj;
+		struct spa_pod_prop *prop;
+		struct spa_node *node;
+		uint32_t idx = 0;
+
+		if (result.index > 0)
+			return 0;
+
 		if (this->fmt[SPA_DIRECTION_INPUT] == this->merger)
-			return spa_node_enum_params(this->merger, seq, id, start, num, filter);
+			node = this->merger;
 		else
-			return spa_node_enum_params(this->channelmix, seq, id, start, num, filter);
+			node = this->channelmix;
+
+		/* the properties of the node, with the dither method added */
+		if (spa_node_enum_params_sync(node, id, &idx, NULL, &props, &b) != 1)
+			return 0;
+
+		obj = (struct spa_pod_object *) props;
+		spa_pod_builder_push_object(&b, &f, SPA_TYPE_OBJECT_Props, id);
+		SPA_POD_OBJECT_FOREACH(obj, prop)
+			spa_pod_builder_raw_padded(&b, prop, SPA_POD_PROP_SIZE(prop));
+		spa_pod_builder_add(&b,
+			SPA_PROP_ditherType, SPA_POD_Id(this->dither),
+			0);
+		param = spa_pod_builder_pop(&b, &f);
+		break;
+	}
 
 	default:
 		return -ENOENT;
@@ -553,6 +777,7 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 
 	switch (id) {
 	case SPA_IO_Position:
+		this->io_position = data;
 		res = spa_node_set_io(this->resample, id, data, size);
 		res = spa_node_set_io(this->fmt[0], id, data, size);
 		res = spa_node_set_io(this->fmt[1], id, data, size);
@@ -808,9 +1033,13 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 	}
 	case SPA_PARAM_Props:
 	{
+		if (param != NULL)
+			set_dither(this, param);
 		if (this->fmt[SPA_DIRECTION_INPUT] == this->merger)
 			res = spa_node_set_param(this->merger, id, flags, param);
 		res = spa_node_set_param(this->channelmix, id, flags, param);
+		if (this->use_fused)
+			sync_fused_volume(this);
 		break;
 	}
 	default:
@@ -834,6 +1063,7 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 			return res;
 		if ((res = setup_buffers(this, SPA_DIRECTION_INPUT)) < 0)
 			return res;
+		setup_fused(this);
 		break;
 
 	case SPA_NODE_COMMAND_Suspend:
@@ -1035,9 +1265,37 @@ impl_node_port_set_param(void *object,
 					direction, port_id, id, flags, param)) < 0)
 		return res;
 
+	if (id == SPA_PARAM_Format)
+		clean_fused(this);
+
 	return res;
 }
 
+static void use_port_buffers(struct impl *this, struct port *port,
+		enum spa_direction direction, struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	uint32_t i;
+
+	spa_list_init(&port->queue);
+	port->offset = 0;
+
+	n_buffers = SPA_MIN(n_buffers, MAX_BUFFERS);
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		b->id = i;
+		b->flags = 0;
+		b->outbuf = buffers[i];
+		b->h = spa_buffer_find_meta_data(buffers[i], SPA_META_Header, sizeof(*b->h));
+
+		if (direction == SPA_DIRECTION_OUTPUT)
+			spa_list_append(&port->queue, &b->link);
+		else
+			SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+	}
+	port->n_buffers = n_buffers;
+}
+
 static int
 impl_node_port_use_buffers(void *object,
 			   enum spa_direction direction,
@@ -1061,6 +1319,9 @@ impl_node_port_use_buffers(void *object,
 					direction, port_id, flags, buffers, n_buffers)) < 0)
 		return res;
 
+	if (port_id == 0 && target == this->fmt[direction])
+		use_port_buffers(this, &this->ports[direction], direction, buffers, n_buffers);
+
 	return res;
 }
 
@@ -1079,6 +1340,7 @@ impl_node_port_set_io(void *object,
 
 	switch (id) {
 	case SPA_IO_RateMatch:
+		this->io_rate_match = data;
 		res = spa_node_port_set_io(this->resample, direction, 0, id, data, size);
 		break;
 	default:
@@ -1088,11 +1350,42 @@ impl_node_port_set_io(void *object,
 			target = this->fmt[direction];
 
 		res = spa_node_port_set_io(target, direction, port_id, id, data, size);
+
+		if (id == SPA_IO_Buffers && port_id == 0 && target == this->fmt[direction])
+			this->ports[direction].io = data;
 		break;
 	}
 	return res;
 }
 
+static void recycle_buffer(struct impl *this, struct port *port, uint32_t id)
+{
+	struct buffer *b;
+
+	if (SPA_UNLIKELY(id >= port->n_buffers))
+		return;
+
+	b = &port->buffers[id];
+	if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT)) {
+		spa_list_append(&port->queue, &b->link);
+		SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_OUT);
+		spa_log_trace_fp(this->log, NAME " %p: recycle buffer %d", this, id);
+	}
+}
+
+static struct buffer *peek_buffer(struct impl *this, struct port *port)
+{
+	if (spa_list_is_empty(&port->queue))
+		return NULL;
+	return spa_list_first(&port->queue, struct buffer, link);
+}
+
+static void dequeue_buffer(struct impl *this, struct buffer *b)
+{
+	spa_list_remove(&b->link);
+	SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+}
+
 static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
 {
 	struct impl *this = object;
@@ -1100,6 +1393,11 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
+	if (this->use_fused && port_id == 0) {
+		recycle_buffer(this, &this->ports[SPA_DIRECTION_OUTPUT], buffer_id);
+		return 0;
+	}
+
 	if (IS_MONITOR_PORT(this, SPA_DIRECTION_OUTPUT, port_id))
 		target = this->fmt[SPA_DIRECTION_INPUT];
 	else
@@ -1108,6 +1406,138 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 	return spa_node_port_reuse_buffer(target, port_id, buffer_id);
 }
 
+/* does the work of the fmtconvert, channelmix, resample and fmtconvert
+ * nodes in one go, following the buffer handling of the resample node */
+static int process_fused(struct impl *this)
+{
+	struct port *outport, *inport;
+	struct spa_io_buffers *outio, *inio;
+	struct buffer *sbuf, *dbuf;
+	struct spa_buffer *sb, *db;
+	uint32_t i, n_samples, in_len, out_len, max, maxsize;
+	const void *src_datas[SPA_AUDIO_MAX_CHANNELS];
+	void *dst_datas[SPA_AUDIO_MAX_CHANNELS];
+	bool flush_out = false, flush_in = false, draining = false;
+	struct fused *f = &this->fused;
+	int res = 0;
+
+	outport = &this->ports[SPA_DIRECTION_OUTPUT];
+	inport = &this->ports[SPA_DIRECTION_INPUT];
+
+	outio = outport->io;
+	inio = inport->io;
+
+	spa_return_val_if_fail(outio != NULL, -EIO);
+	spa_return_val_if_fail(inio != NULL, -EIO);
+
+	spa_log_trace_fp(this->log, NAME " %p: status %p %d %d -> %p %d %d", this,
+			inio, inio->status, inio->buffer_id,
+			outio, outio->status, outio->buffer_id);
+
+	if (SPA_UNLIKELY(outio->status == SPA_STATUS_HAVE_DATA))
+		return inio->status | outio->status;
+
+	/* recycle */
+	if (SPA_LIKELY(outio->buffer_id < outport->n_buffers)) {
+		recycle_buffer(this, outport, outio->buffer_id);
+		outio->buffer_id = SPA_ID_INVALID;
+	}
+	if (SPA_UNLIKELY(inio->status != SPA_STATUS_HAVE_DATA)) {
+		if (inio->status != SPA_STATUS_DRAINED || this->drained)
+			return outio->status = inio->status;
+		flush_in = draining = true;
+	} else if (SPA_UNLIKELY(inio->buffer_id >= inport->n_buffers))
+		return inio->status = -EINVAL;
+
+	if (SPA_UNLIKELY((dbuf = peek_buffer(this, outport)) == NULL))
+		return outio->status = -EPIPE;
+
+	db = dbuf->outbuf;
+	maxsize = db->datas[0].maxsize / f->dst_stride;
+
+	if (SPA_LIKELY(this->io_position))
+		max = this->io_position->clock.duration;
+	else
+		max = maxsize;
+
+	switch (this->resample_mode) {
+	case MODE_SPLIT:
+		/* in split mode we need to output exactly the size of the
+		 * duration so we don't try to flush early */
+		maxsize = SPA_MIN(maxsize, max);
+		flush_out = false;
+		break;
+	case MODE_MERGE:
+	default:
+		/* in merge mode we consume one duration of samples and
+		 * always output the resulting data */
+		flush_out = true;
+		break;
+	}
+
+	if (SPA_LIKELY(!draining)) {
+		uint32_t size = UINT32_MAX;
+
+		sbuf = &inport->buffers[inio->buffer_id];
+		sb = sbuf->outbuf;
+
+		for (i = 0; i < sb->n_datas; i++) {
+			struct spa_data *sd = &sb->datas[i];
+			uint32_t offs = SPA_MIN(sd->chunk->offset, sd->maxsize);
+			size = SPA_MIN(size, SPA_MIN(sd->maxsize - offs, sd->chunk->size));
+			src_datas[i] = SPA_MEMBER(sd->data, offs + inport->offset * f->src_stride, void);
+		}
+		n_samples = size / f->src_stride;
+	} else {
+		/* push out the remaining samples of the resampler */
+		inport->offset = 0;
+		n_samples = max;
+	}
+
+	in_len = n_samples - SPA_MIN(inport->offset, n_samples);
+	out_len = maxsize - SPA_MIN(outport->offset, maxsize);
+
+	for (i = 0; i < db->n_datas; i++)
+		dst_datas[i] = SPA_MEMBER(db->datas[i].data, outport->offset * f->dst_stride, void);
+
+	fused_process(f, draining ? NULL : src_datas, &in_len, dst_datas, &out_len);
+
+	spa_log_trace_fp(this->log, NAME " %p: in %d/%d out %d/%d", this,
+			in_len, n_samples, out_len, maxsize);
+
+	for (i = 0; i < db->n_datas; i++) {
+		db->datas[i].chunk->offset = 0;
+		db->datas[i].chunk->size = (outport->offset + out_len) * f->dst_stride;
+	}
+
+	inport->offset += in_len;
+	if (inport->offset >= n_samples || flush_in) {
+		inio->status = SPA_STATUS_NEED_DATA;
+		inport->offset = 0;
+		SPA_FLAG_SET(res, inio->status);
+	}
+
+	outport->offset += out_len;
+	if (outport->offset > 0 && (outport->offset >= maxsize || flush_out)) {
+		outio->status = SPA_STATUS_HAVE_DATA;
+		outio->buffer_id = dbuf->id;
+		dequeue_buffer(this, dbuf);
+		outport->offset = 0;
+		this->drained = draining;
+		SPA_FLAG_SET(res, SPA_STATUS_HAVE_DATA);
+	}
+
+	if (this->io_rate_match) {
+		if (SPA_FLAG_IS_SET(this->io_rate_match->flags, SPA_IO_RATE_MATCH_FLAG_ACTIVE))
+			resample_update_rate(&f->resample, this->io_rate_match->rate);
+		else
+			resample_update_rate(&f->resample, 1.0);
+		this->io_rate_match->delay = resample_delay(&f->resample);
+		this->io_rate_match->size = resample_in_len(&f->resample, max - outport->offset);
+	}
+	return res;
+}
+
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
@@ -1118,6 +1548,9 @@ static int impl_node_process(void *object)
 
 	spa_log_trace_fp(this->log, NAME " %p: process %d %d", this, this->n_links, this->n_nodes);
 
+	if (SPA_LIKELY(this->use_fused))
+		return process_fused(this);
+
 	while (1) {
 		res = SPA_STATUS_OK;
 		ready = 0;
@@ -1249,8 +1682,45 @@ impl_init(const struct spa_handle_factory *factory,
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
 	this->cpu = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
 
-	if (this->cpu)
+	if (this->cpu) {
+		this->cpu_flags = spa_cpu_get_flags(this->cpu);
 		this->max_align = spa_cpu_get_max_align(this->cpu);
+	}
+
+	this->fuse = false;
+	this->quality = RESAMPLE_DEFAULT_QUALITY;
+	this->filter = RESAMPLE_FILTER_LINEAR;
+	this->dither = DITHER_METHOD_NONE;
+	if (info != NULL) {
+		const char *str;
+
+		if ((str = spa_dict_lookup(info, "audioconvert.fused")) != NULL)
+			this->fuse = strcmp(str, "true") == 0 || atoi(str) == 1;
+		if ((str = spa_dict_lookup(info, "resample.quality")) != NULL)
+			this->quality = atoi(str);
+		if ((str = spa_dict_lookup(info, "resample.filter")) != NULL)
+			this->filter = resample_native_filter(str);
+		if ((str = spa_dict_lookup(info, "dither.method")) != NULL)
+			this->dither = convert_dither_method(str);
+		if ((str = spa_dict_lookup(info, "resample.peaks")) != NULL)
+			this->peaks = strcmp(str, "true") == 0 || atoi(str) == 1;
+		if ((str = spa_dict_lookup(info, "channelmix.normalize")) != NULL &&
+		    (strcmp(str, "true") == 0 || atoi(str) != 0))
+			this->mix_options |= CHANNELMIX_OPTION_NORMALIZE;
+		if ((str = spa_dict_lookup(info, "channelmix.mix-lfe")) != NULL &&
+		    (strcmp(str, "true") == 0 || atoi(str) != 0))
+			this->mix_options |= CHANNELMIX_OPTION_MIX_LFE;
+		if ((str = spa_dict_lookup(info, "factory.mode")) != NULL) {
+			if (strcmp(str, "split") == 0)
+				this->resample_mode = MODE_SPLIT;
+			else if (strcmp(str, "merge") == 0)
+				this->resample_mode = MODE_MERGE;
+			else
+				this->resample_mode = MODE_CONVERT;
+		}
+	}
+	spa_list_init(&this->ports[SPA_DIRECTION_INPUT].queue);
+	spa_list_init(&this->ports[SPA_DIRECTION_OUTPUT].queue);
 
 	this->node.iface = SPA_INTERFACE_INIT(
 			SPA_TYPE_INTERFACE_Node,
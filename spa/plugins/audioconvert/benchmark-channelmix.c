@@ -0,0 +1,191 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "test-helper.h"
+#include "channelmix-ops.h"
+
+#define MAX_SAMPLES	4096
+#define MAX_CHANNELS	16
+
+#define MAX_COUNT 200
+
+static uint32_t cpu_flags;
+
+struct stats {
+	const char *src;
+	const char *dst;
+	uint32_t n_samples;
+	uint64_t perf;
+	const char *impl;
+};
+
+static float samp_in[MAX_SAMPLES * MAX_CHANNELS] __attribute__ ((aligned (32)));
+static float samp_out[MAX_SAMPLES * MAX_CHANNELS] __attribute__ ((aligned (32)));
+
+static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
+
+#define MASK_7_1_4	MASK_7_1|_M(TFL)|_M(TFR)|_M(TRL)|_M(TRR)
+
+static const struct layout {
+	const char *name;
+	uint32_t channels;
+	uint64_t mask;
+} layouts[] = {
+	{ "mono", 1, _M(MONO) },
+	{ "stereo", 2, _M(FL)|_M(FR) },
+	{ "3.1", 4, MASK_3_1 },
+	{ "quad", 4, _M(FL)|_M(FR)|_M(RL)|_M(RR) },
+	{ "5.1", 6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR) },
+	{ "7.1", 8, MASK_7_1 },
+	{ "7.1.4", 12, MASK_7_1_4 },
+	{ "pro-16", 16, 0 },
+};
+
+#define MAX_IMPL	3
+#define MAX_SIZES	SPA_N_ELEMENTS(sample_sizes)
+#define MAX_LAYOUTS	SPA_N_ELEMENTS(layouts)
+#define MAX_RESULTS	MAX_IMPL * MAX_SIZES * MAX_LAYOUTS * MAX_LAYOUTS
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static void run_test1(const char *impl, const struct layout *src, const struct layout *dst,
+		struct channelmix *mix, int n_samples)
+{
+	uint32_t i, j;
+	const void *ip[MAX_CHANNELS];
+	void *op[MAX_CHANNELS];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	for (j = 0; j < mix->src_chan; j++)
+		ip[j] = &samp_in[j * MAX_SAMPLES];
+	for (j = 0; j < mix->dst_chan; j++)
+		op[j] = &samp_out[j * MAX_SAMPLES];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		channelmix_process(mix, mix->dst_chan, op, mix->src_chan, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.src = src->name,
+		.dst = dst->name,
+		.n_samples = n_samples,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.impl = impl
+	};
+}
+
+static void run_test(const char *impl, uint32_t flags)
+{
+	struct channelmix mix;
+	float volumes[MAX_CHANNELS];
+	size_t i, j, k;
+
+	for (i = 0; i < MAX_CHANNELS; i++)
+		volumes[i] = 1.0f;
+
+	for (i = 0; i < MAX_LAYOUTS; i++) {
+		for (j = 0; j < MAX_LAYOUTS; j++) {
+			spa_zero(mix);
+			mix.src_chan = layouts[i].channels;
+			mix.src_mask = layouts[i].mask;
+			mix.dst_chan = layouts[j].channels;
+			mix.dst_mask = layouts[j].mask;
+			mix.cpu_flags = flags;
+			if (channelmix_init(&mix) < 0)
+				continue;
+			channelmix_set_volume(&mix, 0.8f, false, mix.src_chan, volumes);
+
+			for (k = 0; k < MAX_SIZES; k++)
+				run_test1(impl, &layouts[i], &layouts[j], &mix, sample_sizes[k]);
+
+			channelmix_free(&mix);
+		}
+	}
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+
+	if ((diff = strcmp(a->src, b->src)) != 0) return diff;
+	if ((diff = strcmp(a->dst, b->dst)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < SPA_N_ELEMENTS(samp_in); i++)
+		samp_in[i] = (float)drand48() * 2.0f - 1.0f;
+
+	run_test("c", 0);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("sse", SPA_CPU_FLAG_SSE);
+#endif
+#if defined (HAVE_AVX) && defined(HAVE_FMA)
+	if (SPA_FLAG_IS_SET(cpu_flags, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3))
+		run_test("avx", SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("neon", SPA_CPU_FLAG_NEON);
+#endif
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-8.8s -> %-8.8s %s \tsamples %d\n",
+				s->perf, s->src, s->dst, s->impl, s->n_samples);
+	}
+	return 0;
+}
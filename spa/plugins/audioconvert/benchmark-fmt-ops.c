@@ -30,9 +30,12 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
+
+#include <spa/param/audio/raw.h>
 
 #include "test-helper.h"
-#include "fmt-ops.h"
+#include "fused-ops.h"
 
 static uint32_t cpu_flags;
 
@@ -58,7 +61,7 @@ static uint8_t samp_out[MAX_SAMPLES * MAX_CHANNELS * 4];
 static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
 static const int channel_counts[] = { 1, 2, 4, 6, 8, 11 };
 
-#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * 70
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * 180
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
@@ -130,6 +133,24 @@ static void test_f32_u8(void)
 	run_test("test_f32d_u8", "c", false, true, conv_f32d_to_u8_c);
 	run_test("test_f32_u8d", "c", true, false, conv_f32_to_u8d_c);
 	run_test("test_f32d_u8d", "c", false, false, conv_f32d_to_u8d_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_f32_u8", "sse2", true, true, conv_f32_to_u8_sse2);
+		run_test("test_f32d_u8d", "sse2", false, false, conv_f32d_to_u8d_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_u8", "avx2", true, true, conv_f32_to_u8_avx2);
+		run_test("test_f32d_u8d", "avx2", false, false, conv_f32d_to_u8d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_u8", "avx512", true, true, conv_f32_to_u8_avx512);
+		run_test("test_f32d_u8d", "avx512", false, false, conv_f32d_to_u8d_avx512);
+	}
+#endif
 }
 
 static void test_u8_f32(void)
@@ -138,6 +159,18 @@ static void test_u8_f32(void)
 	run_test("test_u8d_f32", "c", false, true, conv_u8d_to_f32_c);
 	run_test("test_u8_f32d", "c", true, false, conv_u8_to_f32d_c);
 	run_test("test_u8d_f32d", "c", false, false, conv_u8d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_u8_f32", "avx2", true, true, conv_u8_to_f32_avx2);
+		run_test("test_u8d_f32d", "avx2", false, false, conv_u8d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_u8_f32", "avx512", true, true, conv_u8_to_f32_avx512);
+		run_test("test_u8d_f32d", "avx512", false, false, conv_u8d_to_f32d_avx512);
+	}
+#endif
 }
 
 static void test_f32_s16(void)
@@ -159,6 +192,25 @@ static void test_f32_s16(void)
 #endif
 	run_test("test_f32_s16d", "c", true, false, conv_f32_to_s16d_c);
 	run_test("test_f32d_s16d", "c", false, false, conv_f32d_to_s16d_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_f32_s16", "sse2", true, true, conv_f32_to_s16_sse2);
+		run_test("test_f32_s16d", "sse2", true, false, conv_f32_to_s16d_sse2);
+		run_test("test_f32d_s16d", "sse2", false, false, conv_f32d_to_s16d_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s16", "avx2", true, true, conv_f32_to_s16_avx2);
+		run_test("test_f32d_s16d", "avx2", false, false, conv_f32d_to_s16d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s16", "avx512", true, true, conv_f32_to_s16_avx512);
+		run_test("test_f32d_s16d", "avx512", false, false, conv_f32d_to_s16d_avx512);
+	}
+#endif
 }
 
 static void test_s16_f32(void)
@@ -179,6 +231,18 @@ static void test_s16_f32(void)
 	}
 #endif
 	run_test("test_s16d_f32d", "c", false, false, conv_s16d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s16_f32", "avx2", true, true, conv_s16_to_f32_avx2);
+		run_test("test_s16d_f32d", "avx2", false, false, conv_s16d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s16_f32", "avx512", true, true, conv_s16_to_f32_avx512);
+		run_test("test_s16d_f32d", "avx512", false, false, conv_s16d_to_f32d_avx512);
+	}
+#endif
 }
 
 static void test_f32_s32(void)
@@ -197,6 +261,24 @@ static void test_f32_s32(void)
 #endif
 	run_test("test_f32_s32d", "c", true, false, conv_f32_to_s32d_c);
 	run_test("test_f32d_s32d", "c", false, false, conv_f32d_to_s32d_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_f32_s32", "sse2", true, true, conv_f32_to_s32_sse2);
+		run_test("test_f32d_s32d", "sse2", false, false, conv_f32d_to_s32d_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s32", "avx2", true, true, conv_f32_to_s32_avx2);
+		run_test("test_f32d_s32d", "avx2", false, false, conv_f32d_to_s32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s32", "avx512", true, true, conv_f32_to_s32_avx512);
+		run_test("test_f32d_s32d", "avx512", false, false, conv_f32d_to_s32d_avx512);
+	}
+#endif
 }
 
 static void test_s32_f32(void)
@@ -215,6 +297,18 @@ static void test_s32_f32(void)
 #endif
 	run_test("test_s32_f32d", "c", true, false, conv_s32_to_f32d_c);
 	run_test("test_s32d_f32d", "c", false, false, conv_s32d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s32_f32", "avx2", true, true, conv_s32_to_f32_avx2);
+		run_test("test_s32d_f32d", "avx2", false, false, conv_s32d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s32_f32", "avx512", true, true, conv_s32_to_f32_avx512);
+		run_test("test_s32d_f32d", "avx512", false, false, conv_s32d_to_f32d_avx512);
+	}
+#endif
 }
 
 static void test_f32_s24(void)
@@ -259,6 +353,24 @@ static void test_f32_s24_32(void)
 	run_test("test_f32d_s24_32", "c", false, true, conv_f32d_to_s24_32_c);
 	run_test("test_f32_s24_32d", "c", true, false, conv_f32_to_s24_32d_c);
 	run_test("test_f32d_s24_32d", "c", false, false, conv_f32d_to_s24_32d_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_f32_s24_32", "sse2", true, true, conv_f32_to_s24_32_sse2);
+		run_test("test_f32d_s24_32d", "sse2", false, false, conv_f32d_to_s24_32d_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s24_32", "avx2", true, true, conv_f32_to_s24_32_avx2);
+		run_test("test_f32d_s24_32d", "avx2", false, false, conv_f32d_to_s24_32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s24_32", "avx512", true, true, conv_f32_to_s24_32_avx512);
+		run_test("test_f32d_s24_32d", "avx512", false, false, conv_f32d_to_s24_32d_avx512);
+	}
+#endif
 }
 
 static void test_s24_32_f32(void)
@@ -267,6 +379,18 @@ static void test_s24_32_f32(void)
 	run_test("test_s24_32d_f32", "c", false, true, conv_s24_32d_to_f32_c);
 	run_test("test_s24_32_f32d", "c", true, false, conv_s24_32_to_f32d_c);
 	run_test("test_s24_32d_f32d", "c", false, false, conv_s24_32d_to_f32d_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_32_f32", "avx2", true, true, conv_s24_32_to_f32_avx2);
+		run_test("test_s24_32d_f32d", "avx2", false, false, conv_s24_32d_to_f32d_avx2);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s24_32_f32", "avx512", true, true, conv_s24_32_to_f32_avx512);
+		run_test("test_s24_32d_f32d", "avx512", false, false, conv_s24_32d_to_f32d_avx512);
+	}
+#endif
 }
 
 static void test_interleave(void)
@@ -275,6 +399,11 @@ static void test_interleave(void)
 	run_test("test_interleave_16", "c", false, true, conv_interleave_16_c);
 	run_test("test_interleave_24", "c", false, true, conv_interleave_24_c);
 	run_test("test_interleave_32", "c", false, true, conv_interleave_32_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_interleave_32", "sse2", false, true, conv_interleave_32_sse2);
+	}
+#endif
 }
 
 static void test_deinterleave(void)
@@ -283,6 +412,262 @@ static void test_deinterleave(void)
 	run_test("test_deinterleave_16", "c", true, false, conv_deinterleave_16_c);
 	run_test("test_deinterleave_24", "c", true, false, conv_deinterleave_24_c);
 	run_test("test_deinterleave_32", "c", true, false, conv_deinterleave_32_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_deinterleave_32", "sse2", true, false, conv_deinterleave_32_sse2);
+	}
+#endif
+}
+
+static void run_dither1(const char *name, const char *impl, uint32_t dst_fmt,
+		uint32_t method, uint32_t flags, int n_channels, int n_samples)
+{
+	int i, j;
+	const void *ip[n_channels];
+	void *op[n_channels];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+	struct convert conv;
+
+	spa_zero(conv);
+	conv.src_fmt = SPA_AUDIO_FORMAT_F32P;
+	conv.dst_fmt = dst_fmt;
+	conv.n_channels = n_channels;
+	conv.cpu_flags = flags;
+	conv.method = method;
+	spa_assert(convert_init(&conv) == 0);
+
+	for (j = 0; j < n_channels; j++) {
+		ip[j] = &samp_in[j * n_samples * 4];
+		op[j] = &samp_out[j * n_samples * 4];
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		convert_process(&conv, op, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	convert_free(&conv);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.n_channels = n_channels,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.name = name,
+		.impl = impl
+	};
+}
+
+static void run_dither(const char *name, uint32_t dst_fmt)
+{
+	static const struct {
+		const char *impl;
+		uint32_t method;
+		bool simd;
+	} methods[] = {
+		{ "none", DITHER_METHOD_NONE, true },
+		{ "rectangular", DITHER_METHOD_RECTANGULAR, true },
+		{ "triangular", DITHER_METHOD_TRIANGULAR, true },
+		{ "triangular-c", DITHER_METHOD_TRIANGULAR, false },
+		{ "shaped", DITHER_METHOD_SHAPED, true },
+	};
+	size_t i, j, k;
+
+	for (k = 0; k < SPA_N_ELEMENTS(methods); k++) {
+		for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
+			for (j = 0; j < SPA_N_ELEMENTS(channel_counts); j++) {
+				run_dither1(name, methods[k].impl, dst_fmt, methods[k].method,
+					methods[k].simd ? cpu_flags : 0, channel_counts[j],
+					(sample_sizes[i] + (channel_counts[j] -1)) / channel_counts[j]);
+			}
+		}
+	}
+}
+
+static void test_dither(void)
+{
+	/* the undithered conversion is the "none" result */
+	run_dither("dither_f32d_s16", SPA_AUDIO_FORMAT_S16);
+	run_dither("dither_f32d_s16d", SPA_AUDIO_FORMAT_S16P);
+	run_dither("dither_f32d_u8d", SPA_AUDIO_FORMAT_U8P);
+}
+
+#define MAX_FUSED_SAMPLES	8192
+#define MAX_FUSED_CHANNELS	8
+
+static float fused_in[MAX_FUSED_SAMPLES * MAX_FUSED_CHANNELS];
+static float fused_out[MAX_FUSED_SAMPLES * MAX_FUSED_CHANNELS];
+static float fused_tmp[3][MAX_FUSED_SAMPLES * MAX_FUSED_CHANNELS];
+
+static const int fused_sample_sizes[] = { 256, 1024, 4096 };
+
+#define POS_STEREO	{ SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR, }
+#define POS_5_1		{ SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR, SPA_AUDIO_CHANNEL_FC, \
+			  SPA_AUDIO_CHANNEL_LFE, SPA_AUDIO_CHANNEL_SL, SPA_AUDIO_CHANNEL_SR, }
+
+struct fused_setup {
+	const char *name;
+	struct spa_audio_info_raw src;
+	struct spa_audio_info_raw dst;
+};
+
+static const struct fused_setup fused_setups[] = {
+	{ "fused_s16_44100_2-f32p_48000_6",
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 44100,
+				.channels = 2, .position = POS_STEREO),
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P, .rate = 48000,
+				.channels = 6, .position = POS_5_1), },
+	{ "fused_f32_48000_2-s16_48000_2",
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32, .rate = 48000,
+				.channels = 2, .position = POS_STEREO),
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 48000,
+				.channels = 2, .position = POS_STEREO), },
+	{ "fused_s16_48000_2-f32p_44100_2",
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 48000,
+				.channels = 2, .position = POS_STEREO),
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P, .rate = 44100,
+				.channels = 2, .position = POS_STEREO), },
+	{ "fused_s32_48000_6-s16_48000_2",
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S32, .rate = 48000,
+				.channels = 6, .position = POS_5_1),
+		SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 48000,
+				.channels = 2, .position = POS_STEREO), },
+};
+
+static void init_fused(struct fused *f, const struct fused_setup *s)
+{
+	spa_zero(*f);
+	f->src_info = s->src;
+	f->mix_info[0] = s->src;
+	f->mix_info[0].format = SPA_AUDIO_FORMAT_F32P;
+	f->mix_info[1] = s->dst;
+	f->mix_info[1].format = SPA_AUDIO_FORMAT_F32P;
+	f->dst_info = s->dst;
+	f->cpu_flags = cpu_flags;
+	f->quality = RESAMPLE_DEFAULT_QUALITY;
+	spa_assert(fused_init(f) == 0);
+}
+
+static void set_planes(void *p[], void *mem, const struct spa_audio_info_raw *info)
+{
+	uint32_t i;
+	for (i = 0; i < info->channels; i++)
+		p[i] = SPA_MEMBER(mem, i * MAX_FUSED_SAMPLES * sizeof(float), void);
+}
+
+static void add_fused_result(const struct fused_setup *s, const char *impl,
+		uint32_t n_samples, uint64_t count, uint64_t t1, uint64_t t2)
+{
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.n_channels = s->dst.channels,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.name = s->name,
+		.impl = impl
+	};
+}
+
+/* run the stages one after the other over the complete buffer, like
+ * the chain of nodes inside audioconvert does */
+static void run_chained(const struct fused_setup *s, uint32_t n_samples)
+{
+	struct fused f;
+	const void *ip[MAX_FUSED_CHANNELS], *mp[MAX_FUSED_CHANNELS];
+	void *op[MAX_FUSED_CHANNELS], *up[MAX_FUSED_CHANNELS];
+	void *xp[MAX_FUSED_CHANNELS], *rp[MAX_FUSED_CHANNELS];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+	uint32_t i, in_len, out_len;
+
+	init_fused(&f, s);
+
+	set_planes((void**)ip, fused_in, &s->src);
+	set_planes(op, fused_out, &s->dst);
+	set_planes(up, fused_tmp[0], &f.mix_info[0]);
+	set_planes(xp, fused_tmp[1], &f.mix_info[1]);
+	set_planes(rp, fused_tmp[2], &f.mix_info[1]);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		in_len = resample_in_len(&f.resample, n_samples);
+		out_len = n_samples;
+
+		convert_process(&f.conv_in, up, ip, in_len);
+		memcpy(mp, up, sizeof(mp));
+		channelmix_process(&f.mix, f.mix_info[1].channels, xp,
+				f.mix_info[0].channels, mp, in_len);
+		memcpy(mp, xp, sizeof(mp));
+		resample_process(&f.resample, mp, &in_len, rp, &out_len);
+		memcpy(mp, rp, sizeof(mp));
+		convert_process(&f.conv_out, op, mp, out_len);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	add_fused_result(s, "chained", n_samples, count, t1, t2);
+
+	fused_free(&f);
+}
+
+static void run_fused(const struct fused_setup *s, uint32_t n_samples)
+{
+	struct fused f;
+	const void *ip[MAX_FUSED_CHANNELS];
+	void *op[MAX_FUSED_CHANNELS];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+	uint32_t i, in_len, out_len;
+
+	init_fused(&f, s);
+
+	set_planes((void**)ip, fused_in, &s->src);
+	set_planes(op, fused_out, &s->dst);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		in_len = resample_in_len(&f.resample, n_samples);
+		out_len = n_samples;
+		fused_process(&f, ip, &in_len, op, &out_len);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	add_fused_result(s, "fused", n_samples, count, t1, t2);
+
+	fused_free(&f);
+}
+
+static void test_fused(void)
+{
+	size_t i, j;
+
+	for (i = 0; i < SPA_N_ELEMENTS(fused_in); i++)
+		fused_in[i] = sinf(i * 0.01f) * 0.5f;
+
+	for (i = 0; i < SPA_N_ELEMENTS(fused_setups); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(fused_sample_sizes); j++) {
+			run_chained(&fused_setups[i], fused_sample_sizes[j]);
+			run_fused(&fused_setups[i], fused_sample_sizes[j]);
+		}
+	}
 }
 
 static int compare_func(const void *_a, const void *_b)
@@ -296,6 +681,34 @@ static int compare_func(const void *_a, const void *_b)
 	return 0;
 }
 
+static const struct stats *find_c_result(const struct stats *s)
+{
+	uint32_t i;
+	for (i = 0; i < n_results; i++) {
+		const struct stats *r = &results[i];
+		if (strcmp(r->impl, "c") == 0 &&
+		    strcmp(r->name, s->name) == 0 &&
+		    r->n_samples == s->n_samples &&
+		    r->n_channels == s->n_channels)
+			return r;
+	}
+	return NULL;
+}
+
+static const struct stats *find_impl_result(const struct stats *s, const char *impl)
+{
+	uint32_t i;
+	for (i = 0; i < n_results; i++) {
+		const struct stats *r = &results[i];
+		if (strcmp(r->impl, impl) == 0 &&
+		    strcmp(r->name, s->name) == 0 &&
+		    r->n_samples == s->n_samples &&
+		    r->n_channels == s->n_channels)
+			return r;
+	}
+	return NULL;
+}
+
 int main(int argc, char *argv[])
 {
 	uint32_t i;
@@ -315,6 +728,8 @@ int main(int argc, char *argv[])
 	test_s24_32_f32();
 	test_interleave();
 	test_deinterleave();
+	test_dither();
+	test_fused();
 
 	qsort(results, n_results, sizeof(struct stats), compare_func);
 
@@ -323,5 +738,43 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, channels %d\n",
 				s->perf, s->name, s->impl, s->n_samples, s->n_channels);
 	}
+
+	fprintf(stderr, "\nspeedup against c:\n");
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		const struct stats *c = find_c_result(s);
+
+		if (c == NULL || c == s || c->perf == 0)
+			continue;
+		fprintf(stderr, "%-32.32s %-6.6s \t samples %d, channels %d \t %6.2fx\n",
+				s->name, s->impl, s->n_samples, s->n_channels,
+				(double)s->perf / (double)c->perf);
+	}
+
+	fprintf(stderr, "\ndither overhead per sample:\n");
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		const struct stats *c = find_impl_result(s, "none");
+		double n = (double)s->n_samples * s->n_channels;
+
+		if (c == NULL || c == s || s->perf == 0 || c->perf == 0 || n == 0)
+			continue;
+		fprintf(stderr, "%-32.32s %-12.12s \t samples %d, channels %d \t %6.2f ns\n",
+				s->name, s->impl, s->n_samples, s->n_channels,
+				(SPA_NSEC_PER_SEC / (double)s->perf -
+				 SPA_NSEC_PER_SEC / (double)c->perf) / n);
+	}
+
+	fprintf(stderr, "\nspeedup of fused against chained:\n");
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		const struct stats *c = find_impl_result(s, "chained");
+
+		if (c == NULL || c == s || c->perf == 0)
+			continue;
+		fprintf(stderr, "%-32.32s %-6.6s \t samples %d, channels %d \t %6.2fx\n",
+				s->name, s->impl, s->n_samples, s->n_channels,
+				(double)s->perf / (double)c->perf);
+	}
 	return 0;
 }
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include "test-helper.h"
 #include "resample.h"
@@ -59,14 +60,50 @@ static const int in_rates[] = { 44100, 44100, 48000, 96000, 22050, 96000 };
 static const int out_rates[] = { 44100, 48000, 44100, 48000, 48000, 44100 };
 
 
+static const struct {
+	uint32_t filter;
+	const char *name;
+} filters[] = {
+	{ RESAMPLE_FILTER_LINEAR, "linear" },
+	{ RESAMPLE_FILTER_SHORT, "short" },
+	{ RESAMPLE_FILTER_MINIMUM, "minimum-phase" },
+};
+
 #define MAX_RESAMPLER	5
 #define MAX_SIZES	SPA_N_ELEMENTS(sample_sizes)
 #define MAX_RATES	SPA_N_ELEMENTS(in_rates)
-#define MAX_RESULTS	MAX_RESAMPLER * MAX_SIZES * MAX_RATES
+#define MAX_FILTERS	SPA_N_ELEMENTS(filters)
+#define MAX_RESULTS	(MAX_RESAMPLER * MAX_SIZES * MAX_RATES + MAX_FILTERS * MAX_RATES)
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
 
+/* the quality is measured on a sine at SINE_FREQ of the lowest rate with
+ * an integer number of cycles in the analysed output samples, after
+ * skipping the filter startup */
+#define SINE_SKIP	2048
+#define SINE_BINS	8192
+#define SINE_FREQ	0.4
+#define SINE_HARMONICS	5
+#define SINE_IN		32768
+
+struct quality_stats {
+	uint32_t in_rate;
+	uint32_t out_rate;
+	const char *filter;
+	uint32_t delay;
+	double freq;
+	double snr;
+	double thd;
+	uint64_t perf;
+};
+
+static float sine_in[SINE_IN];
+static float sine_out[SINE_SKIP + SINE_BINS];
+
+static uint32_t n_quality = 0;
+static struct quality_stats quality[MAX_FILTERS * MAX_RATES];
+
 static void run_test1(const char *name, const char *impl, struct resample *r, int n_samples)
 {
 	uint32_t i, j;
@@ -114,6 +151,77 @@ static void run_test(const char *name, const char *impl, struct resample *r)
 		run_test1(name, impl, r, sample_sizes[i]);
 }
 
+/* amplitude of the cosine and sine with the given number of cycles in d */
+static void tone_fit(const float *d, uint32_t n, uint32_t cycles, double *a, double *b)
+{
+	double w = 2.0 * M_PI * cycles / n;
+	uint32_t i;
+
+	*a = *b = 0.0;
+	for (i = 0; i < n; i++) {
+		*a += d[i] * cos(w * i);
+		*b += d[i] * sin(w * i);
+	}
+	*a *= 2.0 / n;
+	*b *= 2.0 / n;
+}
+
+static void run_quality(const char *filter, struct resample *r)
+{
+	const void *ip[1];
+	void *op[1];
+	uint32_t i, in_len, out_len, n_in = 0, n_out = 0, cycles;
+	uint32_t total = SINE_SKIP + SINE_BINS;
+	double w, a, b, signal, noise = 0.0, harmonics = 0.0;
+	const float *d = &sine_out[SINE_SKIP];
+
+	cycles = (uint32_t)(SINE_FREQ * SINE_BINS * SPA_MIN(r->i_rate, r->o_rate) / r->o_rate) | 1;
+	w = 2.0 * M_PI * cycles / SINE_BINS * r->o_rate / r->i_rate;
+	for (i = 0; i < SINE_IN; i++)
+		sine_in[i] = 0.5 * sin(w * i);
+
+	while (n_out < total) {
+		ip[0] = &sine_in[n_in];
+		op[0] = &sine_out[n_out];
+		in_len = SINE_IN - n_in;
+		out_len = total - n_out;
+		resample_process(r, ip, &in_len, op, &out_len);
+		spa_assert(in_len > 0 || out_len > 0);
+		n_in += in_len;
+		n_out += out_len;
+	}
+
+	/* everything that is not the sine is noise */
+	tone_fit(d, SINE_BINS, cycles, &a, &b);
+	signal = (a * a + b * b) / 2.0;
+	w = 2.0 * M_PI * cycles / SINE_BINS;
+	for (i = 0; i < SINE_BINS; i++) {
+		double e = d[i] - a * cos(w * i) - b * sin(w * i);
+		noise += e * e;
+	}
+	noise = SPA_MAX(noise / SINE_BINS, 1e-30);
+
+	/* harmonics above the nyquist frequency are folded back */
+	for (i = 2; i <= SINE_HARMONICS; i++) {
+		uint32_t h = (i * cycles) % SINE_BINS;
+		tone_fit(d, SINE_BINS, SPA_MIN(h, SINE_BINS - h), &a, &b);
+		harmonics += (a * a + b * b) / 2.0;
+	}
+	harmonics = SPA_MAX(harmonics, 1e-30);
+
+	spa_assert(n_quality < SPA_N_ELEMENTS(quality));
+
+	quality[n_quality++] = (struct quality_stats) {
+		.in_rate = r->i_rate,
+		.out_rate = r->o_rate,
+		.filter = filter,
+		.delay = resample_delay(r),
+		.freq = (double) cycles * r->o_rate / SINE_BINS,
+		.snr = 10.0 * log10(signal / noise),
+		.thd = 10.0 * log10(harmonics / signal),
+	};
+}
+
 static int compare_func(const void *_a, const void *_b)
 {
 	const struct stats *a = _a, *b = _b;
@@ -192,6 +300,29 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
+		uint32_t j;
+
+		if (in_rates[i] == out_rates[i])
+			continue;
+
+		for (j = 0; j < SPA_N_ELEMENTS(filters); j++) {
+			spa_zero(r);
+			r.channels = 1;
+			r.cpu_flags = cpu_flags;
+			r.i_rate = in_rates[i];
+			r.o_rate = out_rates[i];
+			r.quality = RESAMPLE_DEFAULT_QUALITY;
+			r.filter = filters[j].filter;
+			resample_native_init(&r);
+			run_quality(filters[j].name, &r);
+			resample_reset(&r);
+			run_test1(filters[j].name, "best", &r, MAX_SAMPLES);
+			quality[n_quality - 1].perf = results[n_results - 1].perf;
+			resample_free(&r);
+		}
+	}
+
 	qsort(results, n_results, sizeof(struct stats), compare_func);
 
 	for (i = 0; i < n_results; i++) {
@@ -200,5 +331,14 @@ int main(int argc, char *argv[])
 				s->perf, s->name, s->impl, s->in_rate, s->out_rate,
 				s->n_samples, s->n_channels);
 	}
+
+	fprintf(stderr, "\nquality of a sine at %.1f of the lowest rate:\n", SINE_FREQ);
+	for (i = 0; i < n_quality; i++) {
+		struct quality_stats *q = &quality[i];
+		fprintf(stderr, "%-14s %d->%d \t%5.0f Hz \tdelay %3d (%.2f ms) \tsnr %6.1f dB "
+				"\tthd %6.1f dB \t%"PRIu64"\n",
+				q->filter, q->in_rate, q->out_rate, q->freq, q->delay,
+				q->delay * 1000.0 / q->in_rate, q->snr, q->thd, q->perf);
+	}
 	return 0;
 }
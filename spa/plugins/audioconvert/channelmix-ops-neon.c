@@ -0,0 +1,92 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "channelmix-ops.h"
+
+#include <arm_neon.h>
+
+void
+channelmix_f32_n_m_neon(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, j, k, n, n_j, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+		return;
+	}
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY)) {
+		uint32_t copy = SPA_MIN(n_dst, n_src);
+		for (i = 0; i < copy; i++)
+			spa_memcpy(d[i], s[i], n_samples * sizeof(float));
+		for (; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+		return;
+	}
+
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		const float *sj[n_src];
+		float mj[n_src];
+		float32x4_t t[4];
+
+		n_j = mix->n_nonzero[i];
+		if (n_j == 0) {
+			memset(di, 0, n_samples * sizeof(float));
+			continue;
+		}
+		for (k = 0; k < n_j; k++) {
+			j = mix->nonzero[i][k];
+			sj[k] = s[j];
+			mj[k] = mix->matrix[i][j];
+		}
+		unrolled = n_samples & ~15;
+
+		for (n = 0; n < unrolled; n += 16) {
+			t[0] = vmulq_n_f32(vld1q_f32(&sj[0][n   ]), mj[0]);
+			t[1] = vmulq_n_f32(vld1q_f32(&sj[0][n+ 4]), mj[0]);
+			t[2] = vmulq_n_f32(vld1q_f32(&sj[0][n+ 8]), mj[0]);
+			t[3] = vmulq_n_f32(vld1q_f32(&sj[0][n+12]), mj[0]);
+			for (k = 1; k < n_j; k++) {
+				t[0] = vmlaq_n_f32(t[0], vld1q_f32(&sj[k][n   ]), mj[k]);
+				t[1] = vmlaq_n_f32(t[1], vld1q_f32(&sj[k][n+ 4]), mj[k]);
+				t[2] = vmlaq_n_f32(t[2], vld1q_f32(&sj[k][n+ 8]), mj[k]);
+				t[3] = vmlaq_n_f32(t[3], vld1q_f32(&sj[k][n+12]), mj[k]);
+			}
+			vst1q_f32(&di[n   ], t[0]);
+			vst1q_f32(&di[n+ 4], t[1]);
+			vst1q_f32(&di[n+ 8], t[2]);
+			vst1q_f32(&di[n+12], t[3]);
+		}
+		for (; n < n_samples; n++) {
+			float sum = sj[0][n] * mj[0];
+			for (k = 1; k < n_j; k++)
+				sum += sj[k][n] * mj[k];
+			di[n] = sum;
+		}
+	}
+}
@@ -387,3 +387,71 @@ channelmix_f32_5p1_4_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_REST
 		}
 	}
 }
+
+void
+channelmix_f32_n_m_sse(struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
+		uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples)
+{
+	uint32_t i, j, k, n, n_j, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+		return;
+	}
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY)) {
+		uint32_t copy = SPA_MIN(n_dst, n_src);
+		for (i = 0; i < copy; i++)
+			spa_memcpy(d[i], s[i], n_samples * sizeof(float));
+		for (; i < n_dst; i++)
+			memset(d[i], 0, n_samples * sizeof(float));
+		return;
+	}
+
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		const float *sj[n_src];
+		float mj[n_src];
+		__m128 vj[n_src], t[4];
+		bool aligned = SPA_IS_ALIGNED(di, 16);
+
+		n_j = mix->n_nonzero[i];
+		if (n_j == 0) {
+			memset(di, 0, n_samples * sizeof(float));
+			continue;
+		}
+		for (k = 0; k < n_j; k++) {
+			j = mix->nonzero[i][k];
+			sj[k] = s[j];
+			mj[k] = mix->matrix[i][j];
+			vj[k] = _mm_set1_ps(mj[k]);
+			aligned &= SPA_IS_ALIGNED(sj[k], 16);
+		}
+		unrolled = aligned ? n_samples & ~15 : 0;
+
+		for (n = 0; n < unrolled; n += 16) {
+			t[0] = _mm_mul_ps(_mm_load_ps(&sj[0][n   ]), vj[0]);
+			t[1] = _mm_mul_ps(_mm_load_ps(&sj[0][n+ 4]), vj[0]);
+			t[2] = _mm_mul_ps(_mm_load_ps(&sj[0][n+ 8]), vj[0]);
+			t[3] = _mm_mul_ps(_mm_load_ps(&sj[0][n+12]), vj[0]);
+			for (k = 1; k < n_j; k++) {
+				t[0] = _mm_add_ps(t[0], _mm_mul_ps(_mm_load_ps(&sj[k][n   ]), vj[k]));
+				t[1] = _mm_add_ps(t[1], _mm_mul_ps(_mm_load_ps(&sj[k][n+ 4]), vj[k]));
+				t[2] = _mm_add_ps(t[2], _mm_mul_ps(_mm_load_ps(&sj[k][n+ 8]), vj[k]));
+				t[3] = _mm_add_ps(t[3], _mm_mul_ps(_mm_load_ps(&sj[k][n+12]), vj[k]));
+			}
+			_mm_store_ps(&di[n   ], t[0]);
+			_mm_store_ps(&di[n+ 4], t[1]);
+			_mm_store_ps(&di[n+ 8], t[2]);
+			_mm_store_ps(&di[n+12], t[3]);
+		}
+		for (; n < n_samples; n++) {
+			float sum = sj[0][n] * mj[0];
+			for (k = 1; k < n_j; k++)
+				sum += sj[k][n] * mj[k];
+			di[n] = sum;
+		}
+	}
+}
@@ -59,6 +59,10 @@ struct channelmix {
 	uint32_t flags;
 	float matrix_orig[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS];
 	float matrix[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS];
+	/* input channels with a non zero coefficient for each output channel,
+	 * updated together with the flags */
+	uint32_t n_nonzero[SPA_AUDIO_MAX_CHANNELS];
+	uint8_t nonzero[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS];
 
 	void (*process) (struct channelmix *mix, uint32_t n_dst, void * SPA_RESTRICT dst[n_dst],
 			uint32_t n_src, const void * SPA_RESTRICT src[n_src], uint32_t n_samples);
@@ -99,9 +103,16 @@ DEFINE_FUNCTION(f32_7p1_4, c);
 
 #if defined (HAVE_SSE)
 DEFINE_FUNCTION(copy, sse);
+DEFINE_FUNCTION(f32_n_m, sse);
 DEFINE_FUNCTION(f32_2_4, sse);
 DEFINE_FUNCTION(f32_5p1_2, sse);
 DEFINE_FUNCTION(f32_5p1_3p1, sse);
 DEFINE_FUNCTION(f32_5p1_4, sse);
 DEFINE_FUNCTION(f32_7p1_4, sse);
 #endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+DEFINE_FUNCTION(f32_n_m, avx);
+#endif
+#if defined (HAVE_NEON)
+DEFINE_FUNCTION(f32_n_m, neon);
+#endif
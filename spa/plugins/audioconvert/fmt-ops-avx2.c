@@ -549,8 +549,8 @@ conv_f32d_to_s32_1s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	uint32_t n, unrolled;
 	__m128 in[1];
 	__m128i out[4];
-	__m128 scale = _mm_set1_ps(S32_SCALE);
-	__m128 int_min = _mm_set1_ps(S32_MIN);
+	__m128 scale = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), scale);
 
 	if (SPA_IS_ALIGNED(s0, 16))
 		unrolled = n_samples & ~3;
@@ -559,8 +559,8 @@ conv_f32d_to_s32_1s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 
 	for(n = 0; n < unrolled; n += 4) {
 		in[0] = _mm_mul_ps(_mm_load_ps(&s0[n]), scale);
-		in[0] = _mm_min_ps(in[0], int_min);
-		out[0] = _mm_cvtps_epi32(in[0]);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
 		out[1] = _mm_shuffle_epi32(out[0], _MM_SHUFFLE(0, 3, 2, 1));
 		out[2] = _mm_shuffle_epi32(out[0], _MM_SHUFFLE(1, 0, 3, 2));
 		out[3] = _mm_shuffle_epi32(out[0], _MM_SHUFFLE(2, 1, 0, 3));
@@ -574,8 +574,8 @@ conv_f32d_to_s32_1s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(; n < n_samples; n++) {
 		in[0] = _mm_load_ss(&s0[n]);
 		in[0] = _mm_mul_ss(in[0], scale);
-		in[0] = _mm_min_ss(in[0], int_min);
-		*d = _mm_cvtss_si32(in[0]);
+		in[0] = _mm_min_ss(scale, _mm_max_ss(in[0], int_min));
+		*d = _mm_cvttss_si32(in[0]) << 8;
 		d += n_channels;
 	}
 }
@@ -589,8 +589,8 @@ conv_f32d_to_s32_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	uint32_t n, unrolled;
 	__m256 in[2];
 	__m256i out[2], t[2];
-	__m256 scale = _mm256_set1_ps(S32_SCALE);
-	__m256 int_min = _mm256_set1_ps(S32_MIN);
+	__m256 scale = _mm256_set1_ps(S24_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), scale);
 
 	if (SPA_IS_ALIGNED(s0, 32) &&
 	    SPA_IS_ALIGNED(s1, 32))
@@ -602,11 +602,11 @@ conv_f32d_to_s32_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[0] = _mm256_mul_ps(_mm256_load_ps(&s0[n]), scale);
 		in[1] = _mm256_mul_ps(_mm256_load_ps(&s1[n]), scale);
 
-		in[0] = _mm256_min_ps(in[0], int_min);
-		in[1] = _mm256_min_ps(in[1], int_min);
+		in[0] = _mm256_min_ps(scale, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(scale, _mm256_max_ps(in[1], int_min));
 
-		out[0] = _mm256_cvtps_epi32(in[0]);	/* a0 a1 a2 a3 a4 a5 a6 a7 */
-		out[1] = _mm256_cvtps_epi32(in[1]);	/* b0 b1 b2 b3 b4 b5 b6 b7 */
+		out[0] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[0]), 8);	/* a0 a1 a2 a3 a4 a5 a6 a7 */
+		out[1] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[1]), 8);	/* b0 b1 b2 b3 b4 b5 b6 b7 */
 
 		t[0] = _mm256_unpacklo_epi32(out[0], out[1]); /* a0 b0 a1 b1 a4 b4 a5 b5 */
 		t[1] = _mm256_unpackhi_epi32(out[0], out[1]); /* a2 b2 a3 b3 a6 b6 a7 b7 */
@@ -635,8 +635,8 @@ conv_f32d_to_s32_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(; n < n_samples; n++) {
 		__m128 in[2];
 		__m128i out[2];
-		__m128 scale = _mm_set1_ps(S32_SCALE);
-		__m128 int_min = _mm_set1_ps(S32_MIN);
+		__m128 scale = _mm_set1_ps(S24_MAX_F);
+		__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), scale);
 
 		in[0] = _mm_load_ss(&s0[n]);
 		in[1] = _mm_load_ss(&s1[n]);
@@ -644,8 +644,8 @@ conv_f32d_to_s32_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[0] = _mm_unpacklo_ps(in[0], in[1]);
 
 		in[0] = _mm_mul_ps(in[0], scale);
-		in[0] = _mm_min_ps(in[0], int_min);
-		out[0] = _mm_cvtps_epi32(in[0]);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
 		_mm_storel_epi64((__m128i*)d, out[0]);
 		d += n_channels;
 	}
@@ -660,8 +660,8 @@ conv_f32d_to_s32_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	uint32_t n, unrolled;
 	__m256 in[4];
 	__m256i out[4], t[4];
-	__m256 scale = _mm256_set1_ps(S32_SCALE);
-	__m256 int_min = _mm256_set1_ps(S32_MIN);
+	__m256 scale = _mm256_set1_ps(S24_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), scale);
 
 	if (SPA_IS_ALIGNED(s0, 32) &&
 	    SPA_IS_ALIGNED(s1, 32) &&
@@ -677,15 +677,15 @@ conv_f32d_to_s32_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[2] = _mm256_mul_ps(_mm256_load_ps(&s2[n]), scale);
 		in[3] = _mm256_mul_ps(_mm256_load_ps(&s3[n]), scale);
 
-		in[0] = _mm256_min_ps(in[0], int_min);
-		in[1] = _mm256_min_ps(in[1], int_min);
-		in[2] = _mm256_min_ps(in[2], int_min);
-		in[3] = _mm256_min_ps(in[3], int_min);
+		in[0] = _mm256_min_ps(scale, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(scale, _mm256_max_ps(in[1], int_min));
+		in[2] = _mm256_min_ps(scale, _mm256_max_ps(in[2], int_min));
+		in[3] = _mm256_min_ps(scale, _mm256_max_ps(in[3], int_min));
 
-		out[0] = _mm256_cvtps_epi32(in[0]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
-		out[1] = _mm256_cvtps_epi32(in[1]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
-		out[2] = _mm256_cvtps_epi32(in[2]); /* c0 c1 c2 c3 c4 c5 c6 c7 */
-		out[3] = _mm256_cvtps_epi32(in[3]); /* d0 d1 d2 d3 d4 d5 d6 d7 */
+		out[0] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[0]), 8); /* a0 a1 a2 a3 a4 a5 a6 a7 */
+		out[1] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[1]), 8); /* b0 b1 b2 b3 b4 b5 b6 b7 */
+		out[2] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[2]), 8); /* c0 c1 c2 c3 c4 c5 c6 c7 */
+		out[3] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[3]), 8); /* d0 d1 d2 d3 d4 d5 d6 d7 */
 
 		t[0] = _mm256_unpacklo_epi32(out[0], out[1]); /* a0 b0 a1 b1 a4 b4 a5 b5 */
 		t[1] = _mm256_unpackhi_epi32(out[0], out[1]); /* a2 b2 a3 b3 a6 b6 a7 b7 */
@@ -710,8 +710,8 @@ conv_f32d_to_s32_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(; n < n_samples; n++) {
 		__m128 in[4];
 		__m128i out[4];
-		__m128 scale = _mm_set1_ps(S32_SCALE);
-		__m128 int_min = _mm_set1_ps(S32_MIN);
+		__m128 scale = _mm_set1_ps(S24_MAX_F);
+		__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), scale);
 
 		in[0] = _mm_load_ss(&s0[n]);
 		in[1] = _mm_load_ss(&s1[n]);
@@ -723,8 +723,8 @@ conv_f32d_to_s32_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[0] = _mm_unpacklo_ps(in[0], in[1]);
 
 		in[0] = _mm_mul_ps(in[0], scale);
-		in[0] = _mm_min_ps(in[0], int_min);
-		out[0] = _mm_cvtps_epi32(in[0]);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
 		_mm_storeu_si128((__m128i*)d, out[0]);
 		d += n_channels;
 	}
@@ -765,8 +765,10 @@ conv_f32d_to_s16_1s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(n = 0; n < unrolled; n += 8) {
 		in[0] = _mm_mul_ps(_mm_load_ps(&s0[n]), int_max);
 		in[1] = _mm_mul_ps(_mm_load_ps(&s0[n+4]), int_max);
-		out[0] = _mm_cvtps_epi32(in[0]);
-		out[1] = _mm_cvtps_epi32(in[1]);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		out[0] = _mm_cvttps_epi32(in[0]);
+		out[1] = _mm_cvttps_epi32(in[1]);
 		out[0] = _mm_packs_epi32(out[0], out[1]);
 
 		d[0*n_channels] = _mm_extract_epi16(out[0], 0);
@@ -782,7 +784,7 @@ conv_f32d_to_s16_1s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(; n < n_samples; n++) {
 		in[0] = _mm_mul_ss(_mm_load_ss(&s0[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
-		*d = _mm_cvtss_si32(in[0]);
+		*d = _mm_cvttss_si32(in[0]);
 		d += n_channels;
 	}
 }
@@ -797,6 +799,7 @@ conv_f32d_to_s16_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	__m256 in[2];
 	__m256i out[4], t[2];
 	__m256 int_max = _mm256_set1_ps(S16_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), int_max);
 
 	if (SPA_IS_ALIGNED(s0, 32) &&
 	    SPA_IS_ALIGNED(s1, 32))
@@ -807,9 +810,11 @@ conv_f32d_to_s16_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(n = 0; n < unrolled; n += 8) {
 		in[0] = _mm256_mul_ps(_mm256_load_ps(&s0[n+0]), int_max);
 		in[1] = _mm256_mul_ps(_mm256_load_ps(&s1[n+0]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
 
-		out[0] = _mm256_cvtps_epi32(in[0]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
-		out[1] = _mm256_cvtps_epi32(in[1]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
+		out[0] = _mm256_cvttps_epi32(in[0]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
+		out[1] = _mm256_cvttps_epi32(in[1]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
 
 		t[0] = _mm256_unpacklo_epi32(out[0], out[1]); /* a0 b0 a1 b1 a4 b4 a5 b5 */
 		t[1] = _mm256_unpackhi_epi32(out[0], out[1]); /* a2 b2 a3 b3 a6 b6 a7 b7 */
@@ -836,8 +841,8 @@ conv_f32d_to_s16_2s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[1] = _mm_mul_ss(_mm_load_ss(&s1[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
 		d += n_channels;
 	}
 }
@@ -852,6 +857,7 @@ conv_f32d_to_s16_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	__m256 in[4];
 	__m256i out[4], t[4];
 	__m256 int_max = _mm256_set1_ps(S16_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), int_max);
 
 	if (SPA_IS_ALIGNED(s0, 32) &&
 	    SPA_IS_ALIGNED(s1, 32) &&
@@ -866,11 +872,15 @@ conv_f32d_to_s16_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[1] = _mm256_mul_ps(_mm256_load_ps(&s1[n]), int_max);
 		in[2] = _mm256_mul_ps(_mm256_load_ps(&s2[n]), int_max);
 		in[3] = _mm256_mul_ps(_mm256_load_ps(&s3[n]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
+		in[2] = _mm256_min_ps(int_max, _mm256_max_ps(in[2], int_min));
+		in[3] = _mm256_min_ps(int_max, _mm256_max_ps(in[3], int_min));
 
-		t[0] = _mm256_cvtps_epi32(in[0]);  /* a0 a1 a2 a3 a4 a5 a6 a7 */
-		t[1] = _mm256_cvtps_epi32(in[1]);  /* b0 b1 b2 b3 b4 b5 b6 b7 */
-		t[2] = _mm256_cvtps_epi32(in[2]);  /* c0 c1 c2 c3 c4 c5 c6 c7 */
-		t[3] = _mm256_cvtps_epi32(in[3]);  /* d0 d1 d2 d3 d4 d5 d6 d7 */
+		t[0] = _mm256_cvttps_epi32(in[0]);  /* a0 a1 a2 a3 a4 a5 a6 a7 */
+		t[1] = _mm256_cvttps_epi32(in[1]);  /* b0 b1 b2 b3 b4 b5 b6 b7 */
+		t[2] = _mm256_cvttps_epi32(in[2]);  /* c0 c1 c2 c3 c4 c5 c6 c7 */
+		t[3] = _mm256_cvttps_epi32(in[3]);  /* d0 d1 d2 d3 d4 d5 d6 d7 */
 
 		t[0] = _mm256_packs_epi32(t[0], t[2]); /* a0 a1 a2 a3 c0 c1 c2 c3 a4 a5 a6 a7 c4 c5 c6 c7 */
 		t[1] = _mm256_packs_epi32(t[1], t[3]); /* b0 b1 b2 b3 d0 d1 d2 d3 b4 b5 b6 b7 d4 d5 d6 d7 */
@@ -916,10 +926,10 @@ conv_f32d_to_s16_4s_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
 		in[2] = _mm_min_ss(int_max, _mm_max_ss(in[2], int_min));
 		in[3] = _mm_min_ss(int_max, _mm_max_ss(in[3], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
-		d[2] = _mm_cvtss_si32(in[2]);
-		d[3] = _mm_cvtss_si32(in[3]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
+		d[2] = _mm_cvttss_si32(in[2]);
+		d[3] = _mm_cvttss_si32(in[3]);
 		d += n_channels;
 	}
 }
@@ -949,6 +959,7 @@ conv_f32d_to_s16_4_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 	__m256 in[4];
 	__m256i out[4], t[4];
 	__m256 int_max = _mm256_set1_ps(S16_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), int_max);
 
 	if (SPA_IS_ALIGNED(s0, 32) &&
 	    SPA_IS_ALIGNED(s1, 32) &&
@@ -963,11 +974,15 @@ conv_f32d_to_s16_4_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		in[1] = _mm256_mul_ps(_mm256_load_ps(&s1[n]), int_max);
 		in[2] = _mm256_mul_ps(_mm256_load_ps(&s2[n]), int_max);
 		in[3] = _mm256_mul_ps(_mm256_load_ps(&s3[n]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
+		in[2] = _mm256_min_ps(int_max, _mm256_max_ps(in[2], int_min));
+		in[3] = _mm256_min_ps(int_max, _mm256_max_ps(in[3], int_min));
 
-		t[0] = _mm256_cvtps_epi32(in[0]);  /* a0 a1 a2 a3 a4 a5 a6 a7 */
-		t[1] = _mm256_cvtps_epi32(in[1]);  /* b0 b1 b2 b3 b4 b5 b6 b7 */
-		t[2] = _mm256_cvtps_epi32(in[2]);  /* c0 c1 c2 c3 c4 c5 c6 c7 */
-		t[3] = _mm256_cvtps_epi32(in[3]);  /* d0 d1 d2 d3 d4 d5 d6 d7 */
+		t[0] = _mm256_cvttps_epi32(in[0]);  /* a0 a1 a2 a3 a4 a5 a6 a7 */
+		t[1] = _mm256_cvttps_epi32(in[1]);  /* b0 b1 b2 b3 b4 b5 b6 b7 */
+		t[2] = _mm256_cvttps_epi32(in[2]);  /* c0 c1 c2 c3 c4 c5 c6 c7 */
+		t[3] = _mm256_cvttps_epi32(in[3]);  /* d0 d1 d2 d3 d4 d5 d6 d7 */
 
 		t[0] = _mm256_packs_epi32(t[0], t[2]); /* a0 a1 a2 a3 c0 c1 c2 c3 a4 a5 a6 a7 c4 c5 c6 c7 */
 		t[1] = _mm256_packs_epi32(t[1], t[3]); /* b0 b1 b2 b3 d0 d1 d2 d3 b4 b5 b6 b7 d4 d5 d6 d7 */
@@ -998,10 +1013,10 @@ conv_f32d_to_s16_4_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
 		in[2] = _mm_min_ss(int_max, _mm_max_ss(in[2], int_min));
 		in[3] = _mm_min_ss(int_max, _mm_max_ss(in[3], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
-		d[2] = _mm_cvtss_si32(in[2]);
-		d[3] = _mm_cvtss_si32(in[3]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
+		d[2] = _mm_cvttss_si32(in[2]);
+		d[3] = _mm_cvttss_si32(in[3]);
 		d += 4;
 	}
 }
@@ -1015,6 +1030,7 @@ conv_f32d_to_s16_2_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 	__m256 in[4];
 	__m256i out[4], t[4];
 	__m256 int_max = _mm256_set1_ps(S16_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), int_max);
 
 	if (SPA_IS_ALIGNED(s0, 32) &&
 	    SPA_IS_ALIGNED(s1, 32))
@@ -1027,11 +1043,15 @@ conv_f32d_to_s16_2_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		in[1] = _mm256_mul_ps(_mm256_load_ps(&s1[n+0]), int_max);
 		in[2] = _mm256_mul_ps(_mm256_load_ps(&s0[n+8]), int_max);
 		in[3] = _mm256_mul_ps(_mm256_load_ps(&s1[n+8]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
+		in[2] = _mm256_min_ps(int_max, _mm256_max_ps(in[2], int_min));
+		in[3] = _mm256_min_ps(int_max, _mm256_max_ps(in[3], int_min));
 
-		out[0] = _mm256_cvtps_epi32(in[0]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
-		out[1] = _mm256_cvtps_epi32(in[1]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
-		out[2] = _mm256_cvtps_epi32(in[2]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
-		out[3] = _mm256_cvtps_epi32(in[3]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
+		out[0] = _mm256_cvttps_epi32(in[0]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
+		out[1] = _mm256_cvttps_epi32(in[1]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
+		out[2] = _mm256_cvttps_epi32(in[2]); /* a0 a1 a2 a3 a4 a5 a6 a7 */
+		out[3] = _mm256_cvttps_epi32(in[3]); /* b0 b1 b2 b3 b4 b5 b6 b7 */
 
 		t[0] = _mm256_unpacklo_epi32(out[0], out[1]); /* a0 b0 a1 b1 a4 b4 a5 b5 */
 		t[1] = _mm256_unpackhi_epi32(out[0], out[1]); /* a2 b2 a3 b3 a6 b6 a7 b7 */
@@ -1055,8 +1075,449 @@ conv_f32d_to_s16_2_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		in[1] = _mm_mul_ss(_mm_load_ss(&s1[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
 		d += 2;
 	}
 }
+
+static void
+conv_s16_to_f32_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const int16_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m256i in[2];
+	__m256 out[2], factor = _mm256_set1_ps(1.0f / S16_SCALE);
+	__m128 tmp, factor1 = _mm_set1_ps(1.0f / S16_SCALE);
+
+	if (SPA_IS_ALIGNED(d, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*)&s[n+0]));
+		in[1] = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*)&s[n+8]));
+		out[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(in[0]), factor);
+		out[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(in[1]), factor);
+		_mm256_store_ps(&d[n+0], out[0]);
+		_mm256_store_ps(&d[n+8], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_cvtsi32_ss(factor1, s[n]);
+		tmp = _mm_mul_ss(tmp, factor1);
+		_mm_store_ss(&d[n], tmp);
+	}
+}
+
+void
+conv_s16d_to_f32d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_s16_to_f32_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_s16_to_f32_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_s16_to_f32_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s16_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	uint32_t n, unrolled;
+	__m256 in[2];
+	__m256i out[2];
+	__m256 int_max = _mm256_set1_ps(S16_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), int_max);
+	__m128 tmp, int_max1 = _mm_set1_ps(S16_MAX_F);
+	__m128 int_min1 = _mm_sub_ps(_mm_setzero_ps(), int_max1);
+
+	if (SPA_IS_ALIGNED(s, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_mul_ps(_mm256_load_ps(&s[n+0]), int_max);
+		in[1] = _mm256_mul_ps(_mm256_load_ps(&s[n+8]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
+		out[0] = _mm256_cvttps_epi32(in[0]);
+		out[1] = _mm256_cvttps_epi32(in[1]);
+		out[0] = _mm256_packs_epi32(out[0], out[1]);
+		out[0] = _mm256_permute4x64_epi64(out[0], _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)&d[n], out[0]);
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_mul_ss(_mm_load_ss(&s[n]), int_max1);
+		tmp = _mm_min_ss(int_max1, _mm_max_ss(tmp, int_min1));
+		d[n] = _mm_cvttss_si32(tmp);
+	}
+}
+
+void
+conv_f32d_to_s16d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s16_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s16_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s16_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_s32_to_f32_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m256i in[2];
+	__m256 out[2], factor = _mm256_set1_ps(1.0f / S24_SCALE);
+	__m128 tmp, factor1 = _mm_set1_ps(1.0f / S24_SCALE);
+
+	if (SPA_IS_ALIGNED(s, 32) && SPA_IS_ALIGNED(d, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_srai_epi32(_mm256_load_si256((__m256i*)&s[n+0]), 8);
+		in[1] = _mm256_srai_epi32(_mm256_load_si256((__m256i*)&s[n+8]), 8);
+		out[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(in[0]), factor);
+		out[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(in[1]), factor);
+		_mm256_store_ps(&d[n+0], out[0]);
+		_mm256_store_ps(&d[n+8], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_cvtsi32_ss(factor1, s[n]>>8);
+		tmp = _mm_mul_ss(tmp, factor1);
+		_mm_store_ss(&d[n], tmp);
+	}
+}
+
+void
+conv_s32d_to_f32d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_s32_to_f32_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_s32_to_f32_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_s32_to_f32_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s32_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m256 in[2];
+	__m256i out[2];
+	__m256 int_max = _mm256_set1_ps(S24_MAX_F);
+	__m256 int_min = _mm256_set1_ps(-S24_MAX_F);
+
+	if (SPA_IS_ALIGNED(s, 32) && SPA_IS_ALIGNED(d, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_mul_ps(_mm256_load_ps(&s[n+0]), int_max);
+		in[1] = _mm256_mul_ps(_mm256_load_ps(&s[n+8]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
+		out[0] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[0]), 8);
+		out[1] = _mm256_slli_epi32(_mm256_cvttps_epi32(in[1]), 8);
+		_mm256_store_si256((__m256i*)&d[n+0], out[0]);
+		_mm256_store_si256((__m256i*)&d[n+8], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = F32_TO_S32(s[n]);
+}
+
+void
+conv_f32d_to_s32d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s32_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s32_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s32_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_s24_32_to_f32_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m256i in[2];
+	__m256 out[2], factor = _mm256_set1_ps(1.0f / S24_SCALE);
+	__m128 tmp, factor1 = _mm_set1_ps(1.0f / S24_SCALE);
+
+	if (SPA_IS_ALIGNED(s, 32) && SPA_IS_ALIGNED(d, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_load_si256((__m256i*)&s[n+0]);
+		in[1] = _mm256_load_si256((__m256i*)&s[n+8]);
+		out[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(in[0]), factor);
+		out[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(in[1]), factor);
+		_mm256_store_ps(&d[n+0], out[0]);
+		_mm256_store_ps(&d[n+8], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_cvtsi32_ss(factor1, s[n]);
+		tmp = _mm_mul_ss(tmp, factor1);
+		_mm_store_ss(&d[n], tmp);
+	}
+}
+
+void
+conv_s24_32d_to_f32d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_s24_32_to_f32_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_s24_32_to_f32_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_s24_32_to_f32_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s24_32_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m256 in[2];
+	__m256i out[2];
+	__m256 int_max = _mm256_set1_ps(S24_MAX_F);
+	__m256 int_min = _mm256_sub_ps(_mm256_setzero_ps(), int_max);
+	__m128 tmp, int_max1 = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min1 = _mm_sub_ps(_mm_setzero_ps(), int_max1);
+
+	if (SPA_IS_ALIGNED(s, 32) && SPA_IS_ALIGNED(d, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_mul_ps(_mm256_load_ps(&s[n+0]), int_max);
+		in[1] = _mm256_mul_ps(_mm256_load_ps(&s[n+8]), int_max);
+		in[0] = _mm256_min_ps(int_max, _mm256_max_ps(in[0], int_min));
+		in[1] = _mm256_min_ps(int_max, _mm256_max_ps(in[1], int_min));
+		out[0] = _mm256_cvttps_epi32(in[0]);
+		out[1] = _mm256_cvttps_epi32(in[1]);
+		_mm256_store_si256((__m256i*)&d[n+0], out[0]);
+		_mm256_store_si256((__m256i*)&d[n+8], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_mul_ss(_mm_load_ss(&s[n]), int_max1);
+		tmp = _mm_min_ss(int_max1, _mm_max_ss(tmp, int_min1));
+		d[n] = _mm_cvttss_si32(tmp);
+	}
+}
+
+void
+conv_f32d_to_s24_32d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s24_32_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s24_32_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s24_32_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_u8_to_f32_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const uint8_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m256i in[2];
+	__m256 out[2], factor = _mm256_set1_ps(1.0f / U8_OFFS), one = _mm256_set1_ps(1.0f);
+
+	if (SPA_IS_ALIGNED(d, 32))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)&s[n+0]));
+		in[1] = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)&s[n+8]));
+		out[0] = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(in[0]), factor), one);
+		out[1] = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(in[1]), factor), one);
+		_mm256_store_ps(&d[n+0], out[0]);
+		_mm256_store_ps(&d[n+8], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = U8_TO_F32(s[n]);
+}
+
+void
+conv_u8d_to_f32d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_u8_to_f32_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_u8_to_f32_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_u8_to_f32_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_u8_1_avx2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	uint8_t *d = dst;
+	uint32_t n, unrolled;
+	__m256 in[4];
+	__m256i out[4];
+	__m256 scale = _mm256_set1_ps(U8_SCALE), offs = _mm256_set1_ps(U8_OFFS);
+	__m256 max = _mm256_set1_ps(1.0f), min = _mm256_set1_ps(-1.0f);
+	__m256i perm = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	if (SPA_IS_ALIGNED(s, 32))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm256_min_ps(max, _mm256_max_ps(_mm256_load_ps(&s[n+ 0]), min));
+		in[1] = _mm256_min_ps(max, _mm256_max_ps(_mm256_load_ps(&s[n+ 8]), min));
+		in[2] = _mm256_min_ps(max, _mm256_max_ps(_mm256_load_ps(&s[n+16]), min));
+		in[3] = _mm256_min_ps(max, _mm256_max_ps(_mm256_load_ps(&s[n+24]), min));
+		out[0] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(in[0], scale), offs));
+		out[1] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(in[1], scale), offs));
+		out[2] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(in[2], scale), offs));
+		out[3] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(in[3], scale), offs));
+		out[0] = _mm256_packs_epi32(out[0], out[1]);
+		out[2] = _mm256_packs_epi32(out[2], out[3]);
+		out[0] = _mm256_packus_epi16(out[0], out[2]);
+		out[0] = _mm256_permutevar8x32_epi32(out[0], perm);
+		_mm256_storeu_si256((__m256i*)&d[n], out[0]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = F32_TO_U8(s[n]);
+}
+
+void
+conv_f32d_to_u8d_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_u8_1_avx2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_u8_avx2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_u8_1_avx2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static inline __m256i
+dither_random_avx2(__m256i *state)
+{
+	__m256i x = *state;
+	x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+	x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+	*state = x;
+	return x;
+}
+
+static inline __m256
+dither_level_avx2(__m256 v, __m256 offs, __m256 min, __m256 max, __m256 inv)
+{
+	__m256 q, bias;
+
+	q = _mm256_cvtepi32_ps(_mm256_cvtps_epi32(_mm256_min_ps(max, _mm256_max_ps(v, min))));
+	bias = _mm256_add_ps(_mm256_set1_ps(0.25f),
+			_mm256_and_ps(_mm256_cmp_ps(q, _mm256_setzero_ps(), _CMP_LT_OQ),
+				_mm256_set1_ps(-0.5f)));
+	return _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(q, bias), offs), inv);
+}
+
+void
+conv_dither_f32_avx2(struct convert *conv, uint32_t channel, float * SPA_RESTRICT dst,
+		const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t n, unrolled, *r = &conv->random[channel * DITHER_LANES];
+	const bool triangular = conv->method != DITHER_METHOD_RECTANGULAR;
+	__m256i rnd;
+	__m256 v;
+	__m256 scale = _mm256_set1_ps(conv->scale), offs = _mm256_set1_ps(conv->offs);
+	__m256 min = _mm256_set1_ps(conv->min), max = _mm256_set1_ps(conv->max);
+	__m256 inv = _mm256_set1_ps(1.0f / conv->scale);
+	__m256 factor = _mm256_set1_ps(1.0f / 4294967296.0f);
+
+	rnd = _mm256_loadu_si256((__m256i*)r);
+
+	unrolled = n_samples & ~7;
+	for(n = 0; n < unrolled; n += 8) {
+		v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&src[n]), scale), offs);
+		v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_cvtepi32_ps(dither_random_avx2(&rnd)), factor));
+		if (triangular)
+			v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_cvtepi32_ps(dither_random_avx2(&rnd)), factor));
+		_mm256_storeu_ps(&dst[n], dither_level_avx2(v, offs, min, max, inv));
+	}
+	_mm256_storeu_si256((__m256i*)r, rnd);
+
+	if (n < n_samples)
+		conv_dither_f32_c(conv, channel, &dst[n], &src[n], n_samples - n);
+}
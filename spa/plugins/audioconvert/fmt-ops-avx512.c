@@ -0,0 +1,395 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fmt-ops.h"
+
+#include <immintrin.h>
+
+static void
+conv_s16_to_f32_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const int16_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m512i in[2];
+	__m512 out[2], factor = _mm512_set1_ps(1.0f / S16_SCALE);
+
+	if (SPA_IS_ALIGNED(d, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_cvtepi16_epi32(_mm256_loadu_si256((__m256i*)&s[n+ 0]));
+		in[1] = _mm512_cvtepi16_epi32(_mm256_loadu_si256((__m256i*)&s[n+16]));
+		out[0] = _mm512_mul_ps(_mm512_cvtepi32_ps(in[0]), factor);
+		out[1] = _mm512_mul_ps(_mm512_cvtepi32_ps(in[1]), factor);
+		_mm512_store_ps(&d[n+ 0], out[0]);
+		_mm512_store_ps(&d[n+16], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = S16_TO_F32(s[n]);
+}
+
+void
+conv_s16d_to_f32d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_s16_to_f32_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_s16_to_f32_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_s16_to_f32_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s16_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	uint32_t n, unrolled;
+	__m512 in[2];
+	__m512i out[2];
+	__m512 int_max = _mm512_set1_ps(S16_MAX_F);
+	__m512 int_min = _mm512_set1_ps(-S16_MAX_F);
+	__m128 tmp, int_max1 = _mm_set1_ps(S16_MAX_F);
+	__m128 int_min1 = _mm_set1_ps(-S16_MAX_F);
+
+	if (SPA_IS_ALIGNED(s, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_mul_ps(_mm512_load_ps(&s[n+ 0]), int_max);
+		in[1] = _mm512_mul_ps(_mm512_load_ps(&s[n+16]), int_max);
+		in[0] = _mm512_min_ps(int_max, _mm512_max_ps(in[0], int_min));
+		in[1] = _mm512_min_ps(int_max, _mm512_max_ps(in[1], int_min));
+		out[0] = _mm512_cvttps_epi32(in[0]);
+		out[1] = _mm512_cvttps_epi32(in[1]);
+		_mm256_storeu_si256((__m256i*)&d[n+ 0], _mm512_cvtsepi32_epi16(out[0]));
+		_mm256_storeu_si256((__m256i*)&d[n+16], _mm512_cvtsepi32_epi16(out[1]));
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_mul_ss(_mm_load_ss(&s[n]), int_max1);
+		tmp = _mm_min_ss(int_max1, _mm_max_ss(tmp, int_min1));
+		d[n] = _mm_cvttss_si32(tmp);
+	}
+}
+
+void
+conv_f32d_to_s16d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s16_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s16_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s16_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_s32_to_f32_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m512i in[2];
+	__m512 out[2], factor = _mm512_set1_ps(1.0f / S24_SCALE);
+
+	if (SPA_IS_ALIGNED(s, 64) && SPA_IS_ALIGNED(d, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_srai_epi32(_mm512_load_si512(&s[n+ 0]), 8);
+		in[1] = _mm512_srai_epi32(_mm512_load_si512(&s[n+16]), 8);
+		out[0] = _mm512_mul_ps(_mm512_cvtepi32_ps(in[0]), factor);
+		out[1] = _mm512_mul_ps(_mm512_cvtepi32_ps(in[1]), factor);
+		_mm512_store_ps(&d[n+ 0], out[0]);
+		_mm512_store_ps(&d[n+16], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = S32_TO_F32(s[n]);
+}
+
+void
+conv_s32d_to_f32d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_s32_to_f32_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_s32_to_f32_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_s32_to_f32_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s32_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m512 in[2];
+	__m512i out[2];
+	__m512 int_max = _mm512_set1_ps(S24_MAX_F);
+	__m512 int_min = _mm512_set1_ps(-S24_MAX_F);
+
+	if (SPA_IS_ALIGNED(s, 64) && SPA_IS_ALIGNED(d, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_mul_ps(_mm512_load_ps(&s[n+ 0]), int_max);
+		in[1] = _mm512_mul_ps(_mm512_load_ps(&s[n+16]), int_max);
+		in[0] = _mm512_min_ps(int_max, _mm512_max_ps(in[0], int_min));
+		in[1] = _mm512_min_ps(int_max, _mm512_max_ps(in[1], int_min));
+		out[0] = _mm512_slli_epi32(_mm512_cvttps_epi32(in[0]), 8);
+		out[1] = _mm512_slli_epi32(_mm512_cvttps_epi32(in[1]), 8);
+		_mm512_store_si512(&d[n+ 0], out[0]);
+		_mm512_store_si512(&d[n+16], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = F32_TO_S32(s[n]);
+}
+
+void
+conv_f32d_to_s32d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s32_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s32_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s32_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_s24_32_to_f32_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const int32_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m512i in[2];
+	__m512 out[2], factor = _mm512_set1_ps(1.0f / S24_SCALE);
+
+	if (SPA_IS_ALIGNED(s, 64) && SPA_IS_ALIGNED(d, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_load_si512(&s[n+ 0]);
+		in[1] = _mm512_load_si512(&s[n+16]);
+		out[0] = _mm512_mul_ps(_mm512_cvtepi32_ps(in[0]), factor);
+		out[1] = _mm512_mul_ps(_mm512_cvtepi32_ps(in[1]), factor);
+		_mm512_store_ps(&d[n+ 0], out[0]);
+		_mm512_store_ps(&d[n+16], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = S24_TO_F32(s[n]);
+}
+
+void
+conv_s24_32d_to_f32d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_s24_32_to_f32_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_s24_32_to_f32_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_s24_32_to_f32_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s24_32_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m512 in[2];
+	__m512i out[2];
+	__m512 int_max = _mm512_set1_ps(S24_MAX_F);
+	__m512 int_min = _mm512_set1_ps(-S24_MAX_F);
+	__m128 tmp, int_max1 = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min1 = _mm_set1_ps(-S24_MAX_F);
+
+	if (SPA_IS_ALIGNED(s, 64) && SPA_IS_ALIGNED(d, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_mul_ps(_mm512_load_ps(&s[n+ 0]), int_max);
+		in[1] = _mm512_mul_ps(_mm512_load_ps(&s[n+16]), int_max);
+		in[0] = _mm512_min_ps(int_max, _mm512_max_ps(in[0], int_min));
+		in[1] = _mm512_min_ps(int_max, _mm512_max_ps(in[1], int_min));
+		out[0] = _mm512_cvttps_epi32(in[0]);
+		out[1] = _mm512_cvttps_epi32(in[1]);
+		_mm512_store_si512(&d[n+ 0], out[0]);
+		_mm512_store_si512(&d[n+16], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		tmp = _mm_mul_ss(_mm_load_ss(&s[n]), int_max1);
+		tmp = _mm_min_ss(int_max1, _mm_max_ss(tmp, int_min1));
+		d[n] = _mm_cvttss_si32(tmp);
+	}
+}
+
+void
+conv_f32d_to_s24_32d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s24_32_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s24_32_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s24_32_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_u8_to_f32_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const uint8_t *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m512i in[2];
+	__m512 out[2], factor = _mm512_set1_ps(1.0f / U8_OFFS), one = _mm512_set1_ps(1.0f);
+
+	if (SPA_IS_ALIGNED(d, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i*)&s[n+ 0]));
+		in[1] = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i*)&s[n+16]));
+		out[0] = _mm512_sub_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(in[0]), factor), one);
+		out[1] = _mm512_sub_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(in[1]), factor), one);
+		_mm512_store_ps(&d[n+ 0], out[0]);
+		_mm512_store_ps(&d[n+16], out[1]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = U8_TO_F32(s[n]);
+}
+
+void
+conv_u8d_to_f32d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_u8_to_f32_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_u8_to_f32_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_u8_to_f32_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_u8_1_avx512(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	uint8_t *d = dst;
+	uint32_t n, unrolled;
+	__m512 in[2];
+	__m512i out[2];
+	__m512 scale = _mm512_set1_ps(U8_SCALE), offs = _mm512_set1_ps(U8_OFFS);
+	__m512 max = _mm512_set1_ps(1.0f), min = _mm512_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s, 64))
+		unrolled = n_samples & ~31;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 32) {
+		in[0] = _mm512_min_ps(max, _mm512_max_ps(_mm512_load_ps(&s[n+ 0]), min));
+		in[1] = _mm512_min_ps(max, _mm512_max_ps(_mm512_load_ps(&s[n+16]), min));
+		out[0] = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(in[0], scale), offs));
+		out[1] = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(in[1], scale), offs));
+		_mm_storeu_si128((__m128i*)&d[n+ 0], _mm512_cvtusepi32_epi8(out[0]));
+		_mm_storeu_si128((__m128i*)&d[n+16], _mm512_cvtusepi32_epi8(out[1]));
+	}
+	for(; n < n_samples; n++)
+		d[n] = F32_TO_U8(s[n]);
+}
+
+void
+conv_f32d_to_u8d_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_u8_1_avx512(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_u8_avx512(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_u8_1_avx512(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
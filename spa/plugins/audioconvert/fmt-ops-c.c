@@ -830,3 +830,55 @@ conv_interleave_32_c(struct convert *conv, void * SPA_RESTRICT dst[], const void
 			*d++ = s[i][j];
 	}
 }
+
+void
+conv_dither_f32_c(struct convert *conv, uint32_t channel, float * SPA_RESTRICT dst,
+		const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t n, *r = &conv->random[channel * DITHER_LANES];
+	const float scale = conv->scale, offs = conv->offs;
+	const float min = conv->min, max = conv->max, inv = 1.0f / scale;
+	const bool triangular = conv->method != DITHER_METHOD_RECTANGULAR;
+	float v;
+
+	for (n = 0; n < n_samples; n++) {
+		uint32_t *l = &r[n % DITHER_LANES];
+
+		v = src[n] * scale + offs;
+		v += dither_random(l);
+		if (triangular)
+			v += dither_random(l);
+		dst[n] = dither_level(dither_round(SPA_CLAMP(v, min, max)), offs, inv);
+	}
+}
+
+/* 3 tap error feedback filter that moves the noise to the high
+ * frequencies where the ear is less sensitive to it */
+static const float ns_taps[] = { 1.623f, -0.982f, 0.109f };
+
+void
+conv_dither_f32_shaped_c(struct convert *conv, uint32_t channel, float * SPA_RESTRICT dst,
+		const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t n, *r = &conv->random[channel * DITHER_LANES];
+	float *e = &conv->ns_data[channel * NS_MAX];
+	const float scale = conv->scale, offs = conv->offs;
+	const float min = conv->min, max = conv->max, inv = 1.0f / scale;
+	float v, q, err;
+
+	for (n = 0; n < n_samples; n++) {
+		uint32_t *l = &r[n % DITHER_LANES];
+
+		v = src[n] * scale + offs;
+		v -= ns_taps[0] * e[0] + ns_taps[1] * e[1] + ns_taps[2] * e[2];
+		q = dither_round(SPA_CLAMP(v + dither_random(l) + dither_random(l), min, max));
+
+		/* don't let clipping blow up the feedback loop */
+		err = SPA_CLAMP(q - v, -1.5f, 1.5f);
+		e[2] = e[1];
+		e[1] = e[0];
+		e[0] = err;
+
+		dst[n] = dither_level(q, offs, inv);
+	}
+}
@@ -36,10 +36,12 @@ conv_s16_to_f32d_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 	float *d0 = dst[0], *d1 = dst[1];
 	uint32_t stride = n_channels << 1;
 	unsigned int remainder = n_samples & 3;
+	union { float f; uint32_t i; } factor = { .f = 1.0f / S16_SCALE };
 	n_samples -= remainder;
 
 #ifdef __aarch64__
 	asm volatile(
+		"      dup v4.4s, %w[factor]\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
@@ -50,8 +52,10 @@ conv_s16_to_f32d_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      subs %[n_samples], %[n_samples], #4\n"
 		"      sshll v2.4s, v0.4h, #0\n"
 		"      sshll v3.4s, v1.4h, #0\n"
-		"      scvtf v0.4s, v2.4s, #15\n"
-		"      scvtf v1.4s, v3.4s, #15\n"
+		"      scvtf v0.4s, v2.4s\n"
+		"      scvtf v1.4s, v3.4s\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
+		"      fmul v1.4s, v1.4s, v4.4s\n"
 		"      st1 { v0.4s }, [%[d0]], #16\n"
 		"      st1 { v1.4s }, [%[d1]], #16\n"
 		"      bne 1b\n"
@@ -63,18 +67,21 @@ conv_s16_to_f32d_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      subs %[remainder], %[remainder], #1\n"
 		"      sshll v2.4s, v0.4h, #0\n"
 		"      sshll v3.4s, v1.4h, #0\n"
-		"      scvtf v0.4s, v2.4s, #15\n"
-		"      scvtf v1.4s, v3.4s, #15\n"
+		"      scvtf v0.4s, v2.4s\n"
+		"      scvtf v1.4s, v3.4s\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
+		"      fmul v1.4s, v1.4s, v4.4s\n"
 		"      st1 { v0.s }[0], [%[d0]], #4\n"
 		"      st1 { v1.s }[0], [%[d1]], #4\n"
 		"      bne 3b\n"
 		"4:"
 		: [d0] "+r" (d0), [d1] "+r" (d1), [s] "+r" (s), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "v0", "v1", "v2", "v3");
+		: [stride] "r" (stride), [factor] "r" (factor.i)
+		: "cc", "v0", "v1", "v2", "v3", "v4");
 #else
 	asm volatile(
+		"      vdup.32 q2, %[factor]\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
@@ -85,8 +92,10 @@ conv_s16_to_f32d_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      subs %[n_samples], %[n_samples], #4\n"
 		"      vmovl.s16 q1, d1\n"
 		"      vmovl.s16 q0, d0\n"
-		"      vcvt.f32.s32 q0, q0, #15\n"
-		"      vcvt.f32.s32 q1, q1, #15\n"
+		"      vcvt.f32.s32 q0, q0\n"
+		"      vcvt.f32.s32 q1, q1\n"
+		"      vmul.f32 q0, q0, q2\n"
+		"      vmul.f32 q1, q1, q2\n"
 		"      vst1.32 { q0 }, [%[d0]]!\n"
 		"      vst1.32 { q1 }, [%[d1]]!\n"
 		"      bne 1b\n"
@@ -98,16 +107,18 @@ conv_s16_to_f32d_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      subs %[remainder], %[remainder], #1\n"
 		"      vmovl.s16 q1, d1\n"
 		"      vmovl.s16 q0, d0\n"
-		"      vcvt.f32.s32 q0, q0, #15\n"
-		"      vcvt.f32.s32 q1, q1, #15\n"
+		"      vcvt.f32.s32 q0, q0\n"
+		"      vcvt.f32.s32 q1, q1\n"
+		"      vmul.f32 q0, q0, q2\n"
+		"      vmul.f32 q1, q1, q2\n"
 		"      vst1.32 { d0[0] }, [%[d0]]!\n"
 		"      vst1.32 { d1[0] }, [%[d1]]!\n"
 		"      bne 3b\n"
 		"4:"
 		: [d0] "+r" (d0), [d1] "+r" (d1), [s] "+r" (s), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "q0", "q1");
+		: [stride] "r" (stride), [factor] "r" (factor.i)
+		: "cc", "q0", "q1", "q2");
 #endif
 }
 
@@ -119,10 +130,12 @@ conv_s16_to_f32d_1s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 	float *d = dst[0];
 	uint32_t stride = n_channels << 1;
 	uint32_t remainder = n_samples & 3;
+	union { float f; uint32_t i; } factor = { .f = 1.0f / S16_SCALE };
 	n_samples -= remainder;
 
 #ifdef __aarch64__
 	asm volatile(
+		"      dup v4.4s, %w[factor]\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
@@ -132,7 +145,8 @@ conv_s16_to_f32d_1s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      ld1 { v0.h }[3], [%[s]], %[stride]\n"
 		"      subs %[n_samples], %[n_samples], #4\n"
 		"      sshll v1.4s, v0.4h, #0\n"
-		"      scvtf v0.4s, v1.4s, #15\n"
+		"      scvtf v0.4s, v1.4s\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
 		"      st1 { v0.4s }, [%[d]], #16\n"
 		"      bne 1b\n"
 		"2:"
@@ -142,16 +156,18 @@ conv_s16_to_f32d_1s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      ld1 { v0.h }[0], [%[s]], %[stride]\n"
 		"      subs %[remainder], %[remainder], #1\n"
 		"      sshll v1.4s, v0.4h, #0\n"
-		"      scvtf v0.4s, v1.4s, #15\n"
+		"      scvtf v0.4s, v1.4s\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
 		"      st1 { v0.s }[0], [%[d]], #4\n"
 		"      bne 3b\n"
 		"4:"
 		: [d] "+r" (d), [s] "+r" (s), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "v0", "v1");
+		: [stride] "r" (stride), [factor] "r" (factor.i)
+		: "cc", "v0", "v1", "v4");
 #else
 	asm volatile(
+		"      vdup.32 q2, %[factor]\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
@@ -161,7 +177,8 @@ conv_s16_to_f32d_1s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      vld1.16 { d0[3] }, [%[s]], %[stride]\n"
 		"      subs %[n_samples], %[n_samples], #4\n"
 		"      vmovl.s16 q0, d0\n"
-		"      vcvt.f32.s32 q0, q0, #15\n"
+		"      vcvt.f32.s32 q0, q0\n"
+		"      vmul.f32 q0, q0, q2\n"
 		"      vst1.32 { q0 }, [%[d]]!\n"
 		"      bne 1b\n"
 		"2:"
@@ -171,14 +188,15 @@ conv_s16_to_f32d_1s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA
 		"      vld1.16 { d0[0] }, [%[s]], %[stride]\n"
 		"      subs %[remainder], %[remainder], #1\n"
 		"      vmovl.s16 q0, d0\n"
-		"      vcvt.f32.s32 q0, q0, #15\n"
+		"      vcvt.f32.s32 q0, q0\n"
+		"      vmul.f32 q0, q0, q2\n"
 		"      vst1.32 { d0[0] }, [%[d]]!\n"
 		"      bne 3b\n"
 		"4:"
 		: [d] "+r" (d), [s] "+r" (s), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "q0");
+		: [stride] "r" (stride), [factor] "r" (factor.i)
+		: "cc", "q0", "q2");
 #endif
 }
 
@@ -203,20 +221,29 @@ conv_f32d_to_s16_2s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	int16_t *d = dst;
 	uint32_t stride = n_channels << 1;
 	uint32_t remainder = n_samples & 3;
+	union { float f; uint32_t i; } scale = { .f = S16_SCALE };
 	n_samples -= remainder;
 
 #ifdef __aarch64__
 	asm volatile(
+		"      dup v4.4s, %w[scale]\n"
+		"      fneg v5.4s, v4.4s\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
 		"      ld1 { v0.4s }, [%[s0]], #16\n"
 		"      ld1 { v1.4s }, [%[s1]], #16\n"
 		"      subs %[n_samples], %[n_samples], #4\n"
-		"      fcvtzs v0.4s, v0.4s, #31\n"
-		"      fcvtzs v1.4s, v1.4s, #31\n"
-		"      sqrshrn v0.4h, v0.4s, #16\n"
-		"      sqrshrn v1.4h, v1.4s, #16\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
+		"      fmul v1.4s, v1.4s, v4.4s\n"
+		"      fmin v0.4s, v0.4s, v4.4s\n"
+		"      fmin v1.4s, v1.4s, v4.4s\n"
+		"      fmax v0.4s, v0.4s, v5.4s\n"
+		"      fmax v1.4s, v1.4s, v5.4s\n"
+		"      fcvtzs v0.4s, v0.4s\n"
+		"      fcvtzs v1.4s, v1.4s\n"
+		"      sqxtn v0.4h, v0.4s\n"
+		"      sqxtn v1.4h, v1.4s\n"
 		"      st2 { v0.h, v1.h }[0], [%[d]], %[stride]\n"
 		"      st2 { v0.h, v1.h }[1], [%[d]], %[stride]\n"
 		"      st2 { v0.h, v1.h }[2], [%[d]], %[stride]\n"
@@ -227,31 +254,45 @@ conv_f32d_to_s16_2s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		"      beq 4f\n"
 		"3:"
 		"      ld1 { v0.s }[0], [%[s0]], #4\n"
-		"      ld1 { v2.s }[0], [%[s1]], #4\n"
+		"      ld1 { v1.s }[0], [%[s1]], #4\n"
 		"      subs %[remainder], %[remainder], #1\n"
-		"      fcvtzs v0.4s, v0.4s, #31\n"
-		"      fcvtzs v1.4s, v1.4s, #31\n"
-		"      sqrshrn v0.4h, v0.4s, #16\n"
-		"      sqrshrn v1.4h, v1.4s, #16\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
+		"      fmul v1.4s, v1.4s, v4.4s\n"
+		"      fmin v0.4s, v0.4s, v4.4s\n"
+		"      fmin v1.4s, v1.4s, v4.4s\n"
+		"      fmax v0.4s, v0.4s, v5.4s\n"
+		"      fmax v1.4s, v1.4s, v5.4s\n"
+		"      fcvtzs v0.4s, v0.4s\n"
+		"      fcvtzs v1.4s, v1.4s\n"
+		"      sqxtn v0.4h, v0.4s\n"
+		"      sqxtn v1.4h, v1.4s\n"
 		"      st2 { v0.h, v1.h }[0], [%[d]], %[stride]\n"
 		"      bne 3b\n"
 		"4:"
 		: [d] "+r" (d), [s0] "+r" (s0), [s1] "+r" (s1), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "v0", "v1");
+		: [stride] "r" (stride), [scale] "r" (scale.i)
+		: "cc", "v0", "v1", "v4", "v5");
 #else
 	asm volatile(
+		"      vdup.32 q2, %[scale]\n"
+		"      vneg.f32 q3, q2\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
 		"      vld1.32 { q0 }, [%[s0]]!\n"
 		"      vld1.32 { q1 }, [%[s1]]!\n"
 		"      subs %[n_samples], %[n_samples], #4\n"
-		"      vcvt.s32.f32 q0, q0, #31\n"
-		"      vcvt.s32.f32 q1, q1, #31\n"
-		"      vqrshrn.s32 d0, q0, #16\n"
-		"      vqrshrn.s32 d1, q1, #16\n"
+		"      vmul.f32 q0, q0, q2\n"
+		"      vmul.f32 q1, q1, q2\n"
+		"      vmin.f32 q0, q0, q2\n"
+		"      vmin.f32 q1, q1, q2\n"
+		"      vmax.f32 q0, q0, q3\n"
+		"      vmax.f32 q1, q1, q3\n"
+		"      vcvt.s32.f32 q0, q0\n"
+		"      vcvt.s32.f32 q1, q1\n"
+		"      vqmovn.s32 d0, q0\n"
+		"      vqmovn.s32 d1, q1\n"
 		"      vst2.16 { d0[0], d1[0] }, [%[d]], %[stride]\n"
 		"      vst2.16 { d0[1], d1[1] }, [%[d]], %[stride]\n"
 		"      vst2.16 { d0[2], d1[2] }, [%[d]], %[stride]\n"
@@ -264,17 +305,23 @@ conv_f32d_to_s16_2s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		"      vld1.32 { d0[0] }, [%[s0]]!\n"
 		"      vld1.32 { d2[0] }, [%[s1]]!\n"
 		"      subs %[remainder], %[remainder], #1\n"
-		"      vcvt.s32.f32 q0, q0, #31\n"
-		"      vcvt.s32.f32 q1, q1, #31\n"
-		"      vqrshrn.s32 d0, q0, #16\n"
-		"      vqrshrn.s32 d1, q1, #16\n"
+		"      vmul.f32 q0, q0, q2\n"
+		"      vmul.f32 q1, q1, q2\n"
+		"      vmin.f32 q0, q0, q2\n"
+		"      vmin.f32 q1, q1, q2\n"
+		"      vmax.f32 q0, q0, q3\n"
+		"      vmax.f32 q1, q1, q3\n"
+		"      vcvt.s32.f32 q0, q0\n"
+		"      vcvt.s32.f32 q1, q1\n"
+		"      vqmovn.s32 d0, q0\n"
+		"      vqmovn.s32 d1, q1\n"
 		"      vst2.16 { d0[0], d1[0] }, [%[d]], %[stride]\n"
 		"      bne 3b\n"
 		"4:"
 		: [d] "+r" (d), [s0] "+r" (s0), [s1] "+r" (s1), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "q0", "q1");
+		: [stride] "r" (stride), [scale] "r" (scale.i)
+		: "cc", "q0", "q1", "q2", "q3");
 #endif
 }
 
@@ -286,17 +333,23 @@ conv_f32d_to_s16_1s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	int16_t *d = dst;
 	uint32_t stride = n_channels << 1;
 	uint32_t remainder = n_samples & 3;
+	union { float f; uint32_t i; } scale = { .f = S16_SCALE };
 	n_samples -= remainder;
 
 #ifdef __aarch64__
 	asm volatile(
+		"      dup v4.4s, %w[scale]\n"
+		"      fneg v5.4s, v4.4s\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
 		"      ld1 { v0.4s }, [%[s]], #16\n"
 		"      subs %[n_samples], %[n_samples], #4\n"
-		"      fcvtzs v0.4s, v0.4s, #31\n"
-		"      sqrshrn v0.4h, v0.4s, #16\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
+		"      fmin v0.4s, v0.4s, v4.4s\n"
+		"      fmax v0.4s, v0.4s, v5.4s\n"
+		"      fcvtzs v0.4s, v0.4s\n"
+		"      sqxtn v0.4h, v0.4s\n"
 		"      st1 { v0.h }[0], [%[d]], %[stride]\n"
 		"      st1 { v0.h }[1], [%[d]], %[stride]\n"
 		"      st1 { v0.h }[2], [%[d]], %[stride]\n"
@@ -308,24 +361,32 @@ conv_f32d_to_s16_1s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		"3:"
 		"      ld1 { v0.s }[0], [%[s]], #4\n"
 		"      subs %[remainder], %[remainder], #1\n"
-		"      fcvtzs v0.4s, v0.4s, #31\n"
-		"      sqrshrn v0.4h, v0.4s, #16\n"
+		"      fmul v0.4s, v0.4s, v4.4s\n"
+		"      fmin v0.4s, v0.4s, v4.4s\n"
+		"      fmax v0.4s, v0.4s, v5.4s\n"
+		"      fcvtzs v0.4s, v0.4s\n"
+		"      sqxtn v0.4h, v0.4s\n"
 		"      st1 { v0.h }[0], [%[d]], %[stride]\n"
 		"      bne 3b\n"
 		"4:"
 		: [d] "+r" (d), [s] "+r" (s), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "v0");
+		: [stride] "r" (stride), [scale] "r" (scale.i)
+		: "cc", "v0", "v4", "v5");
 #else
 	asm volatile(
+		"      vdup.32 q2, %[scale]\n"
+		"      vneg.f32 q3, q2\n"
 		"      cmp %[n_samples], #0\n"
 		"      beq 2f\n"
 		"1:"
 		"      vld1.32 { q0 }, [%[s]]!\n"
 		"      subs %[n_samples], %[n_samples], #4\n"
-		"      vcvt.s32.f32 q0, q0, #31\n"
-		"      vqrshrn.s32 d0, q0, #16\n"
+		"      vmul.f32 q0, q0, q2\n"
+		"      vmin.f32 q0, q0, q2\n"
+		"      vmax.f32 q0, q0, q3\n"
+		"      vcvt.s32.f32 q0, q0\n"
+		"      vqmovn.s32 d0, q0\n"
 		"      vst1.16 { d0[0] }, [%[d]], %[stride]\n"
 		"      vst1.16 { d0[1] }, [%[d]], %[stride]\n"
 		"      vst1.16 { d0[2] }, [%[d]], %[stride]\n"
@@ -337,15 +398,18 @@ conv_f32d_to_s16_1s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		"3:"
 		"      vld1.32 { d0[0] }, [%[s]]!\n"
 		"      subs %[remainder], %[remainder], #1\n"
-		"      vcvt.s32.f32 q0, q0, #31\n"
-		"      vqrshrn.s32 d0, q0, #16\n"
+		"      vmul.f32 q0, q0, q2\n"
+		"      vmin.f32 q0, q0, q2\n"
+		"      vmax.f32 q0, q0, q3\n"
+		"      vcvt.s32.f32 q0, q0\n"
+		"      vqmovn.s32 d0, q0\n"
 		"      vst1.16 { d0[0] }, [%[d]], %[stride]\n"
 		"      bne 3b\n"
 		"4:"
 		: [d] "+r" (d), [s] "+r" (s), [n_samples] "+r" (n_samples),
 		  [remainder] "+r" (remainder)
-		: [stride] "r" (stride)
-		: "cc", "q0");
+		: [stride] "r" (stride), [scale] "r" (scale.i)
+		: "cc", "q0", "q2", "q3");
 #endif
 }
 
@@ -384,8 +384,8 @@ conv_f32d_to_s32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	uint32_t n, unrolled;
 	__m128 in[1];
 	__m128i out[4];
-	__m128 scale = _mm_set1_ps(S32_SCALE);
-	__m128 int_min = _mm_set1_ps(S32_MIN);
+	__m128 scale = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), scale);
 
 	if (SPA_IS_ALIGNED(s0, 16))
 		unrolled = n_samples & ~3;
@@ -394,8 +394,8 @@ conv_f32d_to_s32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 
 	for(n = 0; n < unrolled; n += 4) {
 		in[0] = _mm_mul_ps(_mm_load_ps(&s0[n]), scale);
-		in[0] = _mm_min_ps(in[0], int_min);
-		out[0] = _mm_cvtps_epi32(in[0]);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
 		out[1] = _mm_shuffle_epi32(out[0], _MM_SHUFFLE(0, 3, 2, 1));
 		out[2] = _mm_shuffle_epi32(out[0], _MM_SHUFFLE(1, 0, 3, 2));
 		out[3] = _mm_shuffle_epi32(out[0], _MM_SHUFFLE(2, 1, 0, 3));
@@ -409,8 +409,8 @@ conv_f32d_to_s32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(; n < n_samples; n++) {
 		in[0] = _mm_load_ss(&s0[n]);
 		in[0] = _mm_mul_ss(in[0], scale);
-		in[0] = _mm_min_ss(in[0], int_min);
-		*d = _mm_cvtss_si32(in[0]);
+		in[0] = _mm_min_ss(scale, _mm_max_ss(in[0], int_min));
+		*d = _mm_cvttss_si32(in[0]) << 8;
 		d += n_channels;
 	}
 }
@@ -424,8 +424,8 @@ conv_f32d_to_s32_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	uint32_t n, unrolled;
 	__m128 in[2];
 	__m128i out[2], t[2];
-	__m128 scale = _mm_set1_ps(S32_SCALE);
-	__m128 int_min = _mm_set1_ps(S32_MIN);
+	__m128 scale = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), scale);
 
 	if (SPA_IS_ALIGNED(s0, 16) &&
 	    SPA_IS_ALIGNED(s1, 16))
@@ -437,11 +437,11 @@ conv_f32d_to_s32_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[0] = _mm_mul_ps(_mm_load_ps(&s0[n]), scale);
 		in[1] = _mm_mul_ps(_mm_load_ps(&s1[n]), scale);
 
-		in[0] = _mm_min_ps(in[0], int_min);
-		in[1] = _mm_min_ps(in[1], int_min);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(scale, _mm_max_ps(in[1], int_min));
 
-		out[0] = _mm_cvtps_epi32(in[0]);
-		out[1] = _mm_cvtps_epi32(in[1]);
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
+		out[1] = _mm_slli_epi32(_mm_cvttps_epi32(in[1]), 8);
 
 		t[0] = _mm_unpacklo_epi32(out[0], out[1]);
 		t[1] = _mm_unpackhi_epi32(out[0], out[1]);
@@ -459,8 +459,8 @@ conv_f32d_to_s32_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[0] = _mm_unpacklo_ps(in[0], in[1]);
 
 		in[0] = _mm_mul_ps(in[0], scale);
-		in[0] = _mm_min_ps(in[0], int_min);
-		out[0] = _mm_cvtps_epi32(in[0]);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
 		_mm_storel_epi64((__m128i*)d, out[0]);
 		d += n_channels;
 	}
@@ -475,8 +475,8 @@ conv_f32d_to_s32_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	uint32_t n, unrolled;
 	__m128 in[4];
 	__m128i out[4];
-	__m128 scale = _mm_set1_ps(S32_SCALE);
-	__m128 int_min = _mm_set1_ps(S32_MIN);
+	__m128 scale = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), scale);
 
 	if (SPA_IS_ALIGNED(s0, 16) &&
 	    SPA_IS_ALIGNED(s1, 16) &&
@@ -492,17 +492,17 @@ conv_f32d_to_s32_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[2] = _mm_mul_ps(_mm_load_ps(&s2[n]), scale);
 		in[3] = _mm_mul_ps(_mm_load_ps(&s3[n]), scale);
 
-		in[0] = _mm_min_ps(in[0], int_min);
-		in[1] = _mm_min_ps(in[1], int_min);
-		in[2] = _mm_min_ps(in[2], int_min);
-		in[3] = _mm_min_ps(in[3], int_min);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(scale, _mm_max_ps(in[1], int_min));
+		in[2] = _mm_min_ps(scale, _mm_max_ps(in[2], int_min));
+		in[3] = _mm_min_ps(scale, _mm_max_ps(in[3], int_min));
 
 		_MM_TRANSPOSE4_PS(in[0], in[1], in[2], in[3]);
 
-		out[0] = _mm_cvtps_epi32(in[0]);
-		out[1] = _mm_cvtps_epi32(in[1]);
-		out[2] = _mm_cvtps_epi32(in[2]);
-		out[3] = _mm_cvtps_epi32(in[3]);
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
+		out[1] = _mm_slli_epi32(_mm_cvttps_epi32(in[1]), 8);
+		out[2] = _mm_slli_epi32(_mm_cvttps_epi32(in[2]), 8);
+		out[3] = _mm_slli_epi32(_mm_cvttps_epi32(in[3]), 8);
 
 		_mm_storeu_si128((__m128i*)(d + 0*n_channels), out[0]);
 		_mm_storeu_si128((__m128i*)(d + 1*n_channels), out[1]);
@@ -521,8 +521,8 @@ conv_f32d_to_s32_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[0] = _mm_unpacklo_ps(in[0], in[1]);
 
 		in[0] = _mm_mul_ps(in[0], scale);
-		in[0] = _mm_min_ps(in[0], int_min);
-		out[0] = _mm_cvtps_epi32(in[0]);
+		in[0] = _mm_min_ps(scale, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
 		_mm_storeu_si128((__m128i*)d, out[0]);
 		d += n_channels;
 	}
@@ -563,8 +563,10 @@ conv_f32_to_s16_1_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RES
 	for(n = 0; n < unrolled; n += 8) {
 		in[0] = _mm_mul_ps(_mm_load_ps(&s[n]), int_max);
 		in[1] = _mm_mul_ps(_mm_load_ps(&s[n+4]), int_max);
-		out[0] = _mm_cvtps_epi32(in[0]);
-		out[1] = _mm_cvtps_epi32(in[1]);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		out[0] = _mm_cvttps_epi32(in[0]);
+		out[1] = _mm_cvttps_epi32(in[1]);
 		out[0] = _mm_packs_epi32(out[0], out[1]);
 		_mm_storeu_si128((__m128i*)(d+0), out[0]);
 		d += 8;
@@ -572,7 +574,7 @@ conv_f32_to_s16_1_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RES
 	for(; n < n_samples; n++) {
 		in[0] = _mm_mul_ss(_mm_load_ss(&s[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
-		*d++ = _mm_cvtss_si32(in[0]);
+		*d++ = _mm_cvttss_si32(in[0]);
 	}
 }
 
@@ -612,8 +614,10 @@ conv_f32d_to_s16_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(n = 0; n < unrolled; n += 8) {
 		in[0] = _mm_mul_ps(_mm_load_ps(&s0[n]), int_max);
 		in[1] = _mm_mul_ps(_mm_load_ps(&s0[n+4]), int_max);
-		out[0] = _mm_cvtps_epi32(in[0]);
-		out[1] = _mm_cvtps_epi32(in[1]);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		out[0] = _mm_cvttps_epi32(in[0]);
+		out[1] = _mm_cvttps_epi32(in[1]);
 		out[0] = _mm_packs_epi32(out[0], out[1]);
 
 		d[0*n_channels] = _mm_extract_epi16(out[0], 0);
@@ -629,7 +633,7 @@ conv_f32d_to_s16_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(; n < n_samples; n++) {
 		in[0] = _mm_mul_ss(_mm_load_ss(&s0[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
-		*d = _mm_cvtss_si32(in[0]);
+		*d = _mm_cvttss_si32(in[0]);
 		d += n_channels;
 	}
 }
@@ -655,9 +659,11 @@ conv_f32d_to_s16_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 	for(n = 0; n < unrolled; n += 4) {
 		in[0] = _mm_mul_ps(_mm_load_ps(&s0[n]), int_max);
 		in[1] = _mm_mul_ps(_mm_load_ps(&s1[n]), int_max);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
 
-		t[0] = _mm_cvtps_epi32(in[0]);
-		t[1] = _mm_cvtps_epi32(in[1]);
+		t[0] = _mm_cvttps_epi32(in[0]);
+		t[1] = _mm_cvttps_epi32(in[1]);
 
 		t[0] = _mm_packs_epi32(t[0], t[0]);
 		t[1] = _mm_packs_epi32(t[1], t[1]);
@@ -678,8 +684,8 @@ conv_f32d_to_s16_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[1] = _mm_mul_ss(_mm_load_ss(&s1[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
 		d += n_channels;
 	}
 }
@@ -709,11 +715,15 @@ conv_f32d_to_s16_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[1] = _mm_mul_ps(_mm_load_ps(&s1[n]), int_max);
 		in[2] = _mm_mul_ps(_mm_load_ps(&s2[n]), int_max);
 		in[3] = _mm_mul_ps(_mm_load_ps(&s3[n]), int_max);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		in[2] = _mm_min_ps(int_max, _mm_max_ps(in[2], int_min));
+		in[3] = _mm_min_ps(int_max, _mm_max_ps(in[3], int_min));
 
-		t[0] = _mm_cvtps_epi32(in[0]);
-		t[1] = _mm_cvtps_epi32(in[1]);
-		t[2] = _mm_cvtps_epi32(in[2]);
-		t[3] = _mm_cvtps_epi32(in[3]);
+		t[0] = _mm_cvttps_epi32(in[0]);
+		t[1] = _mm_cvttps_epi32(in[1]);
+		t[2] = _mm_cvttps_epi32(in[2]);
+		t[3] = _mm_cvttps_epi32(in[3]);
 
 		t[0] = _mm_packs_epi32(t[0], t[2]);
 		t[1] = _mm_packs_epi32(t[1], t[3]);
@@ -739,10 +749,10 @@ conv_f32d_to_s16_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_R
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
 		in[2] = _mm_min_ss(int_max, _mm_max_ss(in[2], int_min));
 		in[3] = _mm_min_ss(int_max, _mm_max_ss(in[3], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
-		d[2] = _mm_cvtss_si32(in[2]);
-		d[3] = _mm_cvtss_si32(in[3]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
+		d[2] = _mm_cvttss_si32(in[2]);
+		d[3] = _mm_cvttss_si32(in[3]);
 		d += n_channels;
 	}
 }
@@ -785,11 +795,15 @@ conv_f32d_to_s16_2_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		in[1] = _mm_mul_ps(_mm_load_ps(&s1[n+0]), int_max);
 		in[2] = _mm_mul_ps(_mm_load_ps(&s0[n+4]), int_max);
 		in[3] = _mm_mul_ps(_mm_load_ps(&s1[n+4]), int_max);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		in[2] = _mm_min_ps(int_max, _mm_max_ps(in[2], int_min));
+		in[3] = _mm_min_ps(int_max, _mm_max_ps(in[3], int_min));
 
-		out[0] = _mm_cvtps_epi32(in[0]);
-		out[1] = _mm_cvtps_epi32(in[1]);
-		out[2] = _mm_cvtps_epi32(in[2]);
-		out[3] = _mm_cvtps_epi32(in[3]);
+		out[0] = _mm_cvttps_epi32(in[0]);
+		out[1] = _mm_cvttps_epi32(in[1]);
+		out[2] = _mm_cvttps_epi32(in[2]);
+		out[3] = _mm_cvttps_epi32(in[3]);
 
 		out[0] = _mm_packs_epi32(out[0], out[2]);
 		out[1] = _mm_packs_epi32(out[1], out[3]);
@@ -807,8 +821,411 @@ conv_f32d_to_s16_2_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		in[1] = _mm_mul_ss(_mm_load_ss(&s1[n]), int_max);
 		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
 		in[1] = _mm_min_ss(int_max, _mm_max_ss(in[1], int_min));
-		d[0] = _mm_cvtss_si32(in[0]);
-		d[1] = _mm_cvtss_si32(in[1]);
+		d[0] = _mm_cvttss_si32(in[0]);
+		d[1] = _mm_cvttss_si32(in[1]);
 		d += 2;
 	}
 }
+
+static void
+conv_f32_to_s16d_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	int16_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[1];
+	__m128i out[1];
+	__m128 int_max = _mm_set1_ps(S16_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), int_max);
+
+	unrolled = n_samples & ~3;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_setr_ps(s[0*n_channels],
+				    s[1*n_channels],
+				    s[2*n_channels],
+				    s[3*n_channels]);
+		in[0] = _mm_mul_ps(in[0], int_max);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		out[0] = _mm_cvttps_epi32(in[0]);
+		out[0] = _mm_packs_epi32(out[0], out[0]);
+		_mm_storel_epi64((__m128i*)&d[n], out[0]);
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		in[0] = _mm_mul_ss(_mm_load_ss(s), int_max);
+		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
+		d[n] = _mm_cvttss_si32(in[0]);
+		s += n_channels;
+	}
+}
+
+void
+conv_f32_to_s16d_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0];
+	uint32_t i, n_channels = conv->n_channels;
+
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s16d_1s_sse2(conv, dst[i], &s[i], n_channels, n_samples);
+}
+
+static void
+conv_f32_to_s32_1_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[2];
+	__m128i out[2];
+	__m128 int_max = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), int_max);
+
+	if (SPA_IS_ALIGNED(s, 16) && SPA_IS_ALIGNED(d, 16))
+		unrolled = n_samples & ~7;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 8) {
+		in[0] = _mm_mul_ps(_mm_load_ps(&s[n+0]), int_max);
+		in[1] = _mm_mul_ps(_mm_load_ps(&s[n+4]), int_max);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		out[0] = _mm_slli_epi32(_mm_cvttps_epi32(in[0]), 8);
+		out[1] = _mm_slli_epi32(_mm_cvttps_epi32(in[1]), 8);
+		_mm_store_si128((__m128i*)&d[n+0], out[0]);
+		_mm_store_si128((__m128i*)&d[n+4], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		in[0] = _mm_mul_ss(_mm_load_ss(&s[n]), int_max);
+		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
+		d[n] = _mm_cvttss_si32(in[0]) << 8;
+	}
+}
+
+void
+conv_f32d_to_s32d_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s32_1_sse2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s32_1_sse2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_s24_32_1_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[2];
+	__m128i out[2];
+	__m128 int_max = _mm_set1_ps(S24_MAX_F);
+	__m128 int_min = _mm_sub_ps(_mm_setzero_ps(), int_max);
+
+	if (SPA_IS_ALIGNED(s, 16) && SPA_IS_ALIGNED(d, 16))
+		unrolled = n_samples & ~7;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 8) {
+		in[0] = _mm_mul_ps(_mm_load_ps(&s[n+0]), int_max);
+		in[1] = _mm_mul_ps(_mm_load_ps(&s[n+4]), int_max);
+		in[0] = _mm_min_ps(int_max, _mm_max_ps(in[0], int_min));
+		in[1] = _mm_min_ps(int_max, _mm_max_ps(in[1], int_min));
+		out[0] = _mm_cvttps_epi32(in[0]);
+		out[1] = _mm_cvttps_epi32(in[1]);
+		_mm_store_si128((__m128i*)&d[n+0], out[0]);
+		_mm_store_si128((__m128i*)&d[n+4], out[1]);
+	}
+	for(; n < n_samples; n++) {
+		in[0] = _mm_mul_ss(_mm_load_ss(&s[n]), int_max);
+		in[0] = _mm_min_ss(int_max, _mm_max_ss(in[0], int_min));
+		d[n] = _mm_cvttss_si32(in[0]);
+	}
+}
+
+void
+conv_f32d_to_s24_32d_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_s24_32_1_sse2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_s24_32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_s24_32_1_sse2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_f32_to_u8_1_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_samples)
+{
+	const float *s = src;
+	uint8_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[4];
+	__m128i out[4];
+	__m128 scale = _mm_set1_ps(U8_SCALE), offs = _mm_set1_ps(U8_OFFS);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s, 16))
+		unrolled = n_samples & ~15;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 16) {
+		in[0] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s[n+ 0]), min));
+		in[1] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s[n+ 4]), min));
+		in[2] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s[n+ 8]), min));
+		in[3] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s[n+12]), min));
+		out[0] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[0], scale), offs));
+		out[1] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[1], scale), offs));
+		out[2] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[2], scale), offs));
+		out[3] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in[3], scale), offs));
+		out[0] = _mm_packs_epi32(out[0], out[1]);
+		out[2] = _mm_packs_epi32(out[2], out[3]);
+		out[0] = _mm_packus_epi16(out[0], out[2]);
+		_mm_storeu_si128((__m128i*)&d[n], out[0]);
+	}
+	for(; n < n_samples; n++)
+		d[n] = F32_TO_U8(s[n]);
+}
+
+void
+conv_f32d_to_u8d_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	for(i = 0; i < n_channels; i++)
+		conv_f32_to_u8_1_sse2(conv, dst[i], src[i], n_samples);
+}
+
+void
+conv_f32_to_u8_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	conv_f32_to_u8_1_sse2(conv, dst[0], src[0], n_samples * conv->n_channels);
+}
+
+static void
+conv_deinterleave_32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m128 out;
+
+	if (SPA_IS_ALIGNED(d, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		out = _mm_setr_ps(s[0*n_channels],
+				  s[1*n_channels],
+				  s[2*n_channels],
+				  s[3*n_channels]);
+		_mm_store_ps(&d[n], out);
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[n] = s[0];
+		s += n_channels;
+	}
+}
+
+static void
+conv_deinterleave_32_2s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d0 = dst[0], *d1 = dst[1];
+	uint32_t n, unrolled;
+	__m128 in[2], out[2];
+
+	if (n_channels == 2 && SPA_IS_ALIGNED(s, 16) &&
+	    SPA_IS_ALIGNED(d0, 16) && SPA_IS_ALIGNED(d1, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_load_ps(&s[0]);
+		in[1] = _mm_load_ps(&s[4]);
+		out[0] = _mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(2, 0, 2, 0));
+		out[1] = _mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_store_ps(&d0[n], out[0]);
+		_mm_store_ps(&d1[n], out[1]);
+		s += 8;
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		s += n_channels;
+	}
+}
+
+void
+conv_deinterleave_32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	if (n_channels == 2)
+		conv_deinterleave_32_2s_sse2(conv, dst, s, n_channels, n_samples);
+	else {
+		for(; i < n_channels; i++)
+			conv_deinterleave_32_1s_sse2(conv, dst[i], &s[i], n_channels, n_samples);
+	}
+}
+
+static void
+conv_interleave_32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m128 in;
+
+	if (SPA_IS_ALIGNED(s, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in = _mm_load_ps(&s[n]);
+		_mm_store_ss(&d[0*n_channels], in);
+		in = _mm_shuffle_ps(in, in, _MM_SHUFFLE(0, 3, 2, 1));
+		_mm_store_ss(&d[1*n_channels], in);
+		in = _mm_shuffle_ps(in, in, _MM_SHUFFLE(0, 3, 2, 1));
+		_mm_store_ss(&d[2*n_channels], in);
+		in = _mm_shuffle_ps(in, in, _MM_SHUFFLE(0, 3, 2, 1));
+		_mm_store_ss(&d[3*n_channels], in);
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s[n];
+		d += n_channels;
+	}
+}
+
+static void
+conv_interleave_32_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1];
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[2];
+
+	if (n_channels == 2 && SPA_IS_ALIGNED(d, 16) &&
+	    SPA_IS_ALIGNED(s0, 16) && SPA_IS_ALIGNED(s1, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_load_ps(&s0[n]);
+		in[1] = _mm_load_ps(&s1[n]);
+		_mm_store_ps(&d[0], _mm_unpacklo_ps(in[0], in[1]));
+		_mm_store_ps(&d[4], _mm_unpackhi_ps(in[0], in[1]));
+		d += 8;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d += n_channels;
+	}
+}
+
+void
+conv_interleave_32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	float *d = dst[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	if (n_channels == 2)
+		conv_interleave_32_2s_sse2(conv, d, src, n_channels, n_samples);
+	else {
+		for(; i < n_channels; i++)
+			conv_interleave_32_1s_sse2(conv, &d[i], src[i], n_channels, n_samples);
+	}
+}
+
+static inline __m128i
+dither_random_sse2(__m128i *state)
+{
+	__m128i x = *state;
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	*state = x;
+	return x;
+}
+
+static inline __m128
+dither_level_sse2(__m128 v, __m128 offs, __m128 min, __m128 max, __m128 inv)
+{
+	__m128 q, bias;
+
+	q = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_min_ps(max, _mm_max_ps(v, min))));
+	bias = _mm_add_ps(_mm_set1_ps(0.25f),
+			_mm_and_ps(_mm_cmplt_ps(q, _mm_setzero_ps()), _mm_set1_ps(-0.5f)));
+	return _mm_mul_ps(_mm_sub_ps(_mm_add_ps(q, bias), offs), inv);
+}
+
+void
+conv_dither_f32_sse2(struct convert *conv, uint32_t channel, float * SPA_RESTRICT dst,
+		const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t n, unrolled, *r = &conv->random[channel * DITHER_LANES];
+	const bool triangular = conv->method != DITHER_METHOD_RECTANGULAR;
+	__m128i rnd[2];
+	__m128 v[2];
+	__m128 scale = _mm_set1_ps(conv->scale), offs = _mm_set1_ps(conv->offs);
+	__m128 min = _mm_set1_ps(conv->min), max = _mm_set1_ps(conv->max);
+	__m128 inv = _mm_set1_ps(1.0f / conv->scale);
+	__m128 factor = _mm_set1_ps(1.0f / 4294967296.0f);
+
+	rnd[0] = _mm_loadu_si128((__m128i*)&r[0]);
+	rnd[1] = _mm_loadu_si128((__m128i*)&r[4]);
+
+	unrolled = n_samples & ~7;
+	for(n = 0; n < unrolled; n += 8) {
+		v[0] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&src[n+0]), scale), offs);
+		v[1] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&src[n+4]), scale), offs);
+		v[0] = _mm_add_ps(v[0], _mm_mul_ps(_mm_cvtepi32_ps(dither_random_sse2(&rnd[0])), factor));
+		v[1] = _mm_add_ps(v[1], _mm_mul_ps(_mm_cvtepi32_ps(dither_random_sse2(&rnd[1])), factor));
+		if (triangular) {
+			v[0] = _mm_add_ps(v[0], _mm_mul_ps(_mm_cvtepi32_ps(dither_random_sse2(&rnd[0])), factor));
+			v[1] = _mm_add_ps(v[1], _mm_mul_ps(_mm_cvtepi32_ps(dither_random_sse2(&rnd[1])), factor));
+		}
+		_mm_storeu_ps(&dst[n+0], dither_level_sse2(v[0], offs, min, max, inv));
+		_mm_storeu_ps(&dst[n+4], dither_level_sse2(v[1], offs, min, max, inv));
+	}
+	_mm_storeu_si128((__m128i*)&r[0], rnd[0]);
+	_mm_storeu_si128((__m128i*)&r[4], rnd[1]);
+
+	if (n < n_samples)
+		conv_dither_f32_c(conv, channel, &dst[n], &src[n], n_samples - n);
+}
@@ -24,7 +24,9 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
 #include <math.h>
+#include <stdlib.h>
 
 #include <spa/support/cpu.h>
 #include <spa/utils/defs.h>
@@ -47,13 +49,37 @@ struct conv_info {
 static struct conv_info conv_table[] =
 {
 	/* to f32 */
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_U8, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX512, conv_u8_to_f32_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_U8, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX2, conv_u8_to_f32_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_U8, SPA_AUDIO_FORMAT_F32, 0, 0, conv_u8_to_f32_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_U8P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX512, conv_u8d_to_f32d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_U8P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX2, conv_u8d_to_f32d_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_U8P, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_u8d_to_f32d_c },
 	{ SPA_AUDIO_FORMAT_U8, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_u8_to_f32d_c },
 	{ SPA_AUDIO_FORMAT_U8P, SPA_AUDIO_FORMAT_F32, 0, 0, conv_u8d_to_f32_c },
 
 
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_S16, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX512, conv_s16_to_f32_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S16, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX2, conv_s16_to_f32_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S16, SPA_AUDIO_FORMAT_F32, 0, 0, conv_s16_to_f32_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_S16P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX512, conv_s16d_to_f32d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S16P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX2, conv_s16d_to_f32d_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S16P, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_s16d_to_f32d_c },
 #if defined (HAVE_NEON)
 	{ SPA_AUDIO_FORMAT_S16, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_NEON, conv_s16_to_f32d_neon },
@@ -71,7 +97,13 @@ static struct conv_info conv_table[] =
 
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_F32, 0, 0, conv_copy32_c },
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_copy32d_c },
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_SSE2, conv_deinterleave_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_deinterleave_32_c },
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_SSE2, conv_interleave_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_F32, 0, 0, conv_interleave_32_c },
 
 #if defined (HAVE_AVX2)
@@ -79,8 +111,20 @@ static struct conv_info conv_table[] =
 #endif
 #if defined (HAVE_SSE2)
 	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_SSE2, conv_s32_to_f32d_sse2 },
+#endif
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX512, conv_s32_to_f32_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX2, conv_s32_to_f32_avx2 },
 #endif
 	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_F32, 0, 0, conv_s32_to_f32_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX512, conv_s32d_to_f32d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX2, conv_s32d_to_f32d_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_s32d_to_f32d_c },
 	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_s32_to_f32d_c },
 	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_F32, 0, 0, conv_s32d_to_f32_c },
@@ -104,27 +148,72 @@ static struct conv_info conv_table[] =
 
 	{ SPA_AUDIO_FORMAT_S24_OE, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_s24s_to_f32d_c },
 
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX512, conv_s24_32_to_f32_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX2, conv_s24_32_to_f32_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_F32, 0, 0, conv_s24_32_to_f32_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX512, conv_s24_32d_to_f32d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX2, conv_s24_32d_to_f32d_avx2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_s24_32d_to_f32d_c },
 	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_F32P, 0, 0, conv_s24_32_to_f32d_c },
 	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_F32, 0, 0, conv_s24_32d_to_f32_c },
 
 	/* from f32 */
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_U8, 0, SPA_CPU_FLAG_AVX512, conv_f32_to_u8_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_U8, 0, SPA_CPU_FLAG_AVX2, conv_f32_to_u8_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_U8, 0, SPA_CPU_FLAG_SSE2, conv_f32_to_u8_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_U8, 0, 0, conv_f32_to_u8_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_U8P, 0, SPA_CPU_FLAG_AVX512, conv_f32d_to_u8d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_U8P, 0, SPA_CPU_FLAG_AVX2, conv_f32d_to_u8d_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_U8P, 0, SPA_CPU_FLAG_SSE2, conv_f32d_to_u8d_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_U8P, 0, 0, conv_f32d_to_u8d_c },
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_U8P, 0, 0, conv_f32_to_u8d_c },
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_U8, 0, 0, conv_f32d_to_u8_c },
 
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16, 0, SPA_CPU_FLAG_AVX512, conv_f32_to_s16_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16, 0, SPA_CPU_FLAG_AVX2, conv_f32_to_s16_avx2 },
+#endif
 #if defined (HAVE_SSE2)
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16, 0, SPA_CPU_FLAG_SSE2, conv_f32_to_s16_sse2 },
 #endif
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16, 0, 0, conv_f32_to_s16_c },
 
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_AVX512, conv_f32d_to_s16d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_AVX2, conv_f32d_to_s16d_avx2 },
+#endif
 #if defined (HAVE_SSE2)
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_SSE2, conv_f32d_to_s16d_sse2 },
 #endif
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S16P, 0, 0, conv_f32d_to_s16d_c },
 
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_SSE2, conv_f32_to_s16d_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16P, 0, 0, conv_f32_to_s16d_c },
 
 #if defined (HAVE_NEON)
@@ -141,7 +230,25 @@ static struct conv_info conv_table[] =
 #endif
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S16, 0, 0, conv_f32d_to_s16_c },
 
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_AVX512, conv_f32_to_s32_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_AVX2, conv_f32_to_s32_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_SSE2, conv_f32_to_s32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S32, 0, 0, conv_f32_to_s32_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_AVX512, conv_f32d_to_s32d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_AVX2, conv_f32d_to_s32d_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_SSE2, conv_f32d_to_s32d_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S32P, 0, 0, conv_f32d_to_s32d_c },
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S32P, 0, 0, conv_f32_to_s32d_c },
 #if defined (HAVE_AVX2)
@@ -159,7 +266,25 @@ static struct conv_info conv_table[] =
 
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S24_OE, 0, 0, conv_f32d_to_s24s_c },
 
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_AVX512, conv_f32_to_s24_32_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_AVX2, conv_f32_to_s24_32_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_SSE2, conv_f32_to_s24_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S24_32, 0, 0, conv_f32_to_s24_32_c },
+#if defined (HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_AVX512, conv_f32d_to_s24_32d_avx512 },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_AVX2, conv_f32d_to_s24_32d_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_SSE2, conv_f32d_to_s24_32d_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S24_32P, 0, 0, conv_f32d_to_s24_32d_c },
 	{ SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S24_32P, 0, 0, conv_f32_to_s24_32d_c },
 	{ SPA_AUDIO_FORMAT_F32P, SPA_AUDIO_FORMAT_S24_32, 0, 0, conv_f32d_to_s24_32_c },
@@ -179,7 +304,13 @@ static struct conv_info conv_table[] =
 	/* s32 */
 	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_S32, 0, 0, conv_copy32_c },
 	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_S32P, 0, 0, conv_copy32d_c },
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_SSE2, conv_deinterleave_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S32, SPA_AUDIO_FORMAT_S32P, 0, 0, conv_deinterleave_32_c },
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_SSE2, conv_interleave_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S32P, SPA_AUDIO_FORMAT_S32, 0, 0, conv_interleave_32_c },
 
 	/* s24 */
@@ -191,7 +322,13 @@ static struct conv_info conv_table[] =
 	/* s24_32 */
 	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_S24_32, 0, 0, conv_copy32_c },
 	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_S24_32P, 0, 0, conv_copy32d_c },
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_SSE2, conv_deinterleave_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S24_32, SPA_AUDIO_FORMAT_S24_32P, 0, 0, conv_deinterleave_32_c },
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_SSE2, conv_interleave_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S24_32P, SPA_AUDIO_FORMAT_S24_32, 0, 0, conv_interleave_32_c },
 };
 
@@ -213,16 +350,171 @@ static const struct conv_info *find_conv_info(uint32_t src_fmt, uint32_t dst_fmt
 	return NULL;
 }
 
+struct dither_info {
+	void (*process) (struct convert *conv, uint32_t channel, float * SPA_RESTRICT dst,
+			const float * SPA_RESTRICT src, uint32_t n_samples);
+	uint32_t method;
+	uint32_t cpu_flags;
+};
+
+static struct dither_info dither_table[] =
+{
+	{ conv_dither_f32_shaped_c, DITHER_METHOD_SHAPED, 0 },
+#if defined (HAVE_AVX2)
+	{ conv_dither_f32_avx2, 0, SPA_CPU_FLAG_AVX2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ conv_dither_f32_sse2, 0, SPA_CPU_FLAG_SSE2 },
+#endif
+	{ conv_dither_f32_c, 0, 0 },
+};
+
+#define MATCH_METHOD(a,b)	((a) == 0 || (a) == (b))
+
+static const struct dither_info *find_dither_info(uint32_t method, uint32_t cpu_flags)
+{
+	size_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(dither_table); i++) {
+		if (MATCH_METHOD(dither_table[i].method, method) &&
+		    MATCH_CPU_FLAGS(dither_table[i].cpu_flags, cpu_flags))
+			return &dither_table[i];
+	}
+	return NULL;
+}
+
+/* Dither a block of each channel into the scratch planes and let the
+ * regular conversion function turn the result into integers. */
+static void impl_convert_dither(struct convert *conv, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, offset, chunk, n_channels = conv->n_channels;
+	uint32_t n_dst = SPA_AUDIO_FORMAT_IS_PLANAR(conv->dst_fmt) ? n_channels : 1;
+	const void *s[SPA_AUDIO_MAX_CHANNELS];
+	void *d[SPA_AUDIO_MAX_CHANNELS];
+
+	for (offset = 0; offset < n_samples; offset += chunk) {
+		chunk = SPA_MIN(n_samples - offset, DITHER_SIZE);
+
+		for (i = 0; i < n_channels; i++) {
+			float *t = &conv->dither[i * DITHER_SIZE];
+			conv->dither_process(conv, i, t, (const float*)src[i] + offset, chunk);
+			s[i] = t;
+		}
+		for (i = 0; i < n_dst; i++)
+			d[i] = SPA_MEMBER(dst[i], offset * conv->dst_stride, void);
+
+		conv->quantize(conv, d, s, chunk);
+	}
+}
+
 static void impl_convert_free(struct convert *conv)
 {
 	conv->process = NULL;
+	free(conv->data);
+	conv->data = NULL;
+	conv->dither = NULL;
+}
+
+/* The dither state is allocated for every conversion that can be dithered,
+ * also when the method is none, so that the method can be changed later
+ * with convert_set_dither() */
+static int dither_init(struct convert *conv, uint32_t cpu_flags)
+{
+	uint32_t i, n_channels = conv->n_channels;
+	size_t size;
+
+	switch (conv->dst_fmt) {
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_U8P:
+		conv->scale = U8_SCALE;
+		conv->offs = U8_OFFS;
+		conv->min = U8_MIN;
+		conv->max = U8_MAX;
+		conv->dst_stride = 1;
+		break;
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16P:
+		conv->scale = S16_SCALE;
+		conv->offs = 0.0f;
+		conv->min = S16_MIN;
+		conv->max = S16_MAX;
+		conv->dst_stride = 2;
+		break;
+	default:
+		/* at 24 bits and up, float is not more precise than
+		 * the output and dither makes no difference */
+		return 0;
+	}
+	if (conv->src_fmt != SPA_AUDIO_FORMAT_F32P ||
+	    n_channels > SPA_AUDIO_MAX_CHANNELS)
+		return 0;
+
+	if (!SPA_AUDIO_FORMAT_IS_PLANAR(conv->dst_fmt))
+		conv->dst_stride *= n_channels;
+
+	size = n_channels * (DITHER_SIZE * sizeof(float) +
+			NS_MAX * sizeof(float) + DITHER_LANES * sizeof(uint32_t));
+	conv->data = calloc(1, size + 64);
+	if (conv->data == NULL)
+		return -errno;
+
+	conv->dither = SPA_MEMBER_ALIGN(conv->data, 0, 64, float);
+	conv->ns_data = &conv->dither[n_channels * DITHER_SIZE];
+	conv->random = (uint32_t*)&conv->ns_data[n_channels * NS_MAX];
+
+	/* xorshift needs a non zero seed, give all lanes of all
+	 * channels a different one */
+	for (i = 0; i < n_channels * DITHER_LANES; i++)
+		conv->random[i] = 0x9e3779b9u * (i + 1);
+
+	conv->dither_cpu_flags = cpu_flags;
+	conv->quantize = conv->process;
+
+	return convert_set_dither(conv, conv->method);
+}
+
+int convert_set_dither(struct convert *conv, uint32_t method)
+{
+	const struct dither_info *info;
+
+	if (conv->dither == NULL)
+		return method == DITHER_METHOD_NONE ? 0 : -ENOTSUP;
+
+	if (method == DITHER_METHOD_NONE) {
+		conv->process = conv->quantize;
+		conv->method = method;
+		return 0;
+	}
+	info = find_dither_info(method, conv->dither_cpu_flags);
+	if (info == NULL)
+		return -ENOTSUP;
+
+	/* the kernels look at the method, set it before they can run */
+	conv->method = method;
+	conv->dither_process = info->process;
+	conv->process = impl_convert_dither;
+
+	return 0;
+}
+
+uint32_t convert_dither_method(const char *str)
+{
+	if (strcmp(str, "rectangular") == 0)
+		return DITHER_METHOD_RECTANGULAR;
+	else if (strcmp(str, "triangular") == 0)
+		return DITHER_METHOD_TRIANGULAR;
+	else if (strcmp(str, "shaped") == 0)
+		return DITHER_METHOD_SHAPED;
+	return DITHER_METHOD_NONE;
 }
 
 int convert_init(struct convert *conv)
 {
 	const struct conv_info *info;
+	uint32_t cpu_flags = conv->cpu_flags;
 
-	info = find_conv_info(conv->src_fmt, conv->dst_fmt, conv->n_channels, conv->cpu_flags);
+	info = find_conv_info(conv->src_fmt, conv->dst_fmt, conv->n_channels, cpu_flags);
 	if (info == NULL)
 		return -ENOTSUP;
 
@@ -230,6 +522,8 @@ int convert_init(struct convert *conv)
 	conv->cpu_flags = info->cpu_flags;
 	conv->process = info->process;
 	conv->free = impl_convert_free;
+	conv->data = NULL;
+	conv->dither = NULL;
 
-	return 0;
+	return dither_init(conv, cpu_flags);
 }
@@ -101,26 +101,86 @@ static inline void write_s24s(void *dst, int32_t val)
 #endif
 }
 
-#define MAX_NS	64
+/* xorshift32, returns noise in [-0.5, 0.5) LSB */
+static inline float dither_random(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (int32_t)x * (1.0f / 4294967296.0f);
+}
+
+/* round to nearest even like rintf(), valid for |v| < 2^22 */
+#define DITHER_ROUND	12582912.0f
+
+static inline float dither_round(float v)
+{
+	return (v + DITHER_ROUND) - DITHER_ROUND;
+}
+
+/* Round to the nearest level and map it back to a float that the
+ * conversion functions turn into exactly that level. The level is
+ * nudged 1/4 LSB away from zero so that both the truncating and the
+ * rounding conversions end up on it. */
+static inline float dither_level(float q, float offs, float inv)
+{
+	return (q + (q < 0.0f ? -0.25f : 0.25f) - offs) * inv;
+}
+
+#define DITHER_METHOD_NONE		0	/**< quantize without dither */
+#define DITHER_METHOD_RECTANGULAR	1	/**< 1 LSB rectangular pdf noise */
+#define DITHER_METHOD_TRIANGULAR	2	/**< 2 LSB triangular pdf noise */
+#define DITHER_METHOD_SHAPED		3	/**< triangular noise with shaped error feedback */
+
+/* samples per channel that are dithered in one go */
+#define DITHER_SIZE	1024u
+/* independent PRNG lanes per channel, samples are spread over the lanes */
+#define DITHER_LANES	8
+#define NS_MAX		4
 
 struct convert {
 	uint32_t src_fmt;
 	uint32_t dst_fmt;
 	uint32_t n_channels;
 	uint32_t cpu_flags;
+	uint32_t method;		/**< DITHER_METHOD_*, only used for F32P to
+					  *  8 and 16 bits integer formats */
 
 	unsigned int is_passthrough:1;
-	float ns_data[MAX_NS];
-	uint32_t ns_idx;
-	uint32_t ns_size;
+
+	/* dither state, quantization happens in the integer domain of the
+	 * output format with scale, offs, min and max */
+	float scale;
+	float offs;
+	float min;
+	float max;
+	uint32_t dst_stride;
+	uint32_t dither_cpu_flags;	/**< CPU flags the dither kernels can use */
+	uint32_t *random;		/**< DITHER_LANES PRNG states per channel */
+	float *ns_data;			/**< NS_MAX error samples per channel */
+	float *dither;			/**< DITHER_SIZE samples per channel */
+	void *data;
 
 	void (*process) (struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
 			uint32_t n_samples);
+	void (*dither_process) (struct convert *conv, uint32_t channel, float * SPA_RESTRICT dst,
+			const float * SPA_RESTRICT src, uint32_t n_samples);
+	void (*quantize) (struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+			uint32_t n_samples);
 	void (*free) (struct convert *conv);
 };
 
 int convert_init(struct convert *conv);
 
+/* parse a dither method name: none, rectangular, triangular or shaped */
+uint32_t convert_dither_method(const char *str);
+
+/* change the dither method of an initialized converter. This only swaps
+ * function pointers and can be done while the converter is in use. */
+int convert_set_dither(struct convert *conv, uint32_t method);
+
 #define convert_process(conv,...)	(conv)->process(conv, __VA_ARGS__)
 #define convert_free(conv)		(conv)->free(conv)
 
@@ -201,6 +261,15 @@ DEFINE_FUNCTION(f32_to_s16, sse2);
 DEFINE_FUNCTION(f32d_to_s16_2, sse2);
 DEFINE_FUNCTION(f32d_to_s16, sse2);
 DEFINE_FUNCTION(f32d_to_s16d, sse2);
+DEFINE_FUNCTION(f32_to_s16d, sse2);
+DEFINE_FUNCTION(f32d_to_s32d, sse2);
+DEFINE_FUNCTION(f32_to_s32, sse2);
+DEFINE_FUNCTION(f32d_to_s24_32d, sse2);
+DEFINE_FUNCTION(f32_to_s24_32, sse2);
+DEFINE_FUNCTION(f32d_to_u8d, sse2);
+DEFINE_FUNCTION(f32_to_u8, sse2);
+DEFINE_FUNCTION(deinterleave_32, sse2);
+DEFINE_FUNCTION(interleave_32, sse2);
 #endif
 #if defined(HAVE_SSSE3)
 DEFINE_FUNCTION(s24_to_f32d, ssse3);
@@ -217,6 +286,55 @@ DEFINE_FUNCTION(f32d_to_s32, avx2);
 DEFINE_FUNCTION(f32d_to_s16_4, avx2);
 DEFINE_FUNCTION(f32d_to_s16_2, avx2);
 DEFINE_FUNCTION(f32d_to_s16, avx2);
+DEFINE_FUNCTION(s16d_to_f32d, avx2);
+DEFINE_FUNCTION(s16_to_f32, avx2);
+DEFINE_FUNCTION(f32d_to_s16d, avx2);
+DEFINE_FUNCTION(f32_to_s16, avx2);
+DEFINE_FUNCTION(s32d_to_f32d, avx2);
+DEFINE_FUNCTION(s32_to_f32, avx2);
+DEFINE_FUNCTION(f32d_to_s32d, avx2);
+DEFINE_FUNCTION(f32_to_s32, avx2);
+DEFINE_FUNCTION(s24_32d_to_f32d, avx2);
+DEFINE_FUNCTION(s24_32_to_f32, avx2);
+DEFINE_FUNCTION(f32d_to_s24_32d, avx2);
+DEFINE_FUNCTION(f32_to_s24_32, avx2);
+DEFINE_FUNCTION(u8d_to_f32d, avx2);
+DEFINE_FUNCTION(u8_to_f32, avx2);
+DEFINE_FUNCTION(f32d_to_u8d, avx2);
+DEFINE_FUNCTION(f32_to_u8, avx2);
+#endif
+#if defined(HAVE_AVX512)
+DEFINE_FUNCTION(s16d_to_f32d, avx512);
+DEFINE_FUNCTION(s16_to_f32, avx512);
+DEFINE_FUNCTION(f32d_to_s16d, avx512);
+DEFINE_FUNCTION(f32_to_s16, avx512);
+DEFINE_FUNCTION(s32d_to_f32d, avx512);
+DEFINE_FUNCTION(s32_to_f32, avx512);
+DEFINE_FUNCTION(f32d_to_s32d, avx512);
+DEFINE_FUNCTION(f32_to_s32, avx512);
+DEFINE_FUNCTION(s24_32d_to_f32d, avx512);
+DEFINE_FUNCTION(s24_32_to_f32, avx512);
+DEFINE_FUNCTION(f32d_to_s24_32d, avx512);
+DEFINE_FUNCTION(f32_to_s24_32, avx512);
+DEFINE_FUNCTION(u8d_to_f32d, avx512);
+DEFINE_FUNCTION(u8_to_f32, avx512);
+DEFINE_FUNCTION(f32d_to_u8d, avx512);
+DEFINE_FUNCTION(f32_to_u8, avx512);
+#endif
+
+#define DEFINE_DITHER(arch) \
+void conv_dither_f32_##arch(struct convert *conv, uint32_t channel,		\
+		float * SPA_RESTRICT dst, const float * SPA_RESTRICT src,	\
+		uint32_t n_samples)
+
+DEFINE_DITHER(c);
+DEFINE_DITHER(shaped_c);
+#if defined(HAVE_SSE2)
+DEFINE_DITHER(sse2);
+#endif
+#if defined(HAVE_AVX2)
+DEFINE_DITHER(avx2);
 #endif
 
+#undef DEFINE_DITHER
 #undef DEFINE_FUNCTION
@@ -54,7 +54,7 @@
 #define MAX_DATAS	SPA_AUDIO_MAX_CHANNELS
 
 #define PROP_DEFAULT_TRUNCATE	false
-#define PROP_DEFAULT_DITHER	0
+#define PROP_DEFAULT_DITHER	DITHER_METHOD_NONE
 
 struct impl;
 
@@ -194,7 +194,10 @@ static int setup_convert(struct impl *this)
 	this->conv.dst_fmt = dst_fmt;
 	this->conv.n_channels = outformat.info.raw.channels;
 	this->conv.cpu_flags = this->cpu_flags;
+	this->conv.method = this->props.dither;
 
+	if (this->conv.process)
+		convert_free(&this->conv);
 	if ((res = convert_init(&this->conv)) < 0)
 		return res;
 
@@ -216,7 +219,30 @@ static int impl_node_enum_params(void *object, int seq,
 static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 			       const struct spa_pod *param)
 {
-	return -ENOTSUP;
+	struct impl *this = object;
+	struct props *p = &this->props;
+	uint32_t dither = p->dither;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	switch (id) {
+	case SPA_PARAM_Props:
+		if (param == NULL) {
+			dither = PROP_DEFAULT_DITHER;
+		} else {
+			spa_pod_parse_object(param,
+				SPA_TYPE_OBJECT_Props, NULL,
+				SPA_PROP_ditherType,	SPA_POD_OPT_Id(&dither));
+		}
+		if (dither == p->dither)
+			return 0;
+		p->dither = dither;
+		if (this->conv.process)
+			return convert_set_dither(&this->conv, dither);
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
 }
 
 static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
@@ -948,6 +974,14 @@ static int impl_get_interface(struct spa_handle *handle, const char *type, void
 
 static int impl_clear(struct spa_handle *handle)
 {
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (this->conv.process)
+		convert_free(&this->conv);
 	return 0;
 }
 
@@ -1019,6 +1053,13 @@ impl_init(const struct spa_handle_factory *factory,
 	this->info.n_params = 0;
 	props_reset(&this->props);
 
+	if (info != NULL) {
+		const char *str;
+
+		if ((str = spa_dict_lookup(info, "dither.method")) != NULL)
+			this->props.dither = convert_dither_method(str);
+	}
+
 	init_port(this, SPA_DIRECTION_OUTPUT, 0);
 	init_port(this, SPA_DIRECTION_INPUT, 0);
 
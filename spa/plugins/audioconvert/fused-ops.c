@@ -0,0 +1,381 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <spa/support/log.h>
+#include <spa/utils/defs.h>
+#include <spa/param/audio/format-utils.h>
+
+#include "fused-ops.h"
+
+#define _MASK(ch)	(1ULL << SPA_AUDIO_CHANNEL_ ## ch)
+
+static uint64_t default_mask(uint32_t channels)
+{
+	uint64_t mask = 0;
+	switch (channels) {
+	case 7:
+	case 8:
+		mask |= _MASK(RL);
+		mask |= _MASK(RR);
+		SPA_FALLTHROUGH
+	case 5:
+	case 6:
+		mask |= _MASK(SL);
+		mask |= _MASK(SR);
+		if ((channels & 1) == 0)
+			mask |= _MASK(LFE);
+		SPA_FALLTHROUGH
+	case 3:
+		mask |= _MASK(FC);
+		SPA_FALLTHROUGH
+	case 2:
+		mask |= _MASK(FL);
+		mask |= _MASK(FR);
+		break;
+	case 1:
+		mask |= _MASK(MONO);
+		break;
+	case 4:
+		mask |= _MASK(FL);
+		mask |= _MASK(FR);
+		mask |= _MASK(RL);
+		mask |= _MASK(RR);
+		break;
+	}
+	return mask;
+}
+
+static uint64_t channel_mask(const struct spa_audio_info_raw *info)
+{
+	uint64_t mask = 0;
+	uint32_t i, p;
+
+	for (i = 0; i < info->channels; i++) {
+		p = info->position[i];
+		mask |= 1ULL << (p < 64 ? p : 0);
+	}
+	if (mask & 1 || info->channels == 1)
+		mask = default_mask(info->channels);
+	return mask;
+}
+
+static uint32_t calc_width(const struct spa_audio_info_raw *info)
+{
+	switch (info->format) {
+	case SPA_AUDIO_FORMAT_U8P:
+	case SPA_AUDIO_FORMAT_U8:
+		return 1;
+	case SPA_AUDIO_FORMAT_S16P:
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16_OE:
+		return 2;
+	case SPA_AUDIO_FORMAT_S24P:
+	case SPA_AUDIO_FORMAT_S24:
+	case SPA_AUDIO_FORMAT_S24_OE:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+/* same channel matching as the fmtconvert node */
+static void calc_remap(const struct spa_audio_info_raw *in, const struct spa_audio_info_raw *out,
+		uint32_t *src_remap, uint32_t *dst_remap)
+{
+	uint32_t i, j, position[SPA_AUDIO_MAX_CHANNELS];
+
+	for (i = 0; i < SPA_AUDIO_MAX_CHANNELS; i++)
+		src_remap[i] = dst_remap[i] = i;
+
+	memcpy(position, out->position, sizeof(position));
+	for (i = 0; i < in->channels; i++) {
+		for (j = 0; j < out->channels; j++) {
+			if (in->position[i] != position[j])
+				continue;
+			src_remap[j] = i;
+			dst_remap[i] = j;
+			position[j] = -1;
+			break;
+		}
+	}
+}
+
+static int setup_convert(struct fused *f, struct convert *conv,
+		const struct spa_audio_info_raw *in, const struct spa_audio_info_raw *out,
+		uint32_t *src_remap, uint32_t *dst_remap)
+{
+	if (in->channels != out->channels || in->rate != out->rate)
+		return -EINVAL;
+
+	calc_remap(in, out, src_remap, dst_remap);
+
+	conv->src_fmt = in->format;
+	conv->dst_fmt = out->format;
+	conv->n_channels = out->channels;
+	conv->cpu_flags = f->cpu_flags;
+	conv->method = f->dither;
+
+	return convert_init(conv);
+}
+
+static int setup_channelmix(struct fused *f)
+{
+	struct spa_audio_info_raw *src = &f->mix_info[0], *dst = &f->mix_info[1];
+
+	if (src->rate != dst->rate)
+		return -EINVAL;
+
+	f->mix.src_chan = src->channels;
+	f->mix.src_mask = channel_mask(src);
+	f->mix.dst_chan = dst->channels;
+	f->mix.dst_mask = channel_mask(dst);
+	f->mix.cpu_flags = f->cpu_flags;
+	f->mix.options = f->options;
+	f->mix.log = f->log;
+
+	return channelmix_init(&f->mix);
+}
+
+static int setup_resample(struct fused *f)
+{
+	f->resample.channels = f->mix_info[1].channels;
+	f->resample.i_rate = f->mix_info[1].rate;
+	f->resample.o_rate = f->dst_info.rate;
+	f->resample.log = f->log;
+	f->resample.quality = f->quality;
+	f->resample.filter = f->filter;
+	f->resample.cpu_flags = f->cpu_flags;
+
+	return resample_native_init(&f->resample);
+}
+
+static int setup_scratch(struct fused *f)
+{
+	uint32_t i, n_unpacked, n_mixed, in_stride, out_stride;
+
+	/* a block asks for at most this many input samples. When the rate
+	 * is adjusted, blocks are clamped to this size and simply produce
+	 * a little less output. */
+	f->max_in = resample_in_len(&f->resample, FUSED_BLOCK_SIZE);
+	f->max_in = SPA_ROUND_UP_N(f->max_in + f->max_in / 8, 16);
+
+	n_unpacked = f->mix_info[0].channels;
+	n_mixed = f->mix_info[1].channels;
+
+	in_stride = SPA_ROUND_UP_N(f->max_in * sizeof(float), 64);
+	out_stride = SPA_ROUND_UP_N(FUSED_BLOCK_SIZE * sizeof(float), 64);
+
+	f->scratch = calloc(1, (n_unpacked + n_mixed) * in_stride +
+			n_mixed * out_stride + 64);
+	if (f->scratch == NULL)
+		return -errno;
+
+	for (i = 0; i < n_unpacked; i++)
+		f->unpacked[i] = SPA_MEMBER_ALIGN(f->scratch, i * in_stride, 64, void);
+	for (i = 0; i < n_mixed; i++) {
+		f->mixed[i] = SPA_MEMBER_ALIGN(f->scratch,
+				(n_unpacked + i) * in_stride, 64, void);
+		f->resampled[i] = SPA_MEMBER_ALIGN(f->scratch,
+				(n_unpacked + n_mixed) * in_stride + i * out_stride, 64, void);
+	}
+	return 0;
+}
+
+int fused_init(struct fused *f)
+{
+	int res;
+
+	if (f->mix_info[0].format != SPA_AUDIO_FORMAT_F32P ||
+	    f->mix_info[1].format != SPA_AUDIO_FORMAT_F32P ||
+	    f->src_info.channels > SPA_AUDIO_MAX_CHANNELS ||
+	    f->dst_info.channels > SPA_AUDIO_MAX_CHANNELS)
+		return -EINVAL;
+
+	if ((res = setup_convert(f, &f->conv_in, &f->src_info, &f->mix_info[0],
+					f->in_src_remap, f->in_dst_remap)) < 0)
+		return res;
+
+	/* the resampler sits between the channelmix and the output
+	 * converter and only changes the rate */
+	f->mix_info[1].rate = f->src_info.rate;
+	if ((res = setup_channelmix(f)) < 0)
+		goto error_conv_in;
+
+	if ((res = setup_resample(f)) < 0)
+		goto error_mix;
+
+	{
+		struct spa_audio_info_raw resampled = f->mix_info[1];
+		resampled.rate = f->dst_info.rate;
+		if ((res = setup_convert(f, &f->conv_out, &resampled, &f->dst_info,
+					f->out_src_remap, f->out_dst_remap)) < 0)
+			goto error_resample;
+	}
+
+	if ((res = setup_scratch(f)) < 0)
+		goto error_conv_out;
+
+	f->src_stride = calc_width(&f->src_info);
+	f->n_src_datas = f->src_info.channels;
+	if (!SPA_AUDIO_FORMAT_IS_PLANAR(f->src_info.format)) {
+		f->src_stride *= f->src_info.channels;
+		f->n_src_datas = 1;
+	}
+	f->dst_stride = calc_width(&f->dst_info);
+	f->n_dst_datas = f->dst_info.channels;
+	if (!SPA_AUDIO_FORMAT_IS_PLANAR(f->dst_info.format)) {
+		f->dst_stride *= f->dst_info.channels;
+		f->n_dst_datas = 1;
+	}
+
+	spa_log_debug(f->log, "fused %p: block:%d max-in:%d passthrough:%d:%d:%d", f,
+			FUSED_BLOCK_SIZE, f->max_in, f->conv_in.is_passthrough,
+			SPA_FLAG_IS_SET(f->mix.flags, CHANNELMIX_FLAG_IDENTITY),
+			f->conv_out.is_passthrough);
+
+	return 0;
+
+error_conv_out:
+	convert_free(&f->conv_out);
+error_resample:
+	resample_free(&f->resample);
+error_mix:
+	channelmix_free(&f->mix);
+error_conv_in:
+	convert_free(&f->conv_in);
+	return res;
+}
+
+void fused_free(struct fused *f)
+{
+	convert_free(&f->conv_in);
+	channelmix_free(&f->mix);
+	resample_free(&f->resample);
+	convert_free(&f->conv_out);
+	free(f->scratch);
+	f->scratch = NULL;
+}
+
+void fused_reset(struct fused *f)
+{
+	resample_reset(&f->resample);
+}
+
+void fused_set_volume(struct fused *f, float volume, bool mute,
+		uint32_t n_channel_volumes, float *channel_volumes)
+{
+	channelmix_set_volume(&f->mix, volume, mute, n_channel_volumes, channel_volumes);
+}
+
+int fused_set_dither(struct fused *f, uint32_t method)
+{
+	f->dither = method;
+	return convert_set_dither(&f->conv_out, method);
+}
+
+void fused_process(struct fused *f,
+		const void * SPA_RESTRICT src[], uint32_t *in_len,
+		void * SPA_RESTRICT dst[], uint32_t *out_len)
+{
+	uint32_t i, in_total = *in_len, out_total = *out_len;
+	uint32_t in_done = 0, out_done = 0;
+	uint32_t n_unpacked = f->mix_info[0].channels;
+	uint32_t n_mixed = f->mix_info[1].channels;
+	const void *src_datas[SPA_AUDIO_MAX_CHANNELS];
+	void *unpacked[SPA_AUDIO_MAX_CHANNELS];
+	const void *resampled[SPA_AUDIO_MAX_CHANNELS];
+	void *dst_datas[SPA_AUDIO_MAX_CHANNELS];
+	const void **mix_src, **resample_src;
+	void **resample_dst;
+	bool mix_passthrough;
+
+	/* order the planes between the stages like the fmtconvert nodes do */
+	for (i = 0; i < n_unpacked; i++)
+		unpacked[n_unpacked > 1 ? f->in_dst_remap[i] : 0] = f->unpacked[i];
+	for (i = 0; i < n_mixed; i++)
+		resampled[n_mixed > 1 ? f->out_src_remap[i] : 0] = f->resampled[i];
+
+	mix_passthrough = SPA_FLAG_IS_SET(f->mix.flags, CHANNELMIX_FLAG_IDENTITY);
+
+	mix_src = f->conv_in.is_passthrough ? src_datas : (const void**)f->unpacked;
+	if (src == NULL)
+		resample_src = (const void**)f->mixed;
+	else
+		resample_src = mix_passthrough ? mix_src : (const void**)f->mixed;
+	resample_dst = f->conv_out.is_passthrough ? dst_datas : f->resampled;
+
+	while (out_done < out_total) {
+		uint32_t in_block, out_block;
+
+		out_block = SPA_MIN(out_total - out_done, FUSED_BLOCK_SIZE);
+		in_block = resample_in_len(&f->resample, out_block);
+		in_block = SPA_MIN(in_block, f->max_in);
+		in_block = SPA_MIN(in_block, in_total - in_done);
+		if (in_block == 0)
+			break;
+
+		if (SPA_LIKELY(src != NULL)) {
+			for (i = 0; i < f->n_src_datas; i++)
+				src_datas[f->n_src_datas > 1 ? f->in_src_remap[i] : 0] =
+					SPA_MEMBER(src[i], in_done * f->src_stride, void);
+
+			if (!f->conv_in.is_passthrough)
+				convert_process(&f->conv_in, unpacked, src_datas, in_block);
+			if (!mix_passthrough)
+				channelmix_process(&f->mix, n_mixed, f->mixed,
+						n_unpacked, mix_src, in_block);
+		} else {
+			for (i = 0; i < n_mixed; i++)
+				memset(f->mixed[i], 0, in_block * sizeof(float));
+		}
+
+		if (f->conv_out.is_passthrough) {
+			for (i = 0; i < n_mixed; i++)
+				dst_datas[i] = SPA_MEMBER(dst[n_mixed > 1 ? f->out_src_remap[i] : 0],
+						out_done * f->dst_stride, void);
+		} else {
+			for (i = 0; i < f->n_dst_datas; i++)
+				dst_datas[f->n_dst_datas > 1 ? f->out_dst_remap[i] : 0] =
+					SPA_MEMBER(dst[i], out_done * f->dst_stride, void);
+		}
+
+		resample_process(&f->resample, resample_src, &in_block,
+				resample_dst, &out_block);
+
+		if (!f->conv_out.is_passthrough && out_block > 0)
+			convert_process(&f->conv_out, dst_datas, resampled, out_block);
+
+		in_done += in_block;
+		out_done += out_block;
+
+		if (in_block == 0 && out_block == 0)
+			break;
+	}
+	*in_len = in_done;
+	*out_len = out_done;
+}
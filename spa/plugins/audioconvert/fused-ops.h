@@ -0,0 +1,93 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FUSED_OPS_H
+#define FUSED_OPS_H
+
+#include <spa/support/log.h>
+#include <spa/param/audio/raw.h>
+
+#include "fmt-ops.h"
+#include "channelmix-ops.h"
+#include "resample.h"
+
+/* number of output samples converted per block. The intermediate
+ * F32 planes of one block stay in the cache between the stages. */
+#define FUSED_BLOCK_SIZE	256u
+
+/* Runs unpack, channelmix (with volume), resample and pack over
+ * small blocks instead of over the complete buffer between each
+ * stage. The result is the same as running the stages one after
+ * the other. */
+struct fused {
+	struct spa_audio_info_raw src_info;	/**< input format */
+	struct spa_audio_info_raw mix_info[2];	/**< F32P before and after channelmix */
+	struct spa_audio_info_raw dst_info;	/**< output format */
+	uint32_t cpu_flags;
+	uint32_t options;			/**< channelmix options */
+	int quality;				/**< resampler quality */
+	uint32_t filter;			/**< resampler filter type */
+	uint32_t dither;			/**< output dither method */
+
+	struct spa_log *log;
+
+	struct convert conv_in;
+	struct channelmix mix;
+	struct resample resample;
+	struct convert conv_out;
+
+	uint32_t in_src_remap[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t in_dst_remap[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t out_src_remap[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t out_dst_remap[SPA_AUDIO_MAX_CHANNELS];
+
+	uint32_t src_stride;			/**< bytes per sample in an input plane */
+	uint32_t dst_stride;			/**< bytes per sample in an output plane */
+	uint32_t n_src_datas;
+	uint32_t n_dst_datas;
+	uint32_t max_in;			/**< input samples per block */
+
+	void *scratch;
+	void *unpacked[SPA_AUDIO_MAX_CHANNELS];
+	void *mixed[SPA_AUDIO_MAX_CHANNELS];
+	void *resampled[SPA_AUDIO_MAX_CHANNELS];
+};
+
+int fused_init(struct fused *f);
+void fused_free(struct fused *f);
+void fused_reset(struct fused *f);
+
+void fused_set_volume(struct fused *f, float volume, bool mute,
+		uint32_t n_channel_volumes, float *channel_volumes);
+int fused_set_dither(struct fused *f, uint32_t method);
+
+/* Convert at most *in_len samples from src into at most *out_len samples
+ * in dst. On return, *in_len contains the number of consumed samples and
+ * *out_len the number of produced samples. When src is NULL, silence is
+ * used as input, which is used to drain the resampler. */
+void fused_process(struct fused *f,
+		const void * SPA_RESTRICT src[], uint32_t *in_len,
+		void * SPA_RESTRICT dst[], uint32_t *out_len);
+
+#endif /* FUSED_OPS_H */
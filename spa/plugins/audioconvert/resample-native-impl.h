@@ -40,10 +40,13 @@ struct resample_info {
 	resample_func_t process_inter;
 };
 
+struct native_filter;
+
 struct native_data {
 	double rate;
 	uint32_t n_taps;
 	uint32_t n_phases;
+	uint32_t delay;
 	uint32_t in_rate;
 	uint32_t out_rate;
 	uint32_t phase;
@@ -56,6 +59,7 @@ struct native_data {
 	resample_func_t func;
 	float *filter;
 	float *hist_mem;
+	struct native_filter *filter_bank;
 	const struct resample_info *info;
 };
 
@@ -68,7 +72,7 @@ void do_resample_##type##_##arch(struct resample *r,				\
 DEFINE_RESAMPLER(copy,arch)							\
 {										\
 	struct native_data *data = r->data;					\
-	uint32_t index, n_taps = data->n_taps, n_taps2 = n_taps/2;		\
+	uint32_t index, n_taps = data->n_taps, n_taps2 = n_taps - data->delay;	\
 	uint32_t c, olen = *out_len, ilen = *in_len;				\
 										\
 	if (r->channels == 0)							\
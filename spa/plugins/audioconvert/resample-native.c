@@ -23,7 +23,9 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 
+#include <spa/utils/list.h>
 #include <spa/param/audio/format.h>
 
 #include "resample-native-impl.h"
@@ -51,6 +53,66 @@ static const struct quality blackman_qualities[] = {
 	{ 1024, 0.998, },
 };
 
+/* fewer taps with a higher cutoff than the blackman qualities. They
+ * let through more aliasing but halve the delay. */
+static const struct quality short_qualities[] = {
+	{ 8, 0.60, },
+	{ 8, 0.70, },
+	{ 16, 0.76, },
+	{ 16, 0.80, },
+	{ 24, 0.84, },                  /* default */
+	{ 24, 0.87, },
+	{ 32, 0.89, },
+	{ 32, 0.91, },
+};
+
+struct filter_type {
+	const char *name;
+	const struct quality *qualities;
+	uint32_t n_qualities;
+};
+
+static const struct filter_type filter_types[] = {
+	[RESAMPLE_FILTER_LINEAR] = { "linear",
+		blackman_qualities, SPA_N_ELEMENTS(blackman_qualities) },
+	[RESAMPLE_FILTER_SHORT] = { "short",
+		short_qualities, SPA_N_ELEMENTS(short_qualities) },
+	[RESAMPLE_FILTER_MINIMUM] = { "minimum-phase",
+		blackman_qualities, SPA_N_ELEMENTS(blackman_qualities) },
+};
+
+/* the minimum phase filter is designed on a grid with this many points
+ * at most, it is interpolated to the phases of the filter bank */
+#define MIN_PHASE_POINTS	65536
+
+/* The filter bank only depends on the reduced rates and the quality.
+ * It is read-only after it was built so that all resamplers in the
+ * process with the same parameters can share it. */
+struct native_filter {
+	struct spa_list link;
+	int ref;
+	uint32_t in_rate;
+	uint32_t out_rate;
+	int quality;
+	uint32_t filter;
+	uint32_t cpu_flags;
+	uint32_t n_taps;
+	uint32_t n_phases;
+	uint32_t delay;
+	uint32_t filter_stride;
+	size_t size;
+	float *taps;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct spa_list filters;
+	struct resample_native_stats stats;
+} filter_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.filters = { &filter_cache.filters, &filter_cache.filters },
+};
+
 static inline double sinc(double x)
 {
 	if (x < 1e-6) return 1.0;
@@ -81,6 +143,126 @@ static int build_filter(float *taps, uint32_t stride, uint32_t n_taps, uint32_t
 	return 0;
 }
 
+/* in-place radix-2 FFT of n interleaved complex values */
+static void fft(double *x, uint32_t n, bool inverse)
+{
+	uint32_t i, j, k, m, bit;
+
+	for (i = 1, j = 0; i < n; i++) {
+		for (bit = n >> 1; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			SPA_SWAP(x[2 * i], x[2 * j]);
+			SPA_SWAP(x[2 * i + 1], x[2 * j + 1]);
+		}
+	}
+	for (m = 2; m <= n; m <<= 1) {
+		double a = (inverse ? 2.0 : -2.0) * M_PI / m;
+		double wr = cos(a), wi = sin(a);
+
+		for (i = 0; i < n; i += m) {
+			double cr = 1.0, ci = 0.0, t;
+
+			for (k = 0; k < m / 2; k++) {
+				double *p = &x[2 * (i + k)], *q = &x[2 * (i + k + m / 2)];
+				double tr = q[0] * cr - q[1] * ci;
+				double ti = q[0] * ci + q[1] * cr;
+
+				q[0] = p[0] - tr;
+				q[1] = p[1] - ti;
+				p[0] += tr;
+				p[1] += ti;
+
+				t = cr * wr - ci * wi;
+				ci = cr * wi + ci * wr;
+				cr = t;
+			}
+		}
+	}
+	if (inverse) {
+		for (i = 0; i < 2 * n; i++)
+			x[i] /= n;
+	}
+}
+
+static inline double cubic(const double *x, uint32_t n, double pos)
+{
+	int32_t i = (int32_t) floor(pos);
+	double f = pos - i;
+	double y0 = x[2 * ((i - 1) & (n - 1))];
+	double y1 = x[2 * ((i + 0) & (n - 1))];
+	double y2 = x[2 * ((i + 1) & (n - 1))];
+	double y3 = x[2 * ((i + 2) & (n - 1))];
+
+	return y1 + 0.5 * f * (y2 - y0 + f * (2.0 * y0 - 5.0 * y1 + 4.0 * y2 - y3 +
+				f * (3.0 * (y1 - y2) + y3 - y0)));
+}
+
+/* Make a minimum phase version of the blackman filter with the homomorphic
+ * method: the causal part of the real cepstrum of the magnitude response
+ * gives the minimum phase response with the same magnitude.
+ * The taps are stored time reversed because the inner product runs forward
+ * over the input. The delay is the group delay at DC, in samples. */
+static int build_filter_min_phase(float *taps, uint32_t stride, uint32_t n_taps,
+		uint32_t n_phases, double cutoff, uint32_t *delay)
+{
+	uint32_t i, j, n, os, len;
+	double *x, sum = 0.0, moment = 0.0;
+
+	os = SPA_CLAMP(MIN_PHASE_POINTS / n_taps, 8u, 64u);
+	len = n_taps * os;
+	for (n = 1; n < len * 4; n <<= 1);
+
+	if ((x = calloc(n, 2 * sizeof(double))) == NULL)
+		return -errno;
+
+	for (i = 0; i < len; i++) {
+		double t = ((double) i - len / 2) / os;
+		x[2 * i] = cutoff * sinc(fabs(t) * cutoff) * blackman(t, n_taps);
+	}
+
+	fft(x, n, false);
+	for (i = 0; i < n; i++) {
+		double mag = hypot(x[2 * i], x[2 * i + 1]);
+		x[2 * i] = log(SPA_MAX(mag, 1e-10));
+		x[2 * i + 1] = 0.0;
+	}
+	fft(x, n, true);
+
+	/* fold the anti-causal part of the cepstrum onto the causal part */
+	for (i = 1; i < n / 2; i++) {
+		x[2 * i] *= 2.0;
+		x[2 * i + 1] *= 2.0;
+	}
+	for (i = n / 2 + 1; i < n; i++)
+		x[2 * i] = x[2 * i + 1] = 0.0;
+	x[1] = x[n + 1] = 0.0;
+
+	fft(x, n, false);
+	for (i = 0; i < n; i++) {
+		double e = exp(x[2 * i]), p = x[2 * i + 1];
+		x[2 * i] = e * cos(p);
+		x[2 * i + 1] = e * sin(p);
+	}
+	fft(x, n, true);
+
+	for (i = 0; i < len; i++) {
+		sum += x[2 * i];
+		moment += x[2 * i] * i;
+	}
+	*delay = SPA_CLAMP((uint32_t) lrint(moment / sum / os), 1u, n_taps / 2);
+
+	for (i = 0; i <= n_phases; i++) {
+		for (j = 0; j < n_taps; j++) {
+			double t = n_taps - j - 1 + (double) i / n_phases;
+			taps[i * stride + j] = cubic(x, n, t * os);
+		}
+	}
+	free(x);
+	return 0;
+}
+
 static void inner_product_c(float *d, const float * SPA_RESTRICT s,
 		const float * SPA_RESTRICT taps, uint32_t n_taps)
 {
@@ -144,10 +326,125 @@ static const struct resample_info *find_resample_info(uint32_t format, uint32_t
 	return NULL;
 }
 
+static struct native_filter *filter_find(uint32_t in_rate, uint32_t out_rate,
+		int quality, uint32_t filter, uint32_t cpu_flags)
+{
+	struct native_filter *f;
+
+	spa_list_for_each(f, &filter_cache.filters, link) {
+		if (f->in_rate == in_rate && f->out_rate == out_rate &&
+		    f->quality == quality && f->filter == filter &&
+		    f->cpu_flags == cpu_flags)
+			return f;
+	}
+	return NULL;
+}
+
+static struct native_filter *filter_acquire(struct resample *r, uint32_t in_rate,
+		uint32_t out_rate, uint32_t cpu_flags)
+{
+	const struct quality *q = &filter_types[r->filter].qualities[r->quality];
+	struct native_filter *f;
+	double scale;
+	uint32_t n_taps, n_phases, oversample, filter_stride;
+	size_t filter_size;
+
+	pthread_mutex_lock(&filter_cache.lock);
+
+	if ((f = filter_find(in_rate, out_rate, r->quality, r->filter, cpu_flags)) != NULL) {
+		f->ref++;
+		filter_cache.stats.hits++;
+		goto done;
+	}
+
+	scale = SPA_MIN(q->cutoff * out_rate / in_rate, 1.0);
+	/* multiple of 8 taps to ease simd optimizations */
+	n_taps = SPA_ROUND_UP_N((uint32_t)ceil(q->n_taps / scale), 8);
+
+	/* try to get at least 256 phases so that interpolation is
+	 * accurate enough when activated */
+	n_phases = out_rate;
+	oversample = (255 + n_phases) / n_phases;
+	n_phases *= oversample;
+
+	filter_stride = SPA_ROUND_UP_N(n_taps * sizeof(float), 64);
+	filter_size = filter_stride * (n_phases + 1);
+
+	f = calloc(1, sizeof(struct native_filter) + filter_size + 64);
+	if (f == NULL) {
+		pthread_mutex_unlock(&filter_cache.lock);
+		return NULL;
+	}
+
+	f->ref = 1;
+	f->in_rate = in_rate;
+	f->out_rate = out_rate;
+	f->quality = r->quality;
+	f->filter = r->filter;
+	f->cpu_flags = cpu_flags;
+	f->n_taps = n_taps;
+	f->n_phases = n_phases;
+	f->delay = n_taps / 2;
+	f->filter_stride = filter_stride / sizeof(float);
+	f->size = filter_size;
+	f->taps = SPA_MEMBER_ALIGN(f, sizeof(struct native_filter), 64, float);
+
+	if (r->filter == RESAMPLE_FILTER_MINIMUM) {
+		if (build_filter_min_phase(f->taps, f->filter_stride, n_taps,
+				n_phases, scale, &f->delay) < 0) {
+			int res = errno;
+			free(f);
+			pthread_mutex_unlock(&filter_cache.lock);
+			errno = res;
+			return NULL;
+		}
+	} else {
+		build_filter(f->taps, f->filter_stride, n_taps, n_phases, scale);
+	}
+
+	spa_list_append(&filter_cache.filters, &f->link);
+	filter_cache.stats.misses++;
+	filter_cache.stats.n_filters++;
+	filter_cache.stats.bytes += filter_size;
+
+done:
+	spa_log_debug(r->log, "native %p: filter %p in:%d out:%d q:%d %s hits:%"PRIu64
+			" misses:%"PRIu64" filters:%u bytes:%zu", r, f, in_rate, out_rate,
+			r->quality, filter_types[r->filter].name, filter_cache.stats.hits, filter_cache.stats.misses,
+			filter_cache.stats.n_filters, filter_cache.stats.bytes);
+
+	pthread_mutex_unlock(&filter_cache.lock);
+
+	return f;
+}
+
+static void filter_release(struct native_filter *f)
+{
+	pthread_mutex_lock(&filter_cache.lock);
+	if (--f->ref == 0) {
+		spa_list_remove(&f->link);
+		filter_cache.stats.n_filters--;
+		filter_cache.stats.bytes -= f->size;
+		free(f);
+	}
+	pthread_mutex_unlock(&filter_cache.lock);
+}
+
+void resample_native_get_stats(struct resample_native_stats *stats)
+{
+	pthread_mutex_lock(&filter_cache.lock);
+	*stats = filter_cache.stats;
+	pthread_mutex_unlock(&filter_cache.lock);
+}
+
 static void impl_native_free(struct resample *r)
 {
+	struct native_data *d = r->data;
+
 	spa_log_debug(r->log, "native %p: free", r);
-	free(r->data);
+	if (d != NULL)
+		filter_release(d->filter_bank);
+	free(d);
 	r->data = NULL;
 }
 
@@ -308,25 +605,37 @@ static void impl_native_reset (struct resample *r)
 	if (d == NULL)
 		return;
 	memset(d->hist_mem, 0, r->channels * sizeof(float) * d->n_taps * 2);
-	d->hist = (d->n_taps / 2) - 1;
+	d->hist = d->n_taps - d->delay - 1;
 	d->phase = 0;
 }
 
 static uint32_t impl_native_delay (struct resample *r)
 {
 	struct native_data *d = r->data;
-	return d->n_taps / 2;
+	return d->delay;
+}
+
+uint32_t resample_native_filter(const char *str)
+{
+	uint32_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(filter_types); i++) {
+		if (strcmp(filter_types[i].name, str) == 0)
+			return i;
+	}
+	return RESAMPLE_FILTER_LINEAR;
 }
 
 int resample_native_init(struct resample *r)
 {
 	struct native_data *d;
-	const struct quality *q;
-	double scale;
-	uint32_t c, n_taps, n_phases, filter_size, in_rate, out_rate, gcd, filter_stride;
-	uint32_t history_stride, history_size, oversample;
-
-	r->quality = SPA_CLAMP(r->quality, 0, (int) SPA_N_ELEMENTS(blackman_qualities) - 1);
+	const struct resample_info *info;
+	struct native_filter *f;
+	uint32_t c, in_rate, out_rate, gcd;
+	uint32_t history_stride, history_size;
+
+	if (r->filter >= SPA_N_ELEMENTS(filter_types))
+		r->filter = RESAMPLE_FILTER_LINEAR;
+	r->quality = SPA_CLAMP(r->quality, 0, (int) filter_types[r->filter].n_qualities - 1);
 	r->free = impl_native_free;
 	r->update_rate = impl_native_update_rate;
 	r->in_len = impl_native_in_len;
@@ -334,56 +643,50 @@ int resample_native_init(struct resample *r)
 	r->reset = impl_native_reset;
 	r->delay = impl_native_delay;
 
-	q = &blackman_qualities[r->quality];
-
 	gcd = calc_gcd(r->i_rate, r->o_rate);
 
 	in_rate = r->i_rate / gcd;
 	out_rate = r->o_rate / gcd;
 
-	scale = SPA_MIN(q->cutoff * out_rate / in_rate, 1.0);
-	/* multiple of 8 taps to ease simd optimizations */
-	n_taps = SPA_ROUND_UP_N((uint32_t)ceil(q->n_taps / scale), 8);
+	info = find_resample_info(SPA_AUDIO_FORMAT_F32, r->cpu_flags);
 
-	/* try to get at least 256 phases so that interpolation is
-	 * accurate enough when activated */
-	n_phases = out_rate;
-	oversample = (255 + n_phases) / n_phases;
-	n_phases *= oversample;
+	if ((f = filter_acquire(r, in_rate, out_rate, info->cpu_flags)) == NULL)
+		return -errno;
 
-	filter_stride = SPA_ROUND_UP_N(n_taps * sizeof(float), 64);
-	filter_size = filter_stride * (n_phases + 1);
-	history_stride = SPA_ROUND_UP_N(2 * n_taps * sizeof(float), 64);
+	history_stride = SPA_ROUND_UP_N(2 * f->n_taps * sizeof(float), 64);
 	history_size = r->channels * history_stride;
 
 	d = calloc(1, sizeof(struct native_data) +
-			filter_size +
 			history_size +
 			(r->channels * sizeof(float*)) +
 			64);
 
-	if (d == NULL)
-		return -errno;
+	if (d == NULL) {
+		int res = -errno;
+		filter_release(f);
+		return res;
+	}
 
 	r->data = d;
-	d->n_taps = n_taps;
-	d->n_phases = n_phases;
+	d->filter_bank = f;
+	d->n_taps = f->n_taps;
+	d->n_phases = f->n_phases;
+	d->delay = f->delay;
 	d->in_rate = in_rate;
 	d->out_rate = out_rate;
-	d->filter = SPA_MEMBER_ALIGN(d, sizeof(struct native_data), 64, float);
-	d->hist_mem = SPA_MEMBER_ALIGN(d->filter, filter_size, 64, float);
+	d->filter = f->taps;
+	d->hist_mem = SPA_MEMBER_ALIGN(d, sizeof(struct native_data), 64, float);
 	d->history = SPA_MEMBER(d->hist_mem, history_size, float*);
-	d->filter_stride = filter_stride / sizeof(float);
-	d->filter_stride_os = d->filter_stride * oversample;
+	d->filter_stride = f->filter_stride;
+	d->filter_stride_os = d->filter_stride * (f->n_phases / out_rate);
 	for (c = 0; c < r->channels; c++)
 		d->history[c] = SPA_MEMBER(d->hist_mem, c * history_stride, float);
 
-	build_filter(d->filter, d->filter_stride, n_taps, n_phases, scale);
-
-	d->info = find_resample_info(SPA_AUDIO_FORMAT_F32, r->cpu_flags);
+	d->info = info;
 
-	spa_log_debug(r->log, "native %p: q:%d in:%d out:%d n_taps:%d n_phases:%d features:%08x:%08x",
-			r, r->quality, in_rate, out_rate, n_taps, n_phases,
+	spa_log_debug(r->log, "native %p: q:%d %s in:%d out:%d n_taps:%d n_phases:%d delay:%d "
+			"features:%08x:%08x", r, r->quality, filter_types[r->filter].name,
+			in_rate, out_rate, d->n_taps, d->n_phases, d->delay,
 			r->cpu_flags, d->info->cpu_flags);
 
 	r->cpu_flags = d->info->cpu_flags;
@@ -53,12 +53,14 @@ struct impl;
 struct props {
 	double rate;
 	int quality;
+	uint32_t filter;
 };
 
 static void props_reset(struct props *props)
 {
 	props->rate = 1.0;
 	props->quality = RESAMPLE_DEFAULT_QUALITY;
+	props->filter = RESAMPLE_FILTER_LINEAR;
 }
 
 struct buffer {
@@ -162,6 +164,7 @@ static int setup_convert(struct impl *this,
 	this->resample.o_rate = dst_info->info.raw.rate;
 	this->resample.log = this->log;
 	this->resample.quality = this->props.quality;
+	this->resample.filter = this->props.filter;
 
 	if (this->peaks)
 		err = resample_peaks_init(&this->resample);
@@ -972,6 +975,8 @@ impl_init(const struct spa_handle_factory *factory,
 	if (info != NULL) {
 		if ((str = spa_dict_lookup(info, "resample.quality")) != NULL)
 			this->props.quality = atoi(str);
+		if ((str = spa_dict_lookup(info, "resample.filter")) != NULL)
+			this->props.filter = resample_native_filter(str);
 		if ((str = spa_dict_lookup(info, "resample.peaks")) != NULL)
 			this->peaks = strcmp(str, "true") == 0 || atoi(str) == 1;
 		if ((str = spa_dict_lookup(info, "factory.mode")) != NULL) {
@@ -30,6 +30,11 @@
 
 #define RESAMPLE_DEFAULT_QUALITY	4
 
+#define RESAMPLE_FILTER_LINEAR		0	/**< linear phase, delay of half the filter */
+#define RESAMPLE_FILTER_SHORT		1	/**< short linear phase filters, less delay
+						  *  and more aliasing */
+#define RESAMPLE_FILTER_MINIMUM		2	/**< minimum phase, delay of a few samples */
+
 struct resample {
 	uint32_t cpu_flags;
 	uint32_t channels;
@@ -38,6 +43,7 @@ struct resample {
 	struct spa_log *log;
 	double rate;
 	int quality;
+	uint32_t filter;
 
 	void (*free)		(struct resample *r);
 	void (*update_rate)	(struct resample *r, double rate);
@@ -59,7 +65,17 @@ struct resample {
 #define resample_reset(r)		(r)->reset(r)
 #define resample_delay(r)		(r)->delay(r)
 
+/* statistics of the filter banks shared between native resamplers */
+struct resample_native_stats {
+	uint64_t hits;		/**< filters found in the cache */
+	uint64_t misses;	/**< filters that needed to be built */
+	uint32_t n_filters;	/**< filters currently in the cache */
+	size_t bytes;		/**< memory used by the cached filters */
+};
+
+uint32_t resample_native_filter(const char *str);
 int resample_native_init(struct resample *r);
+void resample_native_get_stats(struct resample_native_stats *stats);
 int resample_peaks_init(struct resample *r);
 
 #endif /* RESAMPLE_H */
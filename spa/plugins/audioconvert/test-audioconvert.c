@@ -28,16 +28,23 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include <spa/utils/names.h>
 #include <spa/support/plugin.h>
 #include <spa/param/param.h>
+#include <spa/param/props.h>
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/node/io.h>
+#include <spa/buffer/alloc.h>
 #include <spa/debug/mem.h>
 #include <spa/support/log-impl.h>
 
+#include "fmt-ops.h"
+
 SPA_LOG_IMPL(logger);
 
 extern const struct spa_handle_factory test_source_factory;
@@ -509,6 +516,380 @@ static int test_set_in_format2(struct context *ctx)
 	return 0;
 }
 
+static int test_dither_props(struct context *ctx)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[4096];
+	struct spa_pod *param, *type, *labels;
+	struct spa_pod_parser prs;
+	struct spa_pod_frame f;
+	uint32_t index, id, dither, n_labels;
+	int res;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	index = 0;
+	res = spa_node_enum_params_sync(ctx->convert_node, SPA_PARAM_PropInfo,
+			&index, NULL, &param, &b);
+	spa_assert(res == 1);
+	res = spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_PropInfo, NULL,
+			SPA_PROP_INFO_id, SPA_POD_Id(&id),
+			SPA_PROP_INFO_type, SPA_POD_Pod(&type),
+			SPA_PROP_INFO_labels, SPA_POD_Pod(&labels));
+	spa_assert(res >= 0);
+	spa_assert(id == SPA_PROP_ditherType);
+	spa_assert(spa_pod_is_id(type));
+
+	/* the labels are pairs of an Id and its name */
+	spa_pod_parser_pod(&prs, labels);
+	res = spa_pod_parser_push_struct(&prs, &f);
+	spa_assert(res >= 0);
+	for (n_labels = 0;; n_labels++) {
+		const char *name;
+
+		if (spa_pod_parser_get_id(&prs, &id) < 0)
+			break;
+		res = spa_pod_parser_get_string(&prs, &name);
+		spa_assert(res >= 0);
+		spa_assert(id == n_labels);
+		spa_assert(name != NULL);
+	}
+	spa_assert(n_labels == DITHER_METHOD_SHAPED + 1);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Props, SPA_PARAM_Props,
+			SPA_PROP_ditherType, SPA_POD_Id(DITHER_METHOD_TRIANGULAR));
+	res = spa_node_set_param(ctx->convert_node, SPA_PARAM_Props, 0, param);
+	spa_assert(res == 0);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	index = 0;
+	res = spa_node_enum_params_sync(ctx->convert_node, SPA_PARAM_Props,
+			&index, NULL, &param, &b);
+	spa_assert(res == 1);
+	dither = DITHER_METHOD_NONE;
+	res = spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_ditherType, SPA_POD_Id(&dither));
+	spa_assert(res >= 0);
+	spa_assert(dither == DITHER_METHOD_TRIANGULAR);
+
+	return 0;
+}
+
+#define MAX_CONVERT_BUFFERS	2
+#define MAX_CONVERT_CYCLES	64
+#define MAX_OUT_SAMPLES		(MAX_CONVERT_CYCLES * 1024)
+
+#define POS_STEREO	{ SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR, }
+#define POS_5_1		{ SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR, SPA_AUDIO_CHANNEL_FC, \
+			  SPA_AUDIO_CHANNEL_LFE, SPA_AUDIO_CHANNEL_SL, SPA_AUDIO_CHANNEL_SR, }
+
+struct convert_setup {
+	const char *mode;
+	uint32_t quantum;
+	struct spa_audio_info_raw src;
+	struct spa_audio_info_raw dst;
+};
+
+struct convert_result {
+	uint32_t n_datas;
+	uint32_t stride;
+	uint32_t n_samples;
+	uint8_t *data[SPA_AUDIO_MAX_CHANNELS];
+};
+
+static uint32_t format_width(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16P:
+		return 2;
+	case SPA_AUDIO_FORMAT_S32:
+	case SPA_AUDIO_FORMAT_S32P:
+	case SPA_AUDIO_FORMAT_F32:
+	case SPA_AUDIO_FORMAT_F32P:
+		return 4;
+	default:
+		spa_assert_not_reached();
+	}
+}
+
+static void info_layout(const struct spa_audio_info_raw *info, uint32_t *n_datas, uint32_t *stride)
+{
+	if (SPA_AUDIO_FORMAT_IS_PLANAR(info->format)) {
+		*n_datas = info->channels;
+		*stride = format_width(info->format);
+	} else {
+		*n_datas = 1;
+		*stride = format_width(info->format) * info->channels;
+	}
+}
+
+static void write_sample(void *dst, uint32_t format, float v)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16P:
+		*(int16_t*)dst = (int16_t)(v * 32767.0f);
+		break;
+	case SPA_AUDIO_FORMAT_S32:
+	case SPA_AUDIO_FORMAT_S32P:
+		*(int32_t*)dst = (int32_t)(v * 2147483647.0);
+		break;
+	default:
+		*(float*)dst = v;
+		break;
+	}
+}
+
+/* a tone per channel with some noise, the same for every run */
+static void fill_input(struct spa_buffer *buf, const struct spa_audio_info_raw *info,
+		uint32_t offset, uint32_t n_samples)
+{
+	uint32_t i, c, n_datas, stride, width = format_width(info->format);
+
+	info_layout(info, &n_datas, &stride);
+
+	for (i = 0; i < n_samples; i++) {
+		uint32_t n = offset + i;
+		for (c = 0; c < info->channels; c++) {
+			uint32_t noise = (n * 31 + c * 17) * 1103515245u + 12345u;
+			float v = sinf(n * (0.01f + c * 0.003f)) * 0.6f +
+				(((noise >> 16) & 0xff) / 255.0f - 0.5f) * 0.2f;
+			void *d;
+
+			if (n_datas == 1)
+				d = SPA_MEMBER(buf->datas[0].data, i * stride + c * width, void);
+			else
+				d = SPA_MEMBER(buf->datas[c].data, i * stride, void);
+			write_sample(d, info->format, v);
+		}
+	}
+	for (i = 0; i < n_datas; i++) {
+		buf->datas[i].chunk->offset = 0;
+		buf->datas[i].chunk->size = n_samples * stride;
+		buf->datas[i].chunk->stride = stride;
+	}
+}
+
+static struct spa_buffer **alloc_buffers(const struct spa_audio_info_raw *info, uint32_t n_samples)
+{
+	struct spa_data datas[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t aligns[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t i, n_datas, stride;
+
+	info_layout(info, &n_datas, &stride);
+
+	spa_zero(datas);
+	for (i = 0; i < n_datas; i++) {
+		datas[i].type = SPA_DATA_MemPtr;
+		datas[i].maxsize = n_samples * stride;
+		aligns[i] = 16;
+	}
+	return spa_buffer_alloc_array(MAX_CONVERT_BUFFERS, 0, 0, NULL, n_datas, datas, aligns);
+}
+
+/* pushes MAX_CONVERT_CYCLES quanta of input through an audioconvert node and
+ * collects everything that comes out of it */
+static void run_convert(const struct convert_setup *s, bool fused, struct convert_result *r)
+{
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct spa_support support[1];
+	const struct spa_handle_factory *factory;
+	struct spa_dict_item items[2];
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct spa_io_position position;
+	struct spa_io_buffers inio, outio;
+	struct spa_buffer **in_buffers, **out_buffers;
+	struct spa_audio_info_raw info;
+	uint32_t i, cycle, n_loops;
+	void *iface;
+	int res;
+
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+	items[0] = SPA_DICT_ITEM_INIT("audioconvert.fused", fused ? "true" : "false");
+	items[1] = SPA_DICT_ITEM_INIT("factory.mode", s->mode);
+
+	factory = find_factory(SPA_NAME_AUDIO_CONVERT);
+	spa_assert(factory != NULL);
+	handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	spa_assert(handle != NULL);
+	res = spa_handle_factory_init(factory, handle,
+			&SPA_DICT_INIT_ARRAY(items), support, 1);
+	spa_assert(res >= 0);
+	res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_Node, &iface);
+	spa_assert(res >= 0);
+	node = iface;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	info = s->src;
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, &info);
+	res = spa_node_port_set_param(node, SPA_DIRECTION_INPUT, 0,
+			SPA_PARAM_Format, 0, param);
+	spa_assert(res == 0);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	info = s->dst;
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, &info);
+	res = spa_node_port_set_param(node, SPA_DIRECTION_OUTPUT, 0,
+			SPA_PARAM_Format, 0, param);
+	spa_assert(res == 0);
+
+	spa_zero(position);
+	position.clock.duration = s->quantum;
+	spa_node_set_io(node, SPA_IO_Position, &position, sizeof(position));
+
+	in_buffers = alloc_buffers(&s->src, s->quantum);
+	out_buffers = alloc_buffers(&s->dst, s->quantum);
+	spa_assert(in_buffers != NULL && out_buffers != NULL);
+
+	res = spa_node_port_use_buffers(node, SPA_DIRECTION_INPUT, 0, 0,
+			in_buffers, MAX_CONVERT_BUFFERS);
+	spa_assert(res == 0);
+	res = spa_node_port_use_buffers(node, SPA_DIRECTION_OUTPUT, 0, 0,
+			out_buffers, MAX_CONVERT_BUFFERS);
+	spa_assert(res == 0);
+
+	inio = SPA_IO_BUFFERS_INIT;
+	outio = SPA_IO_BUFFERS_INIT;
+	res = spa_node_port_set_io(node, SPA_DIRECTION_INPUT, 0,
+			SPA_IO_Buffers, &inio, sizeof(inio));
+	spa_assert(res == 0);
+	res = spa_node_port_set_io(node, SPA_DIRECTION_OUTPUT, 0,
+			SPA_IO_Buffers, &outio, sizeof(outio));
+	spa_assert(res == 0);
+
+	res = spa_node_send_command(node,
+			&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Start));
+	spa_assert(res == 0);
+
+	info_layout(&s->dst, &r->n_datas, &r->stride);
+	r->n_samples = 0;
+	for (i = 0; i < r->n_datas; i++) {
+		r->data[i] = calloc(MAX_OUT_SAMPLES, r->stride);
+		spa_assert(r->data[i] != NULL);
+	}
+
+	cycle = 0;
+	for (n_loops = 0; n_loops < MAX_CONVERT_CYCLES * 16; n_loops++) {
+		if (inio.status != SPA_STATUS_HAVE_DATA) {
+			if (cycle == MAX_CONVERT_CYCLES)
+				break;
+			fill_input(in_buffers[cycle & 1], &s->src,
+					cycle * s->quantum, s->quantum);
+			inio.buffer_id = cycle & 1;
+			inio.status = SPA_STATUS_HAVE_DATA;
+			cycle++;
+		}
+
+		res = spa_node_process(node);
+		spa_assert(res >= 0);
+
+		if (outio.status == SPA_STATUS_HAVE_DATA) {
+			struct spa_buffer *ob;
+			uint32_t size;
+
+			spa_assert(outio.buffer_id < MAX_CONVERT_BUFFERS);
+			ob = out_buffers[outio.buffer_id];
+			size = ob->datas[0].chunk->size;
+			spa_assert(size % r->stride == 0);
+			spa_assert(r->n_samples + size / r->stride <= MAX_OUT_SAMPLES);
+
+			for (i = 0; i < r->n_datas; i++) {
+				spa_assert(ob->datas[i].chunk->size == size);
+				memcpy(r->data[i] + r->n_samples * r->stride,
+						SPA_MEMBER(ob->datas[i].data,
+							ob->datas[i].chunk->offset, void), size);
+			}
+			r->n_samples += size / r->stride;
+			outio.status = SPA_STATUS_NEED_DATA;
+		}
+	}
+	spa_assert(cycle == MAX_CONVERT_CYCLES);
+
+	spa_handle_clear(handle);
+	free(handle);
+	free(in_buffers);
+	free(out_buffers);
+}
+
+static void free_result(struct convert_result *r)
+{
+	uint32_t i;
+	for (i = 0; i < r->n_datas; i++)
+		free(r->data[i]);
+}
+
+/* the fused path must give the same samples as the chain of nodes */
+static int test_fused_convert(struct context *ctx)
+{
+	static const struct convert_setup setups[] = {
+		{ "split", 256,
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32, .rate = 48000,
+					.channels = 2, .position = POS_STEREO),
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 48000,
+					.channels = 2, .position = POS_STEREO), },
+		{ "split", 333,
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S32, .rate = 48000,
+					.channels = 6, .position = POS_5_1),
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 48000,
+					.channels = 2, .position = POS_STEREO), },
+		{ "split", 256,
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 44100,
+					.channels = 2, .position = POS_STEREO),
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P, .rate = 48000,
+					.channels = 6, .position = POS_5_1), },
+		{ "split", 333,
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 44100,
+					.channels = 2, .position = POS_STEREO),
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P, .rate = 48000,
+					.channels = 6, .position = POS_5_1), },
+		{ "merge", 256,
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P, .rate = 48000,
+					.channels = 2, .position = POS_STEREO),
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S16, .rate = 44100,
+					.channels = 2, .position = POS_STEREO), },
+		{ "merge", 333,
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P, .rate = 48000,
+					.channels = 2, .position = POS_STEREO),
+			SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_S32P, .rate = 32000,
+					.channels = 2, .position = POS_STEREO), },
+	};
+	uint32_t i, j, level = logger.log.level;
+
+	/* tracing every process cycle is too much */
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+
+	for (i = 0; i < SPA_N_ELEMENTS(setups); i++) {
+		const struct convert_setup *s = &setups[i];
+		struct convert_result chained, fused;
+
+		fprintf(stderr, "fused %s %d: %d/%d@%d -> %d/%d@%d\n", s->mode, s->quantum,
+				s->src.format, s->src.channels, s->src.rate,
+				s->dst.format, s->dst.channels, s->dst.rate);
+
+		run_convert(s, false, &chained);
+		run_convert(s, true, &fused);
+
+		spa_assert(chained.n_samples > 0);
+		spa_assert(chained.n_samples == fused.n_samples);
+		for (j = 0; j < chained.n_datas; j++)
+			spa_assert(memcmp(chained.data[j], fused.data[j],
+						chained.n_samples * chained.stride) == 0);
+
+		free_result(&chained);
+		free_result(&fused);
+	}
+	logger.log.level = level;
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct context ctx;
@@ -529,6 +910,8 @@ int main(int argc, char *argv[])
 	test_convert_setup2(&ctx);
 	test_set_in_format2(&ctx);
 	test_set_out_format(&ctx);
+	test_dither_props(&ctx);
+	test_fused_convert(&ctx);
 
 	clean_context(&ctx);
 
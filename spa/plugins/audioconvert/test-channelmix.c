@@ -36,7 +36,16 @@ SPA_LOG_IMPL(logger);
 
 #define MATRIX(...) (float[]) { __VA_ARGS__ }
 
+#include "test-helper.h"
 #include "channelmix-ops.c"
+
+#define N_SAMPLES	253
+#define N_CHANNELS	16
+
+static uint32_t cpu_flags;
+
+static float samp_in[N_CHANNELS][N_SAMPLES + 16] __attribute__ ((aligned (32)));
+static float samp_out[2][N_CHANNELS][N_SAMPLES + 16] __attribute__ ((aligned (32)));
 static void dump_matrix(struct channelmix *mix, float *coeff)
 {
 	uint32_t i, j;
@@ -199,16 +208,109 @@ static void test_7p1_N(void)
 			       0.0, 1.0, 0.707107, 0.0, 0.0, 0.707107, 0.0, 0.707107));
 }
 
+static void run_n_m(struct channelmix *mix, channelmix_func_t func, uint32_t offset,
+		float out[N_CHANNELS][N_SAMPLES + 16])
+{
+	const void *src[N_CHANNELS];
+	void *dst[N_CHANNELS];
+	uint32_t i;
+
+	for (i = 0; i < mix->src_chan; i++)
+		src[i] = &samp_in[i][offset];
+	for (i = 0; i < mix->dst_chan; i++)
+		dst[i] = &out[i][offset];
+
+	func(mix, mix->dst_chan, dst, mix->src_chan, src, N_SAMPLES);
+}
+
+static void test_n_m_func(uint32_t src_chan, uint64_t src_mask, uint32_t dst_chan, uint64_t dst_mask,
+		const char *name, channelmix_func_t func)
+{
+	struct channelmix mix;
+	float volumes[N_CHANNELS];
+	uint32_t i, n, offset;
+
+	spa_log_debug(&logger.log, "test %s %d->%d", name, src_chan, dst_chan);
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.src_mask = src_mask;
+	mix.dst_chan = dst_chan;
+	mix.dst_mask = dst_mask;
+	mix.log = &logger.log;
+	spa_assert(channelmix_init(&mix) == 0);
+
+	for (i = 0; i < src_chan; i++)
+		volumes[i] = 0.5f + i * 0.1f;
+	channelmix_set_volume(&mix, 0.9f, false, src_chan, volumes);
+
+	/* aligned and unaligned data */
+	for (offset = 0; offset < 2; offset++) {
+		spa_zero(samp_out);
+		run_n_m(&mix, channelmix_f32_n_m_c, offset, samp_out[0]);
+		run_n_m(&mix, func, offset, samp_out[1]);
+
+		for (i = 0; i < dst_chan; i++) {
+			for (n = 0; n < N_SAMPLES; n++)
+				spa_assert(fabsf(samp_out[0][i][n + offset] -
+						samp_out[1][i][n + offset]) < 0.000001f);
+		}
+	}
+	channelmix_free(&mix);
+}
+
+static void test_n_m(uint32_t src_chan, uint64_t src_mask, uint32_t dst_chan, uint64_t dst_mask)
+{
+#if defined(HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		test_n_m_func(src_chan, src_mask, dst_chan, dst_mask,
+				"sse", channelmix_f32_n_m_sse);
+#endif
+#if defined(HAVE_AVX) && defined(HAVE_FMA)
+	if (SPA_FLAG_IS_SET(cpu_flags, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3))
+		test_n_m_func(src_chan, src_mask, dst_chan, dst_mask,
+				"avx", channelmix_f32_n_m_avx);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		test_n_m_func(src_chan, src_mask, dst_chan, dst_mask,
+				"neon", channelmix_f32_n_m_neon);
+#endif
+}
+
+static void test_generic(void)
+{
+	uint32_t i, n;
+
+	for (i = 0; i < N_CHANNELS; i++)
+		for (n = 0; n < N_SAMPLES + 16; n++)
+			samp_in[i][n] = (float)drand48() * 2.0f - 1.0f;
+
+	test_n_m(1, _M(MONO), 2, _M(FL)|_M(FR));
+	test_n_m(2, _M(FL)|_M(FR), 1, _M(MONO));
+	test_n_m(2, _M(FL)|_M(FR), 6, _M(FL)|_M(FR)|_M(LFE)|_M(FC)|_M(SL)|_M(SR));
+	test_n_m(6, _M(FL)|_M(FR)|_M(LFE)|_M(FC)|_M(SL)|_M(SR), 2, _M(FL)|_M(FR));
+	test_n_m(8, _M(FL)|_M(FR)|_M(LFE)|_M(FC)|_M(SL)|_M(SR)|_M(RL)|_M(RR), 2, _M(FL)|_M(FR));
+	test_n_m(12, _M(FL)|_M(FR)|_M(LFE)|_M(FC)|_M(SL)|_M(SR)|_M(RL)|_M(RR)|
+			_M(TFL)|_M(TFR)|_M(TRL)|_M(TRR), 6,
+			_M(FL)|_M(FR)|_M(LFE)|_M(FC)|_M(SL)|_M(SR));
+	test_n_m(16, 0, 2, 0);
+	test_n_m(16, 0, 1, _M(MONO));
+}
+
 int main(int argc, char *argv[])
 {
 	logger.log.level = SPA_LOG_LEVEL_TRACE;
 
+	cpu_flags = get_cpu_flags();
+
 	test_1_N();
 	test_N_1();
 	test_3p1_N();
 	test_4_N();
 	test_5p1_N();
 	test_7p1_N();
+	test_generic();
 
 	return 0;
 }
@@ -54,27 +54,28 @@ static void compare_mem(int i, int j, const void *m1, const void *m2, size_t siz
 		spa_debug_mem(0, m1, size);
 		spa_debug_mem(0, m2, size);
 	}
-//	spa_assert(res == 0);
+	spa_assert(res == 0);
 }
 
-static void run_test(const char *name,
+static void run_test_channels(const char *name,
 		const void *in, size_t in_size, const void *out, size_t out_size, size_t n_samples,
-		bool in_packed, bool out_packed, convert_func_t func)
+		bool in_packed, bool out_packed, convert_func_t func, uint32_t n_channels)
 {
 	const void *ip[N_CHANNELS];
 	void *tp[N_CHANNELS];
-	int i, j;
+	uint32_t i, j;
 	const uint8_t *in8 = in, *out8 = out;
 	struct convert conv;
 
-	conv.n_channels = N_CHANNELS;
+	spa_assert(n_channels <= N_CHANNELS);
+	conv.n_channels = n_channels;
 
 	for (j = 0; j < N_SAMPLES; j++) {
 		memcpy(&samp_in[j * in_size], &in8[(j % n_samples) * in_size], in_size);
 		memcpy(&samp_out[j * out_size], &out8[(j % n_samples) * out_size], out_size);
 	}
 
-	for (j = 0; j < N_CHANNELS; j++)
+	for (j = 0; j < n_channels; j++)
 		ip[j] = samp_in;
 
 	if (in_packed) {
@@ -100,7 +101,7 @@ static void run_test(const char *name,
 	}
 
 	spa_zero(temp_out);
-	for (j = 0; j < N_CHANNELS; j++)
+	for (j = 0; j < n_channels; j++)
 		tp[j] = &temp_out[j * N_SAMPLES * out_size];
 
 	fprintf(stderr, "test %s:\n", name);
@@ -109,19 +110,27 @@ static void run_test(const char *name,
 	if (out_packed) {
 		const uint8_t *d = tp[0], *s = samp_out;
 		for (i = 0; i < N_SAMPLES; i++) {
-			for (j = 0; j < N_CHANNELS; j++) {
+			for (j = 0; j < n_channels; j++) {
 				compare_mem(i, j, d, s, out_size);
 				d += out_size;
 			}
 			s += out_size;
 		}
 	} else {
-		for (j = 0; j < N_CHANNELS; j++) {
+		for (j = 0; j < n_channels; j++) {
 			compare_mem(0, j, tp[j], samp_out, N_SAMPLES * out_size);
 		}
 	}
 }
 
+static void run_test(const char *name,
+		const void *in, size_t in_size, const void *out, size_t out_size, size_t n_samples,
+		bool in_packed, bool out_packed, convert_func_t func)
+{
+	run_test_channels(name, in, in_size, out, out_size, n_samples,
+			in_packed, out_packed, func, N_CHANNELS);
+}
+
 static void test_f32_u8(void)
 {
 	const float in[] = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 1.1f, -1.1f };
@@ -135,6 +144,30 @@ static void test_f32_u8(void)
 			true, false, conv_f32_to_u8d_c);
 	run_test("test_f32d_u8d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_f32d_to_u8d_c);
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_f32_u8_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_u8_sse2);
+		run_test("test_f32d_u8d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_u8d_sse2);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_u8_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_u8_avx2);
+		run_test("test_f32d_u8d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_u8d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_u8_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_u8_avx512);
+		run_test("test_f32d_u8d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_u8d_avx512);
+	}
+#endif
 }
 
 static void test_u8_f32(void)
@@ -150,6 +183,22 @@ static void test_u8_f32(void)
 			true, false, conv_u8_to_f32d_c);
 	run_test("test_u8d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_u8d_to_f32d_c);
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_u8_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_u8_to_f32_avx2);
+		run_test("test_u8d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_u8d_to_f32d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_u8_f32_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_u8_to_f32_avx512);
+		run_test("test_u8d_f32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_u8d_to_f32d_avx512);
+	}
+#endif
 }
 
 static void test_f32_s16(void)
@@ -169,6 +218,34 @@ static void test_f32_s16(void)
 	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
 		run_test("test_f32d_s16_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, true, conv_f32d_to_s16_sse2);
+		run_test("test_f32_s16_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s16_sse2);
+		run_test("test_f32_s16d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_f32_to_s16d_sse2);
+		run_test("test_f32d_s16d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s16d_sse2);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s16_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s16_avx2);
+		run_test("test_f32d_s16d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s16d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s16_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s16_avx512);
+		run_test("test_f32d_s16d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s16d_avx512);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32d_s16_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, true, conv_f32d_to_s16_neon);
 	}
 #endif
 }
@@ -190,6 +267,34 @@ static void test_s16_f32(void)
 	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
 		run_test("test_s16_f32d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			true, false, conv_s16_to_f32d_sse2);
+		run_test_channels("test_s16_f32d_2_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s16_to_f32d_2_sse2, 2);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s16_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s16_to_f32d_avx2);
+		run_test_channels("test_s16_f32d_2_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s16_to_f32d_2_avx2, 2);
+		run_test("test_s16_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_s16_to_f32_avx2);
+		run_test("test_s16d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_s16d_to_f32d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s16_f32_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_s16_to_f32_avx512);
+		run_test("test_s16d_f32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_s16d_to_f32d_avx512);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s16_f32d_neon", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s16_to_f32d_neon);
 	}
 #endif
 }
@@ -212,6 +317,26 @@ static void test_f32_s32(void)
 	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
 		run_test("test_f32d_s32_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, true, conv_f32d_to_s32_sse2);
+		run_test("test_f32_s32_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s32_sse2);
+		run_test("test_f32d_s32d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s32d_sse2);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s32_avx2);
+		run_test("test_f32d_s32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s32d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s32_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s32_avx512);
+		run_test("test_f32d_s32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s32d_avx512);
 	}
 #endif
 }
@@ -235,6 +360,24 @@ static void test_s32_f32(void)
 			true, false, conv_s32_to_f32d_sse2);
 	}
 #endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s32_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s32_to_f32d_avx2);
+		run_test("test_s32_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_s32_to_f32_avx2);
+		run_test("test_s32d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_s32d_to_f32d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s32_f32_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_s32_to_f32_avx512);
+		run_test("test_s32d_f32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_s32d_to_f32d_avx512);
+	}
+#endif
 }
 
 static void test_f32_s24(void)
@@ -295,6 +438,27 @@ static void test_s24_f32(void)
 			true, false, conv_s24_to_f32d_sse41);
 	}
 #endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_f32d_avx2", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s24_to_f32d_avx2);
+	}
+#endif
+}
+
+static void test_s24s_f32(void)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	const uint8_t in[] = { 0x00, 0x00, 0x00, 0x7f, 0xff, 0xff, 0x80, 0x00, 0x01,
+		0x3f, 0xff, 0xff, 0xc0, 0x00, 0x01,  };
+#else
+	const uint8_t in[] = { 0x00, 0x00, 0x00, 0xff, 0xff, 0x7f, 0x01, 0x00, 0x80,
+		0xff, 0xff, 0x3f, 0x01, 0x00, 0xc0,  };
+#endif
+	const float out[] = { 0.0f, 1.0f, -1.0f, 0.4999999404f, -0.4999999404f, };
+
+	run_test("test_s24s_f32d", in, 3, out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s24s_to_f32d_c);
 }
 
 static void test_f32_s24_32(void)
@@ -311,6 +475,30 @@ static void test_f32_s24_32(void)
 			true, false, conv_f32_to_s24_32d_c);
 	run_test("test_f32d_s24_32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_f32d_to_s24_32d_c);
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_f32_s24_32_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s24_32_sse2);
+		run_test("test_f32d_s24_32d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s24_32d_sse2);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_f32_s24_32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s24_32_avx2);
+		run_test("test_f32d_s24_32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s24_32d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_s24_32_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_f32_to_s24_32_avx512);
+		run_test("test_f32d_s24_32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_f32d_to_s24_32d_avx512);
+	}
+#endif
 }
 
 static void test_s24_32_f32(void)
@@ -326,6 +514,188 @@ static void test_s24_32_f32(void)
 			true, true, conv_s24_32_to_f32_c);
 	run_test("test_s24_32d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_s24_32d_to_f32d_c);
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_32_f32_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_s24_32_to_f32_avx2);
+		run_test("test_s24_32d_f32d_avx2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_s24_32d_to_f32d_avx2);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_s24_32_f32_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, true, conv_s24_32_to_f32_avx512);
+		run_test("test_s24_32d_f32d_avx512", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, false, conv_s24_32d_to_f32d_avx512);
+	}
+#endif
+}
+
+static void test_interleave_32(void)
+{
+	const float in[] = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 1.1f, -1.1f };
+	const float out[] = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 1.1f, -1.1f };
+
+	run_test("test_interleave_32", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, true, conv_interleave_32_c);
+	run_test("test_deinterleave_32", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_deinterleave_32_c);
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_interleave_32_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, true, conv_interleave_32_sse2);
+		run_test("test_deinterleave_32_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_deinterleave_32_sse2);
+	}
+#endif
+}
+
+#define N_DITHER	(DITHER_SIZE * 2 + 37)
+
+static float dither_in[2][N_DITHER];
+static int16_t dither_out[2][2][N_DITHER];
+static uint8_t dither_out_u8[2][N_DITHER * 2];
+
+static void run_dither(uint32_t method, uint32_t dst_fmt, uint32_t flags,
+		void *dst[], const void *src[])
+{
+	struct convert conv;
+
+	spa_zero(conv);
+	conv.src_fmt = SPA_AUDIO_FORMAT_F32P;
+	conv.dst_fmt = dst_fmt;
+	conv.n_channels = 2;
+	conv.cpu_flags = flags;
+	conv.method = method;
+	spa_assert(convert_init(&conv) == 0);
+	spa_assert(conv.process == impl_convert_dither);
+
+	/* odd sized calls */
+	convert_process(&conv, dst, src, 100);
+	src[0] = &dither_in[0][100];
+	src[1] = &dither_in[1][100];
+	if (SPA_AUDIO_FORMAT_IS_PLANAR(dst_fmt)) {
+		dst[0] = SPA_MEMBER(dst[0], 100 * sizeof(int16_t), void);
+		dst[1] = SPA_MEMBER(dst[1], 100 * sizeof(int16_t), void);
+	} else {
+		dst[0] = SPA_MEMBER(dst[0], 100 * 2, void);
+	}
+	convert_process(&conv, dst, src, N_DITHER - 100);
+	convert_free(&conv);
+}
+
+static void test_copy_32(void)
+{
+	const float data[] = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 1.1f, -1.1f };
+
+	run_test("test_copy32", data, sizeof(data[0]), data, sizeof(data[0]), SPA_N_ELEMENTS(data),
+			true, true, conv_copy32_c);
+	run_test("test_copy32d", data, sizeof(data[0]), data, sizeof(data[0]), SPA_N_ELEMENTS(data),
+			false, false, conv_copy32d_c);
+}
+
+static void test_dither(uint32_t method, float max_error)
+{
+	const void *src[2];
+	void *dst[2];
+	uint32_t i, j, k, n_zero = 0;
+	double sum = 0.0;
+
+	fprintf(stderr, "test dither %d:\n", method);
+
+	/* a quiet sine of a couple of LSB on the left, silence on the right */
+	for (i = 0; i < N_DITHER; i++) {
+		dither_in[0][i] = 3.3f * sinf(i * 0.01f) / S16_SCALE;
+		dither_in[1][i] = 0.0f;
+	}
+
+	for (k = 0; k < 2; k++) {
+		src[0] = dither_in[0];
+		src[1] = dither_in[1];
+		dst[0] = dither_out[k][0];
+		dst[1] = dither_out[k][1];
+		run_dither(method, SPA_AUDIO_FORMAT_S16P, k == 0 ? 0 : cpu_flags, dst, src);
+
+		src[0] = dither_in[0];
+		src[1] = dither_in[1];
+		dst[0] = dither_out_u8[k];
+		run_dither(method, SPA_AUDIO_FORMAT_U8, k == 0 ? 0 : cpu_flags, dst, src);
+	}
+
+	/* the optimized versions use the same random sequences */
+	spa_assert(memcmp(dither_out[0], dither_out[1], sizeof(dither_out[0])) == 0);
+	spa_assert(memcmp(dither_out_u8[0], dither_out_u8[1], sizeof(dither_out_u8[0])) == 0);
+
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < N_DITHER; i++) {
+			float v = dither_in[j][i] * S16_SCALE;
+			float err = dither_out[0][j][i] - v;
+			spa_assert(fabsf(err) <= max_error);
+			sum += err;
+			if (j == 1 && dither_out[0][j][i] == 0)
+				n_zero++;
+		}
+	}
+	/* silence is turned into noise without offset, rectangular noise
+	 * is too small to change the level of exact silence */
+	spa_assert(n_zero < N_DITHER || method == DITHER_METHOD_RECTANGULAR);
+	spa_assert(fabs(sum / (N_DITHER * 2)) < 0.05);
+}
+
+static void test_dither_none(void)
+{
+	struct convert conv;
+
+	spa_zero(conv);
+	conv.src_fmt = SPA_AUDIO_FORMAT_F32P;
+	conv.dst_fmt = SPA_AUDIO_FORMAT_S32P;
+	conv.n_channels = 2;
+	conv.method = DITHER_METHOD_TRIANGULAR;
+	spa_assert(convert_init(&conv) == 0);
+	spa_assert(conv.process == conv_f32d_to_s32d_c);
+	convert_free(&conv);
+
+	spa_assert(convert_dither_method("shaped") == DITHER_METHOD_SHAPED);
+	spa_assert(convert_dither_method("triangular") == DITHER_METHOD_TRIANGULAR);
+	spa_assert(convert_dither_method("rectangular") == DITHER_METHOD_RECTANGULAR);
+	spa_assert(convert_dither_method("none") == DITHER_METHOD_NONE);
+}
+
+static void test_dither_switch(void)
+{
+	struct convert conv;
+
+	spa_zero(conv);
+	conv.src_fmt = SPA_AUDIO_FORMAT_F32P;
+	conv.dst_fmt = SPA_AUDIO_FORMAT_S16P;
+	conv.n_channels = 2;
+	conv.method = DITHER_METHOD_NONE;
+	spa_assert(convert_init(&conv) == 0);
+	spa_assert(conv.process == conv_f32d_to_s16d_c);
+
+	spa_assert(convert_set_dither(&conv, DITHER_METHOD_TRIANGULAR) == 0);
+	spa_assert(conv.method == DITHER_METHOD_TRIANGULAR);
+	spa_assert(conv.dither_process == conv_dither_f32_c);
+	spa_assert(conv.process != conv_f32d_to_s16d_c);
+
+	spa_assert(convert_set_dither(&conv, DITHER_METHOD_SHAPED) == 0);
+	spa_assert(conv.dither_process == conv_dither_f32_shaped_c);
+
+	spa_assert(convert_set_dither(&conv, DITHER_METHOD_NONE) == 0);
+	spa_assert(conv.process == conv_f32d_to_s16d_c);
+	convert_free(&conv);
+
+	/* no dither state for 32 bits output */
+	spa_zero(conv);
+	conv.src_fmt = SPA_AUDIO_FORMAT_F32P;
+	conv.dst_fmt = SPA_AUDIO_FORMAT_S32P;
+	conv.n_channels = 2;
+	spa_assert(convert_init(&conv) == 0);
+	spa_assert(convert_set_dither(&conv, DITHER_METHOD_TRIANGULAR) == -ENOTSUP);
+	spa_assert(convert_set_dither(&conv, DITHER_METHOD_NONE) == 0);
+	spa_assert(conv.process == conv_f32d_to_s32d_c);
+	convert_free(&conv);
 }
 
 int main(int argc, char *argv[])
@@ -341,7 +711,15 @@ int main(int argc, char *argv[])
 	test_s32_f32();
 	test_f32_s24();
 	test_s24_f32();
+	test_s24s_f32();
 	test_f32_s24_32();
 	test_s24_32_f32();
+	test_interleave_32();
+	test_copy_32();
+	test_dither(DITHER_METHOD_RECTANGULAR, 1.0f);
+	test_dither(DITHER_METHOD_TRIANGULAR, 1.5f);
+	test_dither(DITHER_METHOD_SHAPED, 6.0f);
+	test_dither_none();
+	test_dither_switch();
 	return 0;
 }
@@ -34,11 +34,15 @@
 
 SPA_LOG_IMPL(logger);
 
+#include "test-helper.h"
 #include "resample.h"
+#include "resample-native-impl.h"
 
 #define N_SAMPLES	253
 #define N_CHANNELS	11
 
+static uint32_t cpu_flags;
+
 static float samp_in[N_SAMPLES * 4];
 static float samp_out[N_SAMPLES * 4];
 
@@ -166,12 +170,167 @@ static void test_in_len(void)
 	resample_free(&r);
 }
 
+static void init_native(struct resample *r, uint32_t channels,
+		uint32_t i_rate, uint32_t o_rate, int quality)
+{
+	spa_zero(*r);
+	r->log = &logger.log;
+	r->channels = channels;
+	r->i_rate = i_rate;
+	r->o_rate = o_rate;
+	r->quality = quality;
+	spa_assert(resample_native_init(r) == 0);
+}
+
+static void test_shared_filter(void)
+{
+	struct resample r1, r2, r3;
+	struct native_data *d1, *d2, *d3;
+	struct resample_native_stats s0, s1;
+	const void *src[1];
+	void *dst[1];
+	float out1[N_SAMPLES], out2[N_SAMPLES];
+	uint32_t i, in_len, out_len;
+
+	resample_native_get_stats(&s0);
+
+	init_native(&r1, 2, 44100, 48000, RESAMPLE_DEFAULT_QUALITY);
+	resample_native_get_stats(&s1);
+	spa_assert(s1.misses == s0.misses + 1);
+	spa_assert(s1.n_filters == s0.n_filters + 1);
+	spa_assert(s1.bytes > s0.bytes);
+
+	/* same reduced rates and quality share the filter */
+	init_native(&r2, 1, 88200, 96000, RESAMPLE_DEFAULT_QUALITY);
+	resample_native_get_stats(&s1);
+	spa_assert(s1.hits == s0.hits + 1);
+	spa_assert(s1.n_filters == s0.n_filters + 1);
+
+	d1 = r1.data;
+	d2 = r2.data;
+	spa_assert(d1->filter == d2->filter);
+
+	/* other quality needs another filter */
+	init_native(&r3, 1, 44100, 48000, RESAMPLE_DEFAULT_QUALITY + 1);
+	resample_native_get_stats(&s1);
+	spa_assert(s1.misses == s0.misses + 2);
+	spa_assert(s1.n_filters == s0.n_filters + 2);
+
+	d3 = r3.data;
+	spa_assert(d1->filter != d3->filter);
+
+	resample_free(&r3);
+
+	/* a new resampler with the shared filter gives the same result */
+	init_native(&r3, 1, 44100, 48000, RESAMPLE_DEFAULT_QUALITY);
+	d3 = r3.data;
+	spa_assert(d1->filter == d3->filter);
+
+	for (i = 0; i < N_SAMPLES; i++)
+		samp_in[i] = sinf(i * 0.1f);
+	src[0] = samp_in;
+
+	in_len = N_SAMPLES;
+	out_len = N_SAMPLES;
+	dst[0] = out1;
+	resample_process(&r2, src, &in_len, dst, &out_len);
+	in_len = N_SAMPLES;
+	out_len = N_SAMPLES;
+	dst[0] = out2;
+	resample_process(&r3, src, &in_len, dst, &out_len);
+	spa_assert(memcmp(out1, out2, out_len * sizeof(float)) == 0);
+
+	resample_free(&r1);
+	resample_free(&r2);
+	resample_free(&r3);
+
+	resample_native_get_stats(&s1);
+	spa_assert(s1.n_filters == s0.n_filters);
+	spa_assert(s1.bytes == s0.bytes);
+}
+
+static void run_dc(struct resample *r, float *out, uint32_t *out_len)
+{
+	const void *src[1];
+	void *dst[1];
+	uint32_t i, in_len;
+
+	for (i = 0; i < N_SAMPLES * 4; i++)
+		samp_in[i] = 1.0f;
+
+	src[0] = samp_in;
+	dst[0] = out;
+	in_len = N_SAMPLES * 4;
+	resample_process(r, src, &in_len, dst, out_len);
+}
+
+static void test_filter_types(void)
+{
+	static const uint32_t filters[] = {
+		RESAMPLE_FILTER_LINEAR,
+		RESAMPLE_FILTER_SHORT,
+		RESAMPLE_FILTER_MINIMUM,
+	};
+	static float out[N_SAMPLES * 4];
+	struct resample r1, r2;
+	struct native_data *d;
+	uint32_t i, j, delay[SPA_N_ELEMENTS(filters)], len1, len2;
+
+	for (i = 0; i < SPA_N_ELEMENTS(filters); i++) {
+		spa_zero(r1);
+		r1.log = &logger.log;
+		r1.channels = 1;
+		r1.i_rate = 44100;
+		r1.o_rate = 48000;
+		r1.quality = RESAMPLE_DEFAULT_QUALITY;
+		r1.filter = filters[i];
+		r2 = r1;
+		r2.cpu_flags = cpu_flags;
+		spa_assert(resample_native_init(&r1) == 0);
+		spa_assert(resample_native_init(&r2) == 0);
+
+		d = r1.data;
+		delay[i] = resample_delay(&r1);
+		spa_assert(delay[i] == resample_delay(&r2));
+		spa_assert(delay[i] > 0 && delay[i] <= d->n_taps / 2);
+		fprintf(stderr, "filter %d: n_taps:%d delay:%d\n", filters[i], d->n_taps, delay[i]);
+
+		/* the filters have unity gain and the optimized versions
+		 * give the same result as the C version */
+		len1 = len2 = N_SAMPLES * 4;
+		run_dc(&r1, samp_out, &len1);
+		run_dc(&r2, out, &len2);
+		spa_assert(len1 == len2);
+		spa_assert(len1 > 2 * d->n_taps);
+
+		for (j = 2 * d->n_taps; j < len1; j++)
+			spa_assert(fabsf(samp_out[j] - 1.0f) < 1e-3f);
+		for (j = 0; j < len1; j++)
+			spa_assert(fabsf(samp_out[j] - out[j]) < 1e-5f);
+
+		resample_free(&r1);
+		resample_free(&r2);
+	}
+	spa_assert(delay[1] < delay[0]);
+	spa_assert(delay[2] < delay[1]);
+
+	spa_assert(resample_native_filter("linear") == RESAMPLE_FILTER_LINEAR);
+	spa_assert(resample_native_filter("short") == RESAMPLE_FILTER_SHORT);
+	spa_assert(resample_native_filter("minimum-phase") == RESAMPLE_FILTER_MINIMUM);
+	spa_assert(resample_native_filter("foo") == RESAMPLE_FILTER_LINEAR);
+}
+
 int main(int argc, char *argv[])
 {
 	logger.log.level = SPA_LOG_LEVEL_TRACE;
 
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
 	test_native();
 	test_in_len();
+	test_shared_filter();
+	test_filter_types();
 
 	return 0;
 }
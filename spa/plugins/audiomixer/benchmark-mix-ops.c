@@ -0,0 +1,168 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/param/audio/format.h>
+
+#include "../audioconvert/test-helper.h"
+#include "mix-ops.h"
+
+#define MAX_SAMPLES	4096
+#define MAX_SOURCES	32
+
+#define MAX_COUNT 2000
+
+static uint32_t cpu_flags;
+
+struct stats {
+	uint32_t n_src;
+	uint32_t n_samples;
+	uint32_t offset;
+	uint64_t perf;
+	const char *impl;
+};
+
+static float samp_in[MAX_SOURCES][MAX_SAMPLES + 8] __attribute__ ((aligned (32)));
+static float samp_out[MAX_SAMPLES + 8] __attribute__ ((aligned (32)));
+
+static const uint32_t sources[] = { 1, 2, 4, 8, 16, 32 };
+static const uint32_t sample_sizes[] = { 256, 1024 };
+static const uint32_t offsets[] = { 0, 1 };	/* aligned and unaligned buffers */
+
+#define MAX_IMPL	4
+#define MAX_RESULTS	MAX_IMPL * SPA_N_ELEMENTS(sources) * \
+			SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(offsets)
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static void run_test1(const char *impl, struct mix_ops *mix,
+		uint32_t n_src, uint32_t n_samples, uint32_t offset)
+{
+	uint32_t i;
+	const void *ip[MAX_SOURCES];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	for (i = 0; i < n_src; i++)
+		ip[i] = &samp_in[i][offset];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		mix_ops_process(mix, &samp_out[offset], ip, n_src, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_src = n_src,
+		.n_samples = n_samples,
+		.offset = offset,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.impl = impl
+	};
+}
+
+static void run_test(const char *impl, uint32_t flags)
+{
+	struct mix_ops mix;
+	size_t i, j, k;
+
+	spa_zero(mix);
+	mix.fmt = SPA_AUDIO_FORMAT_F32;
+	mix.n_channels = 1;
+	mix.cpu_flags = flags;
+	if (mix_ops_init(&mix) < 0)
+		return;
+
+	for (i = 0; i < SPA_N_ELEMENTS(sources); i++)
+		for (j = 0; j < SPA_N_ELEMENTS(sample_sizes); j++)
+			for (k = 0; k < SPA_N_ELEMENTS(offsets); k++)
+				run_test1(impl, &mix, sources[i], sample_sizes[j], offsets[k]);
+
+	mix_ops_free(&mix);
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+
+	if ((diff = a->n_src - b->n_src) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = a->offset - b->offset) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i, j;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < MAX_SOURCES; i++)
+		for (j = 0; j < SPA_N_ELEMENTS(samp_in[i]); j++)
+			samp_in[i][j] = (float)drand48() * 2.0f - 1.0f;
+
+	run_test("c", 0);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("sse", SPA_CPU_FLAG_SSE);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("avx", SPA_CPU_FLAG_AVX);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("neon", SPA_CPU_FLAG_NEON);
+#endif
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \tsources %-2d %s \tsamples %d%s\n",
+				s->perf, s->n_src, s->impl, s->n_samples,
+				s->offset ? " unaligned" : "");
+	}
+	return 0;
+}
@@ -30,22 +30,39 @@
 
 #include "mix-ops.h"
 
+#define MIX_CHUNK	256u
+
+/* sum all sources one chunk at a time so that the destination stays
+ * in cache and is only written back once */
 void
 mix_f32_c(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
 		uint32_t n_src, uint32_t n_samples)
 {
-	uint32_t i, n;
-	float *d = dst;
+	uint32_t i, n, j, chunk;
 
-	if (n_src == 0)
+	if (n_src == 0) {
 		memset(dst, 0, n_samples * sizeof(float));
-	else if (dst != src[0])
-		memcpy(dst, src[0], n_samples * sizeof(float));
+		return;
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			memcpy(dst, src[0], n_samples * sizeof(float));
+		return;
+	}
 
-	for (i = 1; i < n_src; i++) {
-		const float *s = src[i];
-		for (n = 0; n < n_samples; n++)
-			d[n] += s[n];
+	for (n = 0; n < n_samples; n += chunk) {
+		const float *s0 = (const float *)src[0] + n;
+		const float *s1 = (const float *)src[1] + n;
+		float *d = (float *)dst + n;
+
+		chunk = SPA_MIN(n_samples - n, MIX_CHUNK);
+
+		for (j = 0; j < chunk; j++)
+			d[j] = s0[j] + s1[j];
+		for (i = 2; i < n_src; i++) {
+			const float *s = (const float *)src[i] + n;
+			for (j = 0; j < chunk; j++)
+				d[j] += s[j];
+		}
 	}
 }
 
@@ -0,0 +1,86 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#include "mix-ops.h"
+
+#include <arm_neon.h>
+
+void
+mix_f32_neon(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float *d = dst;
+	const float *s;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(float));
+		return;
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			memcpy(dst, src[0], n_samples * sizeof(float));
+		return;
+	}
+
+	unrolled = n_samples & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		float32x4_t in[4];
+
+		s = src[0];
+		in[0] = vld1q_f32(&s[n+ 0]);
+		in[1] = vld1q_f32(&s[n+ 4]);
+		in[2] = vld1q_f32(&s[n+ 8]);
+		in[3] = vld1q_f32(&s[n+12]);
+
+		for (i = 1; i < n_src; i++) {
+			s = src[i];
+			in[0] = vaddq_f32(in[0], vld1q_f32(&s[n+ 0]));
+			in[1] = vaddq_f32(in[1], vld1q_f32(&s[n+ 4]));
+			in[2] = vaddq_f32(in[2], vld1q_f32(&s[n+ 8]));
+			in[3] = vaddq_f32(in[3], vld1q_f32(&s[n+12]));
+		}
+		vst1q_f32(&d[n+ 0], in[0]);
+		vst1q_f32(&d[n+ 4], in[1]);
+		vst1q_f32(&d[n+ 8], in[2]);
+		vst1q_f32(&d[n+12], in[3]);
+	}
+	for (; n < n_samples; n++) {
+		float sum;
+
+		s = src[0];
+		sum = s[n];
+		for (i = 1; i < n_src; i++) {
+			s = src[i];
+			sum += s[n];
+		}
+		d[n] = sum;
+	}
+}
@@ -53,6 +53,10 @@ static struct mix_info mix_table[] =
 #if defined (HAVE_SSE)
 	{ SPA_AUDIO_FORMAT_F32, 1, SPA_CPU_FLAG_SSE, 4, mix_f32_sse },
 	{ SPA_AUDIO_FORMAT_F32P, 1, SPA_CPU_FLAG_SSE, 4, mix_f32_sse },
+#endif
+#if defined (HAVE_NEON)
+	{ SPA_AUDIO_FORMAT_F32, 1, SPA_CPU_FLAG_NEON, 4, mix_f32_neon },
+	{ SPA_AUDIO_FORMAT_F32P, 1, SPA_CPU_FLAG_NEON, 4, mix_f32_neon },
 #endif
 	{ SPA_AUDIO_FORMAT_F32, 1, 0, 4, mix_f32_c },
 	{ SPA_AUDIO_FORMAT_F32P, 1, 0, 4, mix_f32_c },
@@ -62,3 +62,6 @@ DEFINE_FUNCTION(f64, sse2);
 #if defined(HAVE_AVX)
 DEFINE_FUNCTION(f32, avx);
 #endif
+#if defined(HAVE_NEON)
+DEFINE_FUNCTION(f32, neon);
+#endif
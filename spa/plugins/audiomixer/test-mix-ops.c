@@ -0,0 +1,153 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <spa/debug/mem.h>
+#include <spa/param/audio/format.h>
+
+#include "../audioconvert/test-helper.h"
+#include "mix-ops.h"
+
+#define N_SAMPLES	1021
+#define MAX_SOURCES	8
+
+typedef void (*mix_func_t) (struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t n_samples);
+
+static uint32_t cpu_flags;
+
+static float samp_in[MAX_SOURCES][N_SAMPLES + 1];
+static float samp_out[N_SAMPLES + 2];
+static float samp_ref[N_SAMPLES + 2];
+static double samp_in64[MAX_SOURCES][N_SAMPLES + 1];
+static double samp_out64[N_SAMPLES + 2];
+static double samp_ref64[N_SAMPLES + 2];
+
+/* sample counts around the unroll and chunk boundaries of the kernels,
+ * the destination has room for an unaligned offset and one guard sample */
+static const uint32_t sample_sizes[] = { 0, 1, 7, 8, 63, 64, 65, 255, 256, 257, N_SAMPLES };
+
+static void compare_mem(uint32_t n_src, uint32_t n_samples, uint32_t offset,
+		const void *m1, const void *m2, size_t size)
+{
+	int res = memcmp(m1, m2, size);
+	if (res != 0) {
+		fprintf(stderr, "sources %u samples %u offset %u:\n", n_src, n_samples, offset);
+		spa_debug_mem(0, m1, size);
+		spa_debug_mem(0, m2, size);
+	}
+	spa_assert(res == 0);
+}
+
+static void run_test(const char *name, uint32_t fmt, mix_func_t func)
+{
+	uint32_t i, j, n_src, offset;
+	const void *ip[MAX_SOURCES];
+	struct mix_ops mix;
+	bool f64 = fmt == SPA_AUDIO_FORMAT_F64;
+	size_t stride = f64 ? sizeof(double) : sizeof(float);
+	uint8_t *out = f64 ? (uint8_t*)samp_out64 : (uint8_t*)samp_out;
+	uint8_t *ref = f64 ? (uint8_t*)samp_ref64 : (uint8_t*)samp_ref;
+
+	fprintf(stderr, "test %s:\n", name);
+
+	spa_zero(mix);
+	mix.fmt = fmt;
+	mix.n_channels = 1;
+	mix.cpu_flags = 0;
+	spa_assert(mix_ops_init(&mix) == 0);
+
+	for (n_src = 0; n_src <= MAX_SOURCES; n_src++) {
+		for (offset = 0; offset < 2; offset++) {
+			for (i = 0; i < n_src; i++)
+				ip[i] = f64 ? (const void*)&samp_in64[i][offset] :
+					(const void*)&samp_in[i][offset];
+
+			for (j = 0; j < SPA_N_ELEMENTS(sample_sizes); j++) {
+				uint32_t n_samples = sample_sizes[j];
+
+				memset(out, 0xff, (N_SAMPLES + 2) * stride);
+				memset(ref, 0xff, (N_SAMPLES + 2) * stride);
+
+				mix_ops_process(&mix, ref + offset * stride, ip, n_src, n_samples);
+				func(&mix, out + offset * stride, ip, n_src, n_samples);
+
+				compare_mem(n_src, n_samples, offset, out, ref,
+						(n_samples + offset + 1) * stride);
+			}
+		}
+	}
+	mix_ops_free(&mix);
+}
+
+static void test_f32(void)
+{
+	run_test("mix_f32_c", SPA_AUDIO_FORMAT_F32, mix_f32_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("mix_f32_sse", SPA_AUDIO_FORMAT_F32, mix_f32_sse);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("mix_f32_avx", SPA_AUDIO_FORMAT_F32, mix_f32_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("mix_f32_neon", SPA_AUDIO_FORMAT_F32, mix_f32_neon);
+#endif
+}
+
+static void test_f64(void)
+{
+	run_test("mix_f64_c", SPA_AUDIO_FORMAT_F64, mix_f64_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		run_test("mix_f64_sse2", SPA_AUDIO_FORMAT_F64, mix_f64_sse2);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i, j;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < MAX_SOURCES; i++) {
+		for (j = 0; j < N_SAMPLES + 1; j++) {
+			samp_in[i][j] = (float)drand48() * 2.0f - 1.0f;
+			samp_in64[i][j] = drand48() * 2.0 - 1.0;
+		}
+	}
+	test_f32();
+	test_f64();
+	return 0;
+}
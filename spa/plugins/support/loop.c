@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <semaphore.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/system.h>
@@ -38,23 +39,47 @@
 #include <spa/utils/names.h>
 #include <spa/utils/result.h>
 #include <spa/utils/type.h>
-#include <spa/utils/ringbuffer.h>
 
 #define NAME "loop"
 
-#define DATAS_SIZE (4096 * 8)
+#define ITEM_POOL_SIZE	128u
+#define ITEM_SLOT_SIZE	256u
+#define ITEM_STACK	UINT32_MAX
+
+#define EVENTS_MIN	32u
+#define EVENTS_MAX	1024u
+#define EVENTS_SHRINK	1024u		/* iterations between shrink checks */
+
+#define DEFAULT_BUDGET	10000u		/* usec of callbacks in one iteration, 0 is unlimited */
+#define RMASK_DEFERRED	UINT32_MAX	/* rmask of a deferred source while polling */
 
 /** \cond */
 
+/* completion of a blocking invoke, lives on the stack of the caller. The
+ * loop posts the semaphore without taking a lock. */
+struct invoke_completion {
+	sem_t sem;
+	int res;
+};
+
 struct invoke_item {
-	size_t item_size;
+	struct invoke_item *next;
 	spa_invoke_func_t func;
 	uint32_t seq;
-	void *data;
+	uint32_t slot;			/* first pool slot or ITEM_STACK */
+	uint32_t n_slots;		/* number of pool slots */
+	const void *data;
 	size_t size;
-	bool block;
 	void *user_data;
-	int res;
+	struct invoke_completion *completion;
+};
+
+#define ITEM_DATA_SIZE	(ITEM_SLOT_SIZE - SPA_ROUND_UP_N(sizeof(struct invoke_item), 16))
+
+/* the data of an item can continue in the next slots of the pool */
+struct invoke_slot {
+	struct invoke_item item;
+	uint8_t data[ITEM_DATA_SIZE] SPA_ALIGNED(16);
 };
 
 static int loop_signal_event(void *object, struct spa_source *source);
@@ -76,13 +101,41 @@ struct impl {
 	pthread_t thread;
 
 	struct spa_source *wakeup;
-	int ack_fd;
 
-	struct spa_ringbuffer buffer;
-	uint8_t *buffer_data;
-	uint8_t buffer_mem[DATAS_SIZE + 8];
+	/* pending invoke items, pushed by any thread and taken all at once
+	 * by the loop thread. The list is in LIFO order. */
+	struct invoke_item *queue;
+	uint64_t slot_used[ITEM_POOL_SIZE / 64];
+	struct invoke_slot slots[ITEM_POOL_SIZE];
+
+	/* all timer sources share one timerfd, armed for the earliest
+	 * deadline in a min-heap of the active timers. The heap is only
+	 * touched from the loop thread or with the loop locked. */
+	struct spa_source *timer;
+	struct source_impl **timers;
+	uint32_t n_timers;
+	uint32_t max_timers;
+	uint64_t timer_armed;		/* deadline of the timerfd, 0 when disarmed */
+
+	/* events of the last poll. The array grows when a poll fills it and
+	 * shrinks again when it stays mostly unused. When the callbacks use
+	 * up the budget, the sources of the events from ep_first to ep_last
+	 * are dispatched first in the next iteration, which polls without
+	 * waiting. */
+	struct spa_poll_event *ep;
+	uint32_t n_ep;
+	uint32_t ep_peak;
+	uint32_t ep_first;
+	uint32_t ep_last;
+	uint64_t budget;		/* nsec, 0 is unlimited */
+	uint32_t depth;			/* nesting level of the dispatch */
+
+	/* only written by the loop thread, with atomic stores so that
+	 * get_stats can read them from any thread */
+	struct spa_loop_stats stats;
 
 	unsigned int flushing:1;
+	unsigned int dispatching_timers:1;
 };
 
 struct source_impl {
@@ -101,9 +154,24 @@ struct source_impl {
 	} func;
 	bool enabled;
 	struct spa_source *fallback;
+
+	/* timer sources */
+	uint32_t heap_index;		/* SPA_ID_INVALID when not active */
+	uint64_t deadline;		/* absolute CLOCK_MONOTONIC nsec */
+	uint64_t interval;
 };
 /** \endcond */
 
+#define STATS_SET(impl,field,val)	__atomic_store_n(&(impl)->stats.field, (val), __ATOMIC_RELAXED)
+#define STATS_ADD(impl,field,val)	STATS_SET(impl, field, (impl)->stats.field + (val))
+
+static inline uint64_t get_time_ns(struct impl *impl)
+{
+	struct timespec now;
+	spa_system_clock_gettime(impl->system, CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_NSEC(&now);
+}
+
 static int loop_add_source(void *object, struct spa_source *source)
 {
 	struct impl *impl = object;
@@ -120,34 +188,108 @@ static int loop_update_source(void *object, struct spa_source *source)
 static int loop_remove_source(void *object, struct spa_source *source)
 {
 	struct impl *impl = object;
+	uint32_t i;
+
 	source->loop = NULL;
+	/* the source can be freed before the deferred events are dispatched */
+	for (i = impl->ep_first; i < impl->ep_last; i++) {
+		if (impl->ep[i].data == source)
+			impl->ep[i].data = NULL;
+	}
 	return spa_system_pollfd_del(impl->system, impl->poll_fd, source->fd);
 }
 
-static void flush_items(struct impl *impl)
+/* take n consecutive slots of one word of the pool. Items are never
+ * allocated, when the pool is full the invoke fails. */
+static struct invoke_item *alloc_item(struct impl *impl, size_t size)
 {
-	uint32_t index;
-	int res;
+	uint32_t i, shift, n_slots;
+	uint64_t mask;
+
+	n_slots = 1;
+	if (size > ITEM_DATA_SIZE)
+		n_slots += (size - ITEM_DATA_SIZE + ITEM_SLOT_SIZE - 1) / ITEM_SLOT_SIZE;
+	if (n_slots > 64)
+		return NULL;
+
+	mask = n_slots == 64 ? UINT64_MAX : (UINT64_C(1) << n_slots) - 1;
+
+	for (i = 0; i < SPA_N_ELEMENTS(impl->slot_used); i++) {
+		uint64_t used = __atomic_load_n(&impl->slot_used[i], __ATOMIC_RELAXED);
+
+		for (shift = 0; shift + n_slots <= 64;) {
+			if (used & (mask << shift)) {
+				shift++;
+				continue;
+			}
+			if (__atomic_compare_exchange_n(&impl->slot_used[i], &used,
+						used | (mask << shift), false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				struct invoke_slot *slot = &impl->slots[i * 64 + shift];
+				slot->item.slot = i * 64 + shift;
+				slot->item.n_slots = n_slots;
+				slot->item.data = slot->data;
+				return &slot->item;
+			}
+			/* used was reloaded, check the same position again */
+		}
+	}
+	return NULL;
+}
 
-	impl->flushing = true;
-	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
-		struct invoke_item *item;
-		bool block;
+static void free_item(struct impl *impl, struct invoke_item *item)
+{
+	uint64_t mask = item->n_slots == 64 ? UINT64_MAX :
+		(UINT64_C(1) << item->n_slots) - 1;
 
-		item = SPA_MEMBER(impl->buffer_data, index & (DATAS_SIZE - 1), struct invoke_item);
-		block = item->block;
+	__atomic_fetch_and(&impl->slot_used[item->slot / 64],
+			~(mask << (item->slot % 64)), __ATOMIC_RELEASE);
+}
 
-		spa_log_trace(impl->log, NAME " %p: flush item %p", impl, item);
-		item->res = item->func ? item->func(&impl->loop,
-				true, item->seq, item->data, item->size,
-			   item->user_data) : 0;
+/* returns true when the queue was empty and the loop needs a wakeup */
+static inline bool queue_push(struct impl *impl, struct invoke_item *item)
+{
+	struct invoke_item *head = __atomic_load_n(&impl->queue, __ATOMIC_RELAXED);
+	do {
+		item->next = head;
+	} while (!__atomic_compare_exchange_n(&impl->queue, &head, item, true,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return head == NULL;
+}
 
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
+static void complete_item(struct invoke_completion *c, int res)
+{
+	c->res = res;
+	sem_post(&c->sem);
+}
 
-		if (block) {
-			if ((res = spa_system_eventfd_write(impl->system, impl->ack_fd, 1)) < 0)
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, spa_strerror(res));
+static void flush_items(struct impl *impl)
+{
+	struct invoke_item *item, *next, *list;
+	int res;
+
+	impl->flushing = true;
+	while ((list = __atomic_exchange_n(&impl->queue, NULL, __ATOMIC_ACQUIRE)) != NULL) {
+		struct invoke_item *fifo = NULL;
+
+		/* reverse the batch to run the items in the order they were added */
+		for (item = list; item; item = next) {
+			next = item->next;
+			item->next = fifo;
+			fifo = item;
+		}
+		for (item = fifo; item; item = next) {
+			next = item->next;
+
+			spa_log_trace(impl->log, NAME " %p: flush item %p", impl, item);
+			res = item->func ? item->func(&impl->loop,
+					true, item->seq, item->data, item->size,
+					item->user_data) : 0;
+
+			if (item->completion)
+				complete_item(item->completion, res);
+			else
+				free_item(impl, item);
 		}
 	}
 	impl->flushing = false;
@@ -164,67 +306,62 @@ loop_invoke(void *object,
 {
 	struct impl *impl = object;
 	bool in_thread = pthread_equal(impl->thread, pthread_self());
-	struct invoke_item *item;
+	struct invoke_item *item, stack_item;
+	struct invoke_completion completion;
+	bool wakeup;
 	int res;
-	int32_t filled;
-	uint32_t avail, idx, offset, l0;
 
-	filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-	if (filled < 0 || filled > DATAS_SIZE) {
-		spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
-		return -EPIPE;
-	}
-	avail = DATAS_SIZE - filled;
-	if (avail < sizeof(struct invoke_item)) {
-		spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-		return -EPIPE;
+	if (block) {
+		if (in_thread && impl->flushing) {
+			/* we can't wait for ourselves, run it now */
+			return func ? func(&impl->loop, false, seq, data, size, user_data) : 0;
+		}
+		/* the caller waits so the item and data can stay on its stack */
+		item = &stack_item;
+		item->slot = ITEM_STACK;
+		item->data = data;
+
+		sem_init(&completion.sem, 0, 0);
+		completion.res = 0;
+		item->completion = &completion;
+	} else {
+		if ((item = alloc_item(impl, size)) == NULL) {
+			spa_log_warn(impl->log, NAME " %p: queue full, can't add item of size %zd",
+					impl, size);
+			return -ENOSPC;
+		}
+		if (data && size > 0)
+			memcpy((void*)item->data, data, size);
+		item->completion = NULL;
 	}
-	offset = idx & (DATAS_SIZE - 1);
-
-	l0 = DATAS_SIZE - offset;
-
-	item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
 	item->func = func;
 	item->seq = seq;
 	item->size = size;
-	item->block = block;
 	item->user_data = user_data;
 
-	spa_log_trace(impl->log, NAME " %p: add item %p filled:%d", impl, item, filled);
-
-	if (l0 > sizeof(struct invoke_item) + size) {
-		item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-		item->item_size = SPA_ROUND_UP_N(sizeof(struct invoke_item) + size, 8);
-		if (l0 < sizeof(struct invoke_item) + item->item_size)
-			item->item_size = l0;
-	} else {
-		item->data = impl->buffer_data;
-		item->item_size = SPA_ROUND_UP_N(l0 + size, 8);
-	}
-	if (data && size > 0)
-		memcpy(item->data, data, size);
+	spa_log_trace(impl->log, NAME " %p: add item %p block:%d", impl, item, block);
 
-	spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+	wakeup = queue_push(impl, item);
 
 	if (in_thread) {
 		if (!impl->flushing)
 			flush_items(impl);
-	} else {
+	} else if (wakeup) {
+		/* one wakeup for all items added before the loop runs */
 		loop_signal_event(impl, impl->wakeup);
 	}
 
 	if (block) {
-		uint64_t count = 1;
-
-		spa_loop_control_hook_before(&impl->hooks_list);
+		if (!in_thread) {
+			spa_loop_control_hook_before(&impl->hooks_list);
 
-		if ((res = spa_system_eventfd_read(impl->system, impl->ack_fd, &count)) < 0)
-			spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-					impl, spa_strerror(res));
+			while (sem_wait(&completion.sem) < 0 && errno == EINTR);
 
-		spa_loop_control_hook_after(&impl->hooks_list);
+			spa_loop_control_hook_after(&impl->hooks_list);
+		}
+		res = completion.res;
 
-		res = item->res;
+		sem_destroy(&completion.sem);
 	}
 	else {
 		if (seq != SPA_ID_INVALID)
@@ -279,37 +416,145 @@ static inline void process_destroy(struct impl *impl)
 	spa_list_init(&impl->destroy_list);
 }
 
+static void resize_events(struct impl *impl, uint32_t nfds)
+{
+	struct spa_poll_event *ep;
+	uint32_t n_ep = impl->n_ep;
+
+	impl->ep_peak = SPA_MAX(impl->ep_peak, nfds);
+
+	if (SPA_UNLIKELY(nfds == n_ep && n_ep < EVENTS_MAX)) {
+		/* the poll might have had more events for us */
+		n_ep *= 2;
+	} else if (SPA_UNLIKELY(impl->stats.iterations % EVENTS_SHRINK == 0)) {
+		if (impl->ep_peak < n_ep / 4 && n_ep > EVENTS_MIN)
+			n_ep /= 2;
+		impl->ep_peak = 0;
+	}
+	if (SPA_LIKELY(n_ep == impl->n_ep))
+		return;
+
+	if ((ep = realloc(impl->ep, n_ep * sizeof(struct spa_poll_event))) == NULL)
+		return;
+
+	spa_log_debug(impl->log, NAME " %p: %u events per poll", impl, n_ep);
+	impl->ep = ep;
+	impl->n_ep = n_ep;
+	STATS_SET(impl, batch_size, n_ep);
+}
+
 static int loop_iterate(void *object, int timeout)
 {
 	struct impl *impl = object;
 	struct spa_loop *loop = &impl->loop;
-	struct spa_poll_event ep[32];
-	int i, nfds;
+	struct spa_poll_event nested_ep[EVENTS_MIN];
+	struct spa_poll_event *ep;
+	uint64_t start, now;
+	uint32_t i, nfds, count, n_ep, deferred = 0;
+	bool nested = impl->depth > 0;
+	int res;
+
+	/* a callback can iterate the loop again. The nested iteration polls
+	 * in its own array and leaves the deferred events, the resizing and
+	 * the freeing of the sources to the outer iteration, which still
+	 * uses them. */
+	if (SPA_UNLIKELY(nested)) {
+		ep = nested_ep;
+		n_ep = SPA_N_ELEMENTS(nested_ep);
+	} else {
+		ep = impl->ep;
+		n_ep = impl->n_ep;
+	}
+
+	if (SPA_UNLIKELY(!nested && impl->ep_first < impl->ep_last)) {
+		/* the sources that didn't fit in the budget of the previous
+		 * iteration go first. Their events can be stale by now, so
+		 * poll again without waiting and only dispatch the sources
+		 * that are still ready. */
+		deferred = impl->ep_last - impl->ep_first;
+		memmove(ep, &ep[impl->ep_first], deferred * sizeof(struct spa_poll_event));
+		impl->ep_first = 0;
+		impl->ep_last = deferred;
+		for (i = 0; i < deferred; i++) {
+			struct spa_source *s = ep[i].data;
+			if (s != NULL)
+				s->rmask = RMASK_DEFERRED;
+		}
+		timeout = 0;
+	}
 
 	spa_loop_control_hook_before(&impl->hooks_list);
 
-	nfds = spa_system_pollfd_wait(impl->system, impl->poll_fd, ep, SPA_N_ELEMENTS(ep), timeout);
+	res = spa_system_pollfd_wait(impl->system, impl->poll_fd,
+			&ep[deferred], n_ep - deferred, timeout);
 
 	spa_loop_control_hook_after(&impl->hooks_list);
 
-	if (SPA_UNLIKELY(nfds < 0))
-		return nfds;
+	/* the deferred sources are kept until the next iteration when the
+	 * poll fails */
+	if (SPA_UNLIKELY(res < 0))
+		return res;
+
+	if (SPA_UNLIKELY(deferred > 0))
+		impl->ep_first = impl->ep_last = 0;
+	nfds = deferred + res;
 
 	/* first we set all the rmasks, then call the callbacks. The reason is that
 	 * some callback might also want to look at other sources it manages and
 	 * can then reset the rmask to suppress the callback */
-	for (i = 0; i < nfds; i++) {
+	for (i = deferred; i < nfds; i++) {
 		struct spa_source *s = ep[i].data;
+		/* a deferred source is dispatched from its old place */
+		if (SPA_UNLIKELY(s->rmask == RMASK_DEFERRED))
+			ep[i].data = NULL;
 		s->rmask = ep[i].events;
 	}
-	for (i = 0; i < nfds; i++) {
+	for (i = 0; i < deferred; i++) {
 		struct spa_source *s = ep[i].data;
-		if (SPA_LIKELY(s->rmask && s->fd != -1 && s->loop == loop))
+		if (s != NULL && s->rmask == RMASK_DEFERRED)
+			s->rmask = 0;
+	}
+
+	count = 0;
+	if (nfds > 0) {
+		start = now = get_time_ns(impl);
+		impl->depth++;
+		for (i = 0; i < nfds; i++) {
+			struct spa_source *s = ep[i].data;
+			if (SPA_UNLIKELY(s == NULL || s->rmask == 0 || s->fd == -1 || s->loop != loop))
+				continue;
+
 			s->func(s);
+			count++;
+			if (impl->budget == 0 || nested)
+				continue;
+
+			now = get_time_ns(impl);
+			if (SPA_UNLIKELY(now - start > impl->budget && i + 1 < nfds)) {
+				/* give the other sources and the new events a chance */
+				impl->ep_first = i + 1;
+				impl->ep_last = nfds;
+				STATS_ADD(impl, deferred, nfds - i - 1);
+				break;
+			}
+		}
+		impl->depth--;
+		if (impl->budget == 0 || nested)
+			now = get_time_ns(impl);
+
+		STATS_ADD(impl, events, count);
+		if (count > impl->stats.max_events)
+			STATS_SET(impl, max_events, count);
+		STATS_ADD(impl, dispatch_time, now - start);
 	}
-	if (SPA_UNLIKELY(!spa_list_is_empty(&impl->destroy_list)))
-		process_destroy(impl);
+	STATS_ADD(impl, iterations, 1);
 
+	if (SPA_LIKELY(!nested && impl->ep_first == impl->ep_last)) {
+		if (SPA_UNLIKELY(!spa_list_is_empty(&impl->destroy_list)))
+			process_destroy(impl);
+		if (deferred == 0)
+			resize_events(impl, nfds);
+	}
 	return nfds;
 }
 
@@ -513,18 +758,185 @@ static int loop_signal_event(void *object, struct spa_source *source)
 	return res;
 }
 
-static void source_timer_func(struct spa_source *source)
+static inline bool timer_before(struct impl *impl, uint32_t a, uint32_t b)
 {
-	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
-	uint64_t expirations;
+	return impl->timers[a]->deadline < impl->timers[b]->deadline;
+}
+
+static inline void timer_swap(struct impl *impl, uint32_t a, uint32_t b)
+{
+	struct source_impl *t = impl->timers[a];
+	impl->timers[a] = impl->timers[b];
+	impl->timers[b] = t;
+	impl->timers[a]->heap_index = a;
+	impl->timers[b]->heap_index = b;
+}
+
+static void timer_sift_up(struct impl *impl, uint32_t i)
+{
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+		if (!timer_before(impl, i, parent))
+			break;
+		timer_swap(impl, i, parent);
+		i = parent;
+	}
+}
+
+static void timer_sift_down(struct impl *impl, uint32_t i)
+{
+	while (true) {
+		uint32_t min = i, l = 2 * i + 1, r = l + 1;
+		if (l < impl->n_timers && timer_before(impl, l, min))
+			min = l;
+		if (r < impl->n_timers && timer_before(impl, r, min))
+			min = r;
+		if (min == i)
+			break;
+		timer_swap(impl, i, min);
+		i = min;
+	}
+}
+
+static void timer_remove(struct impl *impl, struct source_impl *s)
+{
+	uint32_t i = s->heap_index;
+
+	if (i == SPA_ID_INVALID)
+		return;
+
+	s->heap_index = SPA_ID_INVALID;
+	if (i != --impl->n_timers) {
+		impl->timers[i] = impl->timers[impl->n_timers];
+		impl->timers[i]->heap_index = i;
+		timer_sift_down(impl, i);
+		timer_sift_up(impl, i);
+	}
+}
+
+static int timer_insert(struct impl *impl, struct source_impl *s, uint64_t deadline)
+{
+	uint32_t i = s->heap_index;
+
+	if (i == SPA_ID_INVALID) {
+		if (impl->n_timers == impl->max_timers) {
+			uint32_t max = SPA_MAX(impl->max_timers * 2, 16u);
+			struct source_impl **timers;
+
+			timers = realloc(impl->timers, max * sizeof(struct source_impl *));
+			if (timers == NULL)
+				return -errno;
+			impl->timers = timers;
+			impl->max_timers = max;
+		}
+		i = impl->n_timers++;
+		impl->timers[i] = s;
+		s->heap_index = i;
+		s->deadline = deadline;
+		timer_sift_up(impl, i);
+	} else if (deadline < s->deadline) {
+		s->deadline = deadline;
+		timer_sift_up(impl, i);
+	} else {
+		s->deadline = deadline;
+		timer_sift_down(impl, i);
+	}
+	return 0;
+}
+
+/* arm the timerfd when the earliest deadline moved before the armed one.
+ * When timers are removed or moved later, the timerfd is left alone and
+ * rearmed after the (early) wakeup. */
+static int timer_rearm(struct impl *impl)
+{
+	struct itimerspec its;
+	uint64_t deadline;
 	int res;
 
-	if (SPA_UNLIKELY((res = spa_system_timerfd_read(impl->impl->system,
-				source->fd, &expirations)) < 0))
-		spa_log_warn(impl->impl->log, NAME " %p: failed to read timer fd %d: %s",
-				source, source->fd, spa_strerror(res));
+	if (impl->timer == NULL || impl->dispatching_timers || impl->n_timers == 0)
+		return 0;
+
+	deadline = impl->timers[0]->deadline;
+	if (impl->timer_armed != 0 && impl->timer_armed <= deadline)
+		return 0;
+
+	spa_zero(its);
+	its.it_value.tv_sec = deadline / SPA_NSEC_PER_SEC;
+	its.it_value.tv_nsec = deadline % SPA_NSEC_PER_SEC;
+
+	if (SPA_UNLIKELY((res = spa_system_timerfd_settime(impl->system,
+				impl->timer->fd, SPA_FD_TIMER_ABSTIME, &its, NULL)) < 0))
+		return res;
+
+	impl->timer_armed = deadline;
+	return 0;
+}
+
+static void timers_dispatch(void *data, int fd, uint32_t mask)
+{
+	struct impl *impl = data;
+	uint64_t expirations, now;
+	uint32_t count;
+	int res;
+
+	if (SPA_UNLIKELY((res = spa_system_timerfd_read(impl->system, fd, &expirations)) < 0 &&
+			res != -EAGAIN))
+		spa_log_warn(impl->log, NAME " %p: failed to read timer fd %d: %s",
+				impl, fd, spa_strerror(res));
+
+	/* the timerfd is one-shot, it is disarmed after it expired */
+	impl->timer_armed = 0;
+	now = get_time_ns(impl);
+
+	/* only dispatch the timers that expired before we started so that
+	 * timers that are rearmed in the past by the callbacks don't keep us
+	 * here forever */
+	impl->dispatching_timers = true;
+	for (count = impl->n_timers; count > 0 && impl->n_timers > 0; count--) {
+		struct source_impl *s = impl->timers[0];
+
+		if (s->deadline > now)
+			break;
+
+		expirations = 1;
+		if (s->interval) {
+			expirations += (now - s->deadline) / s->interval;
+			timer_insert(impl, s, s->deadline + expirations * s->interval);
+		} else {
+			timer_remove(impl, s);
+		}
+		s->func.timer(s->source.data, expirations);
+	}
+	impl->dispatching_timers = false;
+
+	if (SPA_UNLIKELY((res = timer_rearm(impl)) < 0))
+		spa_log_warn(impl->log, NAME " %p: failed to arm timer fd %d: %s",
+				impl, fd, spa_strerror(res));
+}
+
+static int ensure_timer(struct impl *impl)
+{
+	int fd;
+
+	if (impl->timer != NULL)
+		return 0;
+
+	if ((fd = spa_system_timerfd_create(impl->system, CLOCK_MONOTONIC,
+			SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+		return fd;
 
-	impl->func.timer(source->data, expirations);
+	impl->timer = loop_add_io(impl, fd, SPA_IO_IN, true, timers_dispatch, impl);
+	if (impl->timer == NULL) {
+		spa_system_close(impl->system, fd);
+		return -errno;
+	}
+	impl->timer_armed = 0;
+	return 0;
+}
+
+/* never called, timers are dispatched by timers_dispatch() */
+static void source_timer_func(struct spa_source *source)
+{
 }
 
 static struct spa_source *loop_add_timer(void *object,
@@ -538,28 +950,25 @@ static struct spa_source *loop_add_timer(void *object,
 	if (source == NULL)
 		goto error_exit;
 
-	if ((res = spa_system_timerfd_create(impl->system, CLOCK_MONOTONIC,
-			SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+	if ((res = ensure_timer(impl)) < 0)
 		goto error_exit_free;
 
+	/* timers are not in the epoll set, they are dispatched from the
+	 * shared timerfd */
 	source->source.loop = &impl->loop;
 	source->source.func = source_timer_func;
 	source->source.data = data;
-	source->source.fd = res;
+	source->source.fd = -1;
 	source->source.mask = SPA_IO_IN;
 	source->impl = impl;
-	source->close = true;
+	source->close = false;
 	source->func.timer = func;
-
-	if ((res = loop_add_source(impl, &source->source)) < 0)
-		goto error_exit_close;
+	source->heap_index = SPA_ID_INVALID;
 
 	spa_list_insert(&impl->source_list, &source->link);
 
 	return &source->source;
 
-error_exit_close:
-	spa_system_close(impl->system, source->source.fd);
 error_exit_free:
 	free(source);
 	errno = -res;
@@ -572,25 +981,30 @@ loop_update_timer(void *object, struct spa_source *source,
 		  struct timespec *value, struct timespec *interval, bool absolute)
 {
 	struct impl *impl = object;
-	struct itimerspec its;
-	int flags = 0, res;
+	struct source_impl *s = SPA_CONTAINER_OF(source, struct source_impl, source);
+	uint64_t deadline = 0;
+	int res;
 
-	spa_zero(its);
+	/* same semantics as timerfd_settime() */
 	if (SPA_LIKELY(value)) {
-		its.it_value = *value;
+		deadline = SPA_TIMESPEC_TO_NSEC(value);
 	} else if (interval) {
-		its.it_value = *interval;
+		deadline = SPA_TIMESPEC_TO_NSEC(interval);
 		absolute = true;
 	}
-	if (SPA_UNLIKELY(interval))
-		its.it_interval = *interval;
-	if (SPA_LIKELY(absolute))
-		flags |= SPA_FD_TIMER_ABSTIME;
+	if (deadline != 0 && !absolute)
+		deadline += get_time_ns(impl);
 
-	if (SPA_UNLIKELY((res = spa_system_timerfd_settime(impl->system, source->fd, flags, &its, NULL)) < 0))
+	s->interval = interval ? SPA_TIMESPEC_TO_NSEC(interval) : 0;
+
+	if (deadline == 0) {
+		timer_remove(impl, s);
+		return 0;
+	}
+	if (SPA_UNLIKELY((res = timer_insert(impl, s, deadline)) < 0))
 		return res;
 
-	return 0;
+	return timer_rearm(impl);
 }
 
 static void source_signal_func(struct spa_source *source)
@@ -654,10 +1068,13 @@ static void loop_destroy_source(void *object, struct spa_source *source)
 
 	spa_list_remove(&impl->link);
 
-	if (impl->fallback)
+	if (impl->fallback) {
 		loop_destroy_source(impl->impl, impl->fallback);
-	else if (source->loop)
+	} else if (source->func == source_timer_func) {
+		timer_remove(impl->impl, impl);
+	} else if (source->loop) {
 		loop_remove_source(impl->impl, source);
+	}
 
 	if (source->fd != -1 && impl->close) {
 		spa_system_close(impl->impl->system, source->fd);
@@ -674,6 +1091,18 @@ static const struct spa_loop_methods impl_loop = {
 	.invoke = loop_invoke,
 };
 
+static int loop_get_stats(void *object, struct spa_loop_stats *stats)
+{
+	struct impl *impl = object;
+	stats->iterations = __atomic_load_n(&impl->stats.iterations, __ATOMIC_RELAXED);
+	stats->events = __atomic_load_n(&impl->stats.events, __ATOMIC_RELAXED);
+	stats->max_events = __atomic_load_n(&impl->stats.max_events, __ATOMIC_RELAXED);
+	stats->batch_size = __atomic_load_n(&impl->stats.batch_size, __ATOMIC_RELAXED);
+	stats->dispatch_time = __atomic_load_n(&impl->stats.dispatch_time, __ATOMIC_RELAXED);
+	stats->deferred = __atomic_load_n(&impl->stats.deferred, __ATOMIC_RELAXED);
+	return 0;
+}
+
 static const struct spa_loop_control_methods impl_loop_control = {
 	SPA_VERSION_LOOP_CONTROL_METHODS,
 	.get_fd = loop_get_fd,
@@ -681,6 +1110,7 @@ static const struct spa_loop_control_methods impl_loop_control = {
 	.enter = loop_enter,
 	.leave = loop_leave,
 	.iterate = loop_iterate,
+	.get_stats = loop_get_stats,
 };
 
 static const struct spa_loop_utils_methods impl_loop_utils = {
@@ -722,17 +1152,29 @@ static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *impl;
 	struct source_impl *source;
+	struct invoke_item *item;
 
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
 
 	impl = (struct impl *) handle;
 
+	while ((item = impl->queue) != NULL) {
+		impl->queue = item->next;
+		if (item->completion == NULL)
+			free_item(impl, item);
+	}
+
+	if (impl->timer) {
+		loop_destroy_source(impl, impl->timer);
+		impl->timer = NULL;
+	}
 	spa_list_consume(source, &impl->source_list, link)
 		loop_destroy_source(impl, &source->source);
 
 	process_destroy(impl);
+	free(impl->timers);
+	free(impl->ep);
 
-	spa_system_close(impl->system, impl->ack_fd);
 	spa_system_close(impl->system, impl->poll_fd);
 
 	return 0;
@@ -753,6 +1195,7 @@ impl_init(const struct spa_handle_factory *factory,
 	  uint32_t n_support)
 {
 	struct impl *impl;
+	const char *str;
 	int res;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
@@ -791,33 +1234,41 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	impl->poll_fd = res;
 
+	impl->budget = DEFAULT_BUDGET * SPA_NSEC_PER_USEC;
+	if (info && (str = spa_dict_lookup(info, "loop.dispatch-budget")) != NULL)
+		impl->budget = strtoul(str, NULL, 10) * SPA_NSEC_PER_USEC;
+
+	impl->ep = calloc(EVENTS_MIN, sizeof(struct spa_poll_event));
+	if (impl->ep == NULL) {
+		res = -errno;
+		goto error_exit_free_poll;
+	}
+	impl->n_ep = EVENTS_MIN;
+	impl->ep_peak = impl->ep_first = impl->ep_last = 0;
+	impl->depth = 0;
+	spa_zero(impl->stats);
+	impl->stats.batch_size = EVENTS_MIN;
+
 	spa_list_init(&impl->source_list);
 	spa_list_init(&impl->destroy_list);
 	spa_hook_list_init(&impl->hooks_list);
 
-	impl->buffer_data = SPA_PTR_ALIGN(impl->buffer_mem, 8, uint8_t);
-	spa_ringbuffer_init(&impl->buffer);
+	impl->queue = NULL;
+	memset(impl->slot_used, 0, sizeof(impl->slot_used));
 
 	impl->wakeup = loop_add_event(impl, wakeup_func, impl);
 	if (impl->wakeup == NULL) {
 		res = -errno;
 		spa_log_error(impl->log, NAME " %p: can't create wakeup event: %m", impl);
-		goto error_exit_free_poll;
-	}
-	if ((res = spa_system_eventfd_create(impl->system,
-			SPA_FD_EVENT_SEMAPHORE | SPA_FD_CLOEXEC)) < 0) {
-		spa_log_error(impl->log, NAME " %p: can't create ack event: %s",
-				impl, spa_strerror(res));
-		goto error_exit_free_wakeup;
+		goto error_exit_free_events;
 	}
-	impl->ack_fd = res;
 
 	spa_log_debug(impl->log, NAME " %p: initialized", impl);
 
 	return 0;
 
-error_exit_free_wakeup:
-	loop_destroy_source(impl, impl->wakeup);
+error_exit_free_events:
+	free(impl->ep);
 error_exit_free_poll:
 	spa_system_close(impl->system, impl->poll_fd);
 error_exit:
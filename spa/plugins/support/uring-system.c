@@ -0,0 +1,1040 @@
+/* Spa
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+#include <linux/io_uring.h>
+
+#include <spa/support/log.h>
+#include <spa/support/system.h>
+#include <spa/support/plugin.h>
+#include <spa/utils/list.h>
+#include <spa/utils/type.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+
+#define NAME "uring-system"
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#  define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+
+#define DEFAULT_ENTRIES		256
+#define SQPOLL_IDLE_MS		1000
+
+/* the features we can't do without */
+#define REQUIRED_FEATURES	(IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG | IORING_FEAT_RW_CUR_POS)
+
+/* user_data of the requests: fd, operation and generation of the fd */
+#define OP_POLL		0u	/* poll, completes the request */
+#define OP_POLL_LINK	1u	/* poll, followed by a linked read */
+#define OP_READ		2u	/* read of an eventfd or timerfd */
+#define OP_REMOVE	3u	/* poll remove */
+
+#define MAKE_DATA(fd,op,gen)	(((uint64_t)(fd) << 32) | ((uint64_t)(op) << 30) | ((gen) & 0x3fffffff))
+#define DATA_FD(d)		((int)((d) >> 32))
+#define DATA_OP(d)		((uint32_t)((d) >> 30) & 3u)
+#define DATA_GEN(d)		((uint32_t)(d) & 0x3fffffff)
+
+enum fd_type {
+	FD_TYPE_OTHER,
+	FD_TYPE_COUNTER,	/* eventfd or timerfd, reads are done by the ring */
+};
+
+/* state of an fd that is (or was) polled with the ring. Entries are never
+ * freed or moved while the system exists because the ring writes in
+ * the buffer. */
+struct fd_entry {
+	struct spa_list link;		/* link in pending list */
+	int fd;
+	enum fd_type type;
+
+	uint32_t events;
+	void *data;
+	uint32_t gen;			/* generation of the registration */
+	uint32_t armed_gen;		/* generation of the request in flight */
+	uint32_t close_gen;		/* generation when the fd was closed */
+	uint32_t seq;			/* last reported in this wait */
+
+	uint64_t buf;			/* read buffer of the ring */
+	uint64_t value;			/* value read by the ring, not consumed yet */
+
+	unsigned int registered:1;	/* in the poll set */
+	unsigned int armed:1;		/* request in flight */
+	unsigned int pending:1;		/* in the pending list */
+	unsigned int has_value:1;
+};
+
+struct ring {
+	int fd;
+	uint32_t features;
+	bool sqpoll;
+	bool in_use;			/* handed out by pollfd_create */
+
+	void *ring_ptr;
+	size_t ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	uint32_t *sq_head;
+	uint32_t *sq_tail;
+	uint32_t *sq_flags;
+	uint32_t sq_mask;
+	uint32_t sq_entries;
+	uint32_t sq_local_tail;
+
+	uint32_t *cq_head;
+	uint32_t *cq_tail;
+	uint32_t cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_system system;
+        struct spa_log *log;
+
+	pthread_mutex_t lock;
+	struct ring ring;
+
+	struct fd_entry **fds;
+	uint32_t max_fds;
+
+	struct spa_list pending;	/* entries to arm or report in the next wait */
+	uint32_t seq;
+	unsigned int waiting:1;		/* a thread is blocked in the ring */
+};
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		unsigned flags, void *arg, size_t argsz)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int ring_init(struct ring *r, uint32_t entries, bool sqpoll)
+{
+	struct io_uring_params p;
+	size_t sq_size, cq_size;
+	int res;
+
+	spa_zero(p);
+	if (sqpoll) {
+		p.flags |= IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = SQPOLL_IDLE_MS;
+	}
+	if ((r->fd = sys_io_uring_setup(entries, &p)) < 0)
+		return -errno;
+
+	if ((p.features & REQUIRED_FEATURES) != REQUIRED_FEATURES ||
+	    !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+		res = -ENOTSUP;
+		goto error_close;
+	}
+	r->features = p.features;
+	r->sqpoll = sqpoll;
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->ring_size = SPA_MAX(sq_size, cq_size);
+	r->ring_ptr = mmap(NULL, r->ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->ring_ptr == MAP_FAILED) {
+		res = -errno;
+		goto error_close;
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		res = -errno;
+		goto error_unmap;
+	}
+
+	r->sq_head = SPA_MEMBER(r->ring_ptr, p.sq_off.head, uint32_t);
+	r->sq_tail = SPA_MEMBER(r->ring_ptr, p.sq_off.tail, uint32_t);
+	r->sq_flags = SPA_MEMBER(r->ring_ptr, p.sq_off.flags, uint32_t);
+	r->sq_mask = *SPA_MEMBER(r->ring_ptr, p.sq_off.ring_mask, uint32_t);
+	r->sq_entries = p.sq_entries;
+	r->sq_local_tail = *r->sq_tail;
+
+	/* sqes are used in ring order, set up the indirection array once */
+	{
+		uint32_t i, *array = SPA_MEMBER(r->ring_ptr, p.sq_off.array, uint32_t);
+		for (i = 0; i < p.sq_entries; i++)
+			array[i] = i;
+	}
+
+	r->cq_head = SPA_MEMBER(r->ring_ptr, p.cq_off.head, uint32_t);
+	r->cq_tail = SPA_MEMBER(r->ring_ptr, p.cq_off.tail, uint32_t);
+	r->cq_mask = *SPA_MEMBER(r->ring_ptr, p.cq_off.ring_mask, uint32_t);
+	r->cqes = SPA_MEMBER(r->ring_ptr, p.cq_off.cqes, struct io_uring_cqe);
+
+	return 0;
+
+error_unmap:
+	munmap(r->ring_ptr, r->ring_size);
+error_close:
+	close(r->fd);
+	r->fd = -1;
+	return res;
+}
+
+static void ring_clear(struct ring *r)
+{
+	if (r->fd == -1)
+		return;
+	munmap(r->sqes, r->sqes_size);
+	munmap(r->ring_ptr, r->ring_size);
+	close(r->fd);
+	r->fd = -1;
+}
+
+/* make the queued sqes visible to the kernel, returns the number of
+ * new sqes. Must be called with the lock */
+static inline uint32_t ring_flush(struct ring *r)
+{
+	uint32_t to_submit = r->sq_local_tail - *r->sq_tail;
+	if (to_submit)
+		__atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+	return to_submit;
+}
+
+/* submit and/or wait, can be called without the lock */
+static int ring_enter(struct ring *r, uint32_t to_submit, unsigned min_complete,
+		unsigned flags, void *arg, size_t argsz)
+{
+	int res;
+
+	if (r->sqpoll) {
+		/* the kernel thread picks up the sqes */
+		if (__atomic_load_n(r->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		else if (min_complete == 0 && !(flags & IORING_ENTER_SQ_WAIT))
+			return 0;
+		to_submit = 0;
+	} else if (to_submit == 0 && min_complete == 0) {
+		return 0;
+	}
+	if (min_complete)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	res = sys_io_uring_enter(r->fd, to_submit, min_complete, flags, arg, argsz);
+	return res < 0 ? -errno : res;
+}
+
+static inline int ring_submit(struct ring *r)
+{
+	return ring_enter(r, ring_flush(r), 0, 0, NULL, 0);
+}
+
+/* make sure there is room for n sqes */
+static int ring_reserve(struct ring *r, uint32_t n)
+{
+	int res;
+
+	while (r->sq_local_tail + n - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) > r->sq_entries) {
+		if ((res = ring_enter(r, ring_flush(r), 0,
+				r->sqpoll ? IORING_ENTER_SQ_WAIT : 0, NULL, 0)) < 0)
+			return res;
+	}
+	return 0;
+}
+
+static inline struct io_uring_sqe *ring_next_sqe(struct ring *r)
+{
+	struct io_uring_sqe *sqe = &r->sqes[r->sq_local_tail++ & r->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+static struct fd_entry *get_entry(struct impl *impl, int fd, bool create)
+{
+	struct fd_entry *e;
+
+	if (fd < 0)
+		return NULL;
+	if ((uint32_t)fd >= impl->max_fds) {
+		struct fd_entry **fds;
+		uint32_t max;
+
+		if (!create)
+			return NULL;
+		max = SPA_MAX(impl->max_fds * 2, (uint32_t)fd + 64);
+		fds = realloc(impl->fds, max * sizeof(struct fd_entry *));
+		if (fds == NULL)
+			return NULL;
+		memset(&fds[impl->max_fds], 0, (max - impl->max_fds) * sizeof(struct fd_entry *));
+		impl->fds = fds;
+		impl->max_fds = max;
+	}
+	if ((e = impl->fds[fd]) == NULL && create) {
+		if ((e = calloc(1, sizeof(struct fd_entry))) == NULL)
+			return NULL;
+		e->fd = fd;
+		impl->fds[fd] = e;
+	}
+	return e;
+}
+
+static inline void set_pending(struct impl *impl, struct fd_entry *e)
+{
+	if (!e->pending) {
+		spa_list_append(&impl->pending, &e->link);
+		e->pending = true;
+	}
+}
+
+static inline void clear_pending(struct fd_entry *e)
+{
+	if (e->pending) {
+		spa_list_remove(&e->link);
+		e->pending = false;
+	}
+}
+
+/* poll the fd. Counters are read by the ring as soon as they are readable,
+ * which saves the read syscall of the consumer. */
+static int arm_entry(struct impl *impl, struct fd_entry *e)
+{
+	struct io_uring_sqe *sqe;
+	bool link = e->type == FD_TYPE_COUNTER && e->events == SPA_IO_IN;
+	int res;
+
+	if ((res = ring_reserve(&impl->ring, link ? 2 : 1)) < 0)
+		return res;
+
+	sqe = ring_next_sqe(&impl->ring);
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = e->fd;
+	sqe->poll_events = e->events & 0xffff;
+	sqe->user_data = MAKE_DATA(e->fd, link ? OP_POLL_LINK : OP_POLL, e->gen);
+	if (link) {
+		sqe->flags = IOSQE_IO_LINK;
+#if defined(IORING_FEAT_CQE_SKIP) && defined(IOSQE_CQE_SKIP_SUCCESS)
+		if (impl->ring.features & IORING_FEAT_CQE_SKIP)
+			sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+#endif
+
+		sqe = ring_next_sqe(&impl->ring);
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = e->fd;
+		sqe->off = (uint64_t) -1;
+		sqe->addr = (uintptr_t) &e->buf;
+		sqe->len = sizeof(e->buf);
+		sqe->user_data = MAKE_DATA(e->fd, OP_READ, e->gen);
+	}
+	e->armed = true;
+	e->armed_gen = e->gen;
+	return 0;
+}
+
+static int disarm_entry(struct impl *impl, struct fd_entry *e)
+{
+	struct io_uring_sqe *sqe;
+	bool link = e->type == FD_TYPE_COUNTER && e->events == SPA_IO_IN;
+	int res;
+
+	if (!e->armed)
+		return 0;
+	if ((res = ring_reserve(&impl->ring, 1)) < 0)
+		return res;
+
+	sqe = ring_next_sqe(&impl->ring);
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = MAKE_DATA(e->fd, link ? OP_POLL_LINK : OP_POLL, e->armed_gen);
+	sqe->user_data = MAKE_DATA(e->fd, OP_REMOVE, 0);
+	return 0;
+}
+
+/* changes made while the loop thread sleeps in the ring must be
+ * submitted right away, otherwise they are submitted with the next wait */
+static int schedule_entry(struct impl *impl, struct fd_entry *e)
+{
+	int res;
+
+	if (!impl->waiting || e->armed || e->has_value) {
+		set_pending(impl, e);
+		return 0;
+	}
+	if ((res = arm_entry(impl, e)) < 0)
+		return res;
+	return ring_submit(&impl->ring);
+}
+
+static inline bool report_entry(struct impl *impl, struct fd_entry *e, uint32_t events,
+		struct spa_poll_event *ev, int *n_ev)
+{
+	if (e->seq == impl->seq)
+		return false;
+	e->seq = impl->seq;
+	ev[*n_ev].events = events;
+	ev[*n_ev].data = e->data;
+	(*n_ev)++;
+	return true;
+}
+
+/* report the counters with unconsumed values and arm the fds that
+ * completed in the previous wait */
+static void process_pending(struct impl *impl, struct spa_poll_event *ev, int max_ev, int *n_ev)
+{
+	struct fd_entry *e, *t;
+
+	spa_list_for_each_safe(e, t, &impl->pending, link) {
+		if (!e->registered) {
+			clear_pending(e);
+			continue;
+		}
+		if (e->has_value) {
+			if (*n_ev < max_ev && (e->events & SPA_IO_IN))
+				report_entry(impl, e, SPA_IO_IN, ev, n_ev);
+			continue;
+		}
+		if (!e->armed && arm_entry(impl, e) < 0)
+			break;
+		clear_pending(e);
+	}
+}
+
+static void process_cqe(struct impl *impl, struct io_uring_cqe *cqe,
+		struct spa_poll_event *ev, int *n_ev)
+{
+	uint64_t d = cqe->user_data;
+	uint32_t op = DATA_OP(d), gen = DATA_GEN(d);
+	struct fd_entry *e;
+
+	if (op == OP_REMOVE || op == OP_POLL_LINK)
+		return;
+	if ((e = get_entry(impl, DATA_FD(d), false)) == NULL)
+		return;
+
+	e->armed = false;
+	if (op == OP_READ) {
+		/* keep the value when the registration changed, it was
+		 * consumed from the fd and it's still the same fd */
+		if (cqe->res == sizeof(e->buf) && gen > e->close_gen) {
+			e->value += e->buf;
+			e->has_value = true;
+		}
+		if (e->registered && e->has_value && (e->events & SPA_IO_IN))
+			report_entry(impl, e, SPA_IO_IN, ev, n_ev);
+	} else if (cqe->res > 0 && e->registered && gen == e->gen) {
+		report_entry(impl, e, cqe->res & (e->events | SPA_IO_ERR | SPA_IO_HUP), ev, n_ev);
+	}
+	if (e->registered)
+		set_pending(impl, e);
+}
+
+static int reap_cqes(struct impl *impl, struct spa_poll_event *ev, int max_ev, int *n_ev)
+{
+	struct ring *r = &impl->ring;
+	uint32_t head, tail;
+
+	head = *r->cq_head;
+	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail && *n_ev < max_ev) {
+		process_cqe(impl, &r->cqes[head & r->cq_mask], ev, n_ev);
+		head++;
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+	return head != tail;
+}
+
+static ssize_t impl_read(void *object, int fd, void *buf, size_t count)
+{
+	ssize_t res = read(fd, buf, count);
+	return res < 0 ? -errno : res;
+}
+
+static ssize_t impl_write(void *object, int fd, const void *buf, size_t count)
+{
+	ssize_t res = write(fd, buf, count);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_ioctl(void *object, int fd, unsigned long request, ...)
+{
+	int res;
+	va_list ap;
+	long arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, long);
+	res = ioctl(fd, request, arg);
+	va_end(ap);
+
+	return res < 0 ? -errno : res;
+}
+
+static int impl_close(void *object, int fd)
+{
+	struct impl *impl = object;
+	struct fd_entry *e;
+	int res;
+
+	pthread_mutex_lock(&impl->lock);
+	if (fd == impl->ring.fd) {
+		/* the ring stays around until the system is cleared */
+		impl->ring.in_use = false;
+		pthread_mutex_unlock(&impl->lock);
+		spa_log_debug(impl->log, NAME " %p: release ring fd:%d", impl, fd);
+		return 0;
+	}
+	if ((e = get_entry(impl, fd, false)) != NULL) {
+		/* like epoll, a closed fd is removed from the poll set */
+		if (e->registered) {
+			e->registered = false;
+			disarm_entry(impl, e);
+			if (impl->waiting)
+				ring_submit(&impl->ring);
+		}
+		e->close_gen = e->gen++;
+		e->type = FD_TYPE_OTHER;
+		e->has_value = false;
+		e->value = 0;
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	res = close(fd);
+	spa_log_debug(impl->log, NAME " %p: close fd:%d", impl, fd);
+	return res < 0 ? -errno : res;
+}
+
+/* clock */
+static int impl_clock_gettime(void *object,
+			int clockid, struct timespec *value)
+{
+	int res = clock_gettime(clockid, value);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_clock_getres(void *object,
+			int clockid, struct timespec *res)
+{
+	int r = clock_getres(clockid, res);
+	return r < 0 ? -errno : r;
+}
+
+/* poll, the first poll fd is the ring, other ones use epoll */
+static int impl_pollfd_create(void *object, int flags)
+{
+	struct impl *impl = object;
+	int fl = 0, res;
+
+	pthread_mutex_lock(&impl->lock);
+	if (!impl->ring.in_use) {
+		impl->ring.in_use = true;
+		res = impl->ring.fd;
+		pthread_mutex_unlock(&impl->lock);
+		spa_log_debug(impl->log, NAME " %p: ring fd:%d", impl, res);
+		return res;
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= EPOLL_CLOEXEC;
+	res = epoll_create1(fl);
+	spa_log_debug(impl->log, NAME " %p: new fd:%d", impl, res);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_pollfd_add(void *object, int pfd, int fd, uint32_t events, void *data)
+{
+	struct impl *impl = object;
+	struct fd_entry *e;
+	int res;
+
+	if (pfd != impl->ring.fd) {
+		struct epoll_event ep;
+
+		spa_zero(ep);
+		ep.events = events;
+		ep.data.ptr = data;
+		res = epoll_ctl(pfd, EPOLL_CTL_ADD, fd, &ep);
+		return res < 0 ? -errno : res;
+	}
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = get_entry(impl, fd, true)) == NULL) {
+		res = fd < 0 ? -EBADF : -errno;
+	} else if (e->registered) {
+		res = -EEXIST;
+	} else {
+		e->registered = true;
+		e->events = events;
+		e->data = data;
+		e->gen++;
+		res = schedule_entry(impl, e);
+	}
+	pthread_mutex_unlock(&impl->lock);
+	return res < 0 ? res : 0;
+}
+
+static int impl_pollfd_mod(void *object, int pfd, int fd, uint32_t events, void *data)
+{
+	struct impl *impl = object;
+	struct fd_entry *e;
+	int res = 0;
+
+	if (pfd != impl->ring.fd) {
+		struct epoll_event ep;
+
+		spa_zero(ep);
+		ep.events = events;
+		ep.data.ptr = data;
+		res = epoll_ctl(pfd, EPOLL_CTL_MOD, fd, &ep);
+		return res < 0 ? -errno : res;
+	}
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = get_entry(impl, fd, false)) == NULL || !e->registered) {
+		res = -ENOENT;
+	} else if (e->events == events) {
+		e->data = data;
+	} else {
+		/* the new poll is armed when the old one completed */
+		if ((res = disarm_entry(impl, e)) >= 0) {
+			e->events = events;
+			e->data = data;
+			e->gen++;
+			res = schedule_entry(impl, e);
+		}
+	}
+	pthread_mutex_unlock(&impl->lock);
+	return res < 0 ? res : 0;
+}
+
+static int impl_pollfd_del(void *object, int pfd, int fd)
+{
+	struct impl *impl = object;
+	struct fd_entry *e;
+	int res = 0;
+
+	if (pfd != impl->ring.fd) {
+		res = epoll_ctl(pfd, EPOLL_CTL_DEL, fd, NULL);
+		return res < 0 ? -errno : res;
+	}
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = get_entry(impl, fd, false)) == NULL || !e->registered) {
+		res = -ENOENT;
+	} else {
+		e->registered = false;
+		e->gen++;
+		clear_pending(e);
+		/* submit right away so that the ring drops its reference
+		 * to the file before it is closed */
+		if ((res = disarm_entry(impl, e)) >= 0 && e->armed)
+			res = ring_submit(&impl->ring);
+	}
+	pthread_mutex_unlock(&impl->lock);
+	return res < 0 ? res : 0;
+}
+
+static int impl_pollfd_wait(void *object, int pfd,
+		struct spa_poll_event *ev, int n_ev, int timeout)
+{
+	struct impl *impl = object;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct timespec now;
+	int64_t deadline = 0, remaining;
+	uint32_t to_submit;
+	int n = 0, res = 0;
+	bool expired;
+
+	if (pfd != impl->ring.fd) {
+		struct epoll_event ep[n_ev];
+		int i, nfds;
+
+		if (SPA_UNLIKELY((nfds = epoll_wait(pfd, ep, n_ev, timeout)) < 0))
+			return -errno;
+
+		for (i = 0; i < nfds; i++) {
+			ev[i].events = ep[i].events;
+			ev[i].data = ep[i].data.ptr;
+		}
+		return nfds;
+	}
+
+	spa_zero(arg);
+	if (timeout > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		deadline = SPA_TIMESPEC_TO_NSEC(&now) + timeout * SPA_NSEC_PER_MSEC;
+		arg.ts = (uintptr_t) &ts;
+	}
+
+	pthread_mutex_lock(&impl->lock);
+	impl->seq++;
+
+	while (true) {
+		/* the rearms of the previous iteration are submitted together
+		 * with the wait */
+		process_pending(impl, ev, n_ev, &n);
+		reap_cqes(impl, ev, n_ev, &n);
+		if (n > 0 || timeout == 0)
+			break;
+
+		/* completions without events wake us up early, wait for
+		 * what is left of the timeout */
+		if (timeout > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			remaining = deadline - SPA_TIMESPEC_TO_NSEC(&now);
+			if (remaining <= 0)
+				break;
+			ts.tv_sec = remaining / SPA_NSEC_PER_SEC;
+			ts.tv_nsec = remaining % SPA_NSEC_PER_SEC;
+		}
+
+		to_submit = ring_flush(&impl->ring);
+		impl->waiting = true;
+		pthread_mutex_unlock(&impl->lock);
+
+		res = ring_enter(&impl->ring, to_submit, 1, IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+		pthread_mutex_lock(&impl->lock);
+		impl->waiting = false;
+
+		if (res < 0 && res != -ETIME && res != -EBUSY)
+			break;
+		expired = res == -ETIME;
+		res = 0;
+		reap_cqes(impl, ev, n_ev, &n);
+		if (n > 0 || expired)
+			break;
+	}
+	/* when nobody will wait on the ring right away (it might be nested
+	 * in another loop), make sure the rearms are submitted now */
+	if (timeout == 0 || n > 0) {
+		int dummy = 0;
+		if (timeout == 0)
+			process_pending(impl, ev, 0, &dummy);
+		if (timeout == 0 || impl->ring.sqpoll)
+			ring_submit(&impl->ring);
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	return res < 0 ? res : n;
+}
+
+/* timers */
+static int impl_timerfd_create(void *object, int clockid, int flags)
+{
+	struct impl *impl = object;
+	struct fd_entry *e;
+	int fl = 0, res;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= TFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= TFD_NONBLOCK;
+	res = timerfd_create(clockid, fl);
+	spa_log_debug(impl->log, NAME " %p: new fd:%d", impl, res);
+	if (res < 0)
+		return -errno;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = get_entry(impl, res, true)) != NULL)
+		e->type = FD_TYPE_COUNTER;
+	pthread_mutex_unlock(&impl->lock);
+	return res;
+}
+
+static int impl_timerfd_settime(void *object,
+			int fd, int flags,
+			const struct itimerspec *new_value,
+			struct itimerspec *old_value)
+{
+	int fl = 0, res;
+	if (flags & SPA_FD_TIMER_ABSTIME)
+		fl |= TFD_TIMER_ABSTIME;
+	if (flags & SPA_FD_TIMER_CANCEL_ON_SET)
+		fl |= TFD_TIMER_CANCEL_ON_SET;
+	res = timerfd_settime(fd, fl, new_value, old_value);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_timerfd_gettime(void *object,
+			int fd, struct itimerspec *curr_value)
+{
+	int res = timerfd_gettime(fd, curr_value);
+	return res < 0 ? -errno : res;
+
+}
+
+/* take the value the ring read for us or read it from the fd */
+static int read_counter(struct impl *impl, int fd, uint64_t *value)
+{
+	struct fd_entry *e;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = get_entry(impl, fd, false)) != NULL && e->has_value) {
+		*value = e->value;
+		e->value = 0;
+		e->has_value = false;
+		pthread_mutex_unlock(&impl->lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	if (read(fd, value, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+static int impl_timerfd_read(void *object, int fd, uint64_t *expirations)
+{
+	return read_counter(object, fd, expirations);
+}
+
+/* events */
+static int impl_eventfd_create(void *object, int flags)
+{
+	struct impl *impl = object;
+	struct fd_entry *e;
+	int fl = 0, res;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= EFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= EFD_NONBLOCK;
+	if (flags & SPA_FD_EVENT_SEMAPHORE)
+		fl |= EFD_SEMAPHORE;
+	res = eventfd(0, fl);
+	spa_log_debug(impl->log, NAME " %p: new fd:%d", impl, res);
+	if (res < 0)
+		return -errno;
+
+	/* semaphores must be read one by one by the consumer */
+	if (!(flags & SPA_FD_EVENT_SEMAPHORE)) {
+		pthread_mutex_lock(&impl->lock);
+		if ((e = get_entry(impl, res, true)) != NULL)
+			e->type = FD_TYPE_COUNTER;
+		pthread_mutex_unlock(&impl->lock);
+	}
+	return res;
+}
+
+static int impl_eventfd_write(void *object, int fd, uint64_t count)
+{
+	if (write(fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+static int impl_eventfd_read(void *object, int fd, uint64_t *count)
+{
+	return read_counter(object, fd, count);
+}
+
+/* signals */
+static int impl_signalfd_create(void *object, int signal, int flags)
+{
+	struct impl *impl = object;
+	sigset_t mask;
+	int res, fl = 0;
+
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= SFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= SFD_NONBLOCK;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, signal);
+	res = signalfd(-1, &mask, fl);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	spa_log_debug(impl->log, NAME " %p: new fd:%d", impl, res);
+
+	return res < 0 ? -errno : res;
+}
+
+static int impl_signalfd_read(void *object, int fd, int *signal)
+{
+	struct signalfd_siginfo signal_info;
+	int len;
+
+	len = read(fd, &signal_info, sizeof signal_info);
+	if (!(len == -1 && errno == EAGAIN) && len != sizeof signal_info)
+		return -errno;
+
+	*signal = signal_info.ssi_signo;
+
+	return 0;
+}
+
+static const struct spa_system_methods impl_system = {
+	SPA_VERSION_SYSTEM_METHODS,
+	.read = impl_read,
+	.write = impl_write,
+	.ioctl = impl_ioctl,
+	.close = impl_close,
+	.clock_gettime = impl_clock_gettime,
+	.clock_getres = impl_clock_getres,
+	.pollfd_create = impl_pollfd_create,
+	.pollfd_add = impl_pollfd_add,
+	.pollfd_mod = impl_pollfd_mod,
+	.pollfd_del = impl_pollfd_del,
+	.pollfd_wait = impl_pollfd_wait,
+	.timerfd_create = impl_timerfd_create,
+	.timerfd_settime = impl_timerfd_settime,
+	.timerfd_gettime = impl_timerfd_gettime,
+	.timerfd_read = impl_timerfd_read,
+	.eventfd_create = impl_eventfd_create,
+	.eventfd_write = impl_eventfd_write,
+	.eventfd_read = impl_eventfd_read,
+	.signalfd_create = impl_signalfd_create,
+	.signalfd_read = impl_signalfd_read,
+};
+
+static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
+{
+	struct impl *impl;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	impl = (struct impl *) handle;
+
+	if (strcmp(type, SPA_TYPE_INTERFACE_System) == 0)
+		*interface = &impl->system;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *impl;
+	uint32_t i;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	impl = (struct impl *) handle;
+
+	/* the ring must be gone before the buffers it writes to */
+	ring_clear(&impl->ring);
+	for (i = 0; i < impl->max_fds; i++)
+		free(impl->fds[i]);
+	free(impl->fds);
+	pthread_mutex_destroy(&impl->lock);
+
+	return 0;
+}
+
+static size_t
+impl_get_size(const struct spa_handle_factory *factory,
+	      const struct spa_dict *params)
+{
+	return sizeof(struct impl);
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *impl;
+	const char *str;
+	bool sqpoll = false;
+	int res;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	impl = (struct impl *) handle;
+	impl->system.iface = SPA_INTERFACE_INIT(
+			SPA_TYPE_INTERFACE_System,
+			SPA_VERSION_SYSTEM,
+			&impl_system, impl);
+
+	impl->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+
+	if (info && (str = spa_dict_lookup(info, "system.uring.sqpoll")) != NULL)
+		sqpoll = strcmp(str, "true") == 0 || atoi(str) == 1;
+
+	if ((res = ring_init(&impl->ring, DEFAULT_ENTRIES, sqpoll)) < 0) {
+		spa_log_info(impl->log, NAME " %p: io_uring not usable: %s",
+				impl, spa_strerror(res));
+		return res;
+	}
+	pthread_mutex_init(&impl->lock, NULL);
+	spa_list_init(&impl->pending);
+
+	spa_log_debug(impl->log, NAME " %p: initialized sqpoll:%d features:%08x",
+			impl, sqpoll, impl->ring.features);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_System,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	if (*index >= SPA_N_ELEMENTS(impl_interfaces))
+		return 0;
+
+	*info = &impl_interfaces[(*index)++];
+	return 1;
+}
+
+const struct spa_handle_factory spa_support_uring_system_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	SPA_NAME_SUPPORT_SYSTEM,
+	NULL,
+	impl_get_size,
+	impl_init,
+	impl_enum_interface_info
+};
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <time.h>
 #include <assert.h>
+#include <stdbool.h>
 
 #include <spa/utils/dict.h>
 
@@ -66,52 +67,115 @@ static void gen_dict(struct spa_dict *dict, uint32_t n_items)
 	dict->flags = 0;
 }
 
-static void test_query(const struct spa_dict *dict)
+#define HASH_SIZE	2048	/* power of 2, at least twice MAX_ITEMS */
+
+/* an open addressing hash on the keys of the dict, like pw_properties */
+static uint32_t hash_index[HASH_SIZE];	/* index + 1 in dict items, 0 when free */
+static uint32_t hash_size;
+
+static inline uint32_t key_hash(const char *key)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (*key)
+		hash = (hash ^ (uint8_t)*key++) * 16777619u;
+	return hash;
+}
+
+static void hash_build(const struct spa_dict *dict)
+{
+	uint32_t i, j;
+
+	for (hash_size = 16; hash_size < dict->n_items * 2; hash_size *= 2);
+	memset(hash_index, 0, sizeof(hash_index));
+
+	for (i = 0; i < dict->n_items; i++) {
+		for (j = key_hash(dict->items[i].key) & (hash_size - 1);
+		     hash_index[j]; j = (j + 1) & (hash_size - 1))
+			if (!strcmp(dict->items[hash_index[j] - 1].key, dict->items[i].key))
+				break;
+		if (hash_index[j] == 0)
+			hash_index[j] = i + 1;
+	}
+}
+
+static const char *hash_lookup(const struct spa_dict *dict, const char *key)
+{
+	uint32_t j;
+
+	for (j = key_hash(key) & (hash_size - 1); hash_index[j]; j = (j + 1) & (hash_size - 1)) {
+		const struct spa_dict_item *it = &dict->items[hash_index[j] - 1];
+		if (!strcmp(it->key, key))
+			return it->value;
+	}
+	return NULL;
+}
+
+static void test_query(const struct spa_dict *dict, bool hashed)
 {
 	uint32_t i, idx;
-	const char *str;
+	const char *key, *str;
 
 	for (i = 0; i < MAX_COUNT; i++) {
 		idx = random() % dict->n_items;
-		str = spa_dict_lookup(dict, dict->items[idx].key);
-		assert(strcmp(str, dict->items[idx].value) == 0);
+		key = dict->items[idx].key;
+		str = hashed ? hash_lookup(dict, key) : spa_dict_lookup(dict, key);
+		/* the values are the keys */
+		assert(str != NULL && strcmp(key, str) == 0);
 	}
 }
 
-static void test_lookup(struct spa_dict *dict)
+static uint64_t time_query(const struct spa_dict *dict, bool hashed, const char *name)
 {
 	struct timespec ts;
-	uint64_t t1, t2, t3, t4;
+	uint64_t t1, t2;
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	test_query(dict);
+	test_query(dict, hashed);
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	fprintf(stderr, "%d elapsed %"PRIu64" count %u = %"PRIu64"/sec\n", dict->n_items,
-			t2 - t1, MAX_COUNT, MAX_COUNT * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1));
+	fprintf(stderr, "%d %-6s elapsed %"PRIu64" count %u = %"PRIu64"/sec\n", dict->n_items,
+			name, t2 - t1, MAX_COUNT, MAX_COUNT * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1));
+	return t2 - t1;
+}
+
+static void test_lookup(struct spa_dict *dict)
+{
+	struct timespec ts;
+	uint64_t t1, t2, linear, sorted, hashed;
+
+	linear = time_query(dict, false, "linear");
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
 
 	spa_dict_qsort(dict);
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
-	t3 = SPA_TIMESPEC_TO_NSEC(&ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	fprintf(stderr, "%d sort elapsed %"PRIu64"\n", dict->n_items, t3 - t2);
+	fprintf(stderr, "%d sort elapsed %"PRIu64"\n", dict->n_items, t2 - t1);
+
+	sorted = time_query(dict, false, "sorted");
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
-	t3 = SPA_TIMESPEC_TO_NSEC(&ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	test_query(dict);
+	hash_build(dict);
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
-	t4 = SPA_TIMESPEC_TO_NSEC(&ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	fprintf(stderr, "%d hash elapsed %"PRIu64"\n", dict->n_items, t2 - t1);
+
+	hashed = time_query(dict, true, "hashed");
 
-	fprintf(stderr, "%d elapsed %"PRIu64" count %u = %"PRIu64"/sec %f speedup\n", dict->n_items,
-			t4 - t3, MAX_COUNT, MAX_COUNT * (uint64_t)SPA_NSEC_PER_SEC / (t4 - t3),
-			(double)(t2 - t1) / (t4 - t2));
+	fprintf(stderr, "%d speedup sorted %f hashed %f\n", dict->n_items,
+			(double)linear / sorted, (double)linear / hashed);
 }
 
 int main(int argc, char *argv[])
@@ -123,7 +187,7 @@ int main(int argc, char *argv[])
 
 	/* warmup */
 	gen_dict(&dict, 1000);
-	test_query(&dict);
+	test_query(&dict, false);
 
 	gen_dict(&dict, 10);
 	test_lookup(&dict);
@@ -0,0 +1,258 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+#define DEFAULT_SOURCES		512
+#define N_ROUNDS		200
+#define WORK_NS			(20 * SPA_NSEC_PER_USEC)
+
+struct data {
+	const char *plugin_dir;
+
+	struct spa_handle *system_handle;
+	struct spa_handle *loop_handle;
+
+	struct spa_system *system;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	uint32_t n_sources;
+	int (*fds)[2];
+	struct spa_source **sources;
+
+	uint64_t work;
+	uint64_t dispatched;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int load_handle(struct data *data, struct spa_handle **handle, const char *lib,
+		const char *name, const struct spa_dict *info,
+		const struct spa_support *support, uint32_t n_support)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", data->plugin_dir, lib);
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -ENOENT;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		*handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+		if ((res = spa_handle_factory_init(factory, *handle,
+						info, support, n_support)) < 0) {
+			printf("can't make factory instance: %s\n", spa_strerror(res));
+			free(*handle);
+			*handle = NULL;
+			return res;
+		}
+		return 0;
+	}
+	return -EBADF;
+}
+
+static int make_loop(struct data *data, const char *budget)
+{
+	struct spa_support support[1];
+	struct spa_dict_item items[1];
+	void *iface;
+	int res;
+
+	if ((res = load_handle(data, &data->system_handle, "support/libspa-support.so",
+					SPA_NAME_SUPPORT_SYSTEM, NULL, NULL, 0)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(data->system_handle, SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	data->system = iface;
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, data->system);
+
+	items[0] = SPA_DICT_ITEM_INIT("loop.dispatch-budget", budget);
+	if ((res = load_handle(data, &data->loop_handle, "support/libspa-support.so",
+					SPA_NAME_SUPPORT_LOOP, &SPA_DICT_INIT(items, 1),
+					support, 1)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(data->loop_handle, SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	data->control = iface;
+	if ((res = spa_handle_get_interface(data->loop_handle, SPA_TYPE_INTERFACE_LoopUtils, &iface)) < 0)
+		return res;
+	data->utils = iface;
+	return 0;
+}
+
+static void free_loop(struct data *data)
+{
+	if (data->loop_handle) {
+		spa_handle_clear(data->loop_handle);
+		free(data->loop_handle);
+		data->loop_handle = NULL;
+	}
+	if (data->system_handle) {
+		spa_handle_clear(data->system_handle);
+		free(data->system_handle);
+		data->system_handle = NULL;
+	}
+}
+
+/* every source takes two fds */
+static uint32_t max_sources(uint32_t n_sources)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+		return n_sources;
+	if (rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		getrlimit(RLIMIT_NOFILE, &rl);
+	}
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < n_sources * 2 + 64)
+		n_sources = (rl.rlim_cur - 64) / 2;
+	return n_sources;
+}
+
+/* a client that sent a message, read it and do some work */
+static void on_io(void *user_data, int fd, uint32_t mask)
+{
+	struct data *data = user_data;
+	uint64_t end = get_time_ns() + data->work;
+	char c;
+
+	if (read(fd, &c, 1) != 1)
+		printf("read: %m\n");
+	while (get_time_ns() < end);
+	data->dispatched++;
+}
+
+static void run(struct data *data, const char *name, const char *budget, uint64_t work)
+{
+	struct spa_loop_stats stats;
+	uint64_t t1, t2, polls = 0, max_round = 0;
+	uint32_t i, j;
+
+	if (make_loop(data, budget) < 0) {
+		printf("%s: can't make loop\n", name);
+		free_loop(data);
+		return;
+	}
+	data->work = work;
+	data->dispatched = 0;
+
+	for (i = 0; i < data->n_sources; i++)
+		data->sources[i] = spa_loop_utils_add_io(data->utils, data->fds[i][0],
+				SPA_IO_IN, false, on_io, data);
+
+	spa_loop_control_enter(data->control);
+	t1 = get_time_ns();
+	for (j = 0; j < N_ROUNDS; j++) {
+		uint64_t r1 = get_time_ns(), r2;
+
+		for (i = 0; i < data->n_sources; i++) {
+			if (write(data->fds[i][1], "x", 1) != 1)
+				printf("write: %m\n");
+		}
+		while (data->dispatched < (uint64_t)(j + 1) * data->n_sources) {
+			spa_loop_control_iterate(data->control, -1);
+			polls++;
+		}
+		r2 = get_time_ns();
+		max_round = SPA_MAX(max_round, r2 - r1);
+	}
+	t2 = get_time_ns();
+	spa_loop_control_leave(data->control);
+
+	spa_loop_control_get_stats(data->control, &stats);
+	printf("%s: %u sources, %u rounds in %f ms, %f iterations per round, "
+			"max round %f ms\n",
+			name, data->n_sources, N_ROUNDS, (t2 - t1) / 1000000.0,
+			(double)polls / N_ROUNDS, max_round / 1000000.0);
+	printf("%s: %"PRIu64" iterations %"PRIu64" events, max %u per iteration, "
+			"batch %u, %"PRIu64" deferred, %f us per callback\n",
+			name, stats.iterations, stats.events, stats.max_events,
+			stats.batch_size, stats.deferred,
+			stats.dispatch_time / 1000.0 / SPA_MAX(stats.events, 1u));
+
+	for (i = 0; i < data->n_sources; i++)
+		spa_loop_utils_destroy_source(data->utils, data->sources[i]);
+	free_loop(data);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	uint32_t i;
+
+	if ((data.plugin_dir = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		printf("SPA_PLUGIN_DIR not set\n");
+		return -1;
+	}
+
+	data.n_sources = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_SOURCES;
+	data.n_sources = SPA_MAX(max_sources(data.n_sources), 1u);
+	data.fds = calloc(data.n_sources, sizeof(int[2]));
+	data.sources = calloc(data.n_sources, sizeof(struct spa_source *));
+	if (data.fds == NULL || data.sources == NULL) {
+		printf("can't allocate: %m\n");
+		return -1;
+	}
+
+	for (i = 0; i < data.n_sources; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, data.fds[i]) < 0) {
+			printf("socketpair: %m\n");
+			return -1;
+		}
+	}
+
+	run(&data, "idle", "0", 0);
+	run(&data, "unlimited", "0", WORK_NS);
+	run(&data, "budget", "2000", WORK_NS);
+
+	for (i = 0; i < data.n_sources; i++) {
+		close(data.fds[i][0]);
+		close(data.fds[i][1]);
+	}
+	free(data.fds);
+	free(data.sources);
+
+	return 0;
+}
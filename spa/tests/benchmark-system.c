@@ -0,0 +1,248 @@
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+#define N_SELF		500000
+#define N_PINGPONG	200000
+
+static const char *system_libs[] = {
+	"support/libspa-support.so",
+	"support/libspa-uring.so",
+};
+
+struct loop {
+	struct spa_handle *system_handle;
+	struct spa_handle *loop_handle;
+
+	struct spa_system *system;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	struct spa_source *event;
+	struct loop *peer;
+	pthread_t thread;
+
+	uint64_t count;
+	uint64_t max;
+	bool running;
+};
+
+static const char *plugin_dir;
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int load_handle(struct spa_handle **handle, const char *lib, const char *name,
+		const struct spa_support *support, uint32_t n_support)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", plugin_dir, lib);
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -ENOENT;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		*handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+		if ((res = spa_handle_factory_init(factory, *handle,
+						NULL, support, n_support)) < 0) {
+			printf("can't make factory instance: %s\n", spa_strerror(res));
+			free(*handle);
+			*handle = NULL;
+			return res;
+		}
+		return 0;
+	}
+	return -EBADF;
+}
+
+static int make_loop(struct loop *l, const char *system_lib)
+{
+	struct spa_support support[1];
+	void *iface;
+	int res;
+
+	spa_zero(*l);
+	if ((res = load_handle(&l->system_handle, system_lib,
+					SPA_NAME_SUPPORT_SYSTEM, NULL, 0)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(l->system_handle, SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	l->system = iface;
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, l->system);
+
+	if ((res = load_handle(&l->loop_handle, "support/libspa-support.so",
+					SPA_NAME_SUPPORT_LOOP, support, 1)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(l->loop_handle, SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	l->control = iface;
+	if ((res = spa_handle_get_interface(l->loop_handle, SPA_TYPE_INTERFACE_LoopUtils, &iface)) < 0)
+		return res;
+	l->utils = iface;
+	return 0;
+}
+
+static void free_loop(struct loop *l)
+{
+	if (l->loop_handle) {
+		spa_handle_clear(l->loop_handle);
+		free(l->loop_handle);
+	}
+	if (l->system_handle) {
+		spa_handle_clear(l->system_handle);
+		free(l->system_handle);
+	}
+}
+
+static void *loop_thread(void *user_data)
+{
+	struct loop *l = user_data;
+
+	spa_loop_control_enter(l->control);
+	while (l->running)
+		spa_loop_control_iterate(l->control, -1);
+	spa_loop_control_leave(l->control);
+
+	return NULL;
+}
+
+/* the loop wakes itself up */
+static void on_self(void *user_data, uint64_t count)
+{
+	struct loop *l = user_data;
+	if (++l->count < l->max)
+		spa_loop_utils_signal_event(l->utils, l->event);
+}
+
+static void run_self(const char *lib)
+{
+	struct loop l;
+	uint64_t t1, t2;
+
+	if (make_loop(&l, lib) < 0) {
+		printf("%s: not available\n", lib);
+		free_loop(&l);
+		return;
+	}
+	l.max = N_SELF;
+	l.event = spa_loop_utils_add_event(l.utils, on_self, &l);
+
+	spa_loop_control_enter(l.control);
+	t1 = get_time_ns();
+	spa_loop_utils_signal_event(l.utils, l.event);
+	while (l.count < l.max)
+		spa_loop_control_iterate(l.control, -1);
+	t2 = get_time_ns();
+	spa_loop_control_leave(l.control);
+
+	printf("%s: self: %"PRIu64" wakeups, %f wakeups/s, %f us per wakeup\n",
+			lib, l.count, l.count * (double)SPA_NSEC_PER_SEC / (t2 - t1),
+			(t2 - t1) / 1000.0 / l.count);
+
+	spa_loop_utils_destroy_source(l.utils, l.event);
+	free_loop(&l);
+}
+
+/* two loop threads wake each other up */
+static void on_ping(void *user_data, uint64_t count)
+{
+	struct loop *l = user_data;
+
+	if (++l->count >= l->max) {
+		l->running = false;
+		l->peer->running = false;
+	}
+	spa_loop_utils_signal_event(l->peer->utils, l->peer->event);
+}
+
+static void run_pingpong(const char *lib)
+{
+	struct loop l[2];
+	uint64_t t1, t2, total;
+	uint32_t i;
+
+	if (make_loop(&l[0], lib) < 0 || make_loop(&l[1], lib) < 0) {
+		printf("%s: not available\n", lib);
+		free_loop(&l[0]);
+		free_loop(&l[1]);
+		return;
+	}
+	for (i = 0; i < 2; i++) {
+		l[i].peer = &l[1 - i];
+		l[i].max = N_PINGPONG;
+		l[i].running = true;
+		l[i].event = spa_loop_utils_add_event(l[i].utils, on_ping, &l[i]);
+	}
+
+	t1 = get_time_ns();
+	for (i = 0; i < 2; i++)
+		pthread_create(&l[i].thread, NULL, loop_thread, &l[i]);
+	spa_loop_utils_signal_event(l[0].utils, l[0].event);
+	for (i = 0; i < 2; i++)
+		pthread_join(l[i].thread, NULL);
+	t2 = get_time_ns();
+
+	total = l[0].count + l[1].count;
+	printf("%s: pingpong: %"PRIu64" wakeups, %f wakeups/s, %f us per wakeup\n",
+			lib, total, total * (double)SPA_NSEC_PER_SEC / (t2 - t1),
+			(t2 - t1) / 1000.0 / total);
+
+	for (i = 0; i < 2; i++) {
+		spa_loop_utils_destroy_source(l[i].utils, l[i].event);
+		free_loop(&l[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i;
+
+	if ((plugin_dir = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		printf("SPA_PLUGIN_DIR not set\n");
+		return -1;
+	}
+
+	for (i = 0; i < SPA_N_ELEMENTS(system_libs); i++) {
+		run_self(system_libs[i]);
+		run_pingpong(system_libs[i]);
+	}
+	return 0;
+}
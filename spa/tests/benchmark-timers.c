@@ -0,0 +1,271 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+#define DEFAULT_TIMERS		10000
+#define N_UPDATES		10
+#define SPREAD_NS		(50 * SPA_NSEC_PER_MSEC)
+#define INTERVAL_NS		(10 * SPA_NSEC_PER_MSEC)
+#define PERIODIC_NS		(500 * SPA_NSEC_PER_MSEC)
+
+struct data {
+	const char *plugin_dir;
+	struct spa_support support[4];
+	uint32_t n_support;
+
+	struct spa_system *system;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	uint32_t n_timers;
+	struct spa_source **timers;
+
+	uint64_t fired;
+	uint64_t expirations;
+};
+
+static inline uint64_t get_time_ns(clockid_t clock_id)
+{
+	struct timespec ts;
+	clock_gettime(clock_id, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int load_handle(struct data *data, struct spa_handle **handle, const char *lib, const char *name)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", data->plugin_dir, lib);
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -ENOENT;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		*handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+		if ((res = spa_handle_factory_init(factory, *handle,
+						NULL, data->support,
+						data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		return 0;
+	}
+	return -EBADF;
+}
+
+/* loop implementations with one fd per timer need a large fd limit */
+static void raise_fd_limit(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+		return;
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static void on_timeout(void *user_data, uint64_t expirations)
+{
+	struct data *data = user_data;
+	data->fired++;
+	data->expirations += expirations;
+}
+
+static void set_timer(struct data *data, struct spa_source *timer,
+		uint64_t timeout, uint64_t interval)
+{
+	struct timespec value, ival;
+
+	value.tv_sec = timeout / SPA_NSEC_PER_SEC;
+	value.tv_nsec = timeout % SPA_NSEC_PER_SEC;
+	ival.tv_sec = interval / SPA_NSEC_PER_SEC;
+	ival.tv_nsec = interval % SPA_NSEC_PER_SEC;
+	spa_loop_utils_update_timer(data->utils, timer, &value,
+			interval ? &ival : NULL, false);
+}
+
+static void add_timers(struct data *data)
+{
+	uint64_t t1, t2;
+	uint32_t i;
+
+	t1 = get_time_ns(CLOCK_MONOTONIC);
+	for (i = 0; i < data->n_timers; i++) {
+		data->timers[i] = spa_loop_utils_add_timer(data->utils, on_timeout, data);
+		if (data->timers[i] == NULL) {
+			printf("can't add timer %u: %m\n", i);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns(CLOCK_MONOTONIC);
+	printf("add %u timers: %f us per timer\n",
+			data->n_timers, (t2 - t1) / 1000.0 / data->n_timers);
+}
+
+/* arm all timers far in the future and keep moving them around */
+static void update_timers(struct data *data)
+{
+	uint64_t t1, t2, n = (uint64_t)data->n_timers * N_UPDATES;
+	uint32_t i, j;
+
+	t1 = get_time_ns(CLOCK_MONOTONIC);
+	for (j = 0; j < N_UPDATES; j++) {
+		for (i = 0; i < data->n_timers; i++) {
+			uint32_t idx = (i * 7919) % data->n_timers;
+			set_timer(data, data->timers[idx],
+					60 * SPA_NSEC_PER_SEC + ((i + j) % 1000) * SPA_NSEC_PER_MSEC, 0);
+		}
+	}
+	t2 = get_time_ns(CLOCK_MONOTONIC);
+	printf("update %"PRIu64" timers: %f us per update\n",
+			n, (t2 - t1) / 1000.0 / n);
+}
+
+/* run the loop until all timers fired, counting the cpu time of the loop */
+static void run_timers(struct data *data, const char *name, uint64_t expected, uint64_t duration)
+{
+	uint64_t t1, t2, c1, c2, end, wakeups = 0;
+
+	data->fired = data->expirations = 0;
+
+	t1 = get_time_ns(CLOCK_MONOTONIC);
+	c1 = get_time_ns(CLOCK_THREAD_CPUTIME_ID);
+	end = t1 + duration;
+	while (duration ? get_time_ns(CLOCK_MONOTONIC) < end : data->fired < expected) {
+		spa_loop_control_iterate(data->control, 100);
+		wakeups++;
+	}
+	c2 = get_time_ns(CLOCK_THREAD_CPUTIME_ID);
+	t2 = get_time_ns(CLOCK_MONOTONIC);
+
+	printf("%s: %"PRIu64" callbacks %"PRIu64" expirations in %f ms, %"PRIu64" wakeups, "
+			"%f us cpu per callback\n",
+			name, data->fired, data->expirations, (t2 - t1) / 1000000.0, wakeups,
+			(c2 - c1) / 1000.0 / SPA_MAX(data->fired, 1u));
+}
+
+static void expire_timers(struct data *data)
+{
+	uint64_t t1, t2;
+	uint32_t i;
+
+	t1 = get_time_ns(CLOCK_MONOTONIC);
+	for (i = 0; i < data->n_timers; i++)
+		set_timer(data, data->timers[i],
+				1 + (uint64_t)i * SPREAD_NS / data->n_timers, 0);
+	t2 = get_time_ns(CLOCK_MONOTONIC);
+	printf("arm %u timers: %f us per timer\n",
+			data->n_timers, (t2 - t1) / 1000.0 / data->n_timers);
+
+	run_timers(data, "oneshot", data->n_timers, 0);
+
+	for (i = 0; i < data->n_timers; i++)
+		set_timer(data, data->timers[i],
+				1 + (uint64_t)i * INTERVAL_NS / data->n_timers, INTERVAL_NS);
+
+	run_timers(data, "periodic", 0, PERIODIC_NS);
+}
+
+static void destroy_timers(struct data *data)
+{
+	uint64_t t1, t2;
+	uint32_t i;
+
+	t1 = get_time_ns(CLOCK_MONOTONIC);
+	for (i = 0; i < data->n_timers; i++)
+		spa_loop_utils_destroy_source(data->utils, data->timers[i]);
+	t2 = get_time_ns(CLOCK_MONOTONIC);
+	printf("destroy %u timers: %f us per timer\n",
+			data->n_timers, (t2 - t1) / 1000.0 / data->n_timers);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct spa_handle *system = NULL, *handle = NULL;
+	const char *str;
+	void *iface;
+	int res;
+
+	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		printf("SPA_PLUGIN_DIR not set\n");
+		return -1;
+	}
+	data.plugin_dir = str;
+
+	data.n_timers = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_TIMERS;
+	data.n_timers = SPA_MAX(data.n_timers, 1u);
+	data.timers = calloc(data.n_timers, sizeof(struct spa_source *));
+
+	raise_fd_limit();
+
+	if ((res = load_handle(&data, &system,
+					"support/libspa-support.so",
+					SPA_NAME_SUPPORT_SYSTEM)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(system, SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	data.system = iface;
+	data.support[data.n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, data.system);
+
+	if ((res = load_handle(&data, &handle,
+					"support/libspa-support.so",
+					SPA_NAME_SUPPORT_LOOP)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	data.control = iface;
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_LoopUtils, &iface)) < 0)
+		return res;
+	data.utils = iface;
+
+	spa_loop_control_enter(data.control);
+
+	add_timers(&data);
+	update_timers(&data);
+	expire_timers(&data);
+	destroy_timers(&data);
+
+	spa_loop_control_leave(data.control);
+
+	spa_handle_clear(handle);
+	free(handle);
+	spa_handle_clear(system);
+	free(system);
+	free(data.timers);
+
+	return 0;
+}
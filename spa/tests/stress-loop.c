@@ -0,0 +1,267 @@
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <sched.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+#define DEFAULT_PRODUCERS	4
+#define N_ASYNC			200000
+#define N_SYNC			20000
+
+struct data {
+	const char *plugin_dir;
+	struct spa_support support[4];
+	uint32_t n_support;
+
+	struct spa_system *system;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+
+	pthread_t thread;
+	bool running;
+
+	uint64_t executed;
+};
+
+struct producer {
+	struct data *data;
+	pthread_t thread;
+	uint32_t n_async;
+	uint32_t n_sync;
+	uint64_t *latency;
+	uint32_t failed;
+	uint32_t full;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int load_handle(struct data *data, struct spa_handle **handle, const char *lib, const char *name)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", data->plugin_dir, lib);
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -ENOENT;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		*handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+		if ((res = spa_handle_factory_init(factory, *handle,
+						NULL, data->support,
+						data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		return 0;
+	}
+	return -EBADF;
+}
+
+static void *loop_thread(void *user_data)
+{
+	struct data *data = user_data;
+
+	spa_loop_control_enter(data->control);
+	while (data->running)
+		spa_loop_control_iterate(data->control, -1);
+	spa_loop_control_leave(data->control);
+
+	return NULL;
+}
+
+static int do_count(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *d, size_t size, void *user_data)
+{
+	struct data *data = user_data;
+	__atomic_add_fetch(&data->executed, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *d, size_t size, void *user_data)
+{
+	struct data *data = user_data;
+	data->running = false;
+	return 0;
+}
+
+static void *producer_thread(void *user_data)
+{
+	struct producer *p = user_data;
+	struct data *data = p->data;
+	uint64_t payload[4] = { 0, };
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < p->n_async; i++) {
+		payload[0] = i;
+		/* the item pool of the loop is full, wait for the loop to catch up */
+		while ((res = spa_loop_invoke(data->loop, do_count, SPA_ID_INVALID,
+				payload, sizeof(payload), false, data)) == -ENOSPC) {
+			p->full++;
+			sched_yield();
+		}
+		if (res < 0)
+			p->failed++;
+	}
+	for (i = 0; i < p->n_sync; i++) {
+		uint64_t t1, t2;
+
+		payload[0] = i;
+		t1 = get_time_ns();
+		if (spa_loop_invoke(data->loop, do_count, SPA_ID_INVALID,
+				payload, sizeof(payload), true, data) < 0)
+			p->failed++;
+		t2 = get_time_ns();
+		p->latency[i] = t2 - t1;
+	}
+	return NULL;
+}
+
+static int cmp_uint64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t*)a, vb = *(const uint64_t*)b;
+	return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+static void run_test(struct data *data, uint32_t n_producers)
+{
+	struct producer *p;
+	uint64_t *latency, t1, t2, expected;
+	uint32_t i, n_async, n_sync, failed = 0, full = 0;
+
+	n_async = N_ASYNC / n_producers;
+	n_sync = N_SYNC / n_producers;
+
+	p = calloc(n_producers, sizeof(struct producer));
+	latency = calloc(n_producers * n_sync, sizeof(uint64_t));
+
+	data->executed = 0;
+	expected = (uint64_t)n_producers * (n_async + n_sync);
+
+	t1 = get_time_ns();
+	for (i = 0; i < n_producers; i++) {
+		p[i].data = data;
+		p[i].n_async = n_async;
+		p[i].n_sync = n_sync;
+		p[i].latency = &latency[i * n_sync];
+		pthread_create(&p[i].thread, NULL, producer_thread, &p[i]);
+	}
+	for (i = 0; i < n_producers; i++) {
+		pthread_join(p[i].thread, NULL);
+		failed += p[i].failed;
+		full += p[i].full;
+	}
+	while (__atomic_load_n(&data->executed, __ATOMIC_RELAXED) + failed < expected)
+		sched_yield();
+	t2 = get_time_ns();
+
+	qsort(latency, n_producers * n_sync, sizeof(uint64_t), cmp_uint64);
+
+	printf("producers:%2u invokes:%8"PRIu64" failed:%u full:%u %10.0f invokes/s "
+			"blocking p50:%6"PRIu64"ns p99:%7"PRIu64"ns p99.9:%8"PRIu64"ns max:%8"PRIu64"ns\n",
+			n_producers, expected, failed, full,
+			expected * (double)SPA_NSEC_PER_SEC / (t2 - t1),
+			latency[(n_producers * n_sync) / 2],
+			latency[(n_producers * n_sync) * 99 / 100],
+			latency[(n_producers * n_sync) * 999 / 1000],
+			latency[n_producers * n_sync - 1]);
+
+	free(latency);
+	free(p);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct spa_handle *handle = NULL;
+	const char *str;
+	uint32_t i, n_producers;
+	void *iface;
+	int res;
+
+	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		printf("SPA_PLUGIN_DIR not set\n");
+		return -1;
+	}
+	data.plugin_dir = str;
+
+	if (argc > 1)
+		n_producers = atoi(argv[1]);
+	else
+		n_producers = DEFAULT_PRODUCERS;
+	n_producers = SPA_MAX(n_producers, 1u);
+
+	if ((res = load_handle(&data, &handle,
+					"support/libspa-support.so",
+					SPA_NAME_SUPPORT_SYSTEM)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	data.system = iface;
+	data.support[data.n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, data.system);
+
+	if ((res = load_handle(&data, &handle,
+					"support/libspa-support.so",
+					SPA_NAME_SUPPORT_LOOP)) < 0)
+		return res;
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_Loop, &iface)) < 0)
+		return res;
+	data.loop = iface;
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	data.control = iface;
+
+	printf("starting loop invoke stress test\n");
+
+	data.running = true;
+	pthread_create(&data.thread, NULL, loop_thread, &data);
+
+	for (i = 1; i <= n_producers; i++)
+		run_test(&data, i);
+
+	spa_loop_invoke(data.loop, do_stop, SPA_ID_INVALID, NULL, 0, false, &data);
+	pthread_join(data.thread, NULL);
+
+	spa_handle_clear(handle);
+	free(handle);
+
+	return 0;
+}
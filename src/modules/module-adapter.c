@@ -188,6 +188,10 @@ static void *create_object(void *_data,
 		if (factory_name == NULL)
 			goto error_properties;
 
+		/* the adapter drives the follower, they need to run in
+		 * the same data loop */
+		pw_context_select_data_loop(d->context, properties);
+
 		follower = pw_spa_node_load(d->context,
 					factory_name,
 					PW_SPA_NODE_FLAG_ACTIVATE |
@@ -224,6 +224,11 @@ struct pw_impl_node *pw_adapter_new(struct pw_context *context,
 
 	pw_properties_update(props, info->props);
 
+	/* the adapter drives the follower and runs in its data loop */
+	if ((str = pw_properties_get(pw_impl_node_get_properties(follower),
+					PW_KEY_NODE_DATA_LOOP)) != NULL)
+		pw_properties_set(props, PW_KEY_NODE_DATA_LOOP, str);
+
 	if (info->n_output_ports > 0) {
 		direction = PW_DIRECTION_OUTPUT;
 	} else if (info->n_input_ports > 0) {
@@ -816,7 +816,7 @@ do_port_use_buffers(struct impl *impl,
 
 		mb[i].buffer = &b->buffer;
 		mb[i].mem_id = m->id;
-		mb[i].offset = SPA_PTRDIFF(baseptr, mem->map->ptr);
+		mb[i].offset = SPA_PTRDIFF(baseptr, mem->map->ptr) + mem->map->offset;
 		mb[i].size = SPA_PTRDIFF(endptr, baseptr);
 		spa_log_debug(this->log, NAME" %p: buffer %d %d %d %d", this, i, mb[i].mem_id,
 				mb[i].offset, mb[i].size);
@@ -921,7 +921,8 @@ static int impl_node_process(void *object)
 	n->rt.activation->status = PW_NODE_ACTIVATION_TRIGGERED;
 	n->rt.activation->signal_time = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	if (SPA_UNLIKELY(spa_system_eventfd_write(this->data_system, this->writefd, 1) < 0))
+	if (SPA_LIKELY(pw_node_activation_need_wakeup(n->rt.activation)) &&
+	    SPA_UNLIKELY(spa_system_eventfd_write(this->data_system, this->writefd, 1) < 0))
 		spa_log_warn(this->log, NAME" %p: error %m", this);
 
 	return SPA_STATUS_OK;
@@ -1668,6 +1669,16 @@ static int process_node(void *data)
 	return spa_node_process(&this->node);
 }
 
+static int wakeup_node(void *data)
+{
+	struct impl *impl = data;
+	struct node *this = &impl->node;
+	pw_log_trace_fp(NAME " %p: wakeup", this);
+	if (SPA_UNLIKELY(spa_system_eventfd_write(this->data_system, this->writefd, 1) < 0))
+		pw_log_warn(NAME " %p: wakeup failed %m", this);
+	return 0;
+}
+
 /** Create a new client node
  * \param client an owner \ref pw_client
  * \param id an id
@@ -1705,6 +1716,8 @@ struct pw_impl_client_node *pw_impl_client_node_new(struct pw_resource *resource
 	}
 
 	pw_properties_setf(properties, PW_KEY_CLIENT_ID, "%d", client->global->id);
+	/* the client wakes up the node in the first data loop */
+	pw_properties_set(properties, PW_KEY_NODE_DATA_LOOP, "0");
 
 	this = &impl->this;
 
@@ -1736,6 +1749,7 @@ struct pw_impl_client_node *pw_impl_client_node_new(struct pw_resource *resource
 	this->flags = 0;
 
 	this->node->rt.target.signal = process_node;
+	this->node->rt.target.wakeup = wakeup_node;
 	this->node->rt.target.data = impl;
 
 	pw_resource_add_listener(this->resource,
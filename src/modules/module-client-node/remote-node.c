@@ -149,6 +149,7 @@ static void clean_transport(struct node_data *data)
 
 	pw_memmap_free(data->activation);
 	data->node->rt.activation = data->node->activation->map->ptr;
+	data->node->spin_activation = true;
 
 	spa_system_close(data->context->data_system, data->rtwritefd);
 	data->have_transport = false;
@@ -262,6 +263,9 @@ static int client_node_transport(void *object,
 	}
 
 	data->node->rt.activation = data->activation->ptr;
+	data->node->spin_activation = PW_NODE_ACTIVATION_HAS_SPIN(size);
+	if (data->node->spin_activation)
+		data->node->rt.activation->spin_wait = data->node->spin_wait;
 
 	pw_log_debug("remote-node %p: fds:%d %d node:%u activation:%p",
 		proxy, readfd, writefd, data->remote_id, data->activation->ptr);
@@ -827,7 +831,9 @@ static int link_signal_func(void *user_data)
 	link->target.activation->status = PW_NODE_ACTIVATION_TRIGGERED;
 	link->target.activation->signal_time = SPA_TIMESPEC_TO_NSEC(&ts);
 
-	if (SPA_UNLIKELY(spa_system_eventfd_write(data_system, link->signalfd, 1) < 0))
+	if (SPA_LIKELY(!link->data->node->spin_activation ||
+	    pw_node_activation_need_wakeup(link->target.activation)) &&
+	    SPA_UNLIKELY(spa_system_eventfd_write(data_system, link->signalfd, 1) < 0))
 		pw_log_warn("link %p: write failed %m", link);
 
 	return 0;
@@ -770,7 +770,7 @@ impl_node_port_use_buffers(void *object,
 
 		mb[i].buffer = &b->buffer;
 		mb[i].mem_id = b->memid;
-		mb[i].offset = SPA_PTRDIFF(baseptr, SPA_MEMBER(mem->map->ptr, mem->map->offset, void));
+		mb[i].offset = SPA_PTRDIFF(baseptr, mem->map->ptr) + mem->map->offset;
 		mb[i].size = data_size;
 
 		for (j = 0; j < buffers[i]->n_metas; j++)
@@ -1360,6 +1360,8 @@ struct pw_impl_client_node0 *pw_impl_client_node0_new(struct pw_resource *resour
 	convert_properties(properties);
 
 	pw_properties_setf(properties, PW_KEY_CLIENT_ID, "%d", client->global->id);
+	/* the client wakes up the node in the first data loop */
+	pw_properties_set(properties, PW_KEY_NODE_DATA_LOOP, "0");
 
 	impl->context = context;
 	impl->fds[0] = impl->fds[1] = -1;
@@ -78,6 +78,8 @@ struct impl {
 	unsigned int flushing:1;
 	unsigned int listening:1;
 
+	bool writing;				/* drivers in other data loops are writing */
+	uint64_t cache_lookups;			/* format cache lookups at the last profile */
 	struct spa_ringbuffer buffer;
 	uint8_t data[MAX_BUFFER];
 };
@@ -161,6 +163,7 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 	struct pw_node_target *t;
 	int32_t filled;
 	uint32_t idx, avail;
+	uint64_t lookups, prev_lookups;
 
 	spa_pod_builder_init(&b, buffer, sizeof(buffer));
 	spa_pod_builder_push_object(&b, &f[0],
@@ -217,17 +220,36 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 			SPA_POD_Int(na->status),
 			SPA_POD_Fraction(&n->latency));
 	}
+
+	/* the cache is shared by all drivers, only one of them adds the
+	 * counters after a lookup */
+	lookups = impl->context->format_cache.hits + impl->context->format_cache.misses;
+	prev_lookups = __atomic_exchange_n(&impl->cache_lookups, lookups, __ATOMIC_RELAXED);
+	if (lookups != prev_lookups) {
+		spa_pod_builder_prop(&b, SPA_PROFILER_formatCache, 0);
+		spa_pod_builder_add_struct(&b,
+				SPA_POD_Long(impl->context->format_cache.hits),
+				SPA_POD_Long(impl->context->format_cache.misses),
+				SPA_POD_Long(impl->context->format_cache.miss_time),
+				SPA_POD_Long(impl->context->format_cache.saved_time));
+	}
+
 	spa_pod_builder_pop(&b, &f[0]);
 
+	/* drivers can run in different data loops, skip the profile instead of
+	 * waiting when another one is writing */
+	if (__atomic_test_and_set(&impl->writing, __ATOMIC_ACQUIRE))
+		goto dropped;
+
 	filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
 	if (filled < 0 || filled > MAX_BUFFER) {
 		pw_log_warn(NAME " %p: queue xrun %d", impl, filled);
-		goto done;
+		goto unlock_dropped;
 	}
 	avail = MAX_BUFFER - filled;
 	if (avail < b.state.offset) {
 		pw_log_warn(NAME " %p: queue full %d < %d", impl, avail, b.state.offset);
-		goto done;
+		goto unlock_dropped;
 	}
 	spa_ringbuffer_write_data(&impl->buffer,
 			impl->data, MAX_BUFFER,
@@ -237,8 +259,17 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 
 	if (!impl->flushing || filled + b.state.offset > MIN_FLUSH)
 		start_flush(impl);
-done:
-	impl->count++;
+	__atomic_clear(&impl->writing, __ATOMIC_RELEASE);
+	ATOMIC_INC(impl->count);
+	return;
+
+unlock_dropped:
+	__atomic_clear(&impl->writing, __ATOMIC_RELEASE);
+dropped:
+	/* send the cache counters again with the next profile */
+	if (lookups != prev_lookups)
+		__atomic_store_n(&impl->cache_lookups, UINT64_MAX, __ATOMIC_RELAXED);
+	ATOMIC_INC(impl->count);
 }
 
 static const struct pw_context_driver_events context_events = {
@@ -258,8 +289,7 @@ static int do_stop(struct spa_loop *loop,
 static void stop_listener(struct impl *impl)
 {
 	if (impl->listening) {
-		pw_loop_invoke(impl->context->data_loop,
-                       do_stop, SPA_ID_INVALID, NULL, 0, true, impl);
+		pw_context_invoke_data_loops(impl->context, do_stop, impl);
 		impl->listening = false;
 	}
 }
@@ -310,10 +340,12 @@ global_bind(void *_data, struct pw_impl_client *client, uint32_t permissions,
 	pw_resource_add_listener(resource, &data->resource_listener,
 			&resource_events, impl);
 
+	/* new clients get the current cache counters with the next profile */
+	__atomic_store_n(&impl->cache_lookups, UINT64_MAX, __ATOMIC_RELAXED);
+
 	if (++impl->busy == 1) {
 		pw_log_info(NAME" %p: starting profiler", impl);
-		pw_loop_invoke(impl->context->data_loop,
-                       do_start, SPA_ID_INVALID, NULL, 0, false, impl);
+		pw_context_invoke_data_loops(impl->context, do_start, impl);
 		impl->listening = true;
 	}
 	return 0;
@@ -83,6 +83,10 @@ static bool debug_messages = 0;
 #define LOCK_SUFFIX     ".lock"
 #define LOCK_SUFFIXLEN  5
 
+/* size of the shared memory ring for messages without fds, set on the
+ * server to accept rings and advertised in the core properties */
+#define KEY_RING_SIZE	"protocol.native.ring-size"
+
 void pw_protocol_native_init(struct pw_protocol *protocol);
 void pw_protocol_native0_init(struct pw_protocol *protocol);
 
@@ -92,6 +96,7 @@ struct protocol_data {
 	struct pw_protocol *protocol;
 
 	struct server *local;
+	uint32_t ring_size;
 };
 
 struct client {
@@ -103,9 +108,12 @@ struct client {
 	struct pw_protocol_native_connection *connection;
 	struct spa_hook conn_listener;
 
+	struct spa_hook core_listener;
+
 	int ref;
 
 	unsigned int disconnecting:1;
+	unsigned int core_listening:1;
 	unsigned int need_flush:1;
 	unsigned int paused:1;
 };
@@ -473,6 +481,8 @@ static struct client_data *client_new(struct server *s, int fd)
 
 	pw_map_init(&this->compat_v2.types, 0, 32);
 
+	pw_protocol_native_connection_accept_ring(this->connection, d->ring_size);
+
 	pw_protocol_native_connection_add_listener(this->connection,
 						   &this->conn_listener,
 						   &server_conn_events,
@@ -851,6 +861,40 @@ static const struct pw_protocol_native_connection_events client_conn_events = {
 	.need_flush = on_client_need_flush,
 };
 
+static void on_core_info(void *data, const struct pw_core_info *info)
+{
+	struct client *impl = data;
+	const struct pw_properties *props;
+	const char *str;
+	uint32_t size;
+	int res;
+
+	if (info->props == NULL ||
+	    (str = spa_dict_lookup(info->props, KEY_RING_SIZE)) == NULL)
+		return;
+	size = pw_properties_parse_int(str);
+
+	/* the server accepts rings, use our own size when configured */
+	props = pw_context_get_properties(impl->context);
+	if ((str = pw_properties_get(props, KEY_RING_SIZE)) != NULL)
+		size = SPA_MIN(size, (uint32_t)pw_properties_parse_int(str));
+
+	spa_hook_remove(&impl->core_listener);
+	impl->core_listening = false;
+
+	if (size == 0 || impl->connection == NULL)
+		return;
+
+	if ((res = pw_protocol_native_connection_offer_ring(impl->connection, size)) < 0)
+		pw_log_warn(NAME" %p: can't offer ring of %u bytes: %s",
+				impl, size, spa_strerror(res));
+}
+
+static const struct pw_core_events core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.info = on_core_info,
+};
+
 static int impl_connect_fd(struct pw_protocol_client *client, int fd, bool do_close)
 {
 	struct client *impl = SPA_CONTAINER_OF(client, struct client, this);
@@ -872,6 +916,12 @@ static int impl_connect_fd(struct pw_protocol_client *client, int fd, bool do_cl
 						   &impl->conn_listener,
 						   &client_conn_events,
 						   impl);
+
+	if (!impl->core_listening) {
+		pw_core_add_listener(client->core, &impl->core_listener,
+				&core_events, impl);
+		impl->core_listening = true;
+	}
 	return 0;
 
 error_cleanup:
@@ -888,6 +938,11 @@ static void impl_disconnect(struct pw_protocol_client *client)
 
 	impl->disconnecting = true;
 
+	if (impl->core_listening) {
+		spa_hook_remove(&impl->core_listener);
+		impl->core_listening = false;
+	}
+
 	if (impl->source)
                 pw_loop_destroy_source(impl->context->main_loop, impl->source);
 	impl->source = NULL;
@@ -1258,6 +1313,7 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	struct pw_protocol *this;
 	struct protocol_data *d;
 	const struct pw_properties *props;
+	const char *str;
 	int res;
 
 	if (pw_context_find_protocol(context, PW_TYPE_INFO_PROTOCOL_Native) != NULL)
@@ -1284,6 +1340,9 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	props = pw_context_get_properties(context);
 	d->local = create_server(this, context->core, &props->dict);
 
+	if ((str = pw_properties_get(props, KEY_RING_SIZE)) != NULL)
+		d->ring_size = pw_properties_parse_int(str);
+
 	if (need_server(context, &props->dict)) {
 		if (impl_add_server(this, context->core, &props->dict) == NULL) {
 			res = -errno;
@@ -1291,6 +1350,13 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 		}
 	}
 
+	if (d->ring_size > 0) {
+		char val[16];
+		snprintf(val, sizeof(val), "%u", d->ring_size);
+		pw_impl_core_update_properties(context->core,
+				&SPA_DICT_INIT(&SPA_DICT_ITEM_INIT(KEY_RING_SIZE, val), 1));
+	}
+
 	pw_impl_module_add_listener(module, &d->module_listener, &module_events, d);
 
 	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_props));
@@ -0,0 +1,222 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+#include <spa/utils/result.h>
+
+#include <pipewire/pipewire.h>
+
+#include "connection.h"
+
+#define N_MESSAGES	2000
+#define N_ROUNDS	200
+#define RING_SIZE	(1 << 20)
+
+struct stats {
+	const char *name;
+	uint32_t fds_every;
+	uint32_t batch;		/**< messages per flush */
+	uint32_t ring_size;	/**< 0 to use only the socket */
+	uint64_t messages;
+	uint64_t bytes;
+	uint64_t nsec;		/**< total time */
+	uint64_t write_nsec;	/**< time spent building messages */
+	uint64_t flush_nsec;	/**< time spent in flush */
+	uint64_t *latency;	/**< from end of the write to the read of each message */
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* something like the info of a global, a few ints and a dict */
+static void write_global(struct pw_protocol_native_connection *conn, uint32_t id, int fd)
+{
+	struct spa_pod_builder *b;
+	struct spa_pod_frame f;
+
+	b = pw_protocol_native_connection_begin(conn, 0, 2, NULL);
+	spa_pod_builder_push_struct(b, &f);
+	spa_pod_builder_add(b,
+			SPA_POD_Int(id),
+			SPA_POD_Int(0),
+			SPA_POD_String("PipeWire:Interface:Node"),
+			SPA_POD_Int(3),
+			SPA_POD_Int(pw_protocol_native_connection_add_fd(conn, fd)),
+			SPA_POD_Int(6),
+			SPA_POD_String("object.id"), SPA_POD_String("42"),
+			SPA_POD_String("node.name"), SPA_POD_String("alsa_output.pci-0000_00_1f.3.analog-stereo"),
+			SPA_POD_String("node.description"), SPA_POD_String("Built-in Audio Analog Stereo"),
+			SPA_POD_String("media.class"), SPA_POD_String("Audio/Sink"),
+			SPA_POD_String("factory.id"), SPA_POD_String("18"),
+			SPA_POD_String("client.id"), SPA_POD_String("31"),
+			NULL);
+	spa_pod_builder_pop(b, &f);
+	spa_assert(pw_protocol_native_connection_end(conn, b) >= 0);
+}
+
+static void setup_ring(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out, uint32_t size)
+{
+	const struct pw_protocol_native_message *msg;
+
+	pw_protocol_native_connection_accept_ring(in, size);
+	spa_assert(pw_protocol_native_connection_offer_ring(out, size) == 0);
+	spa_assert(pw_protocol_native_connection_flush(out) == 0);
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) == -EAGAIN);
+	spa_assert(pw_protocol_native_connection_flush(in) == 0);
+	spa_assert(pw_protocol_native_connection_get_next(out, &msg) == -EAGAIN);
+}
+
+static void run_test(struct stats *s, struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	const struct pw_protocol_native_message *msg;
+	uint64_t t1, t2, t3, sent[N_MESSAGES];
+	uint32_t i, j, k, n, n_read;
+	int res;
+
+	t1 = get_time_ns();
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		for (j = 0; j < N_MESSAGES; j += s->batch) {
+			n = SPA_MIN(s->batch, N_MESSAGES - j);
+
+			t2 = get_time_ns();
+			for (k = 0; k < n; k++) {
+				write_global(out, j + k, s->fds_every &&
+						((j + k) % s->fds_every) == 0 ? 1 : -1);
+				sent[k] = get_time_ns();
+			}
+			t3 = get_time_ns();
+			s->write_nsec += t3 - t2;
+
+			n_read = 0;
+			while (n_read < n) {
+				t2 = get_time_ns();
+				res = pw_protocol_native_connection_flush(out);
+				t3 = get_time_ns();
+				s->flush_nsec += t3 - t2;
+				spa_assert(res == 0 || res == -EAGAIN);
+
+				while (pw_protocol_native_connection_get_next(in, &msg) == 1) {
+					s->latency[s->messages++] = get_time_ns() - sent[n_read];
+					for (k = 0; k < msg->n_fds; k++)
+						close(msg->fds[k]);
+					s->bytes += msg->size;
+					n_read++;
+				}
+			}
+		}
+	}
+	s->nsec = get_time_ns() - t1;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t*)a, vb = *(const uint64_t*)b;
+	return va < vb ? -1 : va > vb;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct pw_protocol_native_connection *in, *out;
+	struct stats stats[] = {
+		{ "no fds", 0, N_MESSAGES, 0, },
+		{ "fd every 8", 8, N_MESSAGES, 0, },
+		{ "fd every 4", 4, N_MESSAGES, 0, },
+		{ "ring no fds", 0, N_MESSAGES, RING_SIZE, },
+		{ "ring fd every 8", 8, N_MESSAGES, RING_SIZE, },
+		{ "socket batch 1", 0, 1, 0, },
+		{ "ring batch 1", 0, 1, RING_SIZE, },
+		{ "socket batch 32", 0, 32, 0, },
+		{ "ring batch 32", 0, 32, RING_SIZE, },
+	};
+	uint32_t i;
+	int fds[2];
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(loop), NULL, 0);
+
+	for (i = 0; i < SPA_N_ELEMENTS(stats); i++) {
+		struct stats *s = &stats[i];
+
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			spa_assert_not_reached();
+			return -1;
+		}
+		in = pw_protocol_native_connection_new(context, fds[0]);
+		spa_assert(in != NULL);
+		out = pw_protocol_native_connection_new(context, fds[1]);
+		spa_assert(out != NULL);
+
+		if (s->ring_size > 0)
+			setup_ring(in, out, s->ring_size);
+
+		s->latency = calloc(N_MESSAGES * N_ROUNDS, sizeof(uint64_t));
+		spa_assert(s->latency != NULL);
+
+		run_test(s, in, out);
+
+		qsort(s->latency, s->messages, sizeof(uint64_t), compare_u64);
+
+		fprintf(stderr, "%-18s %4d per flush: %8.0f messages/s %8.1f MB/s "
+				"write %6.1f ns flush %6.1f ns per message, "
+				"latency p50 %8.1f us p99 %8.1f us\n",
+				s->name, s->batch,
+				s->messages * (double)SPA_NSEC_PER_SEC / s->nsec,
+				s->bytes * (double)SPA_NSEC_PER_SEC / s->nsec / (1024 * 1024),
+				(double)s->write_nsec / s->messages,
+				(double)s->flush_nsec / s->messages,
+				s->latency[s->messages / 2] / 1000.0,
+				s->latency[s->messages * 99 / 100] / 1000.0);
+
+		free(s->latency);
+
+		pw_protocol_native_connection_destroy(in);
+		pw_protocol_native_connection_destroy(out);
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	pw_context_destroy(context);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
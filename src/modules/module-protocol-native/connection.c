@@ -30,9 +30,12 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
 #include <spa/utils/result.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
 
 #include <pipewire/pipewire.h>
 
@@ -43,11 +46,26 @@
 
 #define MAX_BUFFER_SIZE (1024 * 32)
 #define MAX_FDS 1024
-#define MAX_FDS_MSG 28
+#define MAX_FDS_MSG 28u
+#define MAX_IOV 64
 
 #define HDR_SIZE_V0	8
 #define HDR_SIZE	16
 
+/* messages to this id are handled by the connection itself */
+#define CONTROL_ID		SPA_ID_INVALID
+#define CONTROL_RING_OFFER	1	/* Int size, Fd ring */
+#define CONTROL_RING_ACK	2
+#define CONTROL_DOORBELL	3	/* seq is the ring write index */
+#define CONTROL_RING_NACK	4	/* Int size, the offer was refused */
+
+/* ring memory: the two ringbuffer headers on the first page, followed
+ * by the client to server and the server to client data areas */
+#define RING_HDR_SIZE	4096
+#define RING_HDR_OFFSET	64
+#define RING_MIN_SIZE	(1u << 12)
+#define RING_MAX_SIZE	(1u << 24)
+
 static bool debug_messages = 0;
 
 struct buffer {
@@ -63,6 +81,31 @@ struct buffer {
 	struct pw_protocol_native_message msg;
 };
 
+/* A chunk of the output stream. Messages are built in place after the
+ * last complete message in the last segment and are never split over
+ * segments, a message that does not fit is moved to a new segment. */
+struct segment {
+	struct spa_list link;
+	size_t size;		/**< bytes of complete messages */
+	size_t maxsize;
+	size_t offset;		/**< bytes already sent */
+	uint8_t data[];
+};
+
+/* The fds of a message need to be sent before or with the bytes of the
+ * message, we keep track of the messages with fds to know how many bytes
+ * can be sent along with the next batch of fds. */
+struct fd_mark {
+	uint64_t pos;		/**< position of the message in the output */
+	uint32_t fds_end;	/**< number of queued fds up to and including the message */
+};
+
+struct ring {
+	struct spa_ringbuffer *rb;
+	uint8_t *data;
+	uint32_t index;		/**< our read or write index */
+};
+
 struct reenter_item {
 	void *old_buffer_data;
 	struct pw_protocol_native_message return_msg;
@@ -76,6 +119,22 @@ struct impl {
 	struct buffer in, out;
 	struct spa_pod_builder builder;
 
+	struct spa_list segments;
+	struct segment *spare;
+	uint64_t out_pos;
+	uint64_t out_sent;
+	struct pw_array marks;
+
+	struct pw_mempool *ring_pool;
+	struct pw_memblock *ring_block;
+	struct pw_memmap *ring_map;
+	uint32_t ring_size;
+	uint32_t ring_max;		/**< max ring size to accept, 0 refuses */
+	struct ring ring_in;
+	struct ring ring_out;
+	uint32_t ring_announced;	/**< write index covered by a doorbell */
+	unsigned int ring_offered:1;
+
 	struct spa_list reenter_stack;
 	uint32_t pending_reentering;
 
@@ -164,6 +223,59 @@ static void *connection_ensure_size(struct pw_protocol_native_connection *conn,
 	return (uint8_t *) buf->buffer_data + buf->buffer_size;
 }
 
+static struct segment *segment_new(struct pw_protocol_native_connection *conn, size_t size)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct segment *seg;
+	int res;
+
+	size = SPA_ROUND_UP_N(size, MAX_BUFFER_SIZE);
+
+	if ((seg = impl->spare) != NULL && seg->maxsize >= size) {
+		impl->spare = NULL;
+	} else if ((seg = malloc(sizeof(struct segment) + size)) != NULL) {
+		seg->maxsize = size;
+	} else {
+		res = -errno;
+		spa_hook_list_call(&conn->listener_list,
+				struct pw_protocol_native_connection_events,
+				error, 0, -res);
+		errno = -res;
+		return NULL;
+	}
+	seg->size = 0;
+	seg->offset = 0;
+	return seg;
+}
+
+static void segment_free(struct impl *impl, struct segment *seg)
+{
+	if (impl->spare == NULL) {
+		impl->spare = seg;
+	} else if (impl->spare->maxsize < seg->maxsize) {
+		free(impl->spare);
+		impl->spare = seg;
+	} else {
+		free(seg);
+	}
+}
+
+static void clear_segments(struct impl *impl)
+{
+	struct segment *seg, *t;
+
+	spa_list_for_each_safe(seg, t, &impl->segments, link) {
+		if (seg->link.next == &impl->segments) {
+			seg->size = seg->offset = 0;
+			break;
+		}
+		spa_list_remove(&seg->link);
+		segment_free(impl, seg);
+	}
+	pw_array_reset(&impl->marks);
+	impl->out_pos = impl->out_sent = 0;
+}
+
 static int refill_buffer(struct pw_protocol_native_connection *conn, struct buffer *buf)
 {
 	ssize_t len;
@@ -358,6 +470,7 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 	struct impl *impl;
 	struct pw_protocol_native_connection *this;
 	struct reenter_item *reenter_item;
+	struct segment *seg;
 
 	impl = calloc(1, sizeof(struct impl));
 	if (impl == NULL)
@@ -376,23 +489,27 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 	impl->hdr_size = HDR_SIZE;
 	impl->version = 3;
 
-	impl->out.buffer_data = calloc(1, MAX_BUFFER_SIZE);
-	impl->out.buffer_maxsize = MAX_BUFFER_SIZE;
+	spa_list_init(&impl->segments);
+	pw_array_init(&impl->marks, 16 * sizeof(struct fd_mark));
+
+	seg = segment_new(this, MAX_BUFFER_SIZE);
 	impl->in.buffer_data = calloc(1, MAX_BUFFER_SIZE);
 	impl->in.buffer_maxsize = MAX_BUFFER_SIZE;
 
 	reenter_item = calloc(1, sizeof(struct reenter_item));
 
-	if (impl->out.buffer_data == NULL || impl->in.buffer_data == NULL || reenter_item == NULL)
+	if (seg == NULL || impl->in.buffer_data == NULL || reenter_item == NULL)
 		goto no_mem;
 
+	spa_list_append(&impl->segments, &seg->link);
+
 	spa_list_init(&impl->reenter_stack);
 	spa_list_append(&impl->reenter_stack, &reenter_item->link);
 
 	return this;
 
 no_mem:
-	free(impl->out.buffer_data);
+	free(seg);
 	free(impl->in.buffer_data);
 	free(reenter_item);
 	free(impl);
@@ -415,6 +532,7 @@ int pw_protocol_native_connection_set_fd(struct pw_protocol_native_connection *c
 void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct segment *seg;
 
 	pw_log_debug("connection %p: destroy", conn);
 
@@ -424,8 +542,16 @@ void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection
 
 	clear_buffer(&impl->out, true);
 	clear_buffer(&impl->in, true);
-	free(impl->out.buffer_data);
+	clear_segments(impl);
+	spa_list_consume(seg, &impl->segments, link) {
+		spa_list_remove(&seg->link);
+		free(seg);
+	}
+	free(impl->spare);
+	pw_array_clear(&impl->marks);
 	free(impl->in.buffer_data);
+	if (impl->ring_pool)
+		pw_mempool_destroy(impl->ring_pool);
 
 	while (!spa_list_is_empty(&impl->reenter_stack))
 		pop_reenter_stack(impl, 1);
@@ -492,6 +618,240 @@ static int prepare_packet(struct pw_protocol_native_connection *conn, struct buf
 	return 0;
 }
 
+static void ring_init(struct impl *impl, uint32_t size, bool offer)
+{
+	uint8_t *p = impl->ring_map->ptr;
+	struct ring *to_server, *to_client;
+
+	impl->ring_size = size;
+	to_server = offer ? &impl->ring_out : &impl->ring_in;
+	to_client = offer ? &impl->ring_in : &impl->ring_out;
+
+	to_server->rb = SPA_MEMBER(p, 0, struct spa_ringbuffer);
+	to_server->data = SPA_MEMBER(p, RING_HDR_SIZE, uint8_t);
+	to_client->rb = SPA_MEMBER(p, RING_HDR_OFFSET, struct spa_ringbuffer);
+	to_client->data = SPA_MEMBER(p, RING_HDR_SIZE + size, uint8_t);
+
+	if (offer) {
+		spa_ringbuffer_init(to_server->rb);
+		spa_ringbuffer_init(to_client->rb);
+	}
+	/* the ring we write to is only enabled when the peer accepted it */
+	impl->ring_out.rb = NULL;
+	impl->ring_in.index = impl->ring_out.index = impl->ring_announced = 0;
+}
+
+static void ring_release(struct impl *impl)
+{
+	if (impl->ring_pool)
+		pw_mempool_destroy(impl->ring_pool);
+	impl->ring_pool = NULL;
+	impl->ring_block = NULL;
+	impl->ring_map = NULL;
+	impl->ring_size = 0;
+	impl->ring_in.rb = NULL;
+	impl->ring_out.rb = NULL;
+	impl->ring_in.index = impl->ring_out.index = impl->ring_announced = 0;
+	impl->ring_offered = false;
+}
+
+static int ring_accept(struct impl *impl, const struct pw_protocol_native_message *msg)
+{
+	struct pw_protocol_native_connection *conn = &impl->this;
+	struct spa_pod_parser prs;
+	struct spa_pod_builder *b;
+	struct stat st;
+	uint32_t i, size;
+	int64_t index;
+	int fd, res, seals;
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+	if (spa_pod_parser_get_struct(&prs,
+				SPA_POD_Int(&size),
+				SPA_POD_Fd(&index)) < 0 ||
+	    index < 0 || index >= msg->n_fds)
+		return -EPROTO;
+
+	fd = msg->fds[index];
+	for (i = 0; i < msg->n_fds; i++)
+		if (i != index)
+			close(msg->fds[i]);
+
+	if (impl->ring_block != NULL || impl->ring_max == 0 || impl->version < 3) {
+		pw_log_info("connection %p: refusing ring", conn);
+		res = -ENOTSUP;
+		goto error_close;
+	}
+	if (size < RING_MIN_SIZE || size > impl->ring_max || (size & (size - 1))) {
+		pw_log_warn("connection %p: invalid ring size %u", conn, size);
+		res = -EINVAL;
+		goto error_close;
+	}
+	/* the peer can't be allowed to shrink the memory under us */
+	if (fstat(fd, &st) < 0 || st.st_size < RING_HDR_SIZE + 2 * (off_t)size) {
+		pw_log_warn("connection %p: ring memory too small", conn);
+		res = -EINVAL;
+		goto error_close;
+	}
+#ifdef F_GET_SEALS
+	seals = fcntl(fd, F_GET_SEALS);
+#else
+	seals = -1;
+#endif
+	if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+		pw_log_warn("connection %p: ring memory is not sealed", conn);
+		res = -EINVAL;
+		goto error_close;
+	}
+
+	if ((impl->ring_pool = pw_mempool_new(NULL)) == NULL) {
+		res = -errno;
+		goto error_close;
+	}
+	impl->ring_block = pw_mempool_import(impl->ring_pool,
+			PW_MEMBLOCK_FLAG_READWRITE, SPA_DATA_MemFd, fd);
+	if (impl->ring_block == NULL) {
+		res = -errno;
+		pw_mempool_destroy(impl->ring_pool);
+		impl->ring_pool = NULL;
+		goto error_close;
+	}
+	impl->ring_block->size = RING_HDR_SIZE + 2 * size;
+	impl->ring_map = pw_memblock_map(impl->ring_block, PW_MEMMAP_FLAG_READWRITE,
+			0, impl->ring_block->size, NULL);
+	if (impl->ring_map == NULL) {
+		res = -errno;
+		goto error_pool;
+	}
+	ring_init(impl, size, false);
+
+	b = pw_protocol_native_connection_begin(conn, CONTROL_ID, CONTROL_RING_ACK, NULL);
+	spa_pod_builder_add_struct(b, SPA_POD_Int(size));
+	if ((res = pw_protocol_native_connection_end(conn, b)) < 0)
+		goto error_pool;
+
+	/* everything after the ack can go over the ring */
+	impl->ring_out.rb = SPA_MEMBER(impl->ring_map->ptr, RING_HDR_OFFSET,
+			struct spa_ringbuffer);
+
+	pw_log_debug("connection %p: accepted ring of %u bytes", conn, size);
+	return 0;
+
+error_pool:
+	ring_release(impl);
+	return res;
+error_close:
+	close(fd);
+	return res;
+}
+
+/* tell the peer that its ring is not used so that it can release it */
+static int ring_refuse(struct impl *impl, const struct pw_protocol_native_message *msg)
+{
+	struct pw_protocol_native_connection *conn = &impl->this;
+	struct spa_pod_parser prs;
+	struct spa_pod_builder *b;
+	uint32_t size = 0;
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+	spa_pod_parser_get_struct(&prs, SPA_POD_Int(&size));
+
+	b = pw_protocol_native_connection_begin(conn, CONTROL_ID, CONTROL_RING_NACK, NULL);
+	spa_pod_builder_add_struct(b, SPA_POD_Int(size));
+	return pw_protocol_native_connection_end(conn, b);
+}
+
+/* insert the ring data announced by a doorbell in the input, in place
+ * of the doorbell, so that it is read in order with the socket data */
+static int ring_read(struct impl *impl, struct buffer *buf, uint32_t index)
+{
+	struct ring *r = &impl->ring_in;
+	uint32_t len;
+	size_t rest;
+	uint8_t *data;
+
+	if (r->rb == NULL)
+		return -EPROTO;
+
+	len = index - r->index;
+	if (len > impl->ring_size)
+		return -EPROTO;
+	if (len == 0)
+		return 0;
+
+	rest = buf->buffer_size - buf->offset;
+	if (connection_ensure_size(&impl->this, buf, len) == NULL)
+		return -errno;
+
+	data = buf->buffer_data + buf->offset;
+	memmove(data + len, data, rest);
+	spa_ringbuffer_read_data(r->rb, r->data, impl->ring_size,
+			r->index & (impl->ring_size - 1), data, len);
+	buf->buffer_size += len;
+
+	r->index = index;
+	spa_ringbuffer_read_update(r->rb, index);
+
+	pw_log_trace("connection %p: read %u bytes from ring", impl, len);
+	return 0;
+}
+
+/* the doorbells that are still in the input announce ring data that is
+ * dropped along with them, move the read index past that data so that the
+ * next doorbell does not insert it */
+static void ring_drop_input(struct impl *impl, struct buffer *buf)
+{
+	struct ring *r = &impl->ring_in;
+	size_t offset = buf->offset;
+	uint32_t *p;
+
+	if (r->rb == NULL || impl->version < 3)
+		return;
+
+	while (offset + impl->hdr_size <= buf->buffer_size) {
+		p = SPA_MEMBER(buf->buffer_data, offset, uint32_t);
+		if (p[0] == CONTROL_ID && (p[1] >> 24) == CONTROL_DOORBELL)
+			r->index = p[2];
+		offset += impl->hdr_size + (p[1] & 0xffffff);
+	}
+	spa_ringbuffer_read_update(r->rb, r->index);
+}
+
+static int handle_control(struct impl *impl, struct buffer *buf)
+{
+	const struct pw_protocol_native_message *msg = &buf->msg;
+	int res;
+
+	switch (msg->opcode) {
+	case CONTROL_DOORBELL:
+		return ring_read(impl, buf, msg->seq);
+	case CONTROL_RING_OFFER:
+		if ((res = ring_accept(impl, msg)) == -EPROTO)
+			return res;
+		if (res < 0 && (res = ring_refuse(impl, msg)) < 0)
+			return res;
+		break;
+	case CONTROL_RING_ACK:
+		if (!impl->ring_offered || impl->ring_map == NULL)
+			return -EPROTO;
+		impl->ring_out.rb = SPA_MEMBER(impl->ring_map->ptr, 0, struct spa_ringbuffer);
+		pw_log_debug("connection %p: ring of %u bytes accepted", impl, impl->ring_size);
+		break;
+	case CONTROL_RING_NACK:
+		if (!impl->ring_offered || impl->ring_out.rb != NULL)
+			return -EPROTO;
+		pw_log_info("connection %p: ring of %u bytes refused, using the socket",
+				impl, impl->ring_size);
+		ring_release(impl);
+		break;
+	default:
+		pw_log_warn("connection %p: unknown control message %u",
+				impl, msg->opcode);
+		break;
+	}
+	return 0;
+}
+
 /** Move to the next packet in the connection
  *
  * \param conn the connection
@@ -525,8 +885,13 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 		len = prepare_packet(conn, buf);
 		if (len < 0)
 			return len;
-		if (len == 0)
-			break;
+		if (len == 0) {
+			if (SPA_LIKELY(buf->msg.id != CONTROL_ID || impl->version < 3))
+				break;
+			if ((res = handle_control(impl, buf)) < 0)
+				return res;
+			continue;
+		}
 
 		if (connection_ensure_size(conn, buf, len) == NULL)
 			return -errno;
@@ -547,16 +912,72 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 	return 1;
 }
 
+/* make room for need bytes after the last complete message, keep bytes
+ * of the message being built are moved along */
+static struct segment *reserve(struct pw_protocol_native_connection *conn,
+		size_t need, size_t keep)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct segment *seg, *s;
+
+	seg = spa_list_last(&impl->segments, struct segment, link);
+	if (seg->size + need > seg->maxsize) {
+		/* move the part of the message that is already
+		 * built to a new segment */
+		if ((s = segment_new(conn, need)) == NULL)
+			return NULL;
+		memcpy(s->data, seg->data + seg->size, keep);
+		spa_list_append(&impl->segments, &s->link);
+		if (seg->size == 0) {
+			spa_list_remove(&seg->link);
+			segment_free(impl, seg);
+		}
+		pw_log_debug("connection %p: new segment of %zd for %zd",
+				conn, s->maxsize, need);
+		seg = s;
+	}
+	return seg;
+}
+
 static inline void *begin_write(struct pw_protocol_native_connection *conn, uint32_t size)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	uint32_t *p;
-	struct buffer *buf = &impl->out;
+	struct segment *seg;
+
 	/* header and size for payload */
-	if ((p = connection_ensure_size(conn, buf, impl->hdr_size + size)) == NULL)
+	seg = reserve(conn, impl->hdr_size + size,
+			impl->hdr_size + impl->builder.state.offset);
+	if (seg == NULL)
 		return NULL;
+	return SPA_MEMBER(seg->data, seg->size + impl->hdr_size, void);
+}
 
-	return SPA_MEMBER(p, impl->hdr_size, void);
+static inline void write_doorbell(struct impl *impl, uint32_t *p)
+{
+	p[0] = CONTROL_ID;
+	p[1] = CONTROL_DOORBELL << 24;
+	p[2] = impl->ring_out.index;
+	p[3] = 0;
+	impl->ring_announced = impl->ring_out.index;
+}
+
+static bool ring_write(struct impl *impl, const void *data, uint32_t size)
+{
+	struct ring *r = &impl->ring_out;
+	int32_t filled;
+
+	/* only trust our own write index, a bad read index means
+	 * the ring is not usable */
+	filled = r->index - __atomic_load_n(&r->rb->readindex, __ATOMIC_ACQUIRE);
+	if (filled < 0 || (uint32_t)filled > impl->ring_size ||
+	    size > impl->ring_size - filled)
+		return false;
+
+	spa_ringbuffer_write_data(r->rb, r->data, impl->ring_size,
+			r->index & (impl->ring_size - 1), data, size);
+	r->index += size;
+	spa_ringbuffer_write_update(r->rb, r->index);
+	return true;
 }
 
 static int builder_overflow(void *data, uint32_t size)
@@ -606,13 +1027,18 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 				  struct spa_pod_builder *builder)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	uint32_t *p, size = builder->state.offset;
+	uint32_t *p, size = builder->state.offset, n_fds;
 	struct buffer *buf = &impl->out;
+	struct segment *seg;
+	struct fd_mark *m;
 	int res;
 
-	if ((p = connection_ensure_size(conn, buf, impl->hdr_size + size)) == NULL)
+	if (begin_write(conn, size) == NULL)
 		return -errno;
 
+	seg = spa_list_last(&impl->segments, struct segment, link);
+	p = SPA_MEMBER(seg->data, seg->size, uint32_t);
+
 	p[0] = buf->msg.id;
 	p[1] = (buf->msg.opcode << 24) | (size & 0xffffff);
 	if (impl->version >= 3) {
@@ -620,12 +1046,38 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 		p[3] = buf->msg.n_fds;
 	}
 
-	buf->buffer_size += impl->hdr_size + size;
-	if (impl->version >= 3)
-		buf->n_fds += buf->msg.n_fds;
-	else
-		buf->n_fds = buf->msg.n_fds;
+	if (impl->ring_out.rb != NULL) {
+		/* messages without fds go over the ring when there is space,
+		 * the others need a doorbell for the ring data before them */
+		if (buf->msg.n_fds == 0 && ring_write(impl, p, impl->hdr_size + size))
+			goto done;
+
+		if (impl->ring_announced != impl->ring_out.index) {
+			if (begin_write(conn, impl->hdr_size + size) == NULL)
+				return -errno;
+			seg = spa_list_last(&impl->segments, struct segment, link);
+			p = SPA_MEMBER(seg->data, seg->size, uint32_t);
+			memmove(SPA_MEMBER(p, impl->hdr_size, void), p, impl->hdr_size + size);
+			write_doorbell(impl, p);
+			seg->size += impl->hdr_size;
+			impl->out_pos += impl->hdr_size;
+			p = SPA_MEMBER(p, impl->hdr_size, uint32_t);
+		}
+	}
+
+	n_fds = impl->version >= 3 ? buf->n_fds + buf->msg.n_fds : buf->msg.n_fds;
+	if (n_fds > buf->n_fds) {
+		if ((m = pw_array_add(&impl->marks, sizeof(struct fd_mark))) == NULL)
+			return -errno;
+		m->pos = impl->out_pos;
+		m->fds_end = n_fds;
+	}
 
+	seg->size += impl->hdr_size + size;
+	impl->out_pos += impl->hdr_size + size;
+	buf->n_fds = n_fds;
+
+done:
 	if (debug_messages) {
 		pw_log_debug(">>>>>>>>> out: id:%d op:%d size:%d seq:%d",
 				buf->msg.id, buf->msg.opcode, size, buf->msg.seq);
@@ -653,39 +1105,61 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	ssize_t sent, outsize;
+	ssize_t sent;
 	struct msghdr msg = { 0 };
-	struct iovec iov[1];
+	struct iovec iov[MAX_IOV];
 	struct cmsghdr *cmsg;
 	char cmsgbuf[CMSG_SPACE(MAX_FDS_MSG * sizeof(int))];
-	int res = 0, *fds;
-	uint32_t fds_len, to_close, n_fds, outfds, i;
+	int res = 0;
+	uint32_t fds_len, to_close, outfds, n_iov, i;
 	struct buffer *buf;
-	void *data;
-	size_t size;
+	struct segment *seg, *t;
+	struct fd_mark *m;
+	size_t limit, size;
 
 	buf = &impl->out;
-	data = buf->buffer_data;
-	size = buf->buffer_size;
-	fds = buf->fds;
-	n_fds = buf->n_fds;
 	to_close = 0;
 
-	while (size > 0) {
-		if (n_fds > MAX_FDS_MSG) {
-			outfds = MAX_FDS_MSG;
-			outsize = SPA_MIN(sizeof(uint32_t), size);
-		} else {
-			outfds = n_fds;
-			outsize = size;
+	if (impl->ring_announced != impl->ring_out.index) {
+		if ((seg = reserve(conn, impl->hdr_size, 0)) == NULL)
+			return -errno;
+		write_doorbell(impl, SPA_MEMBER(seg->data, seg->size, uint32_t));
+		seg->size += impl->hdr_size;
+		impl->out_pos += impl->hdr_size;
+	}
+
+	while (impl->out_sent < impl->out_pos) {
+		outfds = SPA_MIN(buf->n_fds - to_close, MAX_FDS_MSG);
+
+		/* we can send up to the first message that needs more fds
+		 * than we send now. When that is the next message, send a
+		 * byte of it with the fds. */
+		limit = SIZE_MAX;
+		pw_array_for_each(m, &impl->marks) {
+			if (m->fds_end > to_close + outfds) {
+				limit = m->pos > impl->out_sent ?
+					m->pos - impl->out_sent : 1;
+				break;
+			}
+		}
+
+		size = 0;
+		n_iov = 0;
+		spa_list_for_each(seg, &impl->segments, link) {
+			size_t avail = SPA_MIN(seg->size - seg->offset, limit - size);
+			if (avail == 0)
+				continue;
+			iov[n_iov].iov_base = seg->data + seg->offset;
+			iov[n_iov].iov_len = avail;
+			size += avail;
+			if (++n_iov == MAX_IOV || size == limit)
+				break;
 		}
 
 		fds_len = outfds * sizeof(int);
 
-		iov[0].iov_base = data;
-		iov[0].iov_len = outsize;
 		msg.msg_iov = iov;
-		msg.msg_iovlen = 1;
+		msg.msg_iovlen = n_iov;
 
 		if (outfds > 0) {
 			msg.msg_control = cmsgbuf;
@@ -694,7 +1168,7 @@ int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *co
 			cmsg->cmsg_level = SOL_SOCKET;
 			cmsg->cmsg_type = SCM_RIGHTS;
 			cmsg->cmsg_len = CMSG_LEN(fds_len);
-			memcpy(CMSG_DATA(cmsg), fds, fds_len);
+			memcpy(CMSG_DATA(cmsg), &buf->fds[to_close], fds_len);
 			msg.msg_controllen = cmsg->cmsg_len;
 		} else {
 			msg.msg_control = NULL;
@@ -713,27 +1187,48 @@ int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *co
 			}
 			break;
 		}
-		pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, sent,
-			     outfds);
+		pw_log_trace("connection %p: %d written %zd bytes in %u iovs and %u fds",
+				conn, conn->fd, sent, n_iov, outfds);
 
-		size -= sent;
-		data = SPA_MEMBER(data, sent, void);
-		n_fds -= outfds;
-		fds += outfds;
+		impl->out_sent += sent;
 		to_close += outfds;
+
+		/* release the sent segments, the last one is kept to
+		 * write the next messages in */
+		spa_list_for_each_safe(seg, t, &impl->segments, link) {
+			size_t avail = seg->size - seg->offset;
+			if ((size_t)sent < avail) {
+				seg->offset += sent;
+				break;
+			}
+			sent -= avail;
+			if (seg->link.next == &impl->segments) {
+				seg->size = seg->offset = 0;
+				break;
+			}
+			spa_list_remove(&seg->link);
+			segment_free(impl, seg);
+		}
 	}
 
 	res = 0;
 
 exit:
-	if (size > 0)
-		memmove(buf->buffer_data, data, size);
-	buf->buffer_size = size;
 	for (i = 0; i < to_close; i++)
 		close(buf->fds[i]);
-	if (n_fds > 0)
-		memmove(buf->fds, fds, n_fds * sizeof(int));
-	buf->n_fds = n_fds;
+	if (to_close > 0) {
+		buf->n_fds -= to_close;
+		if (buf->n_fds > 0)
+			memmove(buf->fds, &buf->fds[to_close], buf->n_fds * sizeof(int));
+
+		pw_array_consume(m, &impl->marks) {
+			if (m->fds_end > to_close)
+				break;
+			pw_array_remove(&impl->marks, m);
+		}
+		pw_array_for_each(m, &impl->marks)
+			m->fds_end -= to_close;
+	}
 	return res;
 }
 
@@ -750,8 +1245,87 @@ int pw_protocol_native_connection_clear(struct pw_protocol_native_connection *co
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 
+	ring_drop_input(impl, &impl->in);
+
 	clear_buffer(&impl->out, true);
 	clear_buffer(&impl->in, true);
+	clear_segments(impl);
+
+	/* drop the ring data that was not announced yet */
+	if (impl->ring_out.rb != NULL) {
+		impl->ring_out.index = impl->ring_announced;
+		spa_ringbuffer_write_update(impl->ring_out.rb, impl->ring_out.index);
+	}
+	return 0;
+}
+
+/** Offer a shared memory ring to the peer
+ *
+ * \param conn the connection
+ * \param size the size of the ring in each direction, a power of 2
+ * \return 0 on success, < 0 on error
+ *
+ * Messages without fds are sent over the ring once the peer accepted it,
+ * the socket is then only used for messages with fds and to wake up
+ * the peer. Only offer a ring when the peer is known to accept it.
+ *
+ * \memberof pw_protocol_native_connection
+ */
+int pw_protocol_native_connection_offer_ring(struct pw_protocol_native_connection *conn,
+		uint32_t size)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct spa_pod_builder *b;
+	int res;
+
+	if (impl->ring_pool != NULL)
+		return -EBUSY;
+	if (impl->version < 3)
+		return -ENOTSUP;
+	if (size < RING_MIN_SIZE || size > RING_MAX_SIZE || (size & (size - 1)))
+		return -EINVAL;
 
+	if ((impl->ring_pool = pw_mempool_new(NULL)) == NULL)
+		return -errno;
+
+	impl->ring_block = pw_mempool_alloc(impl->ring_pool,
+			PW_MEMBLOCK_FLAG_READWRITE |
+			PW_MEMBLOCK_FLAG_SEAL |
+			PW_MEMBLOCK_FLAG_MAP,
+			SPA_DATA_MemFd, RING_HDR_SIZE + 2 * (size_t)size);
+	if (impl->ring_block == NULL) {
+		res = -errno;
+		goto error;
+	}
+	impl->ring_map = impl->ring_block->map;
+	ring_init(impl, size, true);
+
+	b = pw_protocol_native_connection_begin(conn, CONTROL_ID, CONTROL_RING_OFFER, NULL);
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(size),
+			SPA_POD_Fd(pw_protocol_native_connection_add_fd(conn, impl->ring_block->fd)));
+	if ((res = pw_protocol_native_connection_end(conn, b)) < 0)
+		goto error;
+
+	impl->ring_offered = true;
+	pw_log_debug("connection %p: offered ring of %u bytes", conn, size);
 	return 0;
+
+error:
+	ring_release(impl);
+	return res;
+}
+
+/** Accept shared memory rings from the peer
+ *
+ * \param conn the connection
+ * \param max_size the largest ring to accept, 0 to refuse rings
+ *
+ * \memberof pw_protocol_native_connection
+ */
+void pw_protocol_native_connection_accept_ring(struct pw_protocol_native_connection *conn,
+		uint32_t max_size)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	impl->ring_max = SPA_MIN(max_size, RING_MAX_SIZE);
 }
@@ -99,6 +99,11 @@ pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn);
 int
 pw_protocol_native_connection_clear(struct pw_protocol_native_connection *conn);
 
+int pw_protocol_native_connection_offer_ring(struct pw_protocol_native_connection *conn,
+		uint32_t size);
+void pw_protocol_native_connection_accept_ring(struct pw_protocol_native_connection *conn,
+		uint32_t max_size);
+
 void pw_protocol_native_connection_enter(struct pw_protocol_native_connection *conn);
 void pw_protocol_native_connection_leave(struct pw_protocol_native_connection *conn);
 
@@ -23,6 +23,7 @@
  */
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 
 #include <spa/pod/builder.h>
 #include <spa/pod/parser.h>
@@ -181,6 +182,232 @@ static void test_reentering(struct pw_protocol_native_connection *in,
 	}
 }
 
+static void write_large_message(struct pw_protocol_native_connection *conn,
+		const void *data, uint32_t size)
+{
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(conn, 1, 6, NULL);
+	spa_assert(b != NULL);
+	spa_pod_builder_add_struct(b, SPA_POD_Bytes(data, size));
+	spa_assert(pw_protocol_native_connection_end(conn, b) >= 0);
+}
+
+static void test_segments(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	static uint8_t data[100000];
+	const struct pw_protocol_native_message *msg;
+	struct spa_pod_parser prs;
+	const void *bytes;
+	uint32_t i, len, n_small = 0, n_large = 0;
+	int res;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+
+	/* more fds than fit in one sendmsg and a message that does not
+	 * fit in a segment */
+	for (i = 0; i < 100; i++)
+		write_message(out, 1 + (i & 1));
+	write_large_message(out, data, sizeof(data));
+	for (i = 0; i < 100; i++)
+		write_message(out, 1 + (i & 1));
+
+	while (n_small + n_large < 201) {
+		res = pw_protocol_native_connection_flush(out);
+		spa_assert(res == 0 || res == -EAGAIN);
+
+		while ((res = pw_protocol_native_connection_get_next(in, &msg)) == 1) {
+			if (msg->opcode == 5) {
+				spa_assert(msg->n_fds == 1);
+				spa_assert(pw_protocol_native_connection_get_fd(in, 0) >= 0);
+				n_small++;
+			} else {
+				spa_assert(msg->opcode == 6);
+				spa_assert(n_small == 100);
+				spa_pod_parser_init(&prs, msg->data, msg->size);
+				if (spa_pod_parser_get_struct(&prs,
+						SPA_POD_Bytes(&bytes, &len)) < 0)
+					spa_assert_not_reached();
+				spa_assert(len == sizeof(data));
+				spa_assert(memcmp(bytes, data, len) == 0);
+				n_large++;
+			}
+		}
+		spa_assert(res == -EAGAIN);
+	}
+	spa_assert(n_small == 200);
+	spa_assert(n_large == 1);
+}
+
+static void write_numbered(struct pw_protocol_native_connection *conn,
+		uint32_t n, int fd)
+{
+	static uint8_t data[3000];
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(conn, 1, 7, NULL);
+	spa_assert(b != NULL);
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(n),
+			SPA_POD_Bytes(data, (n * 37) % sizeof(data)),
+			SPA_POD_Int(pw_protocol_native_connection_add_fd(conn, fd)));
+	spa_assert(pw_protocol_native_connection_end(conn, b) >= 0);
+}
+
+static void read_numbered(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out, uint32_t count)
+{
+	const struct pw_protocol_native_message *msg;
+	struct spa_pod_parser prs;
+	const void *bytes;
+	uint32_t n, len, expected = 0;
+	int res, fdidx;
+
+	while (expected < count) {
+		res = pw_protocol_native_connection_flush(out);
+		spa_assert(res == 0 || res == -EAGAIN);
+
+		while ((res = pw_protocol_native_connection_get_next(in, &msg)) == 1) {
+			spa_assert(msg->opcode == 7);
+			spa_pod_parser_init(&prs, msg->data, msg->size);
+			if (spa_pod_parser_get_struct(&prs,
+					SPA_POD_Int(&n),
+					SPA_POD_Bytes(&bytes, &len),
+					SPA_POD_Int(&fdidx)) < 0)
+				spa_assert_not_reached();
+			spa_assert(n == expected);
+			spa_assert(len == (n * 37) % 3000);
+			if (fdidx >= 0) {
+				spa_assert(msg->n_fds == 1);
+				spa_assert(pw_protocol_native_connection_get_fd(in, fdidx) >= 0);
+			} else {
+				spa_assert(msg->n_fds == 0);
+			}
+			expected++;
+		}
+		spa_assert(res == -EAGAIN);
+	}
+}
+
+static void test_ring(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	const struct pw_protocol_native_message *msg;
+	uint32_t i;
+	int avail;
+
+	pw_protocol_native_connection_accept_ring(in, 1 << 16);
+	spa_assert(pw_protocol_native_connection_offer_ring(out, 1000) == -EINVAL);
+	spa_assert(pw_protocol_native_connection_offer_ring(out, 1 << 14) == 0);
+	spa_assert(pw_protocol_native_connection_offer_ring(out, 1 << 14) == -EBUSY);
+
+	/* before the ring is accepted everything goes over the socket */
+	for (i = 0; i < 10; i++)
+		write_numbered(out, i, i == 5 ? 1 : -1);
+	read_numbered(in, out, 10);
+
+	/* read the ack, the server can use the ring from now on */
+	spa_assert(pw_protocol_native_connection_flush(in) == 0);
+	spa_assert(pw_protocol_native_connection_get_next(out, &msg) == -EAGAIN);
+
+	/* messages without fds only need a doorbell on the socket */
+	for (i = 0; i < 10; i++)
+		write_numbered(out, i, -1);
+	spa_assert(pw_protocol_native_connection_flush(out) == 0);
+	spa_assert(ioctl(in->fd, FIONREAD, &avail) == 0);
+	spa_assert(avail == 16);
+	read_numbered(in, out, 10);
+
+	/* mixed with fds and more than fits in the ring */
+	for (i = 0; i < 300; i++)
+		write_numbered(out, i, (i % 7) == 0 ? 2 : -1);
+	read_numbered(in, out, 300);
+
+	for (i = 0; i < 300; i++)
+		write_numbered(in, i, (i % 5) == 0 ? 2 : -1);
+	read_numbered(out, in, 300);
+
+	/* messages that were not announced are dropped on clear */
+	write_numbered(out, 1, -1);
+	spa_assert(pw_protocol_native_connection_clear(out) == 0);
+	write_numbered(out, 0, -1);
+	read_numbered(in, out, 1);
+}
+
+static void test_ring_refused(struct pw_context *context)
+{
+	struct pw_protocol_native_connection *in, *out;
+	const struct pw_protocol_native_message *msg;
+	uint32_t i;
+	int fds[2], avail;
+
+	spa_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	in = pw_protocol_native_connection_new(context, fds[0]);
+	spa_assert(in != NULL);
+	out = pw_protocol_native_connection_new(context, fds[1]);
+	spa_assert(out != NULL);
+
+	/* the default is to refuse rings */
+	spa_assert(pw_protocol_native_connection_offer_ring(out, 1 << 14) == 0);
+	write_numbered(out, 0, -1);
+	read_numbered(in, out, 1);
+
+	/* the refusal releases the ring, a new offer is possible */
+	spa_assert(pw_protocol_native_connection_flush(in) == 0);
+	spa_assert(pw_protocol_native_connection_get_next(out, &msg) == -EAGAIN);
+	spa_assert(pw_protocol_native_connection_offer_ring(out, 1 << 14) == 0);
+
+	/* and everything keeps going over the socket */
+	for (i = 0; i < 10; i++)
+		write_numbered(out, i, -1);
+	spa_assert(pw_protocol_native_connection_flush(out) == 0);
+	spa_assert(ioctl(in->fd, FIONREAD, &avail) == 0);
+	spa_assert(avail > 16 * 10);
+	read_numbered(in, out, 10);
+
+	pw_protocol_native_connection_destroy(in);
+	pw_protocol_native_connection_destroy(out);
+}
+
+static void test_ring_clear(struct pw_context *context)
+{
+	struct pw_protocol_native_connection *in, *out;
+	const struct pw_protocol_native_message *msg;
+	uint32_t i;
+	int fds[2];
+
+	spa_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	in = pw_protocol_native_connection_new(context, fds[0]);
+	spa_assert(in != NULL);
+	out = pw_protocol_native_connection_new(context, fds[1]);
+	spa_assert(out != NULL);
+
+	pw_protocol_native_connection_accept_ring(in, 1 << 16);
+	spa_assert(pw_protocol_native_connection_offer_ring(out, 1 << 14) == 0);
+	write_numbered(out, 0, -1);
+	read_numbered(in, out, 1);
+	spa_assert(pw_protocol_native_connection_flush(in) == 0);
+	spa_assert(pw_protocol_native_connection_get_next(out, &msg) == -EAGAIN);
+
+	/* ring data announced by doorbells that were not read yet is
+	 * dropped on clear, the next doorbell only brings new data */
+	write_numbered(out, 1, 2);
+	for (i = 0; i < 10; i++)
+		write_numbered(out, i + 2, -1);
+	spa_assert(pw_protocol_native_connection_flush(out) == 0);
+	spa_assert(pw_protocol_native_connection_get_next(in, &msg) == 1);
+	spa_assert(msg->n_fds == 1);
+	spa_assert(pw_protocol_native_connection_clear(in) == 0);
+
+	write_numbered(out, 0, -1);
+	read_numbered(in, out, 1);
+
+	pw_protocol_native_connection_destroy(in);
+	pw_protocol_native_connection_destroy(out);
+}
+
 int main(int argc, char *argv[])
 {
 	struct pw_main_loop *loop;
@@ -207,6 +434,10 @@ int main(int argc, char *argv[])
 	test_create(out);
 	test_read_write(in, out);
 	test_reentering(in, out);
+	test_segments(in, out);
+	test_ring(in, out);
+	test_ring_refused(context);
+	test_ring_clear(context);
 
 	pw_protocol_native_connection_destroy(in);
 	pw_protocol_native_connection_destroy(out);
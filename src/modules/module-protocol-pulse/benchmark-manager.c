@@ -0,0 +1,262 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "pulse-server.c"
+
+#include <pipewire/impl.h>
+
+#define SOCKET_NAME	"benchmark-pulse-manager"
+#define CORE_NAME	"benchmark-pulse-manager-0"
+#define N_CARDS		2500	/* every card has one sink, 5000 objects */
+#define N_LISTS		20
+#define N_LOOKUPS	20000
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct sockaddr_un addr;
+	int fd;
+	uint32_t tag;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void request_send(struct data *d, struct message *m)
+{
+	struct descriptor desc;
+	ssize_t res;
+
+	spa_zero(desc);
+	desc.length = htonl(m->length);
+	desc.channel = htonl(-1);
+	res = send(d->fd, &desc, sizeof(desc), MSG_NOSIGNAL);
+	spa_assert(res == sizeof(desc));
+	res = send(d->fd, m->data, m->length, MSG_NOSIGNAL);
+	spa_assert(res == (ssize_t)m->length);
+	free(m->data);
+	free(m);
+}
+
+static struct message *request_new(struct data *d, uint32_t command)
+{
+	static struct stats stat;
+	struct message *m = calloc(1, sizeof(struct message));
+
+	m->stat = &stat;
+	message_put(m,
+		TAG_U32, command,
+		TAG_U32, ++d->tag,
+		TAG_INVALID);
+	return m;
+}
+
+/* read replies until the one for the last command, returns its size */
+static uint32_t request_wait(struct data *d)
+{
+	struct descriptor desc;
+	uint8_t *data;
+	uint32_t t, len;
+
+	while (true) {
+		spa_assert(recv(d->fd, &desc, sizeof(desc), MSG_WAITALL) == sizeof(desc));
+		len = ntohl(desc.length);
+		data = malloc(len);
+		spa_assert(data != NULL);
+		spa_assert(recv(d->fd, data, len, MSG_WAITALL) == (ssize_t)len);
+		/* command and tag as tagged u32 */
+		memcpy(&t, &data[6], 4);
+		free(data);
+		if (ntohl(t) == d->tag)
+			return len;
+	}
+}
+
+static void report(const char *name, uint32_t n, uint64_t nsec)
+{
+	fprintf(stderr, "%-20s %6u in %7.3fs: %9.1f usec/op\n",
+			name, n, nsec / (double)SPA_NSEC_PER_SEC,
+			nsec / 1000.0 / n);
+}
+
+static void run_lists(struct data *d, const char *name, uint32_t command)
+{
+	uint64_t start = get_time_ns();
+	uint32_t i;
+
+	for (i = 0; i < N_LISTS; i++) {
+		request_send(d, request_new(d, command));
+		request_wait(d);
+	}
+	report(name, N_LISTS, get_time_ns() - start);
+}
+
+static void run_lookups(struct data *d, const char *name, uint32_t command,
+		const char *format)
+{
+	uint64_t start = get_time_ns();
+	struct message *m;
+	char value[64];
+	uint32_t i;
+
+	for (i = 0; i < N_LOOKUPS; i++) {
+		snprintf(value, sizeof(value), format, (i * 7919) % N_CARDS);
+		m = request_new(d, command);
+		message_put(m,
+			TAG_U32, SPA_ID_INVALID,
+			TAG_STRING, value,
+			TAG_INVALID);
+		request_send(d, m);
+		request_wait(d);
+	}
+	report(name, N_LOOKUPS, get_time_ns() - start);
+}
+
+/* connects like a libpulse client and times the introspection requests
+ * of a volume control. The sinks have no formats so the sink info is
+ * not sent, only the lookups of the objects are done. */
+static void *client_thread(void *user_data)
+{
+	struct data *d = user_data;
+	uint8_t cookie[NATIVE_COOKIE_LENGTH] = { 0 };
+	struct pw_properties *props;
+	struct message *m;
+
+	d->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	spa_assert(d->fd >= 0);
+	spa_assert(connect(d->fd, (struct sockaddr*)&d->addr, sizeof(d->addr)) == 0);
+
+	m = request_new(d, COMMAND_AUTH);
+	message_put(m,
+		TAG_U32, PROTOCOL_VERSION,
+		TAG_ARBITRARY, cookie, sizeof(cookie),
+		TAG_INVALID);
+	request_send(d, m);
+	request_wait(d);
+
+	/* replies when the manager has all objects */
+	props = pw_properties_new(
+			PW_KEY_APP_NAME, "benchmark-manager",
+			PW_KEY_REMOTE_NAME, "internal",
+			NULL);
+	m = request_new(d, COMMAND_SET_CLIENT_NAME);
+	message_put(m,
+		TAG_PROPLIST, props,
+		TAG_INVALID);
+	request_send(d, m);
+	request_wait(d);
+	pw_properties_free(props);
+
+	run_lists(d, "sink info list", COMMAND_GET_SINK_INFO_LIST);
+	run_lists(d, "card info list", COMMAND_GET_CARD_INFO_LIST);
+	run_lookups(d, "sink info by name", COMMAND_GET_SINK_INFO, "bench-sink.%u");
+	run_lookups(d, "card info by name", COMMAND_GET_CARD_INFO, "bench-card.%u");
+
+	close(d->fd);
+	pw_main_loop_quit(d->loop);
+	return NULL;
+}
+
+static void add_objects(struct data *d)
+{
+	struct pw_properties *props;
+	struct pw_impl_device *device;
+	struct pw_impl_node *node;
+	uint32_t i, card_id;
+
+	for (i = 0; i < N_CARDS; i++) {
+		props = pw_properties_new(
+				PW_KEY_MEDIA_CLASS, "Audio/Device",
+				PW_KEY_DEVICE_API, "benchmark",
+				NULL);
+		pw_properties_setf(props, PW_KEY_DEVICE_NAME, "bench-card.%u", i);
+		device = pw_context_create_device(d->context, props, 0);
+		spa_assert(device != NULL);
+		spa_assert(pw_impl_device_register(device, NULL) >= 0);
+		card_id = pw_global_get_id(pw_impl_device_get_global(device));
+
+		props = pw_properties_new(
+				PW_KEY_MEDIA_CLASS, "Audio/Sink",
+				"card.profile.device", "0",
+				NULL);
+		pw_properties_setf(props, PW_KEY_NODE_NAME, "bench-sink.%u", i);
+		pw_properties_setf(props, PW_KEY_DEVICE_ID, "%u", card_id);
+		node = pw_context_create_node(d->context, props, 0);
+		spa_assert(node != NULL);
+		spa_assert(pw_impl_node_register(node, NULL) >= 0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct data d;
+	struct pw_protocol_pulse *pulse;
+	char runtime_dir[PATH_MAX];
+	pthread_t thread;
+
+	pw_init(&argc, &argv);
+	/* the sinks without formats are not ready, don't warn about them */
+	pw_log_set_level(SPA_LOG_LEVEL_ERROR);
+
+	spa_zero(d);
+	d.loop = pw_main_loop_new(NULL);
+	/* the pulse clients connect to our own core */
+	d.context = pw_context_new(pw_main_loop_get_loop(d.loop),
+			pw_properties_new(
+				PW_KEY_CORE_DAEMON, "true",
+				PW_KEY_CORE_NAME, CORE_NAME,
+				NULL), 0);
+	spa_assert(d.context != NULL);
+
+	add_objects(&d);
+
+	spa_assert(get_runtime_dir(runtime_dir, sizeof(runtime_dir), "pulse") >= 0);
+	d.addr.sun_family = AF_UNIX;
+	spa_assert(snprintf(d.addr.sun_path, sizeof(d.addr.sun_path), "%s/%s",
+				runtime_dir, SOCKET_NAME) < (int)sizeof(d.addr.sun_path));
+	unlink(d.addr.sun_path);
+
+	pulse = pw_protocol_pulse_new(d.context,
+			pw_properties_new("server.address",
+				"[ \"unix:" SOCKET_NAME "\" ]", NULL), 0);
+	spa_assert(pulse != NULL);
+
+	pthread_create(&thread, NULL, client_thread, &d);
+	pw_main_loop_run(d.loop);
+	pthread_join(thread, NULL);
+
+	pw_protocol_pulse_destroy(pulse);
+	pw_context_destroy(d.context);
+	pw_main_loop_destroy(d.loop);
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+static struct {
+	uint64_t recv;
+	uint64_t send;
+} syscalls;
+
+/* count the socket calls made by the server */
+#define recv(...)	(syscalls.recv++, recv(__VA_ARGS__))
+#define recvmsg(...)	(syscalls.recv++, recvmsg(__VA_ARGS__))
+#define send(...)	(syscalls.send++, send(__VA_ARGS__))
+#define sendmsg(...)	(syscalls.send++, sendmsg(__VA_ARGS__))
+
+#include "pulse-server.c"
+
+#define SOCKET_NAME	"benchmark-pulse-server"
+#define BLOCK_SIZE	960	/* 5ms of 48KHz S16 stereo */
+#define LATENCY_EVERY	10	/* blocks between latency queries */
+
+struct session {
+	const char *name;
+	uint32_t n_blocks;
+	uint32_t interval_us;	/**< between blocks, 0 to send them all at once */
+
+	struct pw_main_loop *loop;
+	struct sockaddr_un addr;
+	uint64_t nsec;
+	uint64_t n_frames;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void client_write(int fd, uint32_t channel, const void *data, uint32_t size)
+{
+	struct descriptor desc;
+	ssize_t res;
+	uint8_t buf[sizeof(desc) + BLOCK_SIZE];
+
+	spa_assert(size <= BLOCK_SIZE);
+
+	spa_zero(desc);
+	desc.length = htonl(size);
+	desc.channel = htonl(channel);
+	memcpy(buf, &desc, sizeof(desc));
+	memcpy(buf + sizeof(desc), data, size);
+
+	res = (send)(fd, buf, sizeof(desc) + size, MSG_NOSIGNAL);
+	spa_assert(res == (ssize_t)(sizeof(desc) + size));
+}
+
+static void client_command(int fd, uint32_t command, uint32_t tag)
+{
+	static struct stats stat;
+	struct message *m = calloc(1, sizeof(struct message));
+
+	m->stat = &stat;
+	message_put(m,
+		TAG_U32, command,
+		TAG_U32, tag,
+		TAG_INVALID);
+	if (command == COMMAND_AUTH) {
+		uint8_t cookie[NATIVE_COOKIE_LENGTH] = { 0 };
+		message_put(m,
+			TAG_U32, PROTOCOL_VERSION,
+			TAG_ARBITRARY, cookie, sizeof(cookie),
+			TAG_INVALID);
+	} else if (command == COMMAND_GET_PLAYBACK_LATENCY) {
+		struct timeval tv = { 0, };
+		message_put(m,
+			TAG_U32, 0,
+			TAG_TIMEVAL, &tv,
+			TAG_INVALID);
+	}
+	client_write(fd, -1, m->data, m->length);
+	free(m->data);
+	free(m);
+}
+
+/* read replies until the one with tag */
+static void client_wait(int fd, uint32_t tag)
+{
+	struct descriptor desc;
+	uint8_t data[1024];
+	uint32_t t;
+
+	while (true) {
+		spa_assert((recv)(fd, &desc, sizeof(desc), MSG_WAITALL) == sizeof(desc));
+		spa_assert(ntohl(desc.length) <= sizeof(data));
+		spa_assert((recv)(fd, data, ntohl(desc.length), MSG_WAITALL) ==
+				(ssize_t)ntohl(desc.length));
+		/* command and tag as tagged u32 */
+		memcpy(&t, &data[6], 4);
+		if (ntohl(t) == tag)
+			break;
+	}
+}
+
+/* replays the frames a libpulse client sends for a playback stream:
+ * a block of audio every 5ms and a latency query now and then. There
+ * is no stream on the server so the audio is dropped after parsing. */
+static void *client_thread(void *data)
+{
+	struct session *s = data;
+	uint8_t block[BLOCK_SIZE];
+	uint64_t start;
+	uint32_t i, tag = 1;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	spa_assert(fd >= 0);
+
+	spa_assert(connect(fd, (struct sockaddr*)&s->addr, sizeof(s->addr)) == 0);
+
+	client_command(fd, COMMAND_AUTH, tag);
+	client_wait(fd, tag++);
+
+	memset(block, 0x55, sizeof(block));
+	syscalls.recv = syscalls.send = 0;
+	s->n_frames = 0;
+
+	start = get_time_ns();
+	for (i = 0; i < s->n_blocks; i++) {
+		client_write(fd, 0, block, sizeof(block));
+		s->n_frames++;
+		if (i % LATENCY_EVERY == LATENCY_EVERY - 1) {
+			client_command(fd, COMMAND_GET_PLAYBACK_LATENCY, tag++);
+			s->n_frames++;
+		}
+		if (s->interval_us)
+			usleep(s->interval_us);
+	}
+	client_command(fd, COMMAND_STAT, tag);
+	client_wait(fd, tag);
+	s->nsec = get_time_ns() - start;
+
+	close(fd);
+	pw_main_loop_quit(s->loop);
+	return NULL;
+}
+
+static void run_session(struct pw_context *context, struct pw_main_loop *loop,
+		struct session *s)
+{
+	struct pw_protocol_pulse *pulse;
+	char runtime_dir[PATH_MAX];
+	pthread_t thread;
+	double secs;
+
+	spa_assert(get_runtime_dir(runtime_dir, sizeof(runtime_dir), "pulse") >= 0);
+	spa_zero(s->addr);
+	s->addr.sun_family = AF_UNIX;
+	spa_assert(snprintf(s->addr.sun_path, sizeof(s->addr.sun_path), "%s/%s",
+				runtime_dir, SOCKET_NAME) < (int)sizeof(s->addr.sun_path));
+	unlink(s->addr.sun_path);
+	s->loop = loop;
+
+	pulse = pw_protocol_pulse_new(context,
+			pw_properties_new("server.address",
+				"[ \"unix:" SOCKET_NAME "\" ]", NULL), 0);
+	spa_assert(pulse != NULL);
+
+	pthread_create(&thread, NULL, client_thread, s);
+	pw_main_loop_run(loop);
+	pthread_join(thread, NULL);
+
+	pw_protocol_pulse_destroy(pulse);
+
+	secs = s->nsec / (double)SPA_NSEC_PER_SEC;
+	fprintf(stderr, "%-8s %6u frames in %6.3fs: recv %6"PRIu64" send %5"PRIu64
+			" %9.0f syscalls/s %5.2f syscalls/frame\n",
+			s->name, (uint32_t)s->n_frames, secs,
+			syscalls.recv, syscalls.send,
+			(syscalls.recv + syscalls.send) / secs,
+			(syscalls.recv + syscalls.send) / (double)s->n_frames);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct session sessions[] = {
+		{ "paced", 400, 5000, },
+		{ "burst", 20000, 0, },
+	};
+	uint32_t i;
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(loop), NULL, 0);
+	spa_assert(context != NULL);
+
+	for (i = 0; i < SPA_N_ELEMENTS(sessions); i++)
+		run_session(context, loop, &sessions[i]);
+
+	pw_context_destroy(context);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
@@ -128,12 +128,57 @@ static void select_best(struct selector *s, struct pw_manager_object *o)
 	}
 }
 
+static bool select_match(struct selector *s, struct pw_manager_object *o)
+{
+	return !o->creating && !o->removing && (s->type == NULL || s->type(o));
+}
+
+struct select_named_data {
+	struct selector *sel;
+	struct pw_manager_object *object;
+};
+
+static int select_named(void *data, struct pw_manager_object *o)
+{
+	struct select_named_data *d = data;
+	const char *str;
+
+	if (!select_match(d->sel, o) || o->props == NULL ||
+	    (str = pw_properties_get(o->props, d->sel->key)) == NULL ||
+	    strcmp(str, d->sel->value) != 0)
+		return 0;
+	d->object = o;
+	return 1;
+}
+
 static struct pw_manager_object *select_object(struct pw_manager *m,
 		struct selector *s)
 {
 	struct pw_manager_object *o;
 	const char *str;
 
+	if ((o = pw_manager_find_object(m, s->id)) != NULL && select_match(s, o))
+		return o;
+
+	/* the manager indexes the ids and the node and device names, only
+	 * accumulating selectors or other keys need to look at all objects */
+	if (s->accumulate == NULL &&
+	    (s->key == NULL ||
+	     strcmp(s->key, PW_KEY_NODE_NAME) == 0 ||
+	     strcmp(s->key, PW_KEY_DEVICE_NAME) == 0)) {
+		if (s->value == NULL)
+			return s->best;
+		if (s->key != NULL) {
+			struct select_named_data d = { .sel = s, };
+			if (pw_manager_for_each_named_object(m, s->value, select_named, &d) > 0)
+				return d.object;
+		}
+		if ((o = pw_manager_find_object(m, (uint32_t)atoi(s->value))) != NULL &&
+		    select_match(s, o))
+			return o;
+		return s->best;
+	}
+
 	spa_list_for_each(o, &m->object_list, link) {
 		if (o->creating || o->removing)
 			continue;
@@ -39,6 +39,8 @@
 
 #define PROTOCOL_FLAG_MASK	0xffff0000u
 #define PROTOCOL_VERSION_MASK	0x0000ffffu
+#define PROTOCOL_FLAG_SHM	0x80000000u
+#define PROTOCOL_FLAG_MEMFD	0x40000000u
 #define PROTOCOL_VERSION	34
 
 #define NATIVE_COOKIE_LENGTH 256
@@ -36,6 +36,8 @@
 
 struct object;
 
+#define OBJECT_HASH_SIZE	256u
+
 struct manager {
 	struct pw_manager this;
 
@@ -44,6 +46,12 @@ struct manager {
 	int sync_seq;
 
 	struct spa_hook_list hooks;
+
+	struct spa_list id_hash[OBJECT_HASH_SIZE];	/* objects hashed on the id */
+	struct spa_list name_hash[OBJECT_HASH_SIZE];	/* nodes and devices hashed on
+							 * the node or device name */
+	struct spa_list device_hash[OBJECT_HASH_SIZE];	/* nodes hashed on the card id
+							 * of their node info */
 };
 
 struct object_info {
@@ -73,6 +81,13 @@ struct object {
 	struct spa_hook object_listener;
 
 	struct spa_list data_list;
+
+	struct spa_list id_link;
+	struct spa_list name_link;
+	struct spa_list device_link;
+	const char *name;		/**< node or device name, from props */
+	uint32_t card_id;		/**< card id and card device of the node */
+	uint32_t card_device;
 };
 
 static void core_sync(struct manager *m)
@@ -138,18 +153,68 @@ static bool has_param(struct spa_list *param_list, struct pw_manager_param *p)
 }
 
 
-static struct object *find_object(struct manager *m, uint32_t id)
+static uint32_t name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * 16777619u;
+	return hash;
+}
+
+static inline struct spa_list *id_bucket(struct manager *m, uint32_t id)
+{
+	return &m->id_hash[id & (OBJECT_HASH_SIZE - 1)];
+}
+
+static inline struct spa_list *name_bucket(struct manager *m, const char *name)
+{
+	return &m->name_hash[name_hash(name) & (OBJECT_HASH_SIZE - 1)];
+}
+
+static inline struct spa_list *device_bucket(struct manager *m, uint32_t card_id)
+{
+	return &m->device_hash[card_id & (OBJECT_HASH_SIZE - 1)];
+}
+
+static struct object *lookup_object(struct manager *m, uint32_t id)
 {
 	struct object *o;
-	spa_list_for_each(o, &m->this.object_list, this.link) {
-		if (o->this.creating)
-			continue;
+	spa_list_for_each(o, id_bucket(m, id), id_link) {
 		if (o->this.id == id)
 			return o;
 	}
 	return NULL;
 }
 
+static struct object *find_object(struct manager *m, uint32_t id)
+{
+	struct object *o = lookup_object(m, id);
+	return o == NULL || o->this.creating ? NULL : o;
+}
+
+static void object_update_device(struct object *o)
+{
+	struct pw_node_info *info = o->this.info;
+	uint32_t card_id = SPA_ID_INVALID, device = SPA_ID_INVALID;
+	const char *str;
+
+	if (info != NULL && info->props != NULL) {
+		if ((str = spa_dict_lookup(info->props, PW_KEY_DEVICE_ID)) != NULL)
+			card_id = (uint32_t)atoi(str);
+		if ((str = spa_dict_lookup(info->props, "card.profile.device")) != NULL)
+			device = (uint32_t)atoi(str);
+	}
+	if (card_id == o->card_id && device == o->card_device)
+		return;
+
+	spa_list_remove(&o->device_link);
+	spa_list_init(&o->device_link);
+	o->card_id = card_id;
+	o->card_device = device;
+	if (card_id != SPA_ID_INVALID && device != SPA_ID_INVALID)
+		spa_list_append(device_bucket(o->manager, card_id), &o->device_link);
+}
+
 static void object_update_params(struct object *o)
 {
 	struct pw_manager_param *p;
@@ -170,6 +235,9 @@ static void object_destroy(struct object *o)
 	struct manager *m = o->manager;
 	struct object_data *d;
 	spa_list_remove(&o->this.link);
+	spa_list_remove(&o->id_link);
+	spa_list_remove(&o->name_link);
+	spa_list_remove(&o->device_link);
 	m->this.n_objects--;
 	if (o->this.proxy)
 		pw_proxy_destroy(o->this.proxy);
@@ -315,18 +383,8 @@ static struct object *find_device(struct manager *m, uint32_t card_id, uint32_t
 {
 	struct object *o;
 
-	spa_list_for_each(o, &m->this.object_list, this.link) {
-		struct pw_node_info *info;
-		const char *str;
-
-		if (strcmp(o->this.type, PW_TYPE_INTERFACE_Node) != 0)
-			continue;
-
-		if ((info = o->this.info) != NULL &&
-		    (str = spa_dict_lookup(info->props, PW_KEY_DEVICE_ID)) != NULL &&
-		    (uint32_t)atoi(str) == card_id &&
-		    (str = spa_dict_lookup(info->props, "card.profile.device")) != NULL &&
-		    (uint32_t)atoi(str) == device)
+	spa_list_for_each(o, device_bucket(m, card_id), device_link) {
+		if (o->card_id == card_id && o->card_device == device)
 			return o;
 	}
 	return NULL;
@@ -391,8 +449,10 @@ static void node_event_info(void *object, const struct pw_node_info *info)
 	if (info->change_mask & PW_NODE_CHANGE_MASK_STATE)
 		changed++;
 
-	if (info->change_mask & PW_NODE_CHANGE_MASK_PROPS)
+	if (info->change_mask & PW_NODE_CHANGE_MASK_PROPS) {
+		object_update_device(o);
 		changed++;
+	}
 
 	if (info->change_mask & PW_NODE_CHANGE_MASK_PARAMS) {
 		for (i = 0; i < info->n_params; i++) {
@@ -543,6 +603,7 @@ static void registry_event_global(void *data, uint32_t id,
 	struct object *o;
 	const struct object_info *info;
 	struct pw_proxy *proxy;
+	const char *key = NULL;
 
 	info = find_info(type, version);
 	if (info == NULL)
@@ -573,8 +634,21 @@ static void registry_event_global(void *data, uint32_t id,
 	o->manager = m;
 	o->info = info;
 	spa_list_append(&m->this.object_list, &o->this.link);
+	spa_list_append(id_bucket(m, id), &o->id_link);
 	m->this.n_objects++;
 
+	if (info == &node_info)
+		key = PW_KEY_NODE_NAME;
+	else if (info == &device_info)
+		key = PW_KEY_DEVICE_NAME;
+	spa_list_init(&o->name_link);
+	if (key != NULL && o->this.props != NULL &&
+	    (o->name = pw_properties_get(o->this.props, key)) != NULL)
+		spa_list_append(name_bucket(m, o->name), &o->name_link);
+
+	spa_list_init(&o->device_link);
+	o->card_id = o->card_device = SPA_ID_INVALID;
+
 	if (info->events)
 		pw_proxy_add_object_listener(proxy,
 				&o->object_listener,
@@ -594,12 +668,14 @@ static void registry_event_global_remove(void *object, uint32_t id)
 	struct manager *m = object;
 	struct object *o;
 
-	if ((o = find_object(m, id)) == NULL)
+	if ((o = lookup_object(m, id)) == NULL)
 		return;
 
 	o->this.removing = true;
 
-	manager_emit_removed(m, &o->this);
+	/* objects that are still being created were never announced */
+	if (!o->this.creating)
+		manager_emit_removed(m, &o->this);
 
 	object_destroy(o);
 }
@@ -654,6 +730,7 @@ static const struct pw_core_events core_events = {
 struct pw_manager *pw_manager_new(struct pw_core *core)
 {
 	struct manager *m;
+	uint32_t i;
 
 	m = calloc(1, sizeof(*m));
 	if (m == NULL)
@@ -670,6 +747,11 @@ struct pw_manager *pw_manager_new(struct pw_core *core)
 	spa_hook_list_init(&m->hooks);
 
 	spa_list_init(&m->this.object_list);
+	for (i = 0; i < OBJECT_HASH_SIZE; i++) {
+		spa_list_init(&m->id_hash[i]);
+		spa_list_init(&m->name_hash[i]);
+		spa_list_init(&m->device_hash[i]);
+	}
 
 	pw_core_add_listener(m->this.core,
 			&m->core_listener,
@@ -743,6 +825,49 @@ int pw_manager_for_each_object(struct pw_manager *manager,
 	return 0;
 }
 
+struct pw_manager_object *pw_manager_find_object(struct pw_manager *manager, uint32_t id)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o = find_object(m, id);
+	return o ? &o->this : NULL;
+}
+
+int pw_manager_for_each_named_object(struct pw_manager *manager, const char *name,
+		int (*callback) (void *data, struct pw_manager_object *object),
+		void *data)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o;
+	int res;
+
+	spa_list_for_each(o, name_bucket(m, name), name_link) {
+		if (o->this.creating || strcmp(o->name, name) != 0)
+			continue;
+		if ((res = callback(data, &o->this)) != 0)
+			return res;
+	}
+	return 0;
+}
+
+int pw_manager_for_each_device_object(struct pw_manager *manager,
+		uint32_t card_id, uint32_t device,
+		int (*callback) (void *data, struct pw_manager_object *object),
+		void *data)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o;
+	int res;
+
+	spa_list_for_each(o, device_bucket(m, card_id), device_link) {
+		if (o->this.creating ||
+		    o->card_id != card_id || o->card_device != device)
+			continue;
+		if ((res = callback(data, &o->this)) != 0)
+			return res;
+	}
+	return 0;
+}
+
 void pw_manager_destroy(struct pw_manager *manager)
 {
 	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
@@ -104,6 +104,19 @@ int pw_manager_for_each_object(struct pw_manager *manager,
 		int (*callback) (void *data, struct pw_manager_object *object),
 		void *data);
 
+struct pw_manager_object *pw_manager_find_object(struct pw_manager *manager, uint32_t id);
+
+/* iterate the nodes and devices with the given node.name or device.name */
+int pw_manager_for_each_named_object(struct pw_manager *manager, const char *name,
+		int (*callback) (void *data, struct pw_manager_object *object),
+		void *data);
+
+/* iterate the nodes of a card device */
+int pw_manager_for_each_device_object(struct pw_manager *manager,
+		uint32_t card_id, uint32_t device,
+		int (*callback) (void *data, struct pw_manager_object *object),
+		void *data);
+
 void *pw_manager_object_add_data(struct pw_manager_object *o, const char *id, size_t size);
 
 #ifdef __cplusplus
@@ -125,6 +125,12 @@ struct message {
 	uint32_t length;
 	uint32_t offset;
 	uint8_t *data;
+
+	uint32_t flags;		/**< descriptor flags */
+	uint64_t seek;		/**< descriptor offset */
+	int fds[2];		/**< fds sent with the message, not owned */
+	uint32_t n_fds;
+	unsigned int creds:1;	/**< send our credentials with the message */
 };
 
 static int message_get(struct message *m, ...);
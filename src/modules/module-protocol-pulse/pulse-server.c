@@ -83,6 +83,7 @@ struct stats {
 #include "format.c"
 #include "volume.c"
 #include "message.c"
+#include "shm.c"
 #include "manager.h"
 #include "dbus-name.c"
 
@@ -96,6 +97,16 @@ struct client;
 
 #include "sample.c"
 
+#define MAX_FDS		2
+#define MAX_FLUSH	32		/* messages per sendmsg */
+#define IN_BUFFER_SIZE	16384
+
+struct reader {
+	uint32_t index;
+	struct descriptor desc;
+	struct message *message;
+};
+
 struct client {
 	struct spa_list link;
 	struct impl *impl;
@@ -125,10 +136,25 @@ struct client {
 
 	uint32_t connect_tag;
 
-	uint32_t in_index;
+	struct reader in;		/* reader for the socket */
+	struct reader in_srb;		/* reader for the srbchannel */
 	uint32_t out_index;
-	struct descriptor desc;
-	struct message *message;
+
+	struct {
+		uint8_t data[IN_BUFFER_SIZE];
+		uint32_t offset;
+		uint32_t size;
+	} in_buf;			/* socket data not parsed yet */
+
+	int in_fds[MAX_FDS];
+	uint32_t n_in_fds;
+
+	uid_t uid;
+	struct spa_list shm_pools;
+	struct srbchannel *srb;
+	struct srbchannel *srb_pending;
+	uint32_t srb_tag;
+	struct spa_source *srb_source;
 
 	struct pw_map streams;
 	struct spa_list out_messages;
@@ -141,6 +167,10 @@ struct client {
 	unsigned int disconnect:1;
 	unsigned int disconnecting:1;
 	unsigned int need_flush:1;
+	unsigned int use_shm:1;
+	unsigned int use_memfd:1;
+	unsigned int out_srb:1;
+	unsigned int in_drained:1;	/* last recv did not fill the buffer */
 
 	struct pw_manager_object *prev_default_sink;
 	struct pw_manager_object *prev_default_source;
@@ -248,6 +278,10 @@ struct impl {
 
 	struct spa_list free_messages;
 	struct stats stat;
+
+	unsigned int enable_shm:1;
+	unsigned int enable_memfd:1;
+	unsigned int enable_srbchannel:1;
 };
 
 #include "collect.c"
@@ -328,56 +362,154 @@ static struct message *message_alloc(struct impl *impl, uint32_t channel, uint32
 	msg->channel = channel;
 	msg->offset = 0;
 	msg->length = size;
+	msg->flags = 0;
+	msg->seek = 0;
+	msg->n_fds = 0;
+	msg->creds = false;
 	return msg;
 }
 
+static ssize_t client_send(struct client *client, struct message *m,
+		const struct iovec *iov, uint32_t n_iov)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+#ifdef SCM_CREDENTIALS
+	char cmsgbuf[CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(MAX_FDS * sizeof(int))];
+#else
+	char cmsgbuf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+#endif
+	ssize_t res;
+
+	spa_zero(msg);
+	msg.msg_iov = (struct iovec*)iov;
+	msg.msg_iovlen = n_iov;
+
+	/* fds and credentials go with the first bytes of the message */
+	if (client->out_index == 0 && (m->n_fds > 0 || m->creds)) {
+		size_t controllen = 0;
+
+		spa_zero(cmsgbuf);
+		msg.msg_control = cmsgbuf;
+		msg.msg_controllen = sizeof(cmsgbuf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+#ifdef SCM_CREDENTIALS
+		if (m->creds) {
+			struct ucred ucred;
+			ucred.pid = getpid();
+			ucred.uid = getuid();
+			ucred.gid = getgid();
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_CREDENTIALS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(ucred));
+			memcpy(CMSG_DATA(cmsg), &ucred, sizeof(ucred));
+			controllen += CMSG_SPACE(sizeof(ucred));
+			cmsg = CMSG_NXTHDR(&msg, cmsg);
+		}
+#endif
+		if (m->n_fds > 0) {
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(m->n_fds * sizeof(int));
+			memcpy(CMSG_DATA(cmsg), m->fds, m->n_fds * sizeof(int));
+			controllen += CMSG_SPACE(m->n_fds * sizeof(int));
+		}
+		msg.msg_controllen = controllen;
+	}
+	while (true) {
+		res = sendmsg(client->source->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			res = -errno;
+		}
+		return res;
+	}
+}
+
 static int flush_messages(struct client *client)
 {
 	struct impl *impl = client->impl;
-	int res;
+	struct descriptor desc[MAX_FLUSH];
+	struct iovec iov[MAX_FLUSH * 2];
+	struct message *m, *first;
+	uint32_t n_iov, n_msg, offset;
+	ssize_t res;
+
+	while (!spa_list_is_empty(&client->out_messages)) {
+		first = spa_list_first(&client->out_messages, struct message, link);
+
+		if (client->out_index == 0)
+			client->out_srb = client->srb != NULL &&
+				first->n_fds == 0 && !first->creds;
+
+		/* send as many queued messages as we can in one go, a message
+		 * with fds or credentials can only be the first one because
+		 * they are sent with the first bytes */
+		n_iov = n_msg = 0;
+		offset = client->out_index;
+		spa_list_for_each(m, &client->out_messages, link) {
+			if (n_msg == MAX_FLUSH ||
+			    (n_msg > 0 && (m->n_fds > 0 || m->creds)))
+				break;
 
-	while (true) {
-		struct message *m;
-		struct descriptor desc;
-		void *data;
-		size_t size;
+			desc[n_msg].length = htonl(m->length);
+			desc[n_msg].channel = htonl(m->channel);
+			desc[n_msg].offset_hi = htonl(m->seek >> 32);
+			desc[n_msg].offset_lo = htonl(m->seek & 0xffffffff);
+			desc[n_msg].flags = htonl(m->flags);
+
+			if (offset < sizeof(struct descriptor)) {
+				iov[n_iov].iov_base = SPA_MEMBER(&desc[n_msg], offset, void);
+				iov[n_iov].iov_len = sizeof(struct descriptor) - offset;
+				n_iov++;
+				offset = 0;
+			} else {
+				offset -= sizeof(struct descriptor);
+			}
+			if (offset < m->length) {
+				iov[n_iov].iov_base = m->data + offset;
+				iov[n_iov].iov_len = m->length - offset;
+				n_iov++;
+			}
+			offset = 0;
+			n_msg++;
+		}
 
-		if (spa_list_is_empty(&client->out_messages))
-			break;
-		m = spa_list_first(&client->out_messages, struct message, link);
-
-		if (client->out_index < sizeof(desc)) {
-			desc.length = htonl(m->length);
-			desc.channel = htonl(m->channel);
-			desc.offset_hi = 0;
-			desc.offset_lo = 0;
-			desc.flags = 0;
-
-			data = SPA_MEMBER(&desc, client->out_index, void);
-			size = sizeof(desc) - client->out_index;
-		} else if (client->out_index < m->length + sizeof(desc)) {
-			uint32_t idx = client->out_index - sizeof(desc);
-			data = m->data + idx;
-			size = m->length - idx;
+		if (client->out_srb) {
+			res = srbchannel_writev(client->srb, iov, n_iov);
+			if (res < 0) {
+				pw_log_warn("srbchannel write channel:%d, res %zd",
+						first->channel, res);
+				return res;
+			}
+			/* the client wakes us up when it made room */
+			if (res == 0)
+				return 0;
 		} else {
+			res = client_send(client, first, iov, n_iov);
+			if (res < 0) {
+				if (res != -EAGAIN && res != -EWOULDBLOCK)
+					pw_log_warn("send channel:%d, res %zd: %s",
+							first->channel, res, spa_strerror(res));
+				return res;
+			}
+		}
+		client->out_index += res;
+
+		/* release the messages that went out completely */
+		while (!spa_list_is_empty(&client->out_messages)) {
+			uint32_t size;
+
+			m = spa_list_first(&client->out_messages, struct message, link);
+			size = m->length + sizeof(struct descriptor);
+			if (client->out_index < size)
+				break;
+
 			if (debug_messages && m->channel == SPA_ID_INVALID)
 				message_dump(SPA_LOG_LEVEL_INFO, m);
 			message_free(impl, m, true, false);
-			client->out_index = 0;
-			continue;
-		}
-
-		while (true) {
-			res = send(client->source->fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
-			if (res < 0) {
-				if (errno == EINTR)
-					continue;
-				if (errno != EAGAIN && errno != EWOULDBLOCK)
-					pw_log_warn("send channel:%d %zu, res %d: %m", m->channel, size, res);
-				return -errno;
-			}
-			client->out_index += res;
-			break;
+			client->out_index -= size;
 		}
 	}
 	return 0;
@@ -391,7 +523,7 @@ static int send_message(struct client *client, struct message *m)
 	if (m == NULL)
 		return -EINVAL;
 
-	if (m->length == 0) {
+	if (m->length == 0 && (m->flags & FLAG_SHMMASK) == 0) {
 		res = 0;
 		goto error;
 	} else if (m->length > m->allocated) {
@@ -604,13 +736,64 @@ static int send_stream_started(struct stream *stream)
 	return send_message(client, reply);
 }
 
+static int setup_srbchannel(struct client *client)
+{
+	struct impl *impl = client->impl;
+	struct srbchannel *srb;
+	struct message *msg;
+	uint32_t shm_id;
+
+	srb = srbchannel_new(impl->context->pool, impl->loop->system);
+	if (srb == NULL)
+		return -errno;
+
+	shm_id = srb->block->id;
+
+	/* make the memfd of the ringbuffer known to the client */
+	msg = message_alloc(impl, -1, 0);
+	message_put(msg,
+		TAG_U32, COMMAND_REGISTER_MEMFD_SHMID,
+		TAG_U32, -1,
+		TAG_U32, shm_id,
+		TAG_INVALID);
+	msg->fds[0] = srb->block->fd;
+	msg->n_fds = 1;
+	send_message(client, msg);
+
+	msg = message_alloc(impl, -1, 0);
+	message_put(msg,
+		TAG_U32, COMMAND_ENABLE_SRBCHANNEL,
+		TAG_U32, shm_id,
+		TAG_INVALID);
+	msg->fds[0] = srb->readfd;
+	msg->fds[1] = srb->writefd;
+	msg->n_fds = 2;
+	send_message(client, msg);
+
+	/* and the ringbuffer memory itself */
+	msg = message_alloc(impl, 0, SHM_INFO_SIZE);
+	msg->flags = FLAG_SHMDATA | FLAG_SHMDATA_MEMFD_BLOCK | FLAG_SHMWRITABLE;
+	((uint32_t*)msg->data)[0] = htonl(0);
+	((uint32_t*)msg->data)[1] = htonl(shm_id);
+	((uint32_t*)msg->data)[2] = htonl(0);
+	((uint32_t*)msg->data)[3] = htonl(SRB_SIZE);
+	send_message(client, msg);
+
+	client->srb_pending = srb;
+	client->srb_tag = shm_id;
+
+	pw_log_info(NAME" %p: client:%p srbchannel %u offered", impl, client, shm_id);
+	return 0;
+}
+
 static int do_command_auth(struct client *client, uint32_t command, uint32_t tag, struct message *m)
 {
 	struct impl *impl = client->impl;
 	struct message *reply;
-	uint32_t version;
+	uint32_t version, flags = 0;
 	const void *cookie;
 	size_t len;
+	bool do_shm, do_memfd;
 
 	if (message_get(m,
 			TAG_U32, &version,
@@ -623,19 +806,45 @@ static int do_command_auth(struct client *client, uint32_t command, uint32_t tag
 	if (len != NATIVE_COOKIE_LENGTH)
 		return -EINVAL;
 
-	if ((version & PROTOCOL_VERSION_MASK) >= 13)
+	if ((version & PROTOCOL_VERSION_MASK) >= 13) {
+		flags = version & PROTOCOL_FLAG_MASK;
 		version &= PROTOCOL_VERSION_MASK;
+	}
 
 	client->version = version;
 
-	pw_log_info(NAME" %p: client:%p AUTH tag:%u version:%d", impl, client, tag, version);
+	/* shared memory only works between processes of the same user */
+	do_shm = impl->enable_shm && version >= 13 &&
+		(flags & PROTOCOL_FLAG_SHM) &&
+		client->server->type == SERVER_TYPE_UNIX &&
+		client->uid == getuid();
+	do_memfd = do_shm && impl->enable_memfd && version >= 31 &&
+		(flags & PROTOCOL_FLAG_MEMFD);
+
+	client->use_shm = do_shm;
+	client->use_memfd = do_memfd;
+
+	pw_log_info(NAME" %p: client:%p AUTH tag:%u version:%d shm:%d memfd:%d",
+			impl, client, tag, version, do_shm, do_memfd);
 
 	reply = reply_new(client, tag);
+	flags = (do_shm ? PROTOCOL_FLAG_SHM : 0) |
+		(do_memfd ? PROTOCOL_FLAG_MEMFD : 0);
 	message_put(reply,
-			TAG_U32, PROTOCOL_VERSION,
+			TAG_U32, PROTOCOL_VERSION | flags,
 			TAG_INVALID);
+	/* the client only enables shm when it got our credentials */
+	reply->creds = client->server->type == SERVER_TYPE_UNIX;
 
-	return send_message(client, reply);
+	send_message(client, reply);
+
+	if (do_memfd && impl->enable_srbchannel && version >= 30) {
+		int res;
+		if ((res = setup_srbchannel(client)) < 0)
+			pw_log_warn(NAME" %p: client:%p can't setup srbchannel: %s",
+					impl, client, spa_strerror(res));
+	}
+	return 0;
 }
 
 static int reply_set_client_name(struct client *client, uint32_t tag)
@@ -3659,10 +3868,27 @@ static int fill_module_info(struct client *client, struct message *m,
 	return 0;
 }
 
+struct port_latency_data {
+	int64_t offset;
+};
+
+static int do_port_latency_offset(void *data, struct pw_manager_object *o)
+{
+	struct port_latency_data *d = data;
+
+	if (o->removing)
+		return 0;
+	if (!object_is_sink(o) && !object_is_source_or_monitor(o))
+		return 0;
+
+	d->offset = get_node_latency_offset(o);
+	return 1;
+}
+
 static int64_t get_port_latency_offset(struct client *client, struct pw_manager_object *card, struct port_info *pi)
 {
 	struct pw_manager *m = client->manager;
-	struct pw_manager_object *o;
+	struct port_latency_data d;
 	size_t j;
 
 	/*
@@ -3674,29 +3900,9 @@ static int64_t get_port_latency_offset(struct client *client, struct pw_manager_
 	 * route data might not be updated yet when these events arrive.
 	 */
 	for (j = 0; j < pi->n_devices; ++j) {
-		spa_list_for_each(o, &m->object_list, link) {
-			const char *str;
-			uint32_t card_id = SPA_ID_INVALID;
-			uint32_t device_id = SPA_ID_INVALID;
-			struct pw_node_info *info;
-
-			if (o->creating || o->removing)
-				continue;
-			if (!object_is_sink(o) && !object_is_source_or_monitor(o))
-				continue;
-			if ((info = o->info) == NULL || info->props == NULL)
-				continue;
-			if ((str = spa_dict_lookup(info->props, PW_KEY_DEVICE_ID)) != NULL)
-				card_id = (uint32_t)atoi(str);
-			if (card_id != card->id)
-				continue;
-
-			if ((str = spa_dict_lookup(info->props, "card.profile.device")) != NULL)
-				device_id = (uint32_t)atoi(str);
-
-			if (device_id == pi->devices[j])
-				return get_node_latency_offset(o);
-		}
+		if (pw_manager_for_each_device_object(m, card->id, pi->devices[j],
+					do_port_latency_offset, &d) > 0)
+			return d.offset;
 	}
 
 	return 0LL;
@@ -4972,6 +5178,57 @@ static int do_unload_module(struct client *client, uint32_t command, uint32_t ta
 	return reply_simple_ack(client, tag);
 }
 
+static void on_srb_data(void *data, int fd, uint32_t mask);
+
+static int do_enable_srbchannel(struct client *client, uint32_t command, uint32_t tag, struct message *m)
+{
+	struct impl *impl = client->impl;
+
+	if (client->srb_pending == NULL || tag != client->srb_tag)
+		return -EPROTO;
+
+	pw_log_info(NAME" %p: [%s] %s tag:%u", impl, client->name,
+			commands[command].name, tag);
+
+	/* the client switched to the srbchannel, we do the same */
+	client->srb_source = pw_loop_add_io(impl->loop,
+			client->srb_pending->readfd,
+			SPA_IO_IN, false, on_srb_data, client);
+	if (client->srb_source == NULL)
+		return -errno;
+
+	client->srb = client->srb_pending;
+	client->srb_pending = NULL;
+	return 0;
+}
+
+static int do_register_memfd_shmid(struct client *client, uint32_t command, uint32_t tag, struct message *m)
+{
+	struct impl *impl = client->impl;
+	struct shm_pool *pool;
+	uint32_t shm_id;
+
+	if (message_get(m,
+			TAG_U32, &shm_id,
+			TAG_INVALID) < 0)
+		return -EPROTO;
+
+	if (!client->use_memfd || client->n_in_fds != 1)
+		return -EPROTO;
+
+	pw_log_info(NAME" %p: [%s] %s tag:%u shm_id:%u", impl, client->name,
+			commands[command].name, tag, shm_id);
+
+	if ((pool = shm_pool_find(&client->shm_pools, shm_id)) != NULL)
+		shm_pool_free(pool);
+
+	if (shm_pool_new(&client->shm_pools, shm_id, client->in_fds[0]) == NULL)
+		return -errno;
+
+	client->n_in_fds = 0;
+	return 0;
+}
+
 static int do_error_access(struct client *client, uint32_t command, uint32_t tag, struct message *m)
 {
 	return -EACCES;
@@ -5134,12 +5391,12 @@ static const struct command commands[COMMAND_MAX] =
 
 	/* Supported since protocol v30 (6.0) */
 	/* BOTH DIRECTIONS */
-	[COMMAND_ENABLE_SRBCHANNEL] = { "ENABLE_SRBCHANNEL", do_error_access, },
+	[COMMAND_ENABLE_SRBCHANNEL] = { "ENABLE_SRBCHANNEL", do_enable_srbchannel, },
 	[COMMAND_DISABLE_SRBCHANNEL] = { "DISABLE_SRBCHANNEL", do_error_access, },
 
 	/* Supported since protocol v31 (9.0)
 	 * BOTH DIRECTIONS */
-	[COMMAND_REGISTER_MEMFD_SHMID] = { "REGISTER_MEMFD_SHMID", do_error_access, },
+	[COMMAND_REGISTER_MEMFD_SHMID] = { "REGISTER_MEMFD_SHMID", do_register_memfd_shmid, },
 };
 
 static int client_free_stream(void *item, void *data)
@@ -5165,16 +5422,27 @@ static void client_disconnect(struct client *client)
 
 	if (client->source)
 		pw_loop_destroy_source(impl->loop, client->source);
+	if (client->srb_source)
+		pw_loop_destroy_source(impl->loop, client->srb_source);
 	if (client->manager)
 		pw_manager_destroy(client->manager);
 }
 
+static void client_close_fds(struct client *client)
+{
+	uint32_t i;
+	for (i = 0; i < client->n_in_fds; i++)
+		close(client->in_fds[i]);
+	client->n_in_fds = 0;
+}
+
 static void client_free(struct client *client)
 {
 	struct impl *impl = client->impl;
 	struct message *msg;
 	struct module *module, *tmp;
 	struct pending_sample *p;
+	struct shm_pool *pool;
 
 	pw_log_info(NAME" %p: client %p free", impl, client);
 
@@ -5190,6 +5458,18 @@ static void client_free(struct client *client)
 
 	spa_list_consume(msg, &client->out_messages, link)
 		message_free(impl, msg, true, false);
+	if (client->in.message)
+		message_free(impl, client->in.message, false, false);
+	if (client->in_srb.message)
+		message_free(impl, client->in_srb.message, false, false);
+
+	client_close_fds(client);
+	spa_list_consume(pool, &client->shm_pools, link)
+		shm_pool_free(pool);
+	if (client->srb)
+		srbchannel_free(client->srb);
+	if (client->srb_pending)
+		srbchannel_free(client->srb_pending);
 
 	if (client->core) {
 		client->disconnecting = true;
@@ -5250,34 +5530,72 @@ finish:
 	return 0;
 }
 
+static int send_shm_release(struct client *client, uint32_t block_id)
+{
+	struct message *msg;
+
+	msg = message_alloc(client->impl, -1, 0);
+	msg->flags = FLAG_SHMRELEASE;
+	msg->seek = (uint64_t)block_id << 32;
+	return send_message(client, msg);
+}
+
 static int handle_memblock(struct client *client, struct message *msg)
 {
 	struct impl *impl = client->impl;
 	struct stream *stream;
-	uint32_t channel, flags, index;
+	struct shm_pool *pool = NULL;
+	uint32_t channel, flags, index, length, shm_offset = 0;
 	int64_t offset;
 	int32_t filled, diff;
 	int res = 0;
 
-	channel = ntohl(client->desc.channel);
-	offset = (int64_t) (
-             (((uint64_t) ntohl(client->desc.offset_hi)) << 32) |
-             (((uint64_t) ntohl(client->desc.offset_lo))));
-	flags = ntohl(client->desc.flags);
+	channel = msg->channel;
+	offset = (int64_t) msg->seek;
+	flags = msg->flags;
+	length = msg->length;
+
+	if (flags & FLAG_SHMDATA) {
+		uint32_t *info = (uint32_t*)msg->data, block_id, shm_id;
+
+		block_id = ntohl(info[0]);
+		shm_id = ntohl(info[1]);
+		shm_offset = ntohl(info[2]);
+		length = ntohl(info[3]);
+
+		/* we copy the data out right away, the client can reuse
+		 * the block as soon as we're done */
+		send_shm_release(client, block_id);
+
+		pool = shm_pool_find(&client->shm_pools, shm_id);
+		if (pool == NULL && !(flags & FLAG_SHMDATA_MEMFD_BLOCK))
+			pool = shm_pool_open(&client->shm_pools, shm_id);
+		if (pool == NULL) {
+			pw_log_warn(NAME" %p: unknown shm pool %u", impl, shm_id);
+			goto finish;
+		}
+		if ((uint64_t)shm_offset + length > pool->size) {
+			pw_log_warn(NAME" %p: invalid shm block %u:%u size:%u",
+					impl, shm_id, shm_offset, length);
+			goto finish;
+		}
+	}
 
 	pw_log_debug(NAME" %p: Received memblock channel:%d offset:%"PRIi64
 			" flags:%08x size:%u", impl, channel, offset,
-			flags, msg->length);
+			flags, length);
 
 	stream = pw_map_lookup(&client->streams, channel);
 	if (stream == NULL || stream->type == STREAM_TYPE_RECORD) {
-		res = -EINVAL;
+		/* can happen when the stream was just deleted, ignore */
+		pw_log_debug(NAME" %p: no playback stream for channel %u",
+				impl, channel);
 		goto finish;
 	}
 
 	filled = spa_ringbuffer_get_write_index(&stream->ring, &index);
 	pw_log_debug("new block %p %p/%u filled:%d index:%d flags:%02x offset:%"PRIu64,
-			msg, msg->data, msg->length, filled, index, flags, offset);
+			msg, msg->data, length, filled, index, flags, offset);
 
 
 	switch (flags & FLAG_SEEKMASK) {
@@ -5303,27 +5621,119 @@ static int handle_memblock(struct client *client, struct message *msg)
 
 	if (filled < 0) {
 		/* underrun, reported on reader side */
-	} else if (filled + msg->length > stream->attr.maxlength) {
+	} else if (filled + length > stream->attr.maxlength) {
 		/* overrun */
 		send_overflow(stream);
 	}
 
 	/* always write data to ringbuffer, we expect the other side
 	 * to recover */
-	spa_ringbuffer_write_data(&stream->ring,
-			stream->buffer, stream->attr.maxlength,
-			index % stream->attr.maxlength,
-			msg->data,
-			SPA_MIN(msg->length, stream->attr.maxlength));
-	stream->write_index = index + msg->length;
+	if (pool != NULL) {
+		res = shm_pool_read_ring(pool, shm_offset,
+				stream->buffer, stream->attr.maxlength,
+				index % stream->attr.maxlength,
+				SPA_MIN(length, stream->attr.maxlength));
+		if (res < 0) {
+			pw_log_warn(NAME" %p: can't read shm pool %u: %s",
+					impl, pool->id, spa_strerror(res));
+			res = 0;
+			goto finish;
+		}
+	} else {
+		spa_ringbuffer_write_data(&stream->ring,
+				stream->buffer, stream->attr.maxlength,
+				index % stream->attr.maxlength,
+				msg->data,
+				SPA_MIN(length, stream->attr.maxlength));
+	}
+	stream->write_index = index + length;
 	spa_ringbuffer_write_update(&stream->ring, stream->write_index);
-	stream->requested -= msg->length;
+	stream->requested -= length;
 finish:
 	message_free(impl, msg, false, false);
 	return res;
 }
 
-static int do_read(struct client *client)
+static ssize_t client_recv(struct client *client, void *data, size_t size)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cmsgbuf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	ssize_t res;
+
+	iov.iov_base = data;
+	iov.iov_len = size;
+
+	spa_zero(msg);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf;
+	msg.msg_controllen = sizeof(cmsgbuf);
+
+	while (true) {
+		res = recvmsg(client->source->fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		break;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		uint32_t i, n_fds;
+		int *fds;
+
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		fds = (int*)CMSG_DATA(cmsg);
+		n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n_fds; i++) {
+			if (client->n_in_fds < MAX_FDS)
+				client->in_fds[client->n_in_fds++] = fds[i];
+			else
+				close(fds[i]);
+		}
+	}
+	return res;
+}
+
+/* read from the socket through the input buffer so that many small
+ * frames can be parsed from one recv */
+static ssize_t client_read(struct client *client, void *data, size_t size)
+{
+	ssize_t res;
+	uint32_t avail;
+
+	if (client->in_buf.offset == client->in_buf.size) {
+		/* large reads go straight to the destination */
+		if (size >= sizeof(client->in_buf.data))
+			return client_recv(client, data, size);
+
+		/* we got less than we asked for last time so the socket is
+		 * most likely empty, we'll be woken up when there is more */
+		if (client->in_drained) {
+			client->in_drained = false;
+			return -EAGAIN;
+		}
+		res = client_recv(client, client->in_buf.data,
+				sizeof(client->in_buf.data));
+		if (res <= 0)
+			return res;
+
+		client->in_buf.offset = 0;
+		client->in_buf.size = res;
+		client->in_drained = res < (ssize_t)sizeof(client->in_buf.data);
+	}
+	avail = SPA_MIN(client->in_buf.size - client->in_buf.offset, size);
+	memcpy(data, &client->in_buf.data[client->in_buf.offset], avail);
+	client->in_buf.offset += avail;
+	return avail;
+}
+
+static int do_read(struct client *client, struct reader *rd)
 {
 	struct impl *impl = client->impl;
 	void *data;
@@ -5331,53 +5741,76 @@ static int do_read(struct client *client)
 	ssize_t r;
 	int res = 0;
 
-	if (client->in_index < sizeof(client->desc)) {
-		data = SPA_MEMBER(&client->desc, client->in_index, void);
-		size = sizeof(client->desc) - client->in_index;
+	if (rd->index < sizeof(rd->desc)) {
+		data = SPA_MEMBER(&rd->desc, rd->index, void);
+		size = sizeof(rd->desc) - rd->index;
 	} else {
-		uint32_t idx = client->in_index - sizeof(client->desc);
+		uint32_t idx = rd->index - sizeof(rd->desc);
 
-		if (client->message == NULL) {
+		if (rd->message == NULL) {
 			res = -EIO;
 			goto exit;
 		}
-		data = SPA_MEMBER(client->message->data, idx, void);
-		size = client->message->length - idx;
-	}
-	while (true) {
-		r = recv(client->source->fd, data, size, MSG_DONTWAIT);
+		data = SPA_MEMBER(rd->message->data, idx, void);
+		size = rd->message->length - idx;
+	}
+	if (rd == &client->in_srb) {
+		r = srbchannel_read(client->srb, data, size);
+		if (r < 0) {
+			pw_log_warn("srbchannel read client:%p res %zd", client, r);
+			res = r;
+			goto exit;
+		} else if (r == 0 && size != 0) {
+			res = -EAGAIN;
+			goto exit;
+		}
+	} else {
+		r = client_read(client, data, size);
 		if (r == 0 && size != 0) {
 			res = -EPIPE;
 			goto exit;
 		} else if (r < 0) {
-			if (errno == EINTR)
-		                continue;
-			res = -errno;
-			if (errno != EAGAIN && errno != EWOULDBLOCK)
-				pw_log_warn("recv client:%p res %zd: %m", client, r);
+			res = r;
+			if (res != -EAGAIN && res != -EWOULDBLOCK)
+				pw_log_warn("recv client:%p res %zd: %s", client, r,
+						spa_strerror(res));
 			goto exit;
 		}
-		client->in_index += r;
-		break;
 	}
+	rd->index += r;
 
-	if (client->in_index == sizeof(client->desc)) {
+	if (rd->index == sizeof(rd->desc)) {
 		uint32_t flags, length, channel;
 
-		flags = ntohl(client->desc.flags);
+		flags = ntohl(rd->desc.flags);
+		length = ntohl(rd->desc.length);
+		channel = ntohl(rd->desc.channel);
+
 		if ((flags & FLAG_SHMMASK) != 0) {
-			res = -ENOTSUP;
-			goto exit;
+			if (!client->use_shm) {
+				res = -ENOTSUP;
+				goto exit;
+			}
+			if (flags == FLAG_SHMRELEASE || flags == FLAG_SHMREVOKE) {
+				/* we don't export blocks and don't keep
+				 * imported blocks around */
+				rd->index = 0;
+				goto exit;
+			}
+			if ((flags & FLAG_SHMDATA) == 0 ||
+			    length != SHM_INFO_SIZE ||
+			    channel == (uint32_t) -1) {
+				res = -EPROTO;
+				goto exit;
+			}
 		}
 
-		length = ntohl(client->desc.length);
 		if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
 			pw_log_warn(NAME" %p: Received invalid frame size: %u",
 					impl, length);
 			res = -EPROTO;
 			goto exit;
 		}
-		channel = ntohl(client->desc.channel);
 		if (channel == (uint32_t) -1) {
 			if (flags != 0) {
 				pw_log_warn(NAME" %p: Received packet frame with invalid "
@@ -5386,20 +5819,29 @@ static int do_read(struct client *client)
 				goto exit;
 			}
 		}
-		if (client->message)
-			message_free(impl, client->message, false, false);
-		client->message = message_alloc(impl, channel, length);
-	} else if (client->message &&
-	    client->in_index >= client->message->length + sizeof(client->desc)) {
-		struct message *msg = client->message;
-
-		client->message = NULL;
-		client->in_index = 0;
+		if (rd->message)
+			message_free(impl, rd->message, false, false);
+		rd->message = message_alloc(impl, channel, length);
+		rd->message->flags = flags;
+		rd->message->seek =
+			(((uint64_t) ntohl(rd->desc.offset_hi)) << 32) |
+			(((uint64_t) ntohl(rd->desc.offset_lo)));
+	} else if (rd->message &&
+	    rd->index >= rd->message->length + sizeof(rd->desc)) {
+		struct message *msg = rd->message;
+
+		rd->message = NULL;
+		rd->index = 0;
 
 		if (msg->channel == (uint32_t)-1)
 			res = handle_packet(client, msg);
 		else
 			res = handle_memblock(client, msg);
+
+		/* fds are only valid for the message they came with, they
+		 * might belong to a message that is still in the buffer */
+		if (client->in_buf.offset == client->in_buf.size)
+			client_close_fds(client);
 	}
 exit:
 	return res;
@@ -5447,7 +5889,7 @@ on_client_data(void *data, int fd, uint32_t mask)
 	if (mask & SPA_IO_IN) {
 		pw_log_trace(NAME" %p: can read", impl);
 		while (true) {
-			res = do_read(client);
+			res = do_read(client, &client->in);
 			if (res < 0) {
 				if (res != -EAGAIN)
 					goto error;
@@ -5480,6 +5922,40 @@ error:
 	client_unref(client);
 }
 
+static void
+on_srb_data(void *data, int fd, uint32_t mask)
+{
+	struct client *client = data;
+	struct impl *impl = client->impl;
+	int res;
+
+	srbchannel_wakeup(client->srb);
+
+	pw_log_trace(NAME" %p: can read srbchannel", impl);
+	while (true) {
+		res = do_read(client, &client->in_srb);
+		if (res < 0) {
+			if (res != -EAGAIN)
+				goto error;
+			break;
+		}
+	}
+	/* the client might have made room for our messages */
+	if (!client->disconnect && !spa_list_is_empty(&client->out_messages) &&
+	    !SPA_FLAG_IS_SET(client->source->mask, SPA_IO_OUT)) {
+		client->need_flush = true;
+		pw_loop_update_io(impl->loop, client->source,
+				client->source->mask | SPA_IO_OUT);
+	}
+	return;
+
+error:
+	pw_log_error(NAME" %p: client:%p [%s] srbchannel error %d (%s)", impl,
+			client, client->name, res, spa_strerror(res));
+	client_disconnect(client);
+	client_unref(client);
+}
+
 static int check_flatpak(struct client *client, int pid)
 {
 	char root_path[2048];
@@ -5534,14 +6010,17 @@ static int get_client_pid(struct client *client, int client_fd)
 	len = sizeof(ucred);
 	if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &ucred, &len) < 0) {
                 pw_log_warn(NAME": client %p: no peercred: %m", client);
-	} else
+	} else {
+		client->uid = ucred.uid;
 		return ucred.pid;
+	}
 #elif defined(__FreeBSD__)
 	struct xucred xucred;
 	len = sizeof(xucred);
 	if (getsockopt(client_fd, 0, LOCAL_PEERCRED, &xucred, &len) < 0) {
                 pw_log_warn(NAME": client %p: no peercred: %m", client);
 	} else {
+		client->uid = xucred.cr_uid;
 #if __FreeBSD__ >= 13
 		return xucred.cr_pid;
 #endif
@@ -5574,6 +6053,8 @@ on_connect(void *data, int fd, uint32_t mask)
 	spa_list_init(&client->operations);
 	spa_list_init(&client->modules);
 	spa_list_init(&client->pending_samples);
+	spa_list_init(&client->shm_pools);
+	client->uid = (uid_t)-1;
 
 	client->props = pw_properties_new(
 			PW_KEY_CLIENT_API, "pipewire-pulse",
@@ -5967,7 +6448,7 @@ struct pw_protocol_pulse *pw_protocol_pulse_new(struct pw_context *context,
 		struct pw_properties *props, size_t user_data_size)
 {
 	struct impl *impl;
-	const char *str;
+	const char *str, *opt;
 	char *free_str = NULL;
 	struct spa_json it[2];
 	char value[512];
@@ -5993,6 +6474,18 @@ struct pw_protocol_pulse *pw_protocol_pulse_new(struct pw_context *context,
 	impl->loop = pw_context_get_main_loop(context);
 	impl->props = props;
 
+	impl->enable_shm = true;
+	impl->enable_memfd = true;
+	impl->enable_srbchannel = true;
+	if (props != NULL) {
+		if ((opt = pw_properties_get(props, "pulse.enable-shm")) != NULL)
+			impl->enable_shm = pw_properties_parse_bool(opt);
+		if ((opt = pw_properties_get(props, "pulse.enable-memfd")) != NULL)
+			impl->enable_memfd = pw_properties_parse_bool(opt);
+		if ((opt = pw_properties_get(props, "pulse.enable-srbchannel")) != NULL)
+			impl->enable_srbchannel = pw_properties_parse_bool(opt);
+	}
+
 	impl->cleanup = pw_loop_add_event(impl->loop,
 					on_server_cleanup, impl);
 	if (impl->cleanup == NULL)
@@ -0,0 +1,336 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include <spa/support/system.h>
+
+#define SHM_INFO_SIZE		16	/* block id, shm id, index, length */
+#define SRB_SIZE		(64 * 1024)
+#define SRB_HEADER_SIZE		64
+
+/* A memory pool of the client that memblocks can refer to. The pool
+ * is only mapped when the client can't shrink it under us, else the
+ * data is read from the fd. */
+struct shm_pool {
+	struct spa_list link;
+	uint32_t id;
+	int fd;
+	void *ptr;
+	size_t size;
+};
+
+static struct shm_pool *shm_pool_new(struct spa_list *pools, uint32_t id, int fd)
+{
+	struct shm_pool *pool;
+	struct stat st;
+	int seals = 0;
+
+	if (fstat(fd, &st) < 0)
+		return NULL;
+
+	if ((pool = calloc(1, sizeof(struct shm_pool))) == NULL)
+		return NULL;
+
+	pool->id = id;
+	pool->fd = fd;
+	pool->size = st.st_size;
+
+#ifdef F_GET_SEALS
+	seals = fcntl(fd, F_GET_SEALS);
+	if (seals >= 0 && (seals & F_SEAL_SHRINK)) {
+		pool->ptr = mmap(NULL, pool->size, PROT_READ, MAP_SHARED, fd, 0);
+		if (pool->ptr == MAP_FAILED)
+			pool->ptr = NULL;
+	}
+#endif
+	pw_log_debug("shm pool %u: fd:%d size:%zd seals:%08x mapped:%d",
+			id, fd, pool->size, seals, pool->ptr != NULL);
+
+	spa_list_append(pools, &pool->link);
+	return pool;
+}
+
+static struct shm_pool *shm_pool_open(struct spa_list *pools, uint32_t id)
+{
+	struct shm_pool *pool;
+	char name[64];
+	int fd;
+
+	snprintf(name, sizeof(name), "/dev/shm/pulse-shm-%u", id);
+	if ((fd = open(name, O_RDONLY | O_CLOEXEC)) < 0) {
+		pw_log_warn("can't open shm pool %s: %m", name);
+		return NULL;
+	}
+	if ((pool = shm_pool_new(pools, id, fd)) == NULL)
+		close(fd);
+	return pool;
+}
+
+static struct shm_pool *shm_pool_find(struct spa_list *pools, uint32_t id)
+{
+	struct shm_pool *pool;
+	spa_list_for_each(pool, pools, link) {
+		if (pool->id == id)
+			return pool;
+	}
+	return NULL;
+}
+
+static void shm_pool_free(struct shm_pool *pool)
+{
+	spa_list_remove(&pool->link);
+	if (pool->ptr)
+		munmap(pool->ptr, pool->size);
+	close(pool->fd);
+	free(pool);
+}
+
+static int shm_pool_read(struct shm_pool *pool, uint32_t offset, void *data, uint32_t size)
+{
+	ssize_t res;
+
+	if ((size_t)offset + size > pool->size)
+		return -EINVAL;
+	if (pool->ptr) {
+		memcpy(data, SPA_MEMBER(pool->ptr, offset, void), size);
+		return 0;
+	}
+	while (size > 0) {
+		res = pread(pool->fd, data, size, offset);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (res == 0)
+			return -EINVAL;
+		data = SPA_MEMBER(data, res, void);
+		offset += res;
+		size -= res;
+	}
+	return 0;
+}
+
+/* copy a block of the pool into a ringbuffer of size bytes at index */
+static int shm_pool_read_ring(struct shm_pool *pool, uint32_t offset,
+		void *buffer, uint32_t size, uint32_t index, uint32_t len)
+{
+	uint32_t l0 = SPA_MIN(len, size - index), l1 = len - l0;
+	int res;
+
+	if ((res = shm_pool_read(pool, offset, SPA_MEMBER(buffer, index, void), l0)) < 0)
+		return res;
+	if (l1 > 0)
+		res = shm_pool_read(pool, offset + l0, buffer, l1);
+	return res;
+}
+
+/* Shared memory layout of the pulseaudio srbchannel. The server reads
+ * from the read ring and waits on the read semaphore, the client
+ * does the opposite. */
+struct srb_sem {
+	int32_t waiting;
+	int32_t signalled;
+	int32_t in_pipe;
+};
+
+struct srb_header {
+	int32_t read_count;
+	int32_t write_count;
+	struct srb_sem read_sem;
+	struct srb_sem write_sem;
+	int32_t capacity;
+	int32_t readbuf_offset;
+	int32_t writebuf_offset;
+};
+
+struct srb_ring {
+	int32_t *count;
+	uint8_t *data;
+	uint32_t index;
+};
+
+struct srbchannel {
+	struct spa_system *system;
+	struct pw_memblock *block;
+	struct srb_header *hdr;
+	uint32_t capacity;
+	struct srb_ring read;
+	struct srb_ring write;
+	int readfd;
+	int writefd;
+};
+
+static void srbchannel_free(struct srbchannel *srb)
+{
+	if (srb->readfd >= 0)
+		spa_system_close(srb->system, srb->readfd);
+	if (srb->writefd >= 0)
+		spa_system_close(srb->system, srb->writefd);
+	if (srb->block)
+		pw_memblock_unref(srb->block);
+	free(srb);
+}
+
+static struct srbchannel *srbchannel_new(struct pw_mempool *pool, struct spa_system *system)
+{
+	struct srbchannel *srb;
+	struct srb_header *hdr;
+	int res;
+
+	if ((srb = calloc(1, sizeof(struct srbchannel))) == NULL)
+		return NULL;
+
+	srb->system = system;
+	srb->readfd = srb->writefd = -1;
+
+	srb->block = pw_mempool_alloc(pool,
+			PW_MEMBLOCK_FLAG_READWRITE |
+			PW_MEMBLOCK_FLAG_SEAL |
+			PW_MEMBLOCK_FLAG_MAP,
+			SPA_DATA_MemFd, SRB_SIZE);
+	if (srb->block == NULL)
+		goto error;
+
+	if ((srb->readfd = spa_system_eventfd_create(system,
+					SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0 ||
+	    (srb->writefd = spa_system_eventfd_create(system,
+					SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+		goto error;
+
+	srb->capacity = SPA_ROUND_DOWN_N((SRB_SIZE - SRB_HEADER_SIZE) / 2, 8);
+
+	srb->hdr = hdr = srb->block->map->ptr;
+	spa_zero(*hdr);
+	hdr->capacity = srb->capacity;
+	hdr->readbuf_offset = SRB_HEADER_SIZE;
+	hdr->writebuf_offset = SRB_HEADER_SIZE + srb->capacity;
+	/* we are always polling the read fd */
+	hdr->read_sem.waiting = 1;
+
+	srb->read.count = &hdr->read_count;
+	srb->read.data = SPA_MEMBER(hdr, hdr->readbuf_offset, uint8_t);
+	srb->write.count = &hdr->write_count;
+	srb->write.data = SPA_MEMBER(hdr, hdr->writebuf_offset, uint8_t);
+
+	return srb;
+error:
+	res = -errno;
+	srbchannel_free(srb);
+	errno = -res;
+	return NULL;
+}
+
+/* wake up the client when it waits for our data or space */
+static void srbchannel_post(struct srbchannel *srb)
+{
+	struct srb_sem *sem = &srb->hdr->write_sem;
+	int32_t expected = 0;
+
+	if (__atomic_compare_exchange_n(&sem->signalled, &expected, 1, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) &&
+	    __atomic_load_n(&sem->waiting, __ATOMIC_SEQ_CST)) {
+		__atomic_add_fetch(&sem->in_pipe, 1, __ATOMIC_SEQ_CST);
+		spa_system_eventfd_write(srb->system, srb->writefd, 1);
+	}
+}
+
+/* called when the read fd woke us up */
+static bool srbchannel_wakeup(struct srbchannel *srb)
+{
+	struct srb_sem *sem = &srb->hdr->read_sem;
+	int32_t expected = 1;
+	uint64_t count;
+
+	if (spa_system_eventfd_read(srb->system, srb->readfd, &count) == 0)
+		__atomic_sub_fetch(&sem->in_pipe, (int32_t)count, __ATOMIC_SEQ_CST);
+
+	return __atomic_compare_exchange_n(&sem->signalled, &expected, 0, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static ssize_t srbchannel_read(struct srbchannel *srb, void *data, size_t size)
+{
+	struct srb_ring *r = &srb->read;
+	size_t total = 0;
+	int32_t avail;
+
+	while (size > 0) {
+		avail = __atomic_load_n(r->count, __ATOMIC_SEQ_CST);
+		if (avail < 0 || (uint32_t)avail > srb->capacity)
+			return -EPROTO;
+		avail = SPA_MIN((uint32_t)avail, srb->capacity - r->index);
+		avail = SPA_MIN((size_t)avail, size);
+		if (avail == 0)
+			break;
+
+		memcpy(data, r->data + r->index, avail);
+		r->index = (r->index + avail) % srb->capacity;
+		if (__atomic_fetch_sub(r->count, avail, __ATOMIC_SEQ_CST) >= (int32_t)srb->capacity)
+			srbchannel_post(srb);
+
+		data = SPA_MEMBER(data, avail, void);
+		size -= avail;
+		total += avail;
+	}
+	return total;
+}
+
+static ssize_t srbchannel_writev(struct srbchannel *srb, const struct iovec *iov, uint32_t n_iov)
+{
+	struct srb_ring *r = &srb->write;
+	size_t total = 0, size;
+	const uint8_t *data;
+	int32_t filled;
+	uint32_t i, avail;
+
+	for (i = 0; i < n_iov; i++) {
+		data = iov[i].iov_base;
+		size = iov[i].iov_len;
+
+		while (size > 0) {
+			filled = __atomic_load_n(r->count, __ATOMIC_SEQ_CST);
+			if (filled < 0 || (uint32_t)filled > srb->capacity)
+				return -EPROTO;
+			avail = SPA_MIN(srb->capacity - filled, srb->capacity - r->index);
+			avail = SPA_MIN(avail, size);
+			if (avail == 0)
+				goto done;
+
+			memcpy(r->data + r->index, data, avail);
+			r->index = (r->index + avail) % srb->capacity;
+			__atomic_fetch_add(r->count, avail, __ATOMIC_SEQ_CST);
+
+			data += avail;
+			size -= avail;
+			total += avail;
+		}
+	}
+done:
+	if (total > 0)
+		srbchannel_post(srb);
+	return total;
+}
@@ -43,6 +43,7 @@
 #include <spa/utils/result.h>
 
 #include <pipewire/impl.h>
+#include <pipewire/private.h>
 
 #define DEFAULT_NICE_LEVEL	-11
 #define DEFAULT_RT_PRIO		20
@@ -468,6 +469,7 @@ static void idle_func(struct spa_source *source)
 	int r, rtprio;
 	long long rttime;
 	uint64_t count;
+	uint32_t i;
 
 	spa_system_eventfd_read(impl->system, impl->source.fd, &count);
 
@@ -507,6 +509,18 @@ static void idle_func(struct spa_source *source)
 	} else {
 		pw_log_info("processing thread made realtime prio:%d", rtprio);
 	}
+
+	/* the other data loop workers run node processing as well */
+	for (i = 1; i < impl->context->n_data_loops; i++) {
+		pid_t tid = impl->context->data_loops[i]->tid;
+
+		if (tid == 0)
+			continue;
+		if ((r = pw_rtkit_make_realtime(impl->system_bus, tid, rtprio)) < 0)
+			pw_log_warn("could not make worker %u realtime: %s", i, spa_strerror(r));
+		else
+			pw_log_info("processing worker %u made realtime prio:%d", i, rtprio);
+	}
 exit:
 	pw_rtkit_bus_free(impl->system_bus);
 	impl->system_bus = NULL;
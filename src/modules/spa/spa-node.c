@@ -245,9 +245,19 @@ struct pw_impl_node *pw_spa_node_load(struct pw_context *context,
 	struct spa_handle *handle;
 	void *iface;
 
+	if (properties == NULL)
+		properties = pw_properties_new(NULL, NULL);
+	if (properties == NULL) {
+		res = -errno;
+		goto error_exit;
+	}
+
+	/* the handle and the node use the same data loop */
+	pw_context_select_data_loop(context, properties);
+
 	handle = pw_context_load_spa_handle(context,
 			factory_name,
-			properties ? &properties->dict : NULL);
+			&properties->dict);
 	if (handle == NULL) {
 		res = -errno;
 		goto error_exit;
@@ -262,10 +272,8 @@ struct pw_impl_node *pw_spa_node_load(struct pw_context *context,
 
 	spa_node = iface;
 
-	if (properties != NULL) {
-		if ((res = setup_props(context, spa_node, properties)) < 0) {
-			pw_log_warn("can't setup properties: %s", spa_strerror(res));
-		}
+	if ((res = setup_props(context, spa_node, properties)) < 0) {
+		pw_log_warn("can't setup properties: %s", spa_strerror(res));
 	}
 
 	this = pw_spa_node_new(context, flags,
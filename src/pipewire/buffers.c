@@ -129,7 +129,8 @@ static int alloc_buffers(struct pw_mempool *pool,
 		m = pw_mempool_alloc(pool,
 				PW_MEMBLOCK_FLAG_READWRITE |
 				PW_MEMBLOCK_FLAG_SEAL |
-				PW_MEMBLOCK_FLAG_MAP,
+				PW_MEMBLOCK_FLAG_MAP |
+				PW_MEMBLOCK_FLAG_SLAB,
 				SPA_DATA_MemFd,
 				n_buffers * info.mem_size);
 		if (m == NULL) {
@@ -58,14 +58,32 @@
 #define DEFAULT_VIDEO_RATE_NUM		25u
 #define DEFAULT_VIDEO_RATE_DENOM	1u
 #define DEFAULT_LINK_MAX_BUFFERS	64u
+#define DEFAULT_LINK_FORMAT_CACHE	64u
 #define DEFAULT_MEM_WARN_MLOCK		false
 #define DEFAULT_MEM_ALLOW_MLOCK		true
+#define DEFAULT_NUM_DATA_LOOPS		1u
 
 /** \cond */
 struct impl {
 	struct pw_context this;
 	struct spa_handle *dbus_handle;
-	unsigned int recalc;
+	uint32_t data_loop_users[MAX_DATA_LOOPS];
+	struct spa_support data_loop_support[MAX_DATA_LOOPS][16];	/* support with the DataLoop
+								 * and DataSystem of the loop */
+
+#define GROUP_HASH_SIZE	64u
+	struct spa_list groups[GROUP_HASH_SIZE];	/* nodes with a group_id, hashed on
+							 * the group_id */
+	struct spa_list recalc_list;			/* nodes touched by the current recalc */
+	struct pw_impl_node *target;			/* target for unassigned nodes of the
+							 * last recalc */
+
+	struct spa_list format_cache;			/* format_entry, most recently used first */
+	uint32_t n_format_cache;
+
+	unsigned int recalc:1;
+	unsigned int recalc_partial:1;
+	unsigned int recalc_escaped:1;
 };
 
 
@@ -74,6 +92,17 @@ struct factory_entry {
 	char *lib;
 };
 
+/* the result of a format negotiation between two ports, keyed on the
+ * hashes of the params that were used */
+struct format_entry {
+	struct spa_list link;
+	uint32_t mode;
+	uint64_t output;
+	uint64_t input;
+	uint64_t filters;
+	struct spa_pod *format;
+};
+
 static void fill_properties(struct pw_context *context)
 {
 	struct pw_properties *properties = context->properties;
@@ -146,6 +175,7 @@ static void fill_defaults(struct pw_context *this)
 	this->defaults.video_rate.num = get_default_int(p, "default.video.rate.num", DEFAULT_VIDEO_RATE_NUM);
 	this->defaults.video_rate.denom = get_default_int(p, "default.video.rate.denom", DEFAULT_VIDEO_RATE_DENOM);
 	this->defaults.link_max_buffers = get_default_int(p, "link.max-buffers", DEFAULT_LINK_MAX_BUFFERS);
+	this->defaults.link_format_cache = get_default_int(p, "link.format-cache", DEFAULT_LINK_FORMAT_CACHE);
 	this->defaults.mem_warn_mlock = get_default_bool(p, "mem.warn-mlock", DEFAULT_MEM_WARN_MLOCK);
 	this->defaults.mem_allow_mlock = get_default_bool(p, "mem.allow-mlock", DEFAULT_MEM_ALLOW_MLOCK);
 
@@ -177,6 +207,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	uint32_t n_support;
 	struct pw_properties *pr, *conf = NULL;
 	struct spa_cpu *cpu;
+	uint32_t i, n_data_loops;
 	int res = 0;
 
 	impl = calloc(1, sizeof(struct impl) + user_data_size);
@@ -257,15 +288,43 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	pr = pw_properties_copy(properties);
 	if ((str = pw_properties_get(pr, "context.data-loop." PW_KEY_LIBRARY_NAME_SYSTEM)))
 		pw_properties_set(pr, PW_KEY_LIBRARY_NAME_SYSTEM, str);
+	if ((str = pw_properties_get(pr, "context.data-loop.system.uring.sqpoll")))
+		pw_properties_set(pr, "system.uring.sqpoll", str);
+	if ((str = pw_properties_get(pr, "context.data-loop.loop.dispatch-budget")))
+		pw_properties_set(pr, "loop.dispatch-budget", str);
 
 	this->data_loop_impl = pw_data_loop_new(&pr->dict);
-	pw_properties_free(pr);
 	if (this->data_loop_impl == NULL)  {
 		res = -errno;
+		pw_properties_free(pr);
 		goto error_free;
 	}
+	this->data_loops[this->n_data_loops++] = this->data_loop_impl;
+
+	/* nodes are spread over the data loops, see pw_context_select_data_loop() */
+	n_data_loops = get_default_int(properties, "context.num-data-loops", DEFAULT_NUM_DATA_LOOPS);
+	if ((int32_t)n_data_loops < 1) {
+		pw_log_warn(NAME" %p: invalid context.num-data-loops %d, using %u", this,
+				(int32_t)n_data_loops, DEFAULT_NUM_DATA_LOOPS);
+		n_data_loops = DEFAULT_NUM_DATA_LOOPS;
+	}
+	n_data_loops = SPA_MIN(n_data_loops, MAX_DATA_LOOPS);
+	for (i = 1; i < n_data_loops; i++) {
+		struct pw_data_loop *l = pw_data_loop_new(&pr->dict);
+		if (l == NULL) {
+			pw_log_warn(NAME" %p: can't create data loop %u: %m", this, i);
+			break;
+		}
+		this->data_loops[this->n_data_loops++] = l;
+	}
+	pw_properties_free(pr);
+	pw_log_debug(NAME" %p: %u data loops", this, this->n_data_loops);
 
-	this->pool = pw_mempool_new(NULL);
+	this->pool = pw_mempool_new(pw_properties_new(
+				"mem.slab-size", pw_properties_get(properties, "mem.slab-size"),
+				"mem.slab-hugepages", pw_properties_get(properties, "mem.slab-hugepages"),
+				"mem.slab-prefault", pw_properties_get(properties, "mem.slab-prefault"),
+				NULL));
 	if (this->pool == NULL) {
 		res = -errno;
 		goto error_free_loop;
@@ -305,6 +364,20 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	}
 	this->n_support = n_support;
 
+	for (i = 1; i < this->n_data_loops; i++) {
+		struct pw_loop *l = pw_data_loop_get_loop(this->data_loops[i]);
+		struct spa_support *s = impl->data_loop_support[i];
+		uint32_t j;
+
+		memcpy(s, this->support, n_support * sizeof(struct spa_support));
+		for (j = 0; j < n_support; j++) {
+			if (strcmp(s[j].type, SPA_TYPE_INTERFACE_DataLoop) == 0)
+				s[j].data = l->loop;
+			else if (strcmp(s[j].type, SPA_TYPE_INTERFACE_DataSystem) == 0)
+				s[j].data = l->system;
+		}
+	}
+
 	pw_array_init(&this->factory_lib, 32);
 	pw_array_init(&this->objects, 32);
 	pw_map_init(&this->globals, 128, 32);
@@ -318,6 +391,10 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	spa_list_init(&this->device_list);
 	spa_list_init(&this->client_list);
 	spa_list_init(&this->node_list);
+	for (i = 0; i < GROUP_HASH_SIZE; i++)
+		spa_list_init(&impl->groups[i]);
+	spa_list_init(&impl->recalc_list);
+	spa_list_init(&impl->format_cache);
 	spa_list_init(&this->factory_list);
 	spa_list_init(&this->link_list);
 	spa_list_init(&this->control_list[0]);
@@ -336,8 +413,10 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 
 	fill_properties(this);
 
-	if ((res = pw_data_loop_start(this->data_loop_impl)) < 0)
-		goto error_free_loop;
+	for (i = 0; i < this->n_data_loops; i++) {
+		if ((res = pw_data_loop_start(this->data_loops[i])) < 0)
+			goto error_free_loop;
+	}
 
 	this->sc_pagesize = sysconf(_SC_PAGESIZE);
 
@@ -351,7 +430,8 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	return this;
 
 error_free_loop:
-	pw_data_loop_destroy(this->data_loop_impl);
+	for (i = 0; i < this->n_data_loops; i++)
+		pw_data_loop_destroy(this->data_loops[i]);
 error_free:
 	free(this);
 error_cleanup:
@@ -381,7 +461,9 @@ void pw_context_destroy(struct pw_context *context)
 	struct pw_resource *resource;
 	struct pw_impl_node *node;
 	struct factory_entry *entry;
+	struct format_entry *format;
 	struct pw_impl_core *core_impl;
+	uint32_t i;
 
 	pw_log_debug(NAME" %p: destroy", context);
 	pw_context_emit_destroy(context);
@@ -415,7 +497,8 @@ void pw_context_destroy(struct pw_context *context)
 
 	pw_mempool_destroy(context->pool);
 
-	pw_data_loop_destroy(context->data_loop_impl);
+	for (i = 0; i < context->n_data_loops; i++)
+		pw_data_loop_destroy(context->data_loops[i]);
 
 	pw_properties_free(context->properties);
 	pw_properties_free(context->conf);
@@ -429,6 +512,11 @@ void pw_context_destroy(struct pw_context *context)
 	}
 	pw_array_clear(&context->factory_lib);
 
+	spa_list_consume(format, &impl->format_cache, link) {
+		spa_list_remove(&format->link);
+		free(format);
+	}
+
 	pw_array_clear(&context->objects);
 
 	pw_map_clear(&context->globals);
@@ -675,53 +763,27 @@ SPA_PRINTF_FUNC(7, 8) int pw_context_debug_port_params(struct pw_context *this,
         return 0;
 }
 
-/** Find a common format between two ports
- *
- * \param context a context object
- * \param output an output port
- * \param input an input port
- * \param props extra properties
- * \param n_format_filters number of format filters
- * \param format_filters array of format filters
- * \param[out] error an error when something is wrong
- * \return a common format of NULL on error
- *
- * Find a common format between the given ports. The format will
- * be restricted to a subset given with the format filters.
- *
- * \memberof pw_context
- */
-int pw_context_find_format(struct pw_context *context,
+enum {
+	FORMAT_INPUT = 1,	/* only the input port needs a format */
+	FORMAT_OUTPUT,		/* only the output port needs a format */
+	FORMAT_BOTH,		/* both ports need a format */
+};
+
+static int find_format(struct pw_context *context, uint32_t mode,
 			struct pw_impl_port *output,
 			struct pw_impl_port *input,
-			struct pw_properties *props,
-			uint32_t n_format_filters,
-			struct spa_pod **format_filters,
 			struct spa_pod **format,
 			struct spa_pod_builder *builder,
 			char **error)
 {
-	uint32_t out_state, in_state;
 	int res;
 	uint32_t iidx = 0, oidx = 0;
 	struct spa_pod_builder fb = { 0 };
 	uint8_t fbuf[4096];
 	struct spa_pod *filter;
 
-	out_state = output->state;
-	in_state = input->state;
-
-	pw_log_debug(NAME" %p: finding best format %d %d", context, out_state, in_state);
-
-	/* when a port is configured but the node is idle, we can reconfigure with a different format */
-	if (out_state > PW_IMPL_PORT_STATE_CONFIGURE && output->node->info.state == PW_NODE_STATE_IDLE)
-		out_state = PW_IMPL_PORT_STATE_CONFIGURE;
-	if (in_state > PW_IMPL_PORT_STATE_CONFIGURE && input->node->info.state == PW_NODE_STATE_IDLE)
-		in_state = PW_IMPL_PORT_STATE_CONFIGURE;
-
-	pw_log_debug(NAME" %p: states %d %d", context, out_state, in_state);
-
-	if (in_state == PW_IMPL_PORT_STATE_CONFIGURE && out_state > PW_IMPL_PORT_STATE_CONFIGURE) {
+	switch (mode) {
+	case FORMAT_INPUT:
 		/* only input needs format */
 		spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
 		if ((res = spa_node_port_enum_params_sync(output->node->node,
@@ -750,7 +812,8 @@ int pw_context_find_format(struct pw_context *context,
 				goto error;
 			}
 		}
-	} else if (out_state >= PW_IMPL_PORT_STATE_CONFIGURE && in_state > PW_IMPL_PORT_STATE_CONFIGURE) {
+		break;
+	case FORMAT_OUTPUT:
 		/* only output needs format */
 		spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
 		if ((res = spa_node_port_enum_params_sync(input->node->node,
@@ -779,7 +842,8 @@ int pw_context_find_format(struct pw_context *context,
 				goto error;
 			}
 		}
-	} else if (in_state == PW_IMPL_PORT_STATE_CONFIGURE && out_state == PW_IMPL_PORT_STATE_CONFIGURE) {
+		break;
+	case FORMAT_BOTH:
 	      again:
 		/* both ports need a format */
 		pw_log_debug(NAME" %p: do enum input %d", context, iidx);
@@ -816,7 +880,8 @@ int pw_context_find_format(struct pw_context *context,
 
 		pw_log_debug(NAME" %p: Got filtered:", context);
 		pw_log_format(SPA_LOG_LEVEL_DEBUG, *format);
-	} else {
+		break;
+	default:
 		res = -EBADF;
 		*error = spa_aprintf("error bad node state");
 		goto error;
@@ -828,6 +893,204 @@ error:
 	return res;
 }
 
+static inline uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+	/* FNV-1a */
+	const uint8_t *p = data;
+	while (size--)
+		hash = (hash ^ *p++) * 1099511628211ull;
+	return hash;
+}
+
+/* hash all params of the port with the given id. The hash is kept until
+ * the port changes the params or gets a new format. Returns 0 when a param
+ * does not fit in the buffer, the port can then not be cached. */
+static uint64_t port_params_hash(struct pw_impl_port *port, uint32_t id)
+{
+	uint64_t *hash = &port->format_hash[id == SPA_PARAM_Format ? 1 : 0];
+	uint8_t buffer[4096];
+	struct spa_pod_builder b;
+	struct spa_pod *param;
+	uint32_t index = 0;
+	uint64_t h;
+	int res;
+
+	if (*hash != 0)
+		return *hash;
+
+	h = hash_data(14695981039346656037ull, &id, sizeof(id));
+	while (true) {
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		if ((res = spa_node_port_enum_params_sync(port->node->node,
+						port->direction, port->port_id,
+						id, &index, NULL, &param, &b)) != 1)
+			break;
+		/* the builder does not copy a param that overflows it */
+		if (b.state.offset > sizeof(buffer))
+			return 0;
+		h = hash_data(h, param, SPA_POD_SIZE(param));
+	}
+	if (res == -ENOSPC)
+		return 0;
+	/* the negotiation also depends on the errors */
+	h = hash_data(h, &res, sizeof(res));
+
+	*hash = h ? h : 1;
+	return *hash;
+}
+
+static struct format_entry *format_cache_find(struct impl *impl,
+		const struct format_entry *key)
+{
+	struct format_entry *e;
+
+	spa_list_for_each(e, &impl->format_cache, link) {
+		if (e->mode == key->mode && e->output == key->output &&
+		    e->input == key->input && e->filters == key->filters) {
+			spa_list_remove(&e->link);
+			spa_list_prepend(&impl->format_cache, &e->link);
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static void format_cache_add(struct impl *impl, const struct format_entry *key,
+		const struct spa_pod *format)
+{
+	struct format_entry *e;
+	uint32_t size = SPA_POD_SIZE(format);
+
+	if (impl->n_format_cache >= impl->this.defaults.link_format_cache) {
+		e = spa_list_last(&impl->format_cache, struct format_entry, link);
+		spa_list_remove(&e->link);
+		free(e);
+		impl->n_format_cache--;
+	}
+	if ((e = malloc(sizeof(struct format_entry) + size)) == NULL)
+		return;
+
+	*e = *key;
+	e->format = SPA_MEMBER(e, sizeof(struct format_entry), struct spa_pod);
+	memcpy(e->format, format, size);
+	spa_list_prepend(&impl->format_cache, &e->link);
+	impl->n_format_cache++;
+}
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/** Find a common format between two ports
+ *
+ * \param context a context object
+ * \param output an output port
+ * \param input an input port
+ * \param props extra properties
+ * \param n_format_filters number of format filters
+ * \param format_filters array of format filters
+ * \param[out] error an error when something is wrong
+ * \return a common format of NULL on error
+ *
+ * Find a common format between the given ports. The format will
+ * be restricted to a subset given with the format filters.
+ *
+ * The result only depends on the params of the ports. It is cached on a
+ * hash of them so that links between ports with the same formats, like
+ * the streams of the same application, don't need to negotiate again.
+ *
+ * \memberof pw_context
+ */
+int pw_context_find_format(struct pw_context *context,
+			struct pw_impl_port *output,
+			struct pw_impl_port *input,
+			struct pw_properties *props,
+			uint32_t n_format_filters,
+			struct spa_pod **format_filters,
+			struct spa_pod **format,
+			struct spa_pod_builder *builder,
+			char **error)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	struct format_entry key, *e;
+	uint32_t out_state, in_state, offset, i;
+	uint64_t t1, t2;
+	int res;
+
+	out_state = output->state;
+	in_state = input->state;
+
+	pw_log_debug(NAME" %p: finding best format %d %d", context, out_state, in_state);
+
+	/* when a port is configured but the node is idle, we can reconfigure with a different format */
+	if (out_state > PW_IMPL_PORT_STATE_CONFIGURE && output->node->info.state == PW_NODE_STATE_IDLE)
+		out_state = PW_IMPL_PORT_STATE_CONFIGURE;
+	if (in_state > PW_IMPL_PORT_STATE_CONFIGURE && input->node->info.state == PW_NODE_STATE_IDLE)
+		in_state = PW_IMPL_PORT_STATE_CONFIGURE;
+
+	pw_log_debug(NAME" %p: states %d %d", context, out_state, in_state);
+
+	if (in_state == PW_IMPL_PORT_STATE_CONFIGURE && out_state > PW_IMPL_PORT_STATE_CONFIGURE)
+		key.mode = FORMAT_INPUT;
+	else if (out_state >= PW_IMPL_PORT_STATE_CONFIGURE && in_state > PW_IMPL_PORT_STATE_CONFIGURE)
+		key.mode = FORMAT_OUTPUT;
+	else if (in_state == PW_IMPL_PORT_STATE_CONFIGURE && out_state == PW_IMPL_PORT_STATE_CONFIGURE)
+		key.mode = FORMAT_BOTH;
+	else
+		key.mode = 0;
+
+	if (key.mode == 0 || context->defaults.link_format_cache == 0)
+		return find_format(context, key.mode, output, input, format, builder, error);
+
+	/* a hit also pays for hashing the params of new ports */
+	t1 = get_time_ns();
+	key.output = port_params_hash(output,
+			key.mode == FORMAT_INPUT ? SPA_PARAM_Format : SPA_PARAM_EnumFormat);
+	key.input = port_params_hash(input,
+			key.mode == FORMAT_OUTPUT ? SPA_PARAM_Format : SPA_PARAM_EnumFormat);
+	if (key.output == 0 || key.input == 0)
+		return find_format(context, key.mode, output, input, format, builder, error);
+
+	key.filters = 14695981039346656037ull;
+	for (i = 0; i < n_format_filters; i++) {
+		if (format_filters[i] != NULL)
+			key.filters = hash_data(key.filters, format_filters[i],
+					SPA_POD_SIZE(format_filters[i]));
+	}
+
+	if ((e = format_cache_find(impl, &key)) != NULL) {
+		offset = builder->state.offset;
+		if (spa_pod_builder_raw_padded(builder, e->format, SPA_POD_SIZE(e->format)) >= 0) {
+			*format = spa_pod_builder_deref(builder, offset);
+			t2 = get_time_ns();
+
+			pw_log_debug(NAME" %p: cached format %p for %p -> %p", context,
+					e, output, input);
+			context->format_cache.hits++;
+			context->format_cache.saved_time +=
+				SPA_MAX(context->format_cache.miss_time /
+					SPA_MAX(context->format_cache.misses, 1u), t2 - t1) - (t2 - t1);
+			return 1;
+		}
+		builder->state.offset = offset;
+	}
+
+	t1 = get_time_ns();
+	res = find_format(context, key.mode, output, input, format, builder, error);
+	t2 = get_time_ns();
+
+	context->format_cache.misses++;
+	context->format_cache.miss_time += t2 - t1;
+
+	if (res == 1)
+		format_cache_add(impl, &key, *format);
+
+	return res;
+}
+
 static int ensure_state(struct pw_impl_node *node, bool running)
 {
 	enum pw_node_state state = node->info.state;
@@ -838,8 +1101,113 @@ static int ensure_state(struct pw_impl_node *node, bool running)
 	return pw_impl_node_set_state(node, state);
 }
 
+static void assign_unvisited(struct pw_context *context, struct pw_impl_node *n,
+		struct pw_impl_node *target)
+{
+	struct pw_impl_node *t;
+
+	pw_log_debug(NAME" %p: unassigned node %p: '%s' active:%d want_driver:%d target:%p",
+			context, n, n->name, n->active, n->want_driver, target);
+
+	t = (n->active && n->want_driver) ? target : NULL;
+
+	pw_impl_node_set_driver(n, t);
+	if (t == NULL)
+		ensure_state(n, false);
+	else
+		t->passive = false;
+}
+
+static inline struct spa_list *group_list(struct impl *impl, uint32_t group_id)
+{
+	return &impl->groups[group_id & (GROUP_HASH_SIZE - 1)];
+}
+
+void pw_context_update_node_group(struct pw_context *context, struct pw_impl_node *node)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+
+	spa_list_remove(&node->group_link);
+	spa_list_init(&node->group_link);
+
+	if (node->registered && node->group_id != SPA_ID_INVALID)
+		spa_list_append(group_list(impl, node->group_id), &node->group_link);
+}
+
+/* called when a node is removed from the graph, a destroyed inactive driver
+ * can still be the target of the last recalc */
+void pw_context_forget_node(struct pw_context *context, struct pw_impl_node *node)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+
+	if (impl->target == node)
+		impl->target = NULL;
+}
+
+/* unregistered nodes can be reached over links too, they are added so
+ * that their visited flag is reset but they are never assigned */
+static void recalc_add(struct impl *impl, struct pw_impl_node *node)
+{
+	if (node->recalc || node->exported)
+		return;
+	node->recalc = true;
+	spa_list_append(&impl->recalc_list, &node->recalc_link);
+}
+
+/* all followers of a driver are recalculated together */
+static void recalc_add_driver(struct impl *impl, struct pw_impl_node *driver)
+{
+	struct pw_impl_node *n;
+
+	if (driver->recalc_driver || driver->exported || !driver->registered)
+		return;
+	driver->recalc_driver = true;
+
+	recalc_add(impl, driver);
+	spa_list_for_each(n, &driver->follower_list, follower_link)
+		recalc_add(impl, n);
+}
+
+static inline void recalc_add_peer(struct impl *impl, struct pw_impl_node *peer,
+		bool changed)
+{
+	if (changed)
+		recalc_add_driver(impl, peer->driver_node);
+	else if (peer->driver && !peer->active)
+		recalc_add_driver(impl, peer);
+}
+
+/* Add the drivers that can reach a node. When the node changed, this is
+ * the driver of all linked peers and the nodes in the same group. For the
+ * other nodes, these peers are already collected with them, except for
+ * inactive drivers. They are not reachable but still collect their
+ * peers. */
+static void recalc_add_peers(struct impl *impl, struct pw_impl_node *node, bool changed)
+{
+	struct pw_impl_node *t;
+	struct pw_impl_port *p;
+	struct pw_impl_link *l;
+
+	spa_list_for_each(p, &node->input_ports, link) {
+		spa_list_for_each(l, &p->links, input_link)
+			recalc_add_peer(impl, l->output->node, changed);
+	}
+	spa_list_for_each(p, &node->output_ports, link) {
+		spa_list_for_each(l, &p->links, output_link)
+			recalc_add_peer(impl, l->input->node, changed);
+	}
+	if (node->group_id == SPA_ID_INVALID)
+		return;
+
+	spa_list_for_each(t, group_list(impl, node->group_id), group_link) {
+		if (t->group_id == node->group_id)
+			recalc_add_peer(impl, t, changed);
+	}
+}
+
 static int collect_nodes(struct pw_context *context, struct pw_impl_node *driver)
 {
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
 	struct spa_list queue;
 	struct pw_impl_node *n, *t;
 	struct pw_impl_port *p;
@@ -864,6 +1232,12 @@ static int collect_nodes(struct pw_context *context, struct pw_impl_node *driver
 		pw_impl_node_set_driver(n, driver);
 		n->passive = true;
 
+		/* a partial recalc should only ever reach the nodes it
+		 * collected up front, if not we redo everything */
+		if (impl->recalc_partial && !n->recalc && n->registered)
+			impl->recalc_escaped = true;
+		recalc_add(impl, n);
+
 		spa_list_for_each(p, &n->input_ports, link) {
 			spa_list_for_each(l, &p->links, input_link) {
 				t = l->output->node;
@@ -894,12 +1268,12 @@ static int collect_nodes(struct pw_context *context, struct pw_impl_node *driver
 				}
 			}
 		}
-		/* now go through all the followers of this driver and add the
-		 * nodes that have the same group and that are not yet visited */
+		/* now go through all the nodes that have the same group and
+		 * that are not yet visited */
 		if (n->group_id == SPA_ID_INVALID)
 			continue;
 
-		spa_list_for_each(t, &context->node_list, link) {
+		spa_list_for_each(t, group_list(impl, n->group_id), group_link) {
 			if (t->exported || t == n || !t->active || t->visited)
 				continue;
 			if (t->group_id != n->group_id)
@@ -911,10 +1285,28 @@ static int collect_nodes(struct pw_context *context, struct pw_impl_node *driver
 	return 0;
 }
 
-int pw_context_recalc_graph(struct pw_context *context, const char *reason)
+static void recalc_reset(struct impl *impl)
+{
+	struct pw_impl_node *n;
+
+	spa_list_consume(n, &impl->recalc_list, recalc_link) {
+		spa_list_remove(&n->recalc_link);
+		n->visited = false;
+		n->recalc = false;
+		n->recalc_driver = false;
+	}
+}
+
+/* Recalculate the drivers and followers. With changed nodes, only the
+ * drivers those nodes are (or can be) scheduled with are collected
+ * again, else the complete graph is done. */
+static int recalc_graph(struct pw_context *context, struct pw_impl_node **changed,
+		uint32_t n_changed, const char *reason)
 {
 	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
 	struct pw_impl_node *n, *s, *target, *fallback;
+	bool full = n_changed == 0;
+	uint32_t i;
 
 	pw_log_info(NAME" %p: busy:%d reason:%s", context, impl->recalc, reason);
 
@@ -923,6 +1315,36 @@ int pw_context_recalc_graph(struct pw_context *context, const char *reason)
 
 	impl->recalc = true;
 
+again:
+	impl->recalc_partial = !full;
+	impl->recalc_escaped = false;
+
+	if (!full) {
+		/* everything a changed node can be scheduled with might
+		 * need to move */
+		for (i = 0; i < n_changed; i++) {
+			if (changed[i]->exported)
+				continue;
+			recalc_add_driver(impl, changed[i]->driver_node);
+			recalc_add_peers(impl, changed[i], true);
+		}
+		spa_list_for_each(n, &impl->recalc_list, recalc_link)
+			recalc_add_peers(impl, n, false);
+
+		/* collect the affected drivers, in priority order */
+		spa_list_for_each(n, &context->driver_list, driver_link) {
+			if (n->exported || !n->recalc || n->visited)
+				continue;
+			collect_nodes(context, n);
+		}
+		if (impl->recalc_escaped) {
+			pw_log_debug(NAME" %p: partial recalc escaped, doing full", context);
+			recalc_reset(impl);
+			full = true;
+			goto again;
+		}
+	}
+
 	/* start from all drivers and group all nodes that are linked
 	 * to it. Some nodes are not (yet) linked to anything and they
 	 * will end up 'unassigned' to a driver. Other nodes are drivers
@@ -933,7 +1355,7 @@ int pw_context_recalc_graph(struct pw_context *context, const char *reason)
 		if (n->exported)
 			continue;
 
-		if (!n->visited)
+		if (full && !n->visited)
 			collect_nodes(context, n);
 
 		/* from now on we are only interested in active driving nodes.
@@ -964,28 +1386,36 @@ int pw_context_recalc_graph(struct pw_context *context, const char *reason)
 	if (target == NULL)
 		target = fallback;
 
+	/* the unassigned nodes of the other drivers need to move to the
+	 * new target */
+	if (!full && target != impl->target) {
+		pw_log_debug(NAME" %p: target changed %p->%p, doing full", context,
+				impl->target, target);
+		impl->recalc_partial = false;
+		full = true;
+		spa_list_for_each(n, &context->driver_list, driver_link) {
+			if (!n->exported && !n->visited)
+				collect_nodes(context, n);
+		}
+	}
+	impl->target = target;
+
 	/* now go through all available nodes. The ones we didn't visit
 	 * in collect_nodes() are not linked to any driver. We assign them
 	 * to either an active driver of the first driver */
-	spa_list_for_each(n, &context->node_list, link) {
-		if (n->exported)
-			continue;
-
-		if (!n->visited) {
-			struct pw_impl_node *t;
-
-			pw_log_debug(NAME" %p: unassigned node %p: '%s' active:%d want_driver:%d target:%p",
-					context, n, n->name, n->active, n->want_driver, target);
-
-			t = (n->active && n->want_driver) ? target : NULL;
-
-			pw_impl_node_set_driver(n, t);
-			if (t == NULL)
-				ensure_state(n, false);
-			else
-				t->passive = false;
+	if (full) {
+		spa_list_for_each(n, &context->node_list, link) {
+			if (n->exported)
+				continue;
+			if (!n->visited)
+				assign_unvisited(context, n, target);
+			n->visited = false;
+		}
+	} else {
+		spa_list_for_each(n, &impl->recalc_list, recalc_link) {
+			if (!n->visited && n->registered)
+				assign_unvisited(context, n, target);
 		}
-		n->visited = false;
 	}
 
 	/* assign final quantum and set state for followers and drivers */
@@ -998,6 +1428,10 @@ int pw_context_recalc_graph(struct pw_context *context, const char *reason)
 		if (!n->driving || n->exported)
 			continue;
 
+		/* drivers that were not collected keep their followers */
+		if (!full && !n->recalc && n != target)
+			continue;
+
 		/* collect quantum and count active nodes */
 		spa_list_for_each(s, &n->follower_list, follower_link) {
 			if (s->quantum_size > 0) {
@@ -1038,10 +1472,145 @@ int pw_context_recalc_graph(struct pw_context *context, const char *reason)
 		}
 		ensure_state(n, running);
 	}
+	recalc_reset(impl);
+	impl->recalc_partial = false;
 	impl->recalc = false;
 	return 0;
 }
 
+int pw_context_recalc_graph(struct pw_context *context, const char *reason)
+{
+	return recalc_graph(context, NULL, 0, reason);
+}
+
+/** Recalculate the graph after a change to \a node and optionally \a peer.
+ *
+ * Only the nodes that can be scheduled together with the changed nodes are
+ * reassigned, the rest of the graph is left alone. */
+int pw_context_recalc_nodes(struct pw_context *context, struct pw_impl_node *node,
+		struct pw_impl_node *peer, const char *reason)
+{
+	struct pw_impl_node *changed[2];
+	uint32_t n_changed = 0;
+
+	changed[n_changed++] = node;
+	if (peer != NULL && peer != node)
+		changed[n_changed++] = peer;
+
+	return recalc_graph(context, changed, n_changed, reason);
+}
+
+static uint32_t data_loop_index(struct pw_context *context, const struct spa_dict *props)
+{
+	const char *str;
+	uint32_t index;
+
+	if (props == NULL || (str = spa_dict_lookup(props, PW_KEY_NODE_DATA_LOOP)) == NULL)
+		return 0;
+
+	index = atoi(str);
+	if (index >= context->n_data_loops) {
+		pw_log_warn(NAME" %p: invalid data loop %s, using 0", context, str);
+		index = 0;
+	}
+	return index;
+}
+
+/** Select a data loop for a new node
+ *
+ * \param context a context
+ * \param properties the properties of the new node
+ * \return the index of the data loop
+ *
+ * Select the least used data loop and store it in the
+ * PW_KEY_NODE_DATA_LOOP property when it is not set yet. The spa
+ * handle loaded and the node created with the properties both use
+ * the selected data loop, so that nodes that become ready at the same
+ * time can be processed in parallel.
+ *
+ * \memberof pw_context
+ */
+SPA_EXPORT
+uint32_t pw_context_select_data_loop(struct pw_context *context, struct pw_properties *properties)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	uint32_t i, best = 0;
+
+	if (pw_properties_get(properties, PW_KEY_NODE_DATA_LOOP) != NULL)
+		return data_loop_index(context, &properties->dict);
+
+	for (i = 1; i < context->n_data_loops; i++) {
+		if (impl->data_loop_users[i] < impl->data_loop_users[best])
+			best = i;
+	}
+	pw_properties_setf(properties, PW_KEY_NODE_DATA_LOOP, "%u", best);
+	return best;
+}
+
+struct pw_loop *pw_context_acquire_data_loop(struct pw_context *context, const struct spa_dict *props)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	uint32_t index = data_loop_index(context, props);
+
+	impl->data_loop_users[index]++;
+
+	pw_log_debug(NAME" %p: data loop %u users:%u", context, index,
+			impl->data_loop_users[index]);
+
+	return pw_data_loop_get_loop(context->data_loops[index]);
+}
+
+void pw_context_release_data_loop(struct pw_context *context, struct pw_loop *loop)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	uint32_t i;
+
+	for (i = 0; i < context->n_data_loops; i++) {
+		if (pw_data_loop_get_loop(context->data_loops[i]) != loop)
+			continue;
+		if (impl->data_loop_users[i] > 0)
+			impl->data_loop_users[i]--;
+		break;
+	}
+}
+
+struct invoke_data_loops {
+	spa_invoke_func_t func;
+	void *data;
+	uint32_t index;
+};
+
+static int do_invoke_data_loops(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_context *context = user_data;
+	struct invoke_data_loops d = *(const struct invoke_data_loops *)data;
+
+	if (d.index == 0)
+		return d.func(loop, async, seq, NULL, 0, d.data);
+
+	/* keep this data loop blocked until the next ones are done */
+	d.index--;
+	return pw_loop_invoke(pw_data_loop_get_loop(context->data_loops[d.index]),
+			do_invoke_data_loops, seq, &d, sizeof(d), true, context);
+}
+
+/** Invoke \a func in the first data loop while all other data loops
+ * are blocked, for changes to things that all data loops use. */
+SPA_EXPORT
+int pw_context_invoke_data_loops(struct pw_context *context,
+		spa_invoke_func_t func, void *data)
+{
+	struct invoke_data_loops d;
+
+	d.func = func;
+	d.data = data;
+	d.index = context->n_data_loops - 1;
+
+	return pw_loop_invoke(pw_data_loop_get_loop(context->data_loops[d.index]),
+			do_invoke_data_loops, SPA_ID_INVALID, &d, sizeof(d), true, context);
+}
+
 SPA_EXPORT
 int pw_context_add_spa_lib(struct pw_context *context,
 		const char *factory_regexp, const char *lib)
@@ -1084,9 +1653,10 @@ struct spa_handle *pw_context_load_spa_handle(struct pw_context *context,
 		const char *factory_name,
 		const struct spa_dict *info)
 {
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
 	const char *lib;
 	const struct spa_support *support;
-	uint32_t n_support;
+	uint32_t n_support, index;
 	struct spa_handle *handle;
 
 	pw_log_debug(NAME" %p: load factory %s", context, factory_name);
@@ -1102,6 +1672,8 @@ struct spa_handle *pw_context_load_spa_handle(struct pw_context *context,
 	}
 
 	support = pw_context_get_support(context, &n_support);
+	if ((index = data_loop_index(context, info)) > 0)
+		support = impl->data_loop_support[index];
 
 	handle = pw_load_spa_handle(lib, factory_name,
 			info, n_support, support);
@@ -163,6 +163,9 @@ struct spa_handle *pw_context_load_spa_handle(struct pw_context *context,
 		const char *factory_name,
 		const struct spa_dict *info);
 
+/** select the data loop for a new node and store it in the properties */
+uint32_t pw_context_select_data_loop(struct pw_context *context, struct pw_properties *properties);
+
 
 /** data for registering export functions */
 struct pw_export_type {
@@ -24,7 +24,9 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <unistd.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "pipewire/log.h"
 #include "pipewire/data-loop.h"
@@ -62,6 +64,7 @@ static void thread_cleanup(void *arg)
 	struct pw_data_loop *this = arg;
 	pw_log_debug(NAME" %p: leave thread", this);
 	this->running = false;
+	this->tid = 0;
 	pw_loop_leave(this->loop);
 }
 
@@ -71,6 +74,9 @@ static void *do_loop(void *user_data)
 	int res;
 
 	pw_log_debug(NAME" %p: enter thread", this);
+#ifdef SYS_gettid
+	this->tid = (pid_t) syscall(SYS_gettid);
+#endif
 	pw_loop_enter(this->loop);
 
 	pthread_cleanup_push(thread_cleanup, this);
@@ -87,6 +87,7 @@ static void info_changed(struct pw_impl_link *link)
 
 static void link_update_state(struct pw_impl_link *link, enum pw_link_state state, int res, char *error)
 {
+	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
 	enum pw_link_state old = link->info.state;
 
 	link->info.state = state;
@@ -126,11 +127,13 @@ static void link_update_state(struct pw_impl_link *link, enum pw_link_state stat
 	if (old < PW_LINK_STATE_PAUSED && state == PW_LINK_STATE_PAUSED) {
 		link->prepared = true;
 		link->preparing = false;
-		pw_context_recalc_graph(link->context, "link prepared");
+		pw_context_recalc_nodes(link->context, impl->onode, impl->inode,
+				"link prepared");
 	} else if (old == PW_LINK_STATE_PAUSED && state < PW_LINK_STATE_PAUSED) {
 		link->prepared = false;
 		link->preparing = false;
-		pw_context_recalc_graph(link->context, "link unprepared");
+		pw_context_recalc_nodes(link->context, impl->onode, impl->inode,
+				"link unprepared");
 	}
 }
 
@@ -500,30 +503,70 @@ error:
 	return res;
 }
 
-static int
-do_activate_link(struct spa_loop *loop,
-		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+/* the input and output nodes can be processed in different data loops,
+ * each side of the link is changed in the data loop of its node */
+static void activate_input(struct pw_impl_link *this)
 {
-	struct pw_impl_link *this = user_data;
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 
-	pw_log_trace(NAME" %p: activate", this);
-
-	spa_list_append(&this->output->rt.mix_list, &this->rt.out_mix.rt_link);
 	spa_list_append(&this->input->rt.mix_list, &this->rt.in_mix.rt_link);
 
 	if (impl->inode != impl->onode) {
 		struct pw_node_activation_state *state;
 
 		this->rt.target.activation = impl->inode->rt.activation;
-		spa_list_append(&impl->onode->rt.target_list, &this->rt.target.link);
-
 		state = &this->rt.target.activation->state[0];
 		state->required++;
 
 		pw_log_trace(NAME" %p: node:%p state:%p pending:%d/%d", this, impl->inode,
 				state, state->pending, state->required);
 	}
+}
+
+static void activate_output(struct pw_impl_link *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+
+	spa_list_append(&this->output->rt.mix_list, &this->rt.out_mix.rt_link);
+
+	if (impl->inode != impl->onode)
+		spa_list_append(&impl->onode->rt.target_list, &this->rt.target.link);
+}
+
+static int
+do_activate_link(struct spa_loop *loop,
+		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_link *this = user_data;
+
+	pw_log_trace(NAME" %p: activate", this);
+
+	activate_input(this);
+	activate_output(this);
+	return 0;
+}
+
+static int
+do_activate_input(struct spa_loop *loop,
+		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_link *this = user_data;
+
+	pw_log_trace(NAME" %p: activate input", this);
+
+	activate_input(this);
+	return 0;
+}
+
+static int
+do_activate_output(struct spa_loop *loop,
+		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_link *this = user_data;
+
+	pw_log_trace(NAME" %p: activate output", this);
+
+	activate_output(this);
 	return 0;
 }
 
@@ -548,8 +591,16 @@ int pw_impl_link_activate(struct pw_impl_link *this)
 			return res;
 		impl->io_set = true;
 	}
-	pw_loop_invoke(this->output->node->data_loop,
-	       do_activate_link, SPA_ID_INVALID, NULL, 0, false, this);
+	if (this->output->node->data_loop == this->input->node->data_loop) {
+		pw_loop_invoke(this->output->node->data_loop,
+		       do_activate_link, SPA_ID_INVALID, NULL, 0, false, this);
+	} else {
+		/* the input counts the link before the output can trigger it */
+		pw_loop_invoke(this->input->node->data_loop,
+		       do_activate_input, SPA_ID_INVALID, NULL, 0, true, this);
+		pw_loop_invoke(this->output->node->data_loop,
+		       do_activate_output, SPA_ID_INVALID, NULL, 0, false, this);
+	}
 
 	impl->activated = true;
 	pw_log_info("(%s) activated", this->name);
@@ -676,29 +727,65 @@ int pw_impl_link_prepare(struct pw_impl_link *this)
 	return 0;
 }
 
-static int
-do_deactivate_link(struct spa_loop *loop,
-		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+static void deactivate_output(struct pw_impl_link *this)
 {
-        struct pw_impl_link *this = user_data;
-	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	spa_list_remove(&this->rt.out_mix.rt_link);
 
-	pw_log_trace(NAME" %p: disable %p and %p", this, &this->rt.in_mix, &this->rt.out_mix);
+	if (this->input->node != this->output->node)
+		spa_list_remove(&this->rt.target.link);
+}
+
+static void deactivate_input(struct pw_impl_link *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 
-	spa_list_remove(&this->rt.out_mix.rt_link);
 	spa_list_remove(&this->rt.in_mix.rt_link);
 
 	if (this->input->node != this->output->node) {
 		struct pw_node_activation_state *state;
 
-		spa_list_remove(&this->rt.target.link);
 		state = &this->rt.target.activation->state[0];
 		state->required--;
 
 		pw_log_trace(NAME" %p: node:%p state:%p pending:%d/%d", this, impl->inode,
 				state, state->pending, state->required);
 	}
+}
+
+static int
+do_deactivate_link(struct spa_loop *loop,
+		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+        struct pw_impl_link *this = user_data;
+
+	pw_log_trace(NAME" %p: disable %p and %p", this, &this->rt.in_mix, &this->rt.out_mix);
+
+	deactivate_output(this);
+	deactivate_input(this);
+	return 0;
+}
+
+static int
+do_deactivate_output(struct spa_loop *loop,
+		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+        struct pw_impl_link *this = user_data;
+
+	pw_log_trace(NAME" %p: disable %p", this, &this->rt.out_mix);
+
+	deactivate_output(this);
+	return 0;
+}
+
+static int
+do_deactivate_input(struct spa_loop *loop,
+		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+        struct pw_impl_link *this = user_data;
 
+	pw_log_trace(NAME" %p: disable %p", this, &this->rt.in_mix);
+
+	deactivate_input(this);
 	return 0;
 }
 
@@ -711,8 +798,16 @@ int pw_impl_link_deactivate(struct pw_impl_link *this)
 	if (!impl->activated)
 		return 0;
 
-	pw_loop_invoke(this->output->node->data_loop,
-		       do_deactivate_link, SPA_ID_INVALID, NULL, 0, true, this);
+	if (this->output->node->data_loop == this->input->node->data_loop) {
+		pw_loop_invoke(this->output->node->data_loop,
+			       do_deactivate_link, SPA_ID_INVALID, NULL, 0, true, this);
+	} else {
+		/* the output stops triggering the input before it is uncounted */
+		pw_loop_invoke(this->output->node->data_loop,
+			       do_deactivate_output, SPA_ID_INVALID, NULL, 0, true, this);
+		pw_loop_invoke(this->input->node->data_loop,
+			       do_deactivate_input, SPA_ID_INVALID, NULL, 0, true, this);
+	}
 
 	port_set_io(this, this->output, SPA_IO_Buffers, NULL, 0,
 			&this->rt.out_mix);
@@ -900,30 +995,155 @@ static const struct pw_impl_node_events output_node_events = {
 	.active_changed = node_active_changed,
 };
 
-static bool pw_impl_node_can_reach(struct pw_impl_node *output, struct pw_impl_node *input)
+/* The nodes are kept in a topological order over the links without
+ * feedback, after Pearce and Kelly: a node comes before all the nodes it
+ * links to. A new link can only close a cycle when its input node is
+ * not already after its output node. Only the nodes between the two in
+ * the order are then searched and reordered to make room for the link. */
+struct topo_search {
+	uint64_t visit;
+	uint64_t lower;			/* order of the input node */
+	uint64_t upper;			/* order of the output node */
+	struct pw_impl_node *target;	/* the output node */
+	struct pw_array forward;	/* nodes after the input node */
+	struct pw_array backward;	/* nodes before the output node */
+};
+
+static int topo_forward(struct topo_search *s, struct pw_impl_node *node)
 {
+	struct pw_impl_node **found;
 	struct pw_impl_port *p;
+	int res;
 
-	if (output == input)
-		return true;
+	node->topo_visit = s->visit;
+	if ((found = pw_array_add(&s->forward, sizeof(node))) == NULL)
+		return -errno;
+	*found = node;
 
-	spa_list_for_each(p, &output->output_ports, link) {
+	spa_list_for_each(p, &node->output_ports, link) {
 		struct pw_impl_link *l;
 
 		spa_list_for_each(l, &p->links, output_link) {
+			struct pw_impl_node *n = l->input->node;
+
 			if (l->feedback)
 				continue;
-			if (l->input->node == input)
-				return true;
+			if (n == s->target)
+				return 1;
+			if (n->topo_visit == s->visit || n->topo_order > s->upper)
+				continue;
+			if ((res = topo_forward(s, n)) != 0)
+				return res;
 		}
-		spa_list_for_each(l, &p->links, output_link) {
+	}
+	return 0;
+}
+
+static int topo_backward(struct topo_search *s, struct pw_impl_node *node)
+{
+	struct pw_impl_node **found;
+	struct pw_impl_port *p;
+	int res;
+
+	node->topo_visit = s->visit;
+	if ((found = pw_array_add(&s->backward, sizeof(node))) == NULL)
+		return -errno;
+	*found = node;
+
+	spa_list_for_each(p, &node->input_ports, link) {
+		struct pw_impl_link *l;
+
+		spa_list_for_each(l, &p->links, input_link) {
+			struct pw_impl_node *n = l->output->node;
+
 			if (l->feedback)
 				continue;
-			if (pw_impl_node_can_reach(l->input->node, input))
-				return true;
+			if (n->topo_visit == s->visit || n->topo_order < s->lower)
+				continue;
+			if ((res = topo_backward(s, n)) < 0)
+				return res;
 		}
 	}
-	return false;
+	return 0;
+}
+
+static int compare_order(const void *a, const void *b)
+{
+	const struct pw_impl_node *na = *(struct pw_impl_node * const *)a;
+	const struct pw_impl_node *nb = *(struct pw_impl_node * const *)b;
+	return na->topo_order < nb->topo_order ? -1 : na->topo_order > nb->topo_order;
+}
+
+/* give the nodes before the output node the lowest orders of the found
+ * nodes and the nodes after the input node the highest, keeping their
+ * relative order */
+static int topo_reorder(struct topo_search *s)
+{
+	struct pw_impl_node **f = s->forward.data, **b = s->backward.data;
+	size_t n_f = pw_array_get_len(&s->forward, struct pw_impl_node *);
+	size_t n_b = pw_array_get_len(&s->backward, struct pw_impl_node *);
+	size_t i, j, k;
+	uint64_t *order;
+
+	if ((order = malloc((n_f + n_b) * sizeof(uint64_t))) == NULL)
+		return -errno;
+
+	qsort(f, n_f, sizeof(struct pw_impl_node *), compare_order);
+	qsort(b, n_b, sizeof(struct pw_impl_node *), compare_order);
+
+	for (i = j = k = 0; k < n_b + n_f; k++) {
+		if (j == n_f || (i < n_b && b[i]->topo_order < f[j]->topo_order))
+			order[k] = b[i++]->topo_order;
+		else
+			order[k] = f[j++]->topo_order;
+	}
+	for (k = 0; k < n_b; k++)
+		b[k]->topo_order = order[k];
+	for (k = 0; k < n_f; k++)
+		f[k]->topo_order = order[n_b + k];
+
+	free(order);
+	return 0;
+}
+
+/* check if a new link from output to input makes a cycle. If not, the
+ * nodes are reordered so that the link can be added. */
+static bool check_feedback(struct pw_impl_node *output, struct pw_impl_node *input)
+{
+	struct pw_context *context = output->context;
+	struct topo_search s;
+	int res;
+
+	if (output == input)
+		return true;
+	if (input->topo_order > output->topo_order)
+		return false;
+
+	s.visit = ++context->topo_visit;
+	s.lower = input->topo_order;
+	s.upper = output->topo_order;
+	s.target = output;
+	pw_array_init(&s.forward, 64 * sizeof(struct pw_impl_node *));
+	pw_array_init(&s.backward, 64 * sizeof(struct pw_impl_node *));
+
+	if ((res = topo_forward(&s, input)) == 0 &&
+	    (res = topo_backward(&s, output)) == 0)
+		res = topo_reorder(&s);
+
+	pw_log_debug(NAME" %p -> %p: reordered %zd+%zd nodes: %d", output, input,
+			pw_array_get_len(&s.backward, struct pw_impl_node *),
+			pw_array_get_len(&s.forward, struct pw_impl_node *), res);
+
+	pw_array_clear(&s.forward);
+	pw_array_clear(&s.backward);
+
+	/* when we can't reorder, treat the link as feedback so that the
+	 * order stays valid */
+	if (res < 0)
+		pw_log_warn(NAME" %p -> %p: can't order nodes: %s",
+				output, input, spa_strerror(res));
+
+	return res != 0;
 }
 
 static void try_link_controls(struct impl *impl, struct pw_impl_port *output, struct pw_impl_port *input)
@@ -1063,7 +1283,7 @@ struct pw_impl_link *pw_context_create_link(struct pw_context *context,
 		goto error_no_mem;
 
 	this = &impl->this;
-	this->feedback = pw_impl_node_can_reach(input_node, output_node);
+	this->feedback = check_feedback(output_node, input_node);
 	pw_properties_set(properties, PW_KEY_LINK_FEEDBACK, this->feedback ? "true" : NULL);
 
 	pw_log_debug(NAME" %p: new out-port:%p -> in-port:%p", this, output, input);
@@ -1123,6 +1343,7 @@ struct pw_impl_link *pw_context_create_link(struct pw_context *context,
 		impl->inode = input_node;
 	}
 
+	this->rt.target.peer = impl->inode;
 	this->rt.target.signal = impl->inode->rt.target.signal;
 	this->rt.target.data = impl->inode->rt.target.data;
 
@@ -1281,7 +1502,8 @@ void pw_impl_link_destroy(struct pw_impl_link *link)
 	}
 
 	if (link->prepared)
-		pw_context_recalc_graph(link->context, "link destroy");
+		pw_context_recalc_nodes(link->context, impl->onode, impl->inode,
+				"link destroy");
 
 	pw_log_debug(NAME" %p: free", impl);
 	pw_impl_link_emit_free(link);
@@ -58,6 +58,7 @@ struct impl {
 
 	unsigned int pause_on_idle:1;
 	unsigned int cache_params:1;
+	unsigned int added:1;
 };
 
 #define pw_node_resource(r,m,v,...)	pw_resource_call(r,struct pw_node_events,m,v,__VA_ARGS__)
@@ -98,26 +99,16 @@ static void node_deactivate(struct pw_impl_node *this)
 	}
 }
 
-static void add_node(struct pw_impl_node *this, struct pw_impl_node *driver)
+/* a node can be processed in another data loop than its driver. The target
+ * of the node in the driver is changed in the data loop of the driver, the
+ * driver target of the node in the data loop of the node. */
+static void add_node_to_driver(struct pw_impl_node *this, struct pw_impl_node *driver)
 {
 	struct pw_node_activation_state *dstate, *nstate;
 
-	if (this->exported)
-		return;
-
-	pw_log_trace(NAME" %p: add to driver %p %p %p", this, driver,
-			driver->rt.activation, this->rt.activation);
-
-	/* signal the driver */
-	this->rt.driver_target.activation = driver->rt.activation;
-	this->rt.driver_target.node = driver;
-	this->rt.driver_target.data = driver;
-	spa_list_append(&this->rt.target_list, &this->rt.driver_target.link);
-
-	dstate = &this->rt.driver_target.activation->state[0];
-	dstate->required++;
-
 	spa_list_append(&driver->rt.target_list, &this->rt.target.link);
+	dstate = &driver->rt.activation->state[0];
+	dstate->required++;
 	nstate = &this->rt.activation->state[0];
 	nstate->required++;
 
@@ -126,28 +117,79 @@ static void add_node(struct pw_impl_node *this, struct pw_impl_node *driver)
 			nstate, nstate->pending, nstate->required);
 }
 
-static void remove_node(struct pw_impl_node *this)
+static void remove_node_from_driver(struct pw_impl_node *this, struct pw_impl_node *driver)
 {
 	struct pw_node_activation_state *dstate, *nstate;
 
-	if (this->exported)
-		return;
+	spa_list_remove(&this->rt.target.link);
+	dstate = &driver->rt.activation->state[0];
+	dstate->required--;
+	nstate = &this->rt.activation->state[0];
+	nstate->required--;
+
+	pw_log_trace(NAME" %p: driver state:%p pending:%d/%d, node state:%p pending:%d/%d",
+			this, dstate, dstate->pending, dstate->required,
+			nstate, nstate->pending, nstate->required);
+}
+
+static void add_driver_target(struct pw_impl_node *this, struct pw_impl_node *driver)
+{
+	pw_log_trace(NAME" %p: add to driver %p %p %p", this, driver,
+			driver->rt.activation, this->rt.activation);
 
+	/* signal the driver */
+	this->rt.driver_target.activation = driver->rt.activation;
+	this->rt.driver_target.node = driver;
+	this->rt.driver_target.peer = driver;
+	this->rt.driver_target.data = driver;
+	spa_list_append(&this->rt.target_list, &this->rt.driver_target.link);
+}
+
+static void remove_driver_target(struct pw_impl_node *this)
+{
 	pw_log_trace(NAME" %p: remove from driver %p %p %p",
 			this, this->rt.driver_target.data,
 			this->rt.driver_target.activation, this->rt.activation);
 
 	spa_list_remove(&this->rt.driver_target.link);
-	dstate = &this->rt.driver_target.activation->state[0];
-	dstate->required--;
+}
 
-	spa_list_remove(&this->rt.target.link);
-	nstate = &this->rt.activation->state[0];
-	nstate->required--;
+static int
+do_driver_add(struct spa_loop *loop,
+	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *this = user_data;
+	struct pw_impl_node *driver = *(struct pw_impl_node **)data;
 
-	pw_log_trace(NAME" %p: driver state:%p pending:%d/%d, node state:%p pending:%d/%d",
-			this, dstate, dstate->pending, dstate->required,
-			nstate, nstate->pending, nstate->required);
+	add_node_to_driver(this, driver);
+	return 0;
+}
+
+static int
+do_driver_remove(struct spa_loop *loop,
+	       bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *this = user_data;
+	struct pw_impl_node *driver = *(struct pw_impl_node **)data;
+
+	remove_node_from_driver(this, driver);
+	return 0;
+}
+
+static int
+do_node_add(struct spa_loop *loop,
+	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *this = user_data;
+	struct pw_impl_node *driver = *(struct pw_impl_node **)data;
+
+	spa_loop_add_source(loop, &this->source);
+	if (!this->exported) {
+		add_driver_target(this, driver);
+		if (driver->data_loop == this->data_loop)
+			add_node_to_driver(this, driver);
+	}
+	return 0;
 }
 
 static int
@@ -155,13 +197,49 @@ do_node_remove(struct spa_loop *loop,
 	       bool async, uint32_t seq, const void *data, size_t size, void *user_data)
 {
 	struct pw_impl_node *this = user_data;
-	if (this->source.loop != NULL) {
-		spa_loop_remove_source(loop, &this->source);
-		remove_node(this);
+	struct pw_impl_node *driver = *(struct pw_impl_node **)data;
+
+	spa_loop_remove_source(loop, &this->source);
+	if (!this->exported) {
+		if (driver->data_loop == this->data_loop)
+			remove_node_from_driver(this, driver);
+		remove_driver_target(this);
 	}
 	return 0;
 }
 
+/* first make the node ready to signal its driver, then let the
+ * driver trigger the node */
+static void add_to_driver(struct pw_impl_node *this, struct pw_impl_node *driver)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+
+	if (impl->added)
+		return;
+
+	pw_loop_invoke(this->data_loop, do_node_add, 1,
+			&driver, sizeof(struct pw_impl_node *), true, this);
+	if (!this->exported && driver->data_loop != this->data_loop)
+		pw_loop_invoke(driver->data_loop, do_driver_add, 1,
+				&driver, sizeof(struct pw_impl_node *), true, this);
+	impl->added = true;
+}
+
+static void remove_from_driver(struct pw_impl_node *this, struct pw_impl_node *driver)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+
+	if (!impl->added)
+		return;
+
+	if (!this->exported && driver->data_loop != this->data_loop)
+		pw_loop_invoke(driver->data_loop, do_driver_remove, 1,
+				&driver, sizeof(struct pw_impl_node *), true, this);
+	pw_loop_invoke(this->data_loop, do_node_remove, 1,
+			&driver, sizeof(struct pw_impl_node *), true, this);
+	impl->added = false;
+}
+
 static int pause_node(struct pw_impl_node *this)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -175,7 +253,7 @@ static int pause_node(struct pw_impl_node *this)
 
 	node_deactivate(this);
 
-	pw_loop_invoke(this->data_loop, do_node_remove, 1, NULL, 0, true, this);
+	remove_from_driver(this, this->driver_node);
 
 	res = spa_node_send_command(this->node,
 				    &SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Pause));
@@ -278,20 +356,6 @@ static void emit_params(struct pw_impl_node *node, uint32_t *changed_ids, uint32
 	}
 }
 
-static int
-do_node_add(struct spa_loop *loop,
-	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
-{
-	struct pw_impl_node *this = user_data;
-	struct pw_impl_node *driver = this->driver_node;
-
-	if (this->source.loop == NULL) {
-		spa_loop_add_source(loop, &this->source);
-		add_node(this, driver);
-	}
-	return 0;
-}
-
 static void node_update_state(struct pw_impl_node *node, enum pw_node_state state, int res, char *error)
 {
 	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
@@ -318,7 +382,7 @@ static void node_update_state(struct pw_impl_node *node, enum pw_node_state stat
 
 	switch (state) {
 	case PW_NODE_STATE_RUNNING:
-		pw_loop_invoke(node->data_loop, do_node_add, 1, NULL, 0, true, node);
+		add_to_driver(node, node->driver_node);
 		break;
 	default:
 		break;
@@ -661,6 +725,7 @@ int pw_impl_node_register(struct pw_impl_node *this,
 	if (this->driver)
 		insert_driver(context, this);
 	this->registered = true;
+	pw_context_update_node_group(context, this);
 
 	this->rt.activation->position.clock.id = this->global->id;
 
@@ -684,7 +749,7 @@ int pw_impl_node_register(struct pw_impl_node *this,
 		pw_impl_port_register(port, NULL);
 
 	if (this->active)
-		pw_context_recalc_graph(context, "register active node");
+		pw_context_recalc_nodes(context, this, NULL, "register active node");
 
 	return 0;
 
@@ -707,16 +772,17 @@ static int
 do_move_nodes(struct spa_loop *loop,
 		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
 {
-	struct impl *src = user_data;
-	struct pw_impl_node *driver = *(struct pw_impl_node **)data;
-	struct pw_impl_node *this = &src->this;
+	struct pw_impl_node *this = user_data;
+	struct pw_impl_node * const *drivers = data;
 
-	pw_log_trace(NAME" %p: driver:%p->%p", this, this->driver_node, driver);
+	pw_log_trace(NAME" %p: driver:%p->%p", this, drivers[0], drivers[1]);
 
-	if (this->source.loop != NULL) {
-		remove_node(this);
-		add_node(this, driver);
-	}
+	if (drivers[0]->data_loop == this->data_loop)
+		remove_node_from_driver(this, drivers[0]);
+	remove_driver_target(this);
+	add_driver_target(this, drivers[1]);
+	if (drivers[1]->data_loop == this->data_loop)
+		add_node_to_driver(this, drivers[1]);
 	return 0;
 }
 
@@ -766,9 +832,18 @@ int pw_impl_node_set_driver(struct pw_impl_node *node, struct pw_impl_node *driv
 	pw_log_trace(NAME" %p: set position %p", node, &driver->rt.activation->position);
 	node->rt.position = &driver->rt.activation->position;
 
-	pw_loop_invoke(node->data_loop,
-		       do_move_nodes, SPA_ID_INVALID, &driver, sizeof(struct pw_impl_node *),
-		       true, impl);
+	if (impl->added && !node->exported) {
+		struct pw_impl_node *drivers[2] = { old, driver };
+
+		if (old->data_loop != node->data_loop)
+			pw_loop_invoke(old->data_loop, do_driver_remove, SPA_ID_INVALID,
+					&old, sizeof(struct pw_impl_node *), true, node);
+		pw_loop_invoke(node->data_loop, do_move_nodes, SPA_ID_INVALID,
+				drivers, sizeof(drivers), true, node);
+		if (driver->data_loop != node->data_loop)
+			pw_loop_invoke(driver->data_loop, do_driver_add, SPA_ID_INVALID,
+					&driver, sizeof(struct pw_impl_node *), true, node);
+	}
 	return 0;
 }
 
@@ -804,6 +879,8 @@ static void check_properties(struct pw_impl_node *node)
 	if (group_id != node->group_id) {
 		pw_log_debug(NAME" %p: group %u->%u", node, node->group_id, group_id);
 		node->group_id = group_id;
+		if (node->registered)
+			pw_context_update_node_group(context, node);
 		do_recalc = true;
 	}
 
@@ -846,6 +923,20 @@ static void check_properties(struct pw_impl_node *node)
 	else
 		node->want_driver = false;
 
+	node->spin_wait = 0;
+	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_SPIN_WAIT))) {
+		int spin_wait = pw_properties_parse_int(str);
+		if (spin_wait < 0)
+			pw_log_warn("(%s-%u) invalid spin-wait %s, disabled",
+					node->name, node->info.id, str);
+		else
+			node->spin_wait = spin_wait;
+	}
+	/* the spin time is published by the process that runs the node, the
+	 * server leaves it alone for remote nodes */
+	if (!node->remote && node->spin_activation)
+		node->rt.activation->spin_wait = node->spin_wait;
+
 	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_LATENCY))) {
 		uint32_t num, denom;
                 if (sscanf(str, "%u/%u", &num, &denom) == 2 && denom != 0) {
@@ -918,6 +1009,20 @@ static void dump_states(struct pw_impl_node *driver)
 	}
 }
 
+static inline void trigger_target(struct pw_impl_node *this, struct pw_node_target *t)
+{
+	struct pw_impl_node *n = t->peer;
+
+	/* targets processed in another data loop are woken up with their
+	 * eventfd, everything else is called directly */
+	if (SPA_LIKELY(n == NULL || n->remote || n->data_loop == this->data_loop)) {
+		t->signal(t->data);
+	} else if (SPA_UNLIKELY(spa_system_eventfd_write(this->context->data_system,
+					n->source.fd, 1) < 0)) {
+		pw_log_warn(NAME" %p: write failed %m", this);
+	}
+}
+
 static inline int resume_node(struct pw_impl_node *this, int status)
 {
 	struct pw_node_target *t;
@@ -943,7 +1048,7 @@ static inline int resume_node(struct pw_impl_node *this, int status)
 		if (pw_node_activation_state_dec(state, 1)) {
 			a->status = PW_NODE_ACTIVATION_TRIGGERED;
 			a->signal_time = nsec;
-			t->signal(t->data);
+			trigger_target(this, t);
 		}
 	}
 	return 0;
@@ -1032,14 +1137,21 @@ static void node_on_fd_events(struct spa_source *source)
 	}
 
 	if (SPA_LIKELY(source->rmask & SPA_IO_IN)) {
+		struct pw_node_activation *a = this->rt.activation;
 		uint64_t cmd;
 
 		if (SPA_UNLIKELY(spa_system_eventfd_read(data_system, this->source.fd, &cmd) < 0))
 			pw_log_warn(NAME" %p: read failed %m", this);
-		else if (SPA_UNLIKELY(cmd > 1))
+		else if (SPA_UNLIKELY(cmd > 1 && this->spin_wait == 0))
 			pw_log_warn("(%s-%u) client missed %"PRIu64" wakeups",
 				this->name, this->info.id, cmd - 1);
 
+		/* with spin_wait we can be woken up early by the driver, spin
+		 * until our peers trigger us or go back to sleep */
+		if (SPA_UNLIKELY(this->spin_activation && a->spin_wait > 0) &&
+		    !pw_node_activation_spin(a))
+			return;
+
 		pw_log_trace_fp(NAME" %p: got process", this);
 		this->rt.target.signal(this->rt.target.data);
 	}
@@ -1093,6 +1205,7 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	this->context = context;
 	this->name = strdup("node");
 	this->group_id = SPA_ID_INVALID;
+	this->topo_order = context->topo_order++;
 
 	if (user_data_size > 0)
                 this->user_data = SPA_MEMBER(impl, sizeof(struct impl), void);
@@ -1136,9 +1249,10 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	}
 	impl->pending_id = SPA_ID_INVALID;
 
-	this->data_loop = context->data_loop;
+	this->data_loop = pw_context_acquire_data_loop(context, &properties->dict);
 
 	spa_list_init(&this->follower_list);
+	spa_list_init(&this->group_link);
 
 	spa_hook_list_init(&this->listener_list);
 
@@ -1156,8 +1270,10 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	spa_list_init(&this->rt.target_list);
 
 	this->rt.activation = this->activation->map->ptr;
+	this->spin_activation = true;
 	this->rt.target.activation = this->rt.activation;
 	this->rt.target.node = this;
+	this->rt.target.peer = this;
 	this->rt.target.signal = process_node;
 	this->rt.target.data = this;
 	this->rt.driver_target.signal = process_node;
@@ -1306,7 +1422,7 @@ static void node_info(void *data, const struct spa_node_info *info)
 		emit_params(node, changed_ids, n_changed_ids);
 
 	if (flags_changed)
-		pw_context_recalc_graph(node->context, "node flags changed");
+		pw_context_recalc_nodes(node->context, node, NULL, "node flags changed");
 }
 
 static void node_port_info(void *data, enum spa_direction direction, uint32_t port_id,
@@ -1518,6 +1634,11 @@ static int node_ready(void *data, int status)
 			ta->status = PW_NODE_ACTIVATION_NOT_TRIGGERED;
 			pw_node_activation_state_reset(&ta->state[0]);
 
+			/* wake up spinning followers now so that they are ready
+			 * when their peers trigger them */
+			if (SPA_UNLIKELY(t->wakeup != NULL && ta->spin_wait > 0))
+				t->wakeup(t->data);
+
 			if (SPA_LIKELY(t->node)) {
 				uint32_t id = t->node->info.id;
 
@@ -1700,7 +1821,10 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 		spa_list_remove(&node->link);
 		if (node->driver)
 			spa_list_remove(&node->driver_link);
+		spa_list_remove(&node->group_link);
+		node->registered = false;
 	}
+	pw_context_forget_node(node->context, node);
 
 	if (node->node) {
 		spa_hook_remove(&node->listener);
@@ -1718,8 +1842,12 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 		pw_global_destroy(node->global);
 	}
 
-	if (active)
-		pw_context_recalc_graph(node->context, "active node destroy");
+	/* the followers of a driver were unassigned above and are not
+	 * found from our old driver, recalc everything in that case */
+	if (active && node->driver)
+		pw_context_recalc_graph(node->context, "active driver destroy");
+	else if (active)
+		pw_context_recalc_nodes(node->context, node, NULL, "active node destroy");
 
 	pw_log_debug(NAME" %p: free", node);
 	pw_impl_node_emit_free(node);
@@ -1741,6 +1869,7 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 	clear_info(node);
 
 	spa_system_close(node->context->data_system, node->source.fd);
+	pw_context_release_data_loop(node->context, node->data_loop);
 	free(impl);
 }
 
@@ -2089,7 +2218,7 @@ int pw_impl_node_set_active(struct pw_impl_node *node, bool active)
 		pw_impl_node_emit_active_changed(node, active);
 
 		if (node->registered)
-			pw_context_recalc_graph(node->context,
+			pw_context_recalc_nodes(node->context, node, NULL,
 					active ? "node activate" : "node deactivate");
 	}
 	return 0;
@@ -384,6 +384,11 @@ static void update_info(struct pw_impl_port *port, const struct spa_port_info *i
 			if (port->info.params[i].flags == info->params[i].flags)
 				continue;
 
+			if (id == SPA_PARAM_EnumFormat)
+				port->format_hash[0] = 0;
+			else if (id == SPA_PARAM_Format)
+				port->format_hash[1] = 0;
+
 			pw_log_debug(NAME" %p: update param %d", port, id);
 			port->info.params[i] = info->params[i];
 			port->info.params[i].user = 0;
@@ -537,7 +542,7 @@ static int setup_mixer(struct pw_impl_port *port, const struct spa_pod *param)
 	int res;
 	const char *fallback_lib, *factory_name;
 	struct spa_handle *handle;
-	struct spa_dict_item items[1];
+	struct spa_dict_item items[2];
 	void *iface;
 
 	if ((res = spa_format_parse(param, &media_type, &media_subtype)) < 0)
@@ -584,6 +589,9 @@ static int setup_mixer(struct pw_impl_port *port, const struct spa_pod *param)
 	}
 
 	items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_LIBRARY_NAME, fallback_lib);
+	/* the mixer runs in the data loop of the node */
+	items[1] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_DATA_LOOP,
+			pw_properties_get(port->node->properties, PW_KEY_NODE_DATA_LOOP));
 	handle = pw_context_load_spa_handle(port->node->context, factory_name,
 			&SPA_DICT_INIT_ARRAY(items));
 	if (handle == NULL)
@@ -1262,6 +1270,10 @@ int pw_impl_port_set_param(struct pw_impl_port *port, uint32_t id, uint32_t flag
 
 	pw_log_debug(NAME" %p: %d set param %d %p", port, port->state, id, param);
 
+	/* the possible formats can depend on the format */
+	if (id == SPA_PARAM_Format)
+		port->format_hash[0] = port->format_hash[1] = 0;
+
 	/* set parameter on node */
 	res = spa_node_port_set_param(node->node,
 			port->direction, port->port_id,
@@ -147,7 +147,12 @@ extern "C" {
 #define PW_KEY_NODE_ALWAYS_PROCESS	"node.always-process"	/**< process even when unlinked */
 #define PW_KEY_NODE_PAUSE_ON_IDLE	"node.pause-on-idle"	/**< pause the node when idle */
 #define PW_KEY_NODE_CACHE_PARAMS	"node.cache-params"	/**< cache the node params */
+#define PW_KEY_NODE_SPIN_WAIT		"node.spin-wait"	/**< max time in microseconds the node spins
+								  *  waiting for its trigger instead of
+								  *  sleeping on its eventfd, 0 disables */
 #define PW_KEY_NODE_DRIVER		"node.driver"		/**< node can drive the graph */
+#define PW_KEY_NODE_DATA_LOOP		"node.data-loop"	/**< index of the data loop that
+								  *  processes the node */
 #define PW_KEY_NODE_STREAM		"node.stream"		/**< node is a stream, the server side should
 								  *  add a converter */
 /** Port keys */
@@ -80,6 +80,15 @@ struct pw_loop *pw_loop_new(const struct spa_dict *props)
 	impl->system_handle = pw_load_spa_handle(lib,
 			SPA_NAME_SUPPORT_SYSTEM,
 			props, n_support, support);
+	if (impl->system_handle == NULL && lib != NULL) {
+		/* an alternative system might not be usable on this kernel,
+		 * fall back to the default one */
+		pw_log_warn(NAME" %p: can't make "SPA_NAME_SUPPORT_SYSTEM" handle from %s: %m, "
+				"using default", this, lib);
+		impl->system_handle = pw_load_spa_handle(NULL,
+				SPA_NAME_SUPPORT_SYSTEM,
+				props, n_support, support);
+	}
 	if (impl->system_handle == NULL) {
 		res = -errno;
 		pw_log_error(NAME" %p: can't make "SPA_NAME_SUPPORT_SYSTEM" handle: %m", this);
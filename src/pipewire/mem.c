@@ -39,6 +39,7 @@
 
 #include <pipewire/log.h>
 #include <pipewire/map.h>
+#include <pipewire/array.h>
 #include <pipewire/mem.h>
 
 #define NAME "mempool"
@@ -103,13 +104,50 @@ struct mempool {
 	struct pw_map map;		/* map memblock to id */
 	struct spa_list blocks;		/* list of memblock */
 	uint32_t pagesize;
+
+	struct pw_array ranges;		/* struct range of all mappings, sorted on ptr */
+
+	uint32_t n_blocks;
+	uint32_t fd_hash_size;		/* power of 2 */
+	struct spa_list *fd_hash;	/* memblock on fd */
+
+	uint32_t n_memmaps;
+	uint32_t tag_hash_size;		/* power of 2 */
+	struct spa_list *tag_hash;	/* memmap on tag */
+
+	uint32_t slab_size;		/* 0 when slabs are disabled */
+	unsigned int slab_hugepages:1;
+	unsigned int slab_prefault:1;
+	struct spa_list slabs;		/* list of struct slab */
+
+	struct pw_mempool_stats stats;
+};
+
+/* a free or allocated part of a slab */
+struct region {
+	uint32_t offset;
+	uint32_t size;
+};
+
+/* a sealed memfd that is mapped once and carved into regions for
+ * the blocks allocated with PW_MEMBLOCK_FLAG_SLAB */
+struct slab {
+	struct spa_list link;		/* link in mempool slabs */
+	int fd;
+	void *ptr;
+	uint32_t size;
+	uint32_t n_used;		/* allocated regions */
+	struct pw_array free;		/* struct region, sorted on offset */
 };
 
 struct memblock {
 	struct pw_memblock this;
 	struct spa_list link;		/* link in mempool */
+	struct spa_list fd_link;	/* link in mempool fd_hash */
 	struct spa_list mappings;	/* list of struct mapping */
 	struct spa_list memmaps;	/* list of struct memmap */
+	struct slab *slab;		/* slab of the block or NULL */
+	struct region region;		/* region in the slab */
 };
 
 /* a mapped region of a block */
@@ -128,12 +166,299 @@ struct memmap {
 	struct pw_memmap this;
 	struct mapping *mapping;
 	struct spa_list link;
+	struct spa_list tag_link;	/* link in mempool tag_hash */
 };
 
+#define HASH_INIT_SIZE	16
+
+static inline uint32_t fd_hash(struct mempool *impl, int fd)
+{
+	return (uint32_t)fd & (impl->fd_hash_size - 1);
+}
+
+static inline uint32_t tag_hash(struct mempool *impl, const uint32_t tag[5])
+{
+	/* FNV-1a */
+	uint32_t i, hash = 2166136261u;
+	for (i = 0; i < 5; i++)
+		hash = (hash ^ tag[i]) * 16777619u;
+	return hash & (impl->tag_hash_size - 1);
+}
+
+static struct spa_list *hash_new(uint32_t size)
+{
+	struct spa_list *hash;
+	uint32_t i;
+
+	if ((hash = malloc(size * sizeof(struct spa_list))) == NULL)
+		return NULL;
+	for (i = 0; i < size; i++)
+		spa_list_init(&hash[i]);
+	return hash;
+}
+
+/* the hash tables double when they have on average more than 2
+ * entries per bucket. When we can't grow, we keep the old table. */
+static void fd_hash_add(struct mempool *impl, struct memblock *b)
+{
+	if (++impl->n_blocks > impl->fd_hash_size * 2) {
+		struct spa_list *hash;
+		struct memblock *bl;
+
+		if ((hash = hash_new(impl->fd_hash_size * 2)) != NULL) {
+			free(impl->fd_hash);
+			impl->fd_hash = hash;
+			impl->fd_hash_size *= 2;
+			spa_list_for_each(bl, &impl->blocks, link)
+				spa_list_append(&hash[fd_hash(impl, bl->this.fd)], &bl->fd_link);
+		}
+	}
+	spa_list_append(&impl->fd_hash[fd_hash(impl, b->this.fd)], &b->fd_link);
+}
+
+static void fd_hash_remove(struct mempool *impl, struct memblock *b)
+{
+	impl->n_blocks--;
+	spa_list_remove(&b->fd_link);
+}
+
+static void tag_hash_add(struct mempool *impl, struct memmap *mm)
+{
+	if (++impl->n_memmaps > impl->tag_hash_size * 2) {
+		struct spa_list *hash;
+		struct memblock *b;
+		struct memmap *m;
+
+		if ((hash = hash_new(impl->tag_hash_size * 2)) != NULL) {
+			free(impl->tag_hash);
+			impl->tag_hash = hash;
+			impl->tag_hash_size *= 2;
+			spa_list_for_each(b, &impl->blocks, link)
+				spa_list_for_each(m, &b->memmaps, link)
+					spa_list_append(&hash[tag_hash(impl, m->this.tag)],
+							&m->tag_link);
+		}
+	}
+	spa_list_append(&impl->tag_hash[tag_hash(impl, mm->this.tag)], &mm->tag_link);
+}
+
+static void tag_hash_remove(struct mempool *impl, struct memmap *mm)
+{
+	impl->n_memmaps--;
+	spa_list_remove(&mm->tag_link);
+}
+
+/* the address range of a mapping */
+struct range {
+	const void *ptr;
+	struct mapping *mapping;
+};
+
+/* index of the first range that starts after ptr */
+static uint32_t ranges_upper_bound(struct mempool *impl, const void *ptr)
+{
+	struct range *r = impl->ranges.data;
+	uint32_t lo = 0, hi = pw_array_get_len(&impl->ranges, struct range);
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if ((const uint8_t *)r[mid].ptr <= (const uint8_t *)ptr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int ranges_add(struct mempool *impl, struct mapping *m)
+{
+	struct range *r;
+	uint32_t idx, len;
+
+	idx = ranges_upper_bound(impl, m->ptr);
+	if (pw_array_add(&impl->ranges, sizeof(struct range)) == NULL)
+		return -errno;
+
+	r = impl->ranges.data;
+	len = pw_array_get_len(&impl->ranges, struct range);
+	memmove(&r[idx + 1], &r[idx], (len - idx - 1) * sizeof(struct range));
+	r[idx].ptr = m->ptr;
+	r[idx].mapping = m;
+	return 0;
+}
+
+static void ranges_remove(struct mempool *impl, struct mapping *m)
+{
+	struct range *r = impl->ranges.data;
+	uint32_t idx, len;
+
+	len = pw_array_get_len(&impl->ranges, struct range);
+	idx = ranges_upper_bound(impl, m->ptr);
+	while (idx > 0 && r[--idx].ptr == m->ptr) {
+		if (r[idx].mapping == m) {
+			memmove(&r[idx], &r[idx + 1], (len - idx - 1) * sizeof(struct range));
+			impl->ranges.size -= sizeof(struct range);
+			break;
+		}
+	}
+}
+
+#define SLAB_HUGEPAGE_SIZE	(2u * 1024 * 1024)
+
+static struct slab *slab_new(struct mempool *impl)
+{
+	struct slab *s;
+	struct region *r;
+	int res, fl = MAP_SHARED;
+
+	s = calloc(1, sizeof(struct slab));
+	if (s == NULL)
+		return NULL;
+
+	s->size = impl->slab_size;
+	pw_array_init(&s->free, 16 * sizeof(struct region));
+
+#ifdef HAVE_MEMFD_CREATE
+	s->fd = memfd_create("pipewire-slab", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (s->fd == -1) {
+		res = -errno;
+		pw_log_error(NAME" %p: Failed to create slab memfd: %m", impl);
+		goto error_free;
+	}
+#else
+	res = -ENOTSUP;
+	goto error_free;
+#endif
+	if (ftruncate(s->fd, s->size) < 0) {
+		res = -errno;
+		pw_log_warn(NAME" %p: Failed to truncate slab: %m", impl);
+		goto error_close;
+	}
+	if (fcntl(s->fd, F_ADD_SEALS, F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL) == -1)
+		pw_log_warn(NAME" %p: Failed to add seals: %m", impl);
+
+	if (impl->slab_prefault)
+		fl |= MAP_POPULATE;
+
+	s->ptr = mmap(NULL, s->size, PROT_READ | PROT_WRITE, fl, s->fd, 0);
+	if (s->ptr == MAP_FAILED) {
+		res = -errno;
+		pw_log_error(NAME" %p: Failed to mmap slab fd:%d size:%u: %m",
+				impl, s->fd, s->size);
+		goto error_close;
+	}
+#ifdef MADV_HUGEPAGE
+	if (impl->slab_hugepages &&
+	    madvise(s->ptr, s->size, MADV_HUGEPAGE) < 0)
+		pw_log_warn(NAME" %p: Failed to use huge pages: %m", impl);
+#endif
+	if ((r = pw_array_add(&s->free, sizeof(struct region))) == NULL) {
+		res = -errno;
+		munmap(s->ptr, s->size);
+		goto error_close;
+	}
+	r->offset = 0;
+	r->size = s->size;
+
+	spa_list_append(&impl->slabs, &s->link);
+	impl->stats.n_slabs++;
+	impl->stats.slab_size += s->size;
+
+	pw_log_debug(NAME" %p: slab:%p fd:%d ptr:%p size:%u", impl, s, s->fd, s->ptr, s->size);
+
+	return s;
+
+error_close:
+	close(s->fd);
+error_free:
+	pw_array_clear(&s->free);
+	free(s);
+	errno = -res;
+	return NULL;
+}
+
+static void slab_destroy(struct mempool *impl, struct slab *s)
+{
+	pw_log_debug(NAME" %p: slab:%p fd:%d destroy", impl, s, s->fd);
+
+	spa_list_remove(&s->link);
+	impl->stats.n_slabs--;
+	impl->stats.slab_size -= s->size;
+
+	munmap(s->ptr, s->size);
+	close(s->fd);
+	pw_array_clear(&s->free);
+	free(s);
+}
+
+/* take the first free region that is large enough */
+static int slab_take(struct slab *s, uint32_t size, struct region *region)
+{
+	struct region *r;
+
+	pw_array_for_each(r, &s->free) {
+		if (r->size < size)
+			continue;
+
+		region->offset = r->offset;
+		region->size = size;
+		r->offset += size;
+		r->size -= size;
+		if (r->size == 0)
+			pw_array_remove(&s->free, r);
+		s->n_used++;
+		return 0;
+	}
+	return -ENOSPC;
+}
+
+/* give a region back, merging it with the free regions around it. The
+ * memory is cleared so that the next block starts zeroed like a new memfd.
+ * Slabs are kept around to be reused except when there is another one. */
+static void slab_release(struct mempool *impl, struct slab *s, const struct region *region)
+{
+	struct region *r, *prev = NULL, *next = NULL;
+	uint32_t i, len;
+
+	memset(SPA_MEMBER(s->ptr, region->offset, void), 0, region->size);
+
+	r = s->free.data;
+	len = pw_array_get_len(&s->free, struct region);
+	for (i = 0; i < len; i++) {
+		if (r[i].offset > region->offset)
+			break;
+	}
+	if (i > 0 && r[i - 1].offset + r[i - 1].size == region->offset)
+		prev = &r[i - 1];
+	if (i < len && region->offset + region->size == r[i].offset)
+		next = &r[i];
+
+	if (prev && next) {
+		prev->size += region->size + next->size;
+		pw_array_remove(&s->free, next);
+	} else if (prev) {
+		prev->size += region->size;
+	} else if (next) {
+		next->offset = region->offset;
+		next->size += region->size;
+	} else if (pw_array_add(&s->free, sizeof(struct region)) != NULL) {
+		r = s->free.data;
+		memmove(&r[i + 1], &r[i], (len - i) * sizeof(struct region));
+		r[i] = *region;
+	} else {
+		pw_log_warn(NAME" %p: slab:%p can't free region %u:%u: %m",
+				impl, s, region->offset, region->size);
+	}
+
+	if (--s->n_used == 0 && impl->stats.n_slabs > 1)
+		slab_destroy(impl, s);
+}
+
 struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 {
 	struct mempool *impl;
 	struct pw_mempool *this;
+	const char *str;
 
 	impl = calloc(1, sizeof(struct mempool));
 	if (impl == NULL)
@@ -144,11 +469,33 @@ struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 
 	impl->pagesize = sysconf(_SC_PAGESIZE);
 
-	pw_log_debug(NAME" %p: new", this);
+	if (props) {
+		if ((str = pw_properties_get(props, "mem.slab-hugepages")) != NULL)
+			impl->slab_hugepages = pw_properties_parse_bool(str);
+		if ((str = pw_properties_get(props, "mem.slab-prefault")) != NULL)
+			impl->slab_prefault = pw_properties_parse_bool(str);
+		if ((str = pw_properties_get(props, "mem.slab-size")) != NULL)
+			impl->slab_size = SPA_ROUND_UP_N(pw_properties_parse_int(str),
+					impl->slab_hugepages ? SLAB_HUGEPAGE_SIZE : impl->pagesize);
+	}
+	spa_list_init(&impl->slabs);
+
+	pw_log_debug(NAME" %p: new slab-size:%u", this, impl->slab_size);
 
 	spa_hook_list_init(&impl->listener_list);
 	pw_map_init(&impl->map, 64, 64);
 	spa_list_init(&impl->blocks);
+	pw_array_init(&impl->ranges, 64 * sizeof(struct range));
+
+	impl->fd_hash_size = impl->tag_hash_size = HASH_INIT_SIZE;
+	impl->fd_hash = hash_new(impl->fd_hash_size);
+	impl->tag_hash = hash_new(impl->tag_hash_size);
+	if (impl->fd_hash == NULL || impl->tag_hash == NULL) {
+		free(impl->fd_hash);
+		free(impl->tag_hash);
+		free(impl);
+		return NULL;
+	}
 
 	spa_list_append(&_mempools, &impl->link);
 
@@ -170,6 +517,7 @@ void pw_mempool_clear(struct pw_mempool *pool)
 void pw_mempool_destroy(struct pw_mempool *pool)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
+	struct slab *s;
 
 	pw_log_debug(NAME" %p: destroy", pool);
 
@@ -177,11 +525,17 @@ void pw_mempool_destroy(struct pw_mempool *pool)
 
 	pw_mempool_clear(pool);
 
+	spa_list_consume(s, &impl->slabs, link)
+		slab_destroy(impl, s);
+
 	spa_list_remove(&impl->link);
 
 	spa_hook_list_clean(&impl->listener_list);
 
 	pw_map_clear(&impl->map);
+	pw_array_clear(&impl->ranges);
+	free(impl->fd_hash);
+	free(impl->tag_hash);
 	if (pool->props)
 		pw_properties_free(pool->props);
 	free(impl);
@@ -323,6 +677,11 @@ static struct mapping * memblock_map(struct memblock *b,
 	m->block = b;
 	m->offset = offset;
 	m->size = size;
+	if (ranges_add(p, m) < 0) {
+		munmap(ptr, size);
+		free(m);
+		return NULL;
+	}
 	b->this.ref++;
 	spa_list_append(&b->mappings, &m->link);
 
@@ -342,6 +701,7 @@ static void mapping_free(struct mapping *m)
 
 	if (m->do_unmap)
 		munmap(m->ptr, m->size);
+	ranges_remove(p, m);
 	spa_list_remove(&m->link);
 	free(m);
 }
@@ -387,7 +747,7 @@ struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 	mm->this.flags = flags;
 	mm->this.offset = offset;
 	mm->this.size = size;
-	mm->this.ptr = SPA_MEMBER(m->ptr, range.start, void);
+	mm->this.ptr = SPA_MEMBER(m->ptr, offset - m->offset, void);
 
         pw_log_debug(NAME" %p: map:%p block:%p fd:%d ptr:%p (%d %d) mapping:%p ref:%d", p,
 			&mm->this, b, b->this.fd, mm->this.ptr, offset, size, m, m->ref);
@@ -398,6 +758,7 @@ struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 			tag[0], tag[1], tag[2], tag[3], tag[4]);
 	}
 
+	tag_hash_add(p, mm);
 	spa_list_append(&b->memmaps, &mm->link);
 
 	return &mm->this;
@@ -429,6 +790,7 @@ int pw_memmap_free(struct pw_memmap *map)
         pw_log_debug(NAME" %p: map:%p block:%p fd:%d ptr:%p mapping:%p ref:%d", p,
 			&mm->this, b, b->this.fd, mm->this.ptr, m, m->ref);
 
+	tag_hash_remove(p, mm);
 	spa_list_remove(&mm->link);
 
 	if (--m->ref == 0)
@@ -451,6 +813,74 @@ static inline enum pw_memmap_flags block_flags_to_mem(enum pw_memblock_flags fla
 	return fl;
 }
 
+/* carve the block out of one of the slabs. The slab mapping is shared by
+ * all the blocks in it so the block gets a mapping of its region that is
+ * not unmapped. */
+static int slab_alloc(struct mempool *impl, struct memblock *b)
+{
+	struct slab *s;
+	struct mapping *m;
+	struct region region;
+	int res;
+
+	if (impl->slab_size == 0 ||
+	    b->this.type != SPA_DATA_MemFd ||
+	    !SPA_FLAG_IS_SET(b->this.flags, PW_MEMBLOCK_FLAG_MAP) ||
+	    b->this.size == 0 || b->this.size > impl->slab_size)
+		return -ENOTSUP;
+
+	region.size = SPA_ROUND_UP_N(b->this.size, impl->pagesize);
+
+	spa_list_for_each(s, &impl->slabs, link) {
+		if (slab_take(s, region.size, &region) == 0)
+			goto found;
+	}
+	if ((s = slab_new(impl)) == NULL)
+		return -errno;
+	if ((res = slab_take(s, region.size, &region)) < 0)
+		return res;
+
+found:
+	m = calloc(1, sizeof(struct mapping));
+	if (m == NULL) {
+		res = -errno;
+		goto error_release;
+	}
+	m->ptr = SPA_MEMBER(s->ptr, region.offset, void);
+	m->block = b;
+	m->offset = region.offset;
+	m->size = region.size;
+	if ((res = ranges_add(impl, m)) < 0) {
+		free(m);
+		goto error_release;
+	}
+	b->this.ref++;
+	spa_list_append(&b->mappings, &m->link);
+
+	b->this.fd = s->fd;
+	b->this.map = pw_memblock_map(&b->this,
+			block_flags_to_mem(b->this.flags), region.offset, b->this.size, NULL);
+	if (b->this.map == NULL) {
+		/* the unused mapping was released with its block ref */
+		res = -errno;
+		goto error_release;
+	}
+	b->this.ref--;
+	b->slab = s;
+	b->region = region;
+
+	impl->stats.slab_used += region.size;
+	impl->stats.n_slab_allocs++;
+
+	pw_log_debug(NAME" %p: block:%p slab:%p fd:%d offset:%u size:%u", impl, b,
+			s, s->fd, region.offset, region.size);
+	return 0;
+
+error_release:
+	slab_release(impl, s, &region);
+	return res;
+}
+
 /** Create a new memblock
  * \param pool the pool to use
  * \param flags memblock flags
@@ -479,6 +909,10 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 	spa_list_init(&b->mappings);
 	spa_list_init(&b->memmaps);
 
+	if (SPA_FLAG_IS_SET(flags, PW_MEMBLOCK_FLAG_SLAB) &&
+	    slab_alloc(impl, b) == 0)
+		goto insert;
+
 #ifdef HAVE_MEMFD_CREATE
 	b->this.fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
 	if (b->this.fd == -1) {
@@ -527,8 +961,11 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 		}
 		b->this.ref--;
 	}
+	impl->stats.n_memfd_allocs++;
 
+insert:
 	b->this.id = pw_map_insert_new(&impl->map, b);
+	fd_hash_add(impl, b);
 	spa_list_append(&impl->blocks, &b->link);
 	pw_log_debug(NAME" %p: block:%p id:%d type:%u size:%zd", pool, &b->this, b->this.id, type, size);
 
@@ -550,7 +987,7 @@ static struct memblock * mempool_find_fd(struct pw_mempool *pool, int fd)
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
 	struct memblock *b;
 
-	spa_list_for_each(b, &impl->blocks, link) {
+	spa_list_for_each(b, &impl->fd_hash[fd_hash(impl, fd)], fd_link) {
 		if (fd == b->this.fd) {
 			pw_log_debug(NAME" %p: found %p id:%d fd:%d ref:%d",
 					pool, &b->this, b->this.id, fd, b->this.ref);
@@ -586,6 +1023,7 @@ struct pw_memblock * pw_mempool_import(struct pw_mempool *pool,
 	b->this.fd = fd;
 	b->this.flags = flags;
 	b->this.id = pw_map_insert_new(&impl->map, b);
+	fd_hash_add(impl, b);
 	spa_list_append(&impl->blocks, &b->link);
 
 	pw_log_debug(NAME" %p: block:%p id:%u flags:%08x type:%u fd:%d",
@@ -627,10 +1065,14 @@ struct pw_memmap * pw_mempool_import_map(struct pw_mempool *pool,
 	if (block == NULL)
 		return NULL;
 
-	if (block->ref == 1) {
-		struct mapping *m;
+	b = SPA_CONTAINER_OF(block, struct memblock, this);
 
-		b = SPA_CONTAINER_OF(block, struct memblock, this);
+	/* offsets are relative to the fd, blocks in a slab share the fd
+	 * and are imported as one block with a mapping for each of them */
+	offset = SPA_PTRDIFF(data, old->map->ptr) + old->map->offset;
+
+	if (memblock_find_mapping(b, 0, offset, size) == NULL) {
+		struct mapping *m;
 
 		m = calloc(1, sizeof(struct mapping));
 		if (m == NULL) {
@@ -641,6 +1083,11 @@ struct pw_memmap * pw_mempool_import_map(struct pw_mempool *pool,
 		m->block = b;
 		m->offset = old->map->offset;
 		m->size = old->map->size;
+		if (ranges_add(SPA_CONTAINER_OF(pool, struct mempool, this), m) < 0) {
+			free(m);
+			pw_memblock_unref(block);
+			return NULL;
+		}
 		spa_list_append(&b->mappings, &m->link);
 		pw_log_debug(NAME" %p: mapping:%p block:%p offset:%u size:%u ref:%u",
 				pool, m, block, m->offset, m->size, block->ref);
@@ -648,8 +1095,6 @@ struct pw_memmap * pw_mempool_import_map(struct pw_mempool *pool,
 		block->ref--;
 	}
 
-	offset = SPA_PTRDIFF(data, old->map->ptr);
-
 	map = pw_memblock_map(block,
 			block_flags_to_mem(block->flags), offset, size, tag);
 	if (map == NULL)
@@ -704,6 +1149,7 @@ void pw_memblock_free(struct pw_memblock *block)
 
 	if (block->id != SPA_ID_INVALID)
 		pw_map_remove(&impl->map, block->id);
+	fd_hash_remove(impl, b);
 	spa_list_remove(&b->link);
 
 	if (!SPA_FLAG_IS_SET(block->flags, PW_MEMBLOCK_FLAG_DONT_NOTIFY))
@@ -717,7 +1163,10 @@ void pw_memblock_free(struct pw_memblock *block)
 		mapping_free(m);
 	}
 
-	if (block->fd != -1 && !(block->flags & PW_MEMBLOCK_FLAG_DONT_CLOSE)) {
+	if (b->slab != NULL) {
+		impl->stats.slab_used -= b->region.size;
+		slab_release(impl, b->slab, &b->region);
+	} else if (block->fd != -1 && !(block->flags & PW_MEMBLOCK_FLAG_DONT_CLOSE)) {
 		pw_log_debug(NAME" %p: close fd:%d", pool, block->fd);
 		close(block->fd);
 	}
@@ -728,17 +1177,20 @@ SPA_EXPORT
 struct pw_memblock * pw_mempool_find_ptr(struct pw_mempool *pool, const void *ptr)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
-	struct memblock *b;
 	struct mapping *m;
+	uint32_t idx;
 
-	spa_list_for_each(b, &impl->blocks, link) {
-		spa_list_for_each(m, &b->mappings, link) {
-			if (ptr >= m->ptr && ptr < SPA_MEMBER(m->ptr, m->size, void)) {
-				pw_log_debug(NAME" %p: block:%p id:%d for %p", pool,
-						b, b->this.id, ptr);
-				return &b->this;
-			}
-		}
+	/* mappings don't overlap, only the last one that starts at or
+	 * before ptr can contain it */
+	idx = ranges_upper_bound(impl, ptr);
+	if (idx == 0)
+		return NULL;
+
+	m = pw_array_get_unchecked(&impl->ranges, idx - 1, struct range)->mapping;
+	if (ptr >= m->ptr && ptr < SPA_MEMBER(m->ptr, m->size, void)) {
+		pw_log_debug(NAME" %p: block:%p id:%d for %p", pool,
+				m->block, m->block->this.id, ptr);
+		return &m->block->this;
 	}
 	return NULL;
 }
@@ -769,18 +1221,38 @@ struct pw_memblock * pw_mempool_find_fd(struct pw_mempool *pool, int fd)
 	return &b->this;
 }
 
+SPA_EXPORT
+int pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats)
+{
+	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
+
+	*stats = impl->stats;
+	stats->n_blocks = impl->n_blocks;
+	return 0;
+}
+
 SPA_EXPORT
 struct pw_memmap * pw_mempool_find_tag(struct pw_mempool *pool, uint32_t tag[5], size_t size)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
-	struct memblock *b;
 	struct memmap *mm;
+	uint32_t i, start, end;
 
 	pw_log_debug(NAME" %p: find tag %d:%d:%d:%d:%d size:%zd", pool,
 			tag[0], tag[1], tag[2], tag[3], tag[4], size);
 
-	spa_list_for_each(b, &impl->blocks, link) {
-		spa_list_for_each(mm, &b->memmaps, link) {
+	if (size >= sizeof(mm->this.tag)) {
+		/* complete tag, only look in its bucket */
+		size = sizeof(mm->this.tag);
+		start = tag_hash(impl, tag);
+		end = start + 1;
+	} else {
+		/* a tag prefix can be in any bucket */
+		start = 0;
+		end = impl->tag_hash_size;
+	}
+	for (i = start; i < end; i++) {
+		spa_list_for_each(mm, &impl->tag_hash[i], tag_link) {
 			if (memcmp(tag, mm->this.tag, size) == 0) {
 				pw_log_debug(NAME" %p: found %p", pool, mm);
 				return &mm->this;
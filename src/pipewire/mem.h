@@ -40,6 +40,9 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_MAP =		(1 << 3),	/**< mmap the fd */
 	PW_MEMBLOCK_FLAG_DONT_CLOSE =	(1 << 4),	/**< don't close fd */
 	PW_MEMBLOCK_FLAG_DONT_NOTIFY =	(1 << 5),	/**< don't notify events */
+	PW_MEMBLOCK_FLAG_SLAB =		(1 << 6),	/**< allocate from a slab when the pool
+							  *  has them. The fd is shared with other
+							  *  blocks and offsets are relative to the fd */
 
 	PW_MEMBLOCK_FLAG_READWRITE = PW_MEMBLOCK_FLAG_READABLE | PW_MEMBLOCK_FLAG_WRITABLE,
 };
@@ -101,7 +104,20 @@ struct pw_mempool_events {
 	void (*removed) (void *data, struct pw_memblock *block);
 };
 
-/** Create a new memory pool */
+/** statistics of a pool */
+struct pw_mempool_stats {
+	uint32_t n_blocks;		/**< number of blocks in the pool */
+	uint32_t n_slabs;		/**< number of slabs */
+	uint64_t slab_size;		/**< total size of the slabs */
+	uint64_t slab_used;		/**< size of the slabs used by blocks */
+	uint64_t n_slab_allocs;		/**< blocks allocated from a slab */
+	uint64_t n_memfd_allocs;	/**< blocks allocated with their own fd */
+};
+
+/** Create a new memory pool. Blocks with PW_MEMBLOCK_FLAG_SLAB are
+ * allocated from slabs of "mem.slab-size" bytes when it is set. The slabs
+ * are mapped with huge pages with "mem.slab-hugepages" and prefaulted with
+ * "mem.slab-prefault". */
 struct pw_mempool *pw_mempool_new(struct pw_properties *props);
 
 /** Listen for events */
@@ -116,6 +132,9 @@ void pw_mempool_clear(struct pw_mempool *pool);
 /** Clear and destroy a pool */
 void pw_mempool_destroy(struct pw_mempool *pool);
 
+/** Get the statistics of a pool */
+int pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats);
+
 
 /** Allocate a memory block from the pool */
 struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool,
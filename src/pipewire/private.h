@@ -31,6 +31,7 @@ extern "C" {
 
 #include <sys/socket.h>
 #include <sys/types.h> /* for pthread_t */
+#include <time.h>
 
 #include "pipewire/impl.h"
 
@@ -56,6 +57,7 @@ struct defaults {
 	struct spa_rectangle video_size;
 	struct spa_fraction video_rate;
 	uint32_t link_max_buffers;
+	uint32_t link_format_cache;
 	unsigned int mem_warn_mlock:1;
 	unsigned int mem_allow_mlock:1;
 };
@@ -84,6 +86,7 @@ static inline bool ratelimit_test(struct ratelimit *r, uint64_t now)
 }
 
 #define MAX_PARAMS	32
+#define MAX_DATA_LOOPS	16u
 
 struct pw_param {
 	uint32_t id;
@@ -404,6 +407,9 @@ struct pw_context {
 	struct pw_loop *data_loop;	/**< data loop for data passing */
         struct pw_data_loop *data_loop_impl;
 	struct spa_system *data_system;	/**< data system for data passing */
+	struct pw_data_loop *data_loops[MAX_DATA_LOOPS];	/**< data loop workers, the first
+								  *  one is data_loop_impl */
+	uint32_t n_data_loops;		/**< number of data loop workers */
 
 	struct spa_support support[16];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
@@ -413,6 +419,16 @@ struct pw_context {
 
 	struct pw_impl_client *current_client;	/**< client currently executing code in mainloop */
 
+	uint64_t topo_order;		/**< topological order of the next node */
+	uint64_t topo_visit;		/**< generation of the last topological search */
+
+	struct {
+		uint64_t hits;		/**< negotiations found in the cache */
+		uint64_t misses;	/**< negotiations done on the nodes */
+		uint64_t miss_time;	/**< nsec spent in the negotiations on the nodes */
+		uint64_t saved_time;	/**< nsec saved by the cache hits */
+	} format_cache;			/**< statistics of the format cache */
+
 	long sc_pagesize;
 
 	void *user_data;		/**< extra user data */
@@ -428,6 +444,7 @@ struct pw_data_loop {
 	struct spa_source *event;
 
 	pthread_t thread;
+	pid_t tid;			/**< kernel thread id, 0 when unknown */
 	unsigned int created:1;
 	unsigned int running:1;
 };
@@ -510,8 +527,12 @@ static inline void pw_node_activation_state_reset(struct pw_node_activation_stat
 struct pw_node_target {
 	struct spa_list link;
 	struct pw_impl_node *node;
+	struct pw_impl_node *peer;		/* the local node that is woken up */
 	struct pw_node_activation *activation;
 	int (*signal) (void *data);
+	int (*wakeup) (void *data);		/* wake up the node without triggering it, used
+						 * to let spinning followers wait for their
+						 * trigger */
 	void *data;
 };
 
@@ -565,8 +586,22 @@ struct pw_node_activation {
 	uint32_t command;				/* next command */
 	uint32_t reposition_owner;			/* owner id with new reposition info, last one
 							 * to update wins */
+
+	/* appended fields, only present when PW_NODE_ACTIVATION_HAS_SPIN() */
+	uint32_t spin_wait;				/* max time in microseconds the node spins on
+							 * its activation for the trigger after an
+							 * early wakeup, 0 always uses the eventfd.
+							 * Only set by the process that runs the node. */
+	uint32_t spinning;				/* set while the node spins, a signaler that
+							 * clears it doesn't need to write the eventfd */
 };
 
+/* Older servers allocate activations without the spin fields, check the size
+ * of the mapped activation before using them. Older clients never set
+ * spin_wait so they are never woken up early. */
+#define PW_NODE_ACTIVATION_HAS_SPIN(size)	\
+	((size) >= offsetof(struct pw_node_activation, spinning) + sizeof(uint32_t))
+
 #define ATOMIC_CAS(v,ov,nv)						\
 ({									\
 	__typeof__(v) __ov = (ov);					\
@@ -580,6 +615,49 @@ struct pw_node_activation {
 #define ATOMIC_STORE(s,v)		__atomic_store_n(&(s), (v), __ATOMIC_SEQ_CST)
 #define ATOMIC_XCHG(s,v)		__atomic_exchange_n(&(s), (v), __ATOMIC_SEQ_CST)
 
+/** Check if a node that was just triggered needs to be woken up with its
+ * eventfd. When the node is spinning, this takes over the wakeup and the
+ * node will run as soon as it notices. */
+static inline bool pw_node_activation_need_wakeup(struct pw_node_activation *a)
+{
+	return !ATOMIC_CAS(a->spinning, 1u, 0u);
+}
+
+/** Called by a node with spin_wait set after it was woken up. Spins until
+ * the node is triggered or spin_wait expires. Returns true when the node
+ * was triggered and should be processed, false when it should go back to
+ * waiting on its eventfd. */
+static inline bool pw_node_activation_spin(struct pw_node_activation *a)
+{
+	struct timespec ts;
+	uint64_t end;
+	uint32_t i, status;
+
+	status = ATOMIC_LOAD(a->status);
+	if (status != PW_NODE_ACTIVATION_NOT_TRIGGERED)
+		return status == PW_NODE_ACTIVATION_TRIGGERED;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	end = (uint64_t)SPA_TIMESPEC_TO_NSEC(&ts) + a->spin_wait * SPA_NSEC_PER_USEC;
+
+	ATOMIC_STORE(a->spinning, 1u);
+	for (i = 1; ATOMIC_LOAD(a->spinning); i++) {
+		if (ATOMIC_LOAD(a->status) == PW_NODE_ACTIVATION_TRIGGERED) {
+			/* triggered before we started spinning, an eventfd
+			 * wakeup might still follow and will be ignored */
+			ATOMIC_CAS(a->spinning, 1u, 0u);
+			break;
+		}
+		if ((i & 63) == 0) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			if ((uint64_t)SPA_TIMESPEC_TO_NSEC(&ts) > end &&
+			    ATOMIC_CAS(a->spinning, 1u, 0u))
+				return false;
+		}
+	}
+	return true;
+}
+
 #define SEQ_WRITE(s)			ATOMIC_INC(s)
 #define SEQ_WRITE_SUCCESS(s1,s2)	((s1) + 1 == (s2) && ((s2) & 1) == 0)
 
@@ -633,8 +711,12 @@ struct pw_impl_node {
 	unsigned int visited:1;		/**< for sorting */
 	unsigned int want_driver:1;	/**< this node wants to be assigned to a driver */
 	unsigned int passive:1;		/**< driver graph only has passive links */
+	unsigned int recalc:1;		/**< node is in the graph recalc list */
+	unsigned int recalc_driver:1;	/**< followers are in the graph recalc list */
+	unsigned int spin_activation:1;	/**< rt.activation has the spin fields */
 
 	uint32_t port_user_data_size;	/**< extra size for port user data */
+	uint32_t spin_wait;		/**< node.spin-wait in microseconds */
 
 	struct spa_list driver_link;
 	struct pw_impl_node *driver_node;
@@ -642,6 +724,11 @@ struct pw_impl_node {
 	struct spa_list follower_link;
 
 	struct spa_list sort_link;	/**< link used to sort nodes */
+	struct spa_list recalc_link;	/**< link in context recalc list */
+	struct spa_list group_link;	/**< link in context group index */
+	uint64_t topo_order;		/**< position in the topological order of the nodes
+					  *  over the links without feedback */
+	uint64_t topo_visit;		/**< last search that visited this node */
 
 	struct spa_node *node;		/**< SPA node implementation */
 	struct spa_hook listener;
@@ -653,7 +740,8 @@ struct pw_impl_node {
 
 	struct spa_hook_list listener_list;
 
-	struct pw_loop *data_loop;		/**< the data loop for this node */
+	struct pw_loop *data_loop;		/**< the data loop that processes this node,
+						  *  fixed when the node is created */
 
 	struct spa_fraction latency;		/**< requested latency */
 	uint32_t quantum_size;			/**< desired quantum */
@@ -752,6 +840,8 @@ struct pw_impl_port {
 	struct pw_properties *properties;	/**< properties of the port */
 	struct pw_port_info info;
 	struct spa_param_info params[MAX_PARAMS];
+	uint64_t format_hash[2];	/**< hash of the EnumFormat and Format params for
+					  *  the format cache, 0 when unknown */
 
 	struct pw_buffers buffers;	/**< buffers managed by this port, only on
 					  *  output ports, shared with all links */
@@ -1083,6 +1173,15 @@ int pw_proxy_init(struct pw_proxy *proxy, const char *type, uint32_t version);
 void pw_proxy_remove(struct pw_proxy *proxy);
 
 int pw_context_recalc_graph(struct pw_context *context, const char *reason);
+int pw_context_recalc_nodes(struct pw_context *context, struct pw_impl_node *node,
+		struct pw_impl_node *peer, const char *reason);
+void pw_context_update_node_group(struct pw_context *context, struct pw_impl_node *node);
+void pw_context_forget_node(struct pw_context *context, struct pw_impl_node *node);
+
+struct pw_loop *pw_context_acquire_data_loop(struct pw_context *context, const struct spa_dict *props);
+void pw_context_release_data_loop(struct pw_context *context, struct pw_loop *loop);
+int pw_context_invoke_data_loops(struct pw_context *context,
+		spa_invoke_func_t func, void *data);
 
 void pw_impl_port_update_info(struct pw_impl_port *port, const struct spa_port_info *info);
 
@@ -24,66 +24,402 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <pthread.h>
 #include <spa/utils/json.h>
 
 #include "pipewire/array.h"
 #include "pipewire/utils.h"
+#include "pipewire/keys.h"
 #include "pipewire/properties.h"
 
+#define HASH_INIT_SIZE		16u
+#define INTERN_HASH_SIZE	512u
+
 /** \cond */
+struct slot {
+	uint32_t hash;
+	uint32_t index;			/* index + 1 in items, 0 when free */
+};
+
 struct properties {
 	struct pw_properties this;
 
-	struct pw_array items;
+	struct pw_array items;		/* sorted on key */
+	uint32_t hash_size;		/* power of 2 */
+	struct slot *hash;		/* items on key, linear probing */
+	struct slot hash_init[];	/* first hash, allocated with the properties */
 };
 /** \endcond */
 
-static int add_func(struct pw_properties *this, char *key, char *value)
+/* the well known keys, stored once and shared by all properties */
+static const char interned_keys[] =
+	PW_KEY_PROTOCOL "\0"
+	PW_KEY_ACCESS "\0"
+	PW_KEY_CLIENT_ACCESS "\0"
+	PW_KEY_SEC_PID "\0"
+	PW_KEY_SEC_UID "\0"
+	PW_KEY_SEC_GID "\0"
+	PW_KEY_SEC_LABEL "\0"
+	PW_KEY_LIBRARY_NAME_SYSTEM "\0"
+	PW_KEY_LIBRARY_NAME_LOOP "\0"
+	PW_KEY_LIBRARY_NAME_DBUS "\0"
+	PW_KEY_OBJECT_PATH "\0"
+	PW_KEY_OBJECT_ID "\0"
+	PW_KEY_CONFIG_PREFIX "\0"
+	PW_KEY_CONFIG_NAME "\0"
+	PW_KEY_CONTEXT_PROFILE_MODULES "\0"
+	PW_KEY_USER_NAME "\0"
+	PW_KEY_HOST_NAME "\0"
+	PW_KEY_CORE_NAME "\0"
+	PW_KEY_CORE_VERSION "\0"
+	PW_KEY_CORE_DAEMON "\0"
+	PW_KEY_CORE_ID "\0"
+	PW_KEY_CORE_MONITORS "\0"
+	PW_KEY_CPU_MAX_ALIGN "\0"
+	PW_KEY_CPU_CORES "\0"
+	PW_KEY_PRIORITY_SESSION "\0"
+	PW_KEY_PRIORITY_DRIVER "\0"
+	PW_KEY_REMOTE_NAME "\0"
+	PW_KEY_REMOTE_INTENTION "\0"
+	PW_KEY_APP_NAME "\0"
+	PW_KEY_APP_ID "\0"
+	PW_KEY_APP_VERSION "\0"
+	PW_KEY_APP_ICON "\0"
+	PW_KEY_APP_ICON_NAME "\0"
+	PW_KEY_APP_LANGUAGE "\0"
+	PW_KEY_APP_PROCESS_ID "\0"
+	PW_KEY_APP_PROCESS_BINARY "\0"
+	PW_KEY_APP_PROCESS_USER "\0"
+	PW_KEY_APP_PROCESS_HOST "\0"
+	PW_KEY_APP_PROCESS_MACHINE_ID "\0"
+	PW_KEY_APP_PROCESS_SESSION_ID "\0"
+	PW_KEY_WINDOW_X11_DISPLAY "\0"
+	PW_KEY_CLIENT_ID "\0"
+	PW_KEY_CLIENT_NAME "\0"
+	PW_KEY_CLIENT_API "\0"
+	PW_KEY_NODE_ID "\0"
+	PW_KEY_NODE_NAME "\0"
+	PW_KEY_NODE_NICK "\0"
+	PW_KEY_NODE_DESCRIPTION "\0"
+	PW_KEY_NODE_PLUGGED "\0"
+	PW_KEY_NODE_SESSION "\0"
+	PW_KEY_NODE_GROUP "\0"
+	PW_KEY_NODE_EXCLUSIVE "\0"
+	PW_KEY_NODE_AUTOCONNECT "\0"
+	PW_KEY_NODE_TARGET "\0"
+	PW_KEY_NODE_LATENCY "\0"
+	PW_KEY_NODE_DONT_RECONNECT "\0"
+	PW_KEY_NODE_ALWAYS_PROCESS "\0"
+	PW_KEY_NODE_PAUSE_ON_IDLE "\0"
+	PW_KEY_NODE_CACHE_PARAMS "\0"
+	PW_KEY_NODE_SPIN_WAIT "\0"
+	PW_KEY_NODE_DRIVER "\0"
+	PW_KEY_NODE_DATA_LOOP "\0"
+	PW_KEY_NODE_STREAM "\0"
+	PW_KEY_PORT_ID "\0"
+	PW_KEY_PORT_NAME "\0"
+	PW_KEY_PORT_DIRECTION "\0"
+	PW_KEY_PORT_ALIAS "\0"
+	PW_KEY_PORT_PHYSICAL "\0"
+	PW_KEY_PORT_TERMINAL "\0"
+	PW_KEY_PORT_CONTROL "\0"
+	PW_KEY_PORT_MONITOR "\0"
+	PW_KEY_PORT_CACHE_PARAMS "\0"
+	PW_KEY_PORT_EXTRA "\0"
+	PW_KEY_LINK_ID "\0"
+	PW_KEY_LINK_INPUT_NODE "\0"
+	PW_KEY_LINK_INPUT_PORT "\0"
+	PW_KEY_LINK_OUTPUT_NODE "\0"
+	PW_KEY_LINK_OUTPUT_PORT "\0"
+	PW_KEY_LINK_PASSIVE "\0"
+	PW_KEY_LINK_FEEDBACK "\0"
+	PW_KEY_DEVICE_ID "\0"
+	PW_KEY_DEVICE_NAME "\0"
+	PW_KEY_DEVICE_PLUGGED "\0"
+	PW_KEY_DEVICE_NICK "\0"
+	PW_KEY_DEVICE_STRING "\0"
+	PW_KEY_DEVICE_API "\0"
+	PW_KEY_DEVICE_DESCRIPTION "\0"
+	PW_KEY_DEVICE_BUS_PATH "\0"
+	PW_KEY_DEVICE_SERIAL "\0"
+	PW_KEY_DEVICE_VENDOR_ID "\0"
+	PW_KEY_DEVICE_VENDOR_NAME "\0"
+	PW_KEY_DEVICE_PRODUCT_ID "\0"
+	PW_KEY_DEVICE_PRODUCT_NAME "\0"
+	PW_KEY_DEVICE_CLASS "\0"
+	PW_KEY_DEVICE_FORM_FACTOR "\0"
+	PW_KEY_DEVICE_BUS "\0"
+	PW_KEY_DEVICE_SUBSYSTEM "\0"
+	PW_KEY_DEVICE_ICON "\0"
+	PW_KEY_DEVICE_ICON_NAME "\0"
+	PW_KEY_DEVICE_INTENDED_ROLES "\0"
+	PW_KEY_DEVICE_CACHE_PARAMS "\0"
+	PW_KEY_MODULE_ID "\0"
+	PW_KEY_MODULE_NAME "\0"
+	PW_KEY_MODULE_AUTHOR "\0"
+	PW_KEY_MODULE_DESCRIPTION "\0"
+	PW_KEY_MODULE_USAGE "\0"
+	PW_KEY_MODULE_VERSION "\0"
+	PW_KEY_FACTORY_ID "\0"
+	PW_KEY_FACTORY_NAME "\0"
+	PW_KEY_FACTORY_USAGE "\0"
+	PW_KEY_FACTORY_TYPE_NAME "\0"
+	PW_KEY_FACTORY_TYPE_VERSION "\0"
+	PW_KEY_STREAM_IS_LIVE "\0"
+	PW_KEY_STREAM_LATENCY_MIN "\0"
+	PW_KEY_STREAM_LATENCY_MAX "\0"
+	PW_KEY_STREAM_MONITOR "\0"
+	PW_KEY_STREAM_DONT_REMIX "\0"
+	PW_KEY_STREAM_CAPTURE_SINK "\0"
+	PW_KEY_OBJECT_LINGER "\0"
+	PW_KEY_MEDIA_TYPE "\0"
+	PW_KEY_MEDIA_CATEGORY "\0"
+	PW_KEY_MEDIA_ROLE "\0"
+	PW_KEY_MEDIA_CLASS "\0"
+	PW_KEY_MEDIA_NAME "\0"
+	PW_KEY_MEDIA_TITLE "\0"
+	PW_KEY_MEDIA_ARTIST "\0"
+	PW_KEY_MEDIA_COPYRIGHT "\0"
+	PW_KEY_MEDIA_SOFTWARE "\0"
+	PW_KEY_MEDIA_LANGUAGE "\0"
+	PW_KEY_MEDIA_FILENAME "\0"
+	PW_KEY_MEDIA_ICON "\0"
+	PW_KEY_MEDIA_ICON_NAME "\0"
+	PW_KEY_MEDIA_COMMENT "\0"
+	PW_KEY_MEDIA_DATE "\0"
+	PW_KEY_MEDIA_FORMAT "\0"
+	PW_KEY_FORMAT_DSP "\0"
+	PW_KEY_AUDIO_CHANNEL "\0"
+	PW_KEY_AUDIO_RATE "\0"
+	PW_KEY_AUDIO_CHANNELS "\0"
+	PW_KEY_AUDIO_FORMAT "\0"
+	PW_KEY_VIDEO_RATE "\0"
+	PW_KEY_VIDEO_FORMAT "\0"
+	PW_KEY_VIDEO_SIZE "\0"
+	;
+
+static struct slot intern_hash[INTERN_HASH_SIZE];	/* index is offset + 1 */
+static pthread_once_t intern_once = PTHREAD_ONCE_INIT;
+
+static inline uint32_t key_hash(const char *key)
 {
-	struct spa_dict_item *item;
-	struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (*key)
+		hash = (hash ^ (uint8_t)*key++) * 16777619u;
+	return hash;
+}
 
-	item = pw_array_add(&impl->items, sizeof(struct spa_dict_item));
-	if (item == NULL) {
-		free(key);
-		free(value);
-		return -errno;
+static void intern_init(void)
+{
+	const char *key, *end = &interned_keys[sizeof(interned_keys) - 1];
+	uint32_t i, hash;
+
+	for (key = interned_keys; key < end; key += strlen(key) + 1) {
+		hash = key_hash(key);
+		for (i = hash & (INTERN_HASH_SIZE - 1); intern_hash[i].index;
+		     i = (i + 1) & (INTERN_HASH_SIZE - 1));
+		intern_hash[i].hash = hash;
+		intern_hash[i].index = key - interned_keys + 1;
 	}
+}
+
+static inline bool is_interned(const char *key)
+{
+	return key >= interned_keys && key < &interned_keys[sizeof(interned_keys)];
+}
+
+/* the interned key or a copy */
+static char *intern_key(const char *key, uint32_t hash)
+{
+	uint32_t i;
 
-	item->key = key;
-	item->value = value;
+	if (is_interned(key))
+		return (char *) key;
 
-	this->dict.items = impl->items.data;
-	this->dict.n_items++;
-	return 0;
+	pthread_once(&intern_once, intern_init);
+
+	for (i = hash & (INTERN_HASH_SIZE - 1); intern_hash[i].index;
+	     i = (i + 1) & (INTERN_HASH_SIZE - 1)) {
+		const char *k = &interned_keys[intern_hash[i].index - 1];
+		if (intern_hash[i].hash == hash && strcmp(k, key) == 0)
+			return (char *) k;
+	}
+	return strdup(key);
 }
 
 static void clear_item(struct spa_dict_item *item)
 {
-	free((char *) item->key);
+	if (!is_interned(item->key))
+		free((char *) item->key);
 	free((char *) item->value);
 }
 
+/* the slot with key or the free slot where it should go */
+static struct slot *find_slot(const struct properties *impl, const char *key, uint32_t hash)
+{
+	const struct spa_dict_item *items = impl->items.data;
+	uint32_t i, mask = impl->hash_size - 1;
+
+	for (i = hash & mask; impl->hash[i].index; i = (i + 1) & mask) {
+		const char *k = items[impl->hash[i].index - 1].key;
+		if (impl->hash[i].hash == hash && (k == key || strcmp(k, key) == 0))
+			break;
+	}
+	return &impl->hash[i];
+}
+
 static int find_index(const struct pw_properties *this, const char *key)
 {
-	const struct spa_dict_item *item;
-	item = spa_dict_lookup_item(&this->dict, key);
-	if (item == NULL)
+	const struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
+
+	if (key == NULL)
 		return -1;
-	return item - this->dict.items;
+
+	return (int)find_slot(impl, key, key_hash(key))->index - 1;
+}
+
+static int hash_resize(struct properties *impl, uint32_t size)
+{
+	const struct spa_dict_item *items = impl->items.data;
+	struct slot *hash;
+	uint32_t i, j, h;
+
+	if ((hash = calloc(size, sizeof(struct slot))) == NULL)
+		return -errno;
+
+	for (i = 0; i < impl->this.dict.n_items; i++) {
+		h = key_hash(items[i].key);
+		for (j = h & (size - 1); hash[j].index; j = (j + 1) & (size - 1));
+		hash[j].hash = h;
+		hash[j].index = i + 1;
+	}
+	if (impl->hash != impl->hash_init)
+		free(impl->hash);
+	impl->hash = hash;
+	impl->hash_size = size;
+	return 0;
+}
+
+/* move the index of the items from pos on by delta */
+static void hash_shift(struct properties *impl, uint32_t pos, int delta)
+{
+	uint32_t i;
+
+	for (i = 0; i < impl->hash_size; i++) {
+		if (impl->hash[i].index > pos)
+			impl->hash[i].index += delta;
+	}
+}
+
+/* add a key that is not in the properties yet at its sorted position,
+ * takes ownership of value */
+static int add_item(struct properties *impl, const char *key, uint32_t hash, char *value)
+{
+	struct pw_properties *this = &impl->this;
+	struct spa_dict_item *items;
+	uint32_t lo, hi, n_items = this->dict.n_items;
+	char *k;
+	int res;
+
+	if ((n_items + 1) * 2 > impl->hash_size &&
+	    (res = hash_resize(impl, SPA_MAX(impl->hash_size * 2, HASH_INIT_SIZE))) < 0)
+		goto error;
+
+	if ((k = intern_key(key, hash)) == NULL)
+		goto error_errno;
+
+	if (pw_array_add(&impl->items, sizeof(struct spa_dict_item)) == NULL) {
+		if (!is_interned(k))
+			free(k);
+		goto error_errno;
+	}
+	items = impl->items.data;
+
+	/* copies of sorted dicts are appended */
+	if (n_items == 0 || strcmp(items[n_items - 1].key, k) < 0)
+		lo = hi = n_items;
+	else {
+		lo = 0;
+		hi = n_items;
+	}
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (strcmp(items[mid].key, k) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < n_items) {
+		memmove(&items[lo + 1], &items[lo], (n_items - lo) * sizeof(struct spa_dict_item));
+		hash_shift(impl, lo, 1);
+	}
+	items[lo].key = k;
+	items[lo].value = value;
+
+	this->dict.items = items;
+	this->dict.n_items++;
+
+	*find_slot(impl, k, hash) = (struct slot) { hash, lo + 1 };
+	return 0;
+
+error_errno:
+	res = -errno;
+error:
+	free(value);
+	return res;
+}
+
+static void remove_item(struct properties *impl, struct slot *s)
+{
+	struct pw_properties *this = &impl->this;
+	struct spa_dict_item *items = impl->items.data;
+	uint32_t i, j, home, mask = impl->hash_size - 1;
+	uint32_t idx = s->index - 1;
+
+	/* move up the following slots that would not be found anymore */
+	i = j = s - impl->hash;
+	while (true) {
+		j = (j + 1) & mask;
+		if (impl->hash[j].index == 0)
+			break;
+		home = impl->hash[j].hash & mask;
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		impl->hash[i] = impl->hash[j];
+		i = j;
+	}
+	impl->hash[i].index = 0;
+
+	clear_item(&items[idx]);
+	memmove(&items[idx], &items[idx + 1],
+			(this->dict.n_items - idx - 1) * sizeof(struct spa_dict_item));
+	impl->items.size -= sizeof(struct spa_dict_item);
+	this->dict.n_items--;
+	hash_shift(impl, idx + 1, -1);
 }
 
 static struct properties *properties_new(int prealloc)
 {
 	struct properties *impl;
+	uint32_t size;
 
-	impl = calloc(1, sizeof(struct properties));
+	for (size = HASH_INIT_SIZE; size < (uint32_t)prealloc * 2; size *= 2);
+
+	impl = calloc(1, sizeof(struct properties) + size * sizeof(struct slot));
 	if (impl == NULL)
 		return NULL;
 
 	pw_array_init(&impl->items, 16);
 	pw_array_ensure_size(&impl->items, sizeof(struct spa_dict_item) * prealloc);
 
+	impl->hash = impl->hash_init;
+	impl->hash_size = size;
+
+	/* the items are kept sorted so that spa_dict_lookup() can bisect */
+	impl->this.dict.flags = SPA_DICT_FLAG_SORTED;
+	impl->this.dict.items = impl->items.data;
+
 	return impl;
 }
 
@@ -109,8 +445,7 @@ struct pw_properties *pw_properties_new(const char *key, ...)
 	va_start(varargs, key);
 	while (key != NULL) {
 		value = va_arg(varargs, char *);
-		if (value && key[0])
-			add_func(&impl->this, strdup(key), strdup(value));
+		pw_properties_set(&impl->this, key, value);
 		key = va_arg(varargs, char *);
 	}
 	va_end(varargs);
@@ -137,9 +472,7 @@ struct pw_properties *pw_properties_new_dict(const struct spa_dict *dict)
 
 	for (i = 0; i < dict->n_items; i++) {
 		const struct spa_dict_item *it = &dict->items[i];
-		if (it->key != NULL && it->key[0] && it->value != NULL)
-			add_func(&impl->this, strdup(it->key),
-				 strdup(it->value));
+		pw_properties_set(&impl->this, it->key, it->value);
 	}
 
 	return &impl->this;
@@ -222,7 +555,35 @@ error:
 SPA_EXPORT
 struct pw_properties *pw_properties_copy(const struct pw_properties *properties)
 {
-	return pw_properties_new_dict(&properties->dict);
+	const struct properties *other = SPA_CONTAINER_OF(properties, struct properties, this);
+	const struct spa_dict_item *it;
+	struct properties *impl;
+
+	impl = properties_new(properties->dict.n_items);
+	if (impl == NULL)
+		return NULL;
+
+	spa_dict_for_each(it, &properties->dict) {
+		struct spa_dict_item *item = pw_array_add(&impl->items, sizeof(struct spa_dict_item));
+
+		item->key = is_interned(it->key) ? it->key : strdup(it->key);
+		item->value = strdup(it->value);
+		impl->this.dict.n_items++;
+		if (item->key == NULL || item->value == NULL)
+			goto error;
+	}
+	impl->this.dict.items = impl->items.data;
+
+	/* the items are in the same order so the hash can be copied */
+	if (impl->hash_size == other->hash_size)
+		memcpy(impl->hash, other->hash, impl->hash_size * sizeof(struct slot));
+	else if (hash_resize(impl, impl->hash_size) < 0)
+		goto error;
+
+	return &impl->this;
+error:
+	pw_properties_free(&impl->this);
+	return NULL;
 }
 
 /** Copy multiple keys from one property to another
@@ -288,6 +649,7 @@ void pw_properties_clear(struct pw_properties *properties)
 		clear_item(item);
 	pw_array_reset(&impl->items);
 	properties->dict.n_items = 0;
+	memset(impl->hash, 0, impl->hash_size * sizeof(struct slot));
 }
 
 /** Update properties
@@ -379,42 +741,45 @@ void pw_properties_free(struct pw_properties *properties)
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
 	pw_properties_clear(properties);
 	pw_array_clear(&impl->items);
+	if (impl->hash != impl->hash_init)
+		free(impl->hash);
 	free(impl);
 }
 
 static int do_replace(struct pw_properties *properties, const char *key, char *value, bool copy)
 {
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
-	int index;
+	struct slot *s;
+	uint32_t hash;
+	int res;
 
 	if (key == NULL || key[0] == 0)
 		goto exit_noupdate;
 
-	index = find_index(properties, key);
+	hash = key_hash(key);
+	s = find_slot(impl, key, hash);
 
-	if (index == -1) {
+	if (s->index == 0) {
 		if (value == NULL)
 			return 0;
-		add_func(properties, strdup(key), copy ? strdup(value) : value);
+		if (copy && (value = strdup(value)) == NULL)
+			return -errno;
+		if ((res = add_item(impl, key, hash, value)) < 0)
+			return res;
 	} else {
 		struct spa_dict_item *item =
-		    pw_array_get_unchecked(&impl->items, index, struct spa_dict_item);
+		    pw_array_get_unchecked(&impl->items, s->index - 1, struct spa_dict_item);
 
 		if (value && strcmp(item->value, value) == 0)
 			goto exit_noupdate;
 
 		if (value == NULL) {
-			struct spa_dict_item *last = pw_array_get_unchecked(&impl->items,
-						     pw_array_get_len(&impl->items, struct spa_dict_item) - 1,
-						     struct spa_dict_item);
-			clear_item(item);
-			item->key = last->key;
-			item->value = last->value;
-			impl->items.size -= sizeof(struct spa_dict_item);
-			properties->dict.n_items--;
+			remove_item(impl, s);
 		} else {
+			if (copy && (value = strdup(value)) == NULL)
+				return -errno;
 			free((char *) item->value);
-			item->value = copy ? strdup(value) : value;
+			item->value = value;
 		}
 	}
 	return 1;
@@ -431,7 +796,8 @@ exit_noupdate:
  * \param value a value or NULL to remove the key
  * \return 1 if the properties were changed. 0 if nothing was changed because
  *  the property already existed with the same value or because the key to remove
- *  did not exist.
+ *  did not exist. A negative errno when the memory for the property could not
+ *  be allocated.
  *
  * Set the property in \a properties with \a key to \a value. Any previous value
  * of \a key will be overwritten. When \a value is NULL, the key will be
@@ -0,0 +1,269 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#define DEFAULT_NODES		2000
+#define DEFAULT_LAYERS		20
+#define DEFAULT_FANOUT		6
+
+/* layers of nodes, every node links to fanout nodes of the next layer,
+ * like busses that fan out to many channels and mix back together */
+struct data {
+	struct pw_main_loop *main_loop;
+	struct pw_loop *loop;
+	struct pw_context *context;
+
+	uint32_t n_nodes;
+	uint32_t n_layers;
+	uint32_t n_fanout;
+	uint32_t width;
+	uint32_t n_links;
+
+	struct pw_impl_node **nodes;
+	struct pw_impl_port **outputs;
+	struct pw_impl_port **inputs;
+	struct pw_impl_link **links;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* every node and link takes an fd */
+static void raise_fd_limit(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+		return;
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static struct pw_impl_node *make_node(struct data *d)
+{
+	struct pw_impl_node *node;
+	struct spa_handle *handle;
+	void *iface;
+	int res;
+
+	handle = pw_context_load_spa_handle(d->context, SPA_NAME_AUDIO_PROCESS_CHANNELMIX, NULL);
+	if (handle == NULL) {
+		fprintf(stderr, "can't load %s: %m\n", SPA_NAME_AUDIO_PROCESS_CHANNELMIX);
+		exit(-1);
+	}
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_Node, &iface)) < 0) {
+		fprintf(stderr, "can't get node interface: %s\n", spa_strerror(res));
+		exit(-1);
+	}
+	node = pw_context_create_node(d->context, NULL, 0);
+	if (node == NULL) {
+		fprintf(stderr, "can't create node: %m\n");
+		exit(-1);
+	}
+	pw_impl_node_set_implementation(node, iface);
+	pw_impl_node_register(node, NULL);
+	return node;
+}
+
+static bool is_feedback(struct pw_impl_link *link)
+{
+	const char *str = spa_dict_lookup(pw_impl_link_get_info(link)->props,
+			PW_KEY_LINK_FEEDBACK);
+	return str != NULL && pw_properties_parse_bool(str);
+}
+
+static struct pw_impl_link *make_link(struct data *d, uint32_t output, uint32_t input)
+{
+	struct pw_impl_link *link;
+
+	link = pw_context_create_link(d->context, d->outputs[output], d->inputs[input],
+			NULL, NULL, 0);
+	if (link == NULL) {
+		fprintf(stderr, "can't create link %u -> %u: %m\n", output, input);
+		exit(-1);
+	}
+	pw_impl_link_register(link, NULL);
+	return link;
+}
+
+static void make_nodes(struct data *d, bool reverse)
+{
+	uint32_t i, idx;
+	uint64_t t1, t2;
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_nodes; i++) {
+		idx = reverse ? d->n_nodes - 1 - i : i;
+		d->nodes[idx] = make_node(d);
+		d->outputs[idx] = pw_impl_node_find_port(d->nodes[idx],
+				PW_DIRECTION_OUTPUT, SPA_ID_INVALID);
+		d->inputs[idx] = pw_impl_node_find_port(d->nodes[idx],
+				PW_DIRECTION_INPUT, SPA_ID_INVALID);
+		if (d->outputs[idx] == NULL || d->inputs[idx] == NULL) {
+			fprintf(stderr, "node %u has no ports\n", idx);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "created %u nodes: %f ms\n", d->n_nodes, (t2 - t1) / 1000000.0);
+}
+
+static void destroy_nodes(struct data *d)
+{
+	uint32_t i;
+
+	for (i = 0; i < d->n_nodes; i++)
+		pw_impl_node_destroy(d->nodes[i]);
+}
+
+/* link the layers in the given order. The creation order of the nodes
+ * and links decides how much of the graph has to be reordered. */
+static void make_links(struct data *d, const char *name, bool bottom_up)
+{
+	uint32_t i, j, k, layer, n = 0, feedback = 0;
+	uint64_t t1, t2;
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_layers - 1; i++) {
+		layer = bottom_up ? d->n_layers - 2 - i : i;
+		for (j = 0; j < d->width; j++) {
+			uint32_t output = layer * d->width + j;
+
+			for (k = 0; k < d->n_fanout; k++) {
+				uint32_t input = (layer + 1) * d->width +
+					(j * 7 + k * (d->width / d->n_fanout + 1)) % d->width;
+				d->links[n] = make_link(d, output, input);
+				if (is_feedback(d->links[n]))
+					feedback++;
+				n++;
+			}
+		}
+	}
+	t2 = get_time_ns();
+	d->n_links = n;
+	fprintf(stderr, "%s: created %u links, %u feedback: %f ms, %f us per link\n",
+			name, n, feedback, (t2 - t1) / 1000000.0, (t2 - t1) / 1000.0 / n);
+}
+
+/* links from the last layer back to the first close a cycle */
+static void make_feedback(struct data *d)
+{
+	uint32_t i, n = SPA_MIN(d->width, 100u), feedback = 0;
+	struct pw_impl_link *link;
+	uint64_t t1, t2;
+
+	t1 = get_time_ns();
+	for (i = 0; i < n; i++) {
+		link = make_link(d, (d->n_layers - 1) * d->width + i, (i * 7) % d->width);
+		if (is_feedback(link))
+			feedback++;
+		pw_impl_link_destroy(link);
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "feedback: created %u links, %u feedback: %f ms, %f us per link\n",
+			n, feedback, (t2 - t1) / 1000000.0, (t2 - t1) / 1000.0 / n);
+}
+
+static void destroy_links(struct data *d)
+{
+	uint32_t i;
+
+	for (i = 0; i < d->n_links; i++)
+		pw_impl_link_destroy(d->links[i]);
+	d->n_links = 0;
+}
+
+static void run(struct data *d, const char *name, bool reverse, bool bottom_up)
+{
+	make_nodes(d, reverse);
+	make_links(d, name, bottom_up);
+	make_feedback(d);
+	destroy_links(d);
+	destroy_nodes(d);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+
+	pw_init(&argc, &argv);
+
+	data.n_nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_NODES;
+	data.n_layers = argc > 2 ? (uint32_t)atoi(argv[2]) : DEFAULT_LAYERS;
+	data.n_fanout = argc > 3 ? (uint32_t)atoi(argv[3]) : DEFAULT_FANOUT;
+	data.n_layers = SPA_CLAMP(data.n_layers, 2u, data.n_nodes / 2);
+	data.width = data.n_nodes / data.n_layers;
+	data.n_fanout = SPA_CLAMP(data.n_fanout, 1u, data.width);
+	data.n_nodes = data.width * data.n_layers;
+
+	raise_fd_limit();
+
+	data.main_loop = pw_main_loop_new(NULL);
+	data.loop = pw_main_loop_get_loop(data.main_loop);
+	data.context = pw_context_new(data.loop,
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				NULL), 0);
+	if (data.context == NULL) {
+		fprintf(stderr, "can't create context: %m\n");
+		return -1;
+	}
+	pw_context_add_spa_lib(data.context, "audio.process.*", "audioconvert/libspa-audioconvert");
+
+	data.nodes = calloc(data.n_nodes, sizeof(struct pw_impl_node *));
+	data.outputs = calloc(data.n_nodes, sizeof(struct pw_impl_port *));
+	data.inputs = calloc(data.n_nodes, sizeof(struct pw_impl_port *));
+	data.links = calloc(data.n_nodes * data.n_fanout, sizeof(struct pw_impl_link *));
+
+	fprintf(stderr, "%u layers of %u nodes, fanout %u\n",
+			data.n_layers, data.width, data.n_fanout);
+
+	run(&data, "top-down", false, false);
+	run(&data, "bottom-up", false, true);
+	run(&data, "reversed", true, false);
+
+	pw_context_destroy(data.context);
+	pw_main_loop_destroy(data.main_loop);
+
+	free(data.nodes);
+	free(data.outputs);
+	free(data.inputs);
+	free(data.links);
+
+	return 0;
+}
@@ -0,0 +1,262 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#define DEFAULT_NODES		5000
+#define DEFAULT_LINKS		10000
+#define DEFAULT_GROUPS		100
+#define DEFAULT_FORMAT_CACHE	"64"
+#define N_CHANGES		1000
+
+struct data {
+	struct pw_main_loop *main_loop;
+	struct pw_loop *loop;
+	struct pw_context *context;
+
+	uint32_t n_nodes;
+	uint32_t n_links;
+	uint32_t n_groups;
+
+	struct pw_impl_node **drivers;
+	struct pw_impl_node **nodes;
+	struct pw_impl_link **links;
+	struct pw_impl_port **outputs;
+	struct pw_impl_port **inputs;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static struct pw_impl_node *make_node(struct data *d, const char *factory, uint32_t group,
+		bool driver)
+{
+	struct pw_impl_node *node;
+	struct pw_properties *props;
+	struct spa_handle *handle;
+	void *iface;
+	int res;
+
+	handle = pw_context_load_spa_handle(d->context, factory, NULL);
+	if (handle == NULL) {
+		fprintf(stderr, "can't load %s: %m\n", factory);
+		exit(-1);
+	}
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_Node, &iface)) < 0) {
+		fprintf(stderr, "can't get node interface: %s\n", spa_strerror(res));
+		exit(-1);
+	}
+	props = pw_properties_new(NULL, NULL);
+	pw_properties_setf(props, PW_KEY_NODE_GROUP, "%u", group);
+	if (driver)
+		pw_properties_set(props, PW_KEY_NODE_DRIVER, "true");
+
+	node = pw_context_create_node(d->context, props, 0);
+	if (node == NULL) {
+		fprintf(stderr, "can't create node: %m\n");
+		exit(-1);
+	}
+	pw_impl_node_set_implementation(node, iface);
+	pw_impl_node_register(node, NULL);
+	pw_impl_node_set_active(node, true);
+	return node;
+}
+
+static void iterate(struct data *d)
+{
+	while (pw_loop_iterate(d->loop, 0) > 0);
+}
+
+static uint32_t count_prepared(struct data *d)
+{
+	uint32_t i, n = 0;
+	for (i = 0; i < d->n_links; i++) {
+		if (pw_impl_link_get_info(d->links[i])->state >= PW_LINK_STATE_PAUSED)
+			n++;
+	}
+	return n;
+}
+
+static struct pw_impl_link *make_link(struct data *d, uint32_t index)
+{
+	uint32_t per_group = d->n_nodes / d->n_groups / 2;
+	uint32_t group = index % d->n_groups;
+	uint32_t k = index / d->n_groups;
+	uint32_t src = k % per_group;
+	uint32_t sink = (src + k / per_group) % per_group;
+	struct pw_impl_link *link;
+
+	link = pw_context_create_link(d->context,
+			d->outputs[group * per_group + src],
+			d->inputs[group * per_group + sink],
+			NULL, NULL, 0);
+	if (link == NULL) {
+		fprintf(stderr, "can't create link %u: %m\n", index);
+		exit(-1);
+	}
+	pw_impl_link_register(link, NULL);
+	return link;
+}
+
+static void setup_graph(struct data *d)
+{
+	uint32_t i, per_group = d->n_nodes / d->n_groups / 2;
+	uint64_t t1, t2;
+
+	d->drivers = calloc(d->n_groups, sizeof(struct pw_impl_node *));
+	d->nodes = calloc(d->n_nodes, sizeof(struct pw_impl_node *));
+	d->outputs = calloc(d->n_nodes, sizeof(struct pw_impl_port *));
+	d->inputs = calloc(d->n_nodes, sizeof(struct pw_impl_port *));
+	d->links = calloc(d->n_links, sizeof(struct pw_impl_link *));
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_groups; i++)
+		d->drivers[i] = make_node(d, SPA_NAME_SUPPORT_NODE_DRIVER, i, true);
+
+	/* each group has half sources and half sinks */
+	for (i = 0; i < d->n_groups * per_group; i++) {
+		uint32_t group = i / per_group;
+
+		d->nodes[2 * i] = make_node(d, "audiotestsrc", group, false);
+		d->nodes[2 * i + 1] = make_node(d, "support.null-audio-sink", group, false);
+
+		d->outputs[i] = pw_impl_node_find_port(d->nodes[2 * i],
+				PW_DIRECTION_OUTPUT, SPA_ID_INVALID);
+		d->inputs[i] = pw_impl_node_find_port(d->nodes[2 * i + 1],
+				PW_DIRECTION_INPUT, SPA_ID_INVALID);
+	}
+	d->n_nodes = d->n_groups * per_group * 2;
+	iterate(d);
+	t2 = get_time_ns();
+	fprintf(stderr, "created %u nodes in %u groups: %f ms\n",
+			d->n_nodes, d->n_groups, (t2 - t1) / 1000000.0);
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_links; i++)
+		d->links[i] = make_link(d, i);
+	iterate(d);
+	t2 = get_time_ns();
+	fprintf(stderr, "created %u links, %u prepared: %f ms\n",
+			d->n_links, count_prepared(d), (t2 - t1) / 1000000.0);
+}
+
+static void test_activate(struct data *d)
+{
+	uint32_t i;
+	uint64_t t1, t2, total = 0;
+
+	for (i = 0; i < N_CHANGES; i++) {
+		struct pw_impl_node *node = d->nodes[(i * 7919) % d->n_nodes];
+
+		t1 = get_time_ns();
+		pw_impl_node_set_active(node, false);
+		t2 = get_time_ns();
+		total += t2 - t1;
+		iterate(d);
+
+		t1 = get_time_ns();
+		pw_impl_node_set_active(node, true);
+		t2 = get_time_ns();
+		total += t2 - t1;
+		iterate(d);
+	}
+	fprintf(stderr, "node deactivate/activate: %d changes, %f us per change\n",
+			2 * N_CHANGES, total / (2000.0 * N_CHANGES));
+}
+
+static void test_relink(struct data *d)
+{
+	uint32_t i;
+	uint64_t t1, t2, total = 0;
+
+	for (i = 0; i < N_CHANGES; i++) {
+		uint32_t index = (i * 7919) % d->n_links;
+
+		t1 = get_time_ns();
+		pw_impl_link_destroy(d->links[index]);
+		t2 = get_time_ns();
+		total += t2 - t1;
+
+		d->links[index] = make_link(d, index);
+		iterate(d);
+	}
+	fprintf(stderr, "link destroy: %d changes, %f us per change, %u prepared\n",
+			N_CHANGES, total / (1000.0 * N_CHANGES), count_prepared(d));
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	const char *format_cache;
+
+	pw_init(&argc, &argv);
+
+	data.n_nodes = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_NODES;
+	data.n_links = argc > 2 ? (uint32_t)atoi(argv[2]) : DEFAULT_LINKS;
+	data.n_groups = argc > 3 ? (uint32_t)atoi(argv[3]) : DEFAULT_GROUPS;
+	data.n_groups = SPA_CLAMP(data.n_groups, 1u, data.n_nodes / 2);
+	format_cache = argc > 4 ? argv[4] : DEFAULT_FORMAT_CACHE;
+
+	data.main_loop = pw_main_loop_new(NULL);
+	data.loop = pw_main_loop_get_loop(data.main_loop);
+	data.context = pw_context_new(data.loop,
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				"link.format-cache", format_cache,
+				NULL), 0);
+	if (data.context == NULL) {
+		fprintf(stderr, "can't create context: %m\n");
+		return -1;
+	}
+	pw_context_add_spa_lib(data.context, "support.*", "support/libspa-support");
+	pw_context_add_spa_lib(data.context, "audiotestsrc", "audiotestsrc/libspa-audiotestsrc");
+
+	setup_graph(&data);
+
+	test_activate(&data);
+	test_relink(&data);
+
+	pw_context_destroy(data.context);
+	pw_main_loop_destroy(data.main_loop);
+
+	free(data.drivers);
+	free(data.nodes);
+	free(data.links);
+	free(data.outputs);
+	free(data.inputs);
+
+	return 0;
+}
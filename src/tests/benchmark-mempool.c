@@ -0,0 +1,261 @@
+/* PipeWire
+ *
+ * Copyright © 2021 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <pipewire/pipewire.h>
+
+#define DEFAULT_BLOCKS		10000
+#define BLOCK_SIZE		4096
+#define N_LOOKUPS		100000
+#define N_CHURN			10000
+#define SLAB_SIZE		"4194304"
+
+struct data {
+	uint32_t n_blocks;
+
+	struct pw_mempool *pool;	/**< pool of the server, with the memory */
+	struct pw_mempool *client;	/**< pool of a client, importing the memory */
+
+	struct pw_memblock **blocks;
+	struct pw_memmap **maps;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* every block takes an fd */
+static uint32_t max_blocks(uint32_t n_blocks)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+		return n_blocks;
+	if (rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		getrlimit(RLIMIT_NOFILE, &rl);
+	}
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < n_blocks + 64)
+		n_blocks = rl.rlim_cur - 64;
+	return n_blocks;
+}
+
+static void make_blocks(struct data *d)
+{
+	uint64_t t1, t2;
+	uint32_t i;
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_blocks; i++) {
+		d->blocks[i] = pw_mempool_alloc(d->pool,
+				PW_MEMBLOCK_FLAG_READWRITE |
+				PW_MEMBLOCK_FLAG_SEAL |
+				PW_MEMBLOCK_FLAG_MAP,
+				SPA_DATA_MemFd, BLOCK_SIZE);
+		if (d->blocks[i] == NULL) {
+			fprintf(stderr, "can't allocate block %u: %m\n", i);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "allocated %u blocks: %f ms\n",
+			d->n_blocks, (t2 - t1) / 1000000.0);
+}
+
+/* what the client-node does for the buffers and io areas of a port */
+static void import_blocks(struct data *d)
+{
+	uint64_t t1, t2;
+	uint32_t i;
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_blocks; i++) {
+		uint32_t tag[5] = { i / 64, 0, i % 64, 0, 0 };
+		void *ptr = SPA_MEMBER(d->blocks[i]->map->ptr, 64, void);
+
+		d->maps[i] = pw_mempool_import_map(d->client, d->pool, ptr, 128, tag);
+		if (d->maps[i] == NULL) {
+			fprintf(stderr, "can't import block %u: %m\n", i);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "imported %u blocks: %f ms, %f us per block\n",
+			d->n_blocks, (t2 - t1) / 1000000.0,
+			(t2 - t1) / 1000.0 / d->n_blocks);
+}
+
+static void find_blocks(struct data *d)
+{
+	uint64_t t1, t2;
+	uint32_t i, idx;
+
+	t1 = get_time_ns();
+	for (i = 0; i < N_LOOKUPS; i++) {
+		idx = (i * 7919) % d->n_blocks;
+		if (pw_mempool_find_ptr(d->pool,
+				SPA_MEMBER(d->blocks[idx]->map->ptr, i % BLOCK_SIZE, void)) != d->blocks[idx]) {
+			fprintf(stderr, "wrong block for ptr %u\n", idx);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "find_ptr: %u lookups, %f us per lookup\n",
+			N_LOOKUPS, (t2 - t1) / 1000.0 / N_LOOKUPS);
+
+	t1 = get_time_ns();
+	for (i = 0; i < N_LOOKUPS; i++) {
+		idx = (i * 7919) % d->n_blocks;
+		if (pw_mempool_find_fd(d->pool, d->blocks[idx]->fd) != d->blocks[idx]) {
+			fprintf(stderr, "wrong block for fd %u\n", idx);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "find_fd: %u lookups, %f us per lookup\n",
+			N_LOOKUPS, (t2 - t1) / 1000.0 / N_LOOKUPS);
+
+	t1 = get_time_ns();
+	for (i = 0; i < N_LOOKUPS; i++) {
+		uint32_t tag[5];
+
+		idx = (i * 7919) % d->n_blocks;
+		tag[0] = idx / 64;
+		tag[1] = 0;
+		tag[2] = idx % 64;
+		tag[3] = tag[4] = 0;
+		if (pw_mempool_find_tag(d->client, tag, sizeof(tag)) != d->maps[idx]) {
+			fprintf(stderr, "wrong map for tag %u\n", idx);
+			exit(-1);
+		}
+	}
+	t2 = get_time_ns();
+	fprintf(stderr, "find_tag: %u lookups, %f us per lookup\n",
+			N_LOOKUPS, (t2 - t1) / 1000.0 / N_LOOKUPS);
+}
+
+static void free_blocks(struct data *d)
+{
+	uint64_t t1, t2;
+	uint32_t i;
+
+	t1 = get_time_ns();
+	for (i = 0; i < d->n_blocks; i++)
+		pw_memmap_free(d->maps[i]);
+	pw_mempool_clear(d->client);
+	for (i = 0; i < d->n_blocks; i++)
+		pw_memblock_unref(d->blocks[i]);
+	t2 = get_time_ns();
+	fprintf(stderr, "freed %u blocks: %f ms\n",
+			d->n_blocks, (t2 - t1) / 1000000.0);
+}
+
+/* allocate and free buffer memory like links that come and go */
+static void churn_blocks(const char *name, struct pw_properties *props)
+{
+	struct pw_mempool *pool;
+	struct pw_mempool_stats stats;
+	struct pw_memblock *b;
+	uint64_t t1, t2;
+	uint32_t i;
+
+	pool = pw_mempool_new(props);
+	if (pool == NULL) {
+		fprintf(stderr, "can't allocate: %m\n");
+		exit(-1);
+	}
+
+	t1 = get_time_ns();
+	for (i = 0; i < N_CHURN; i++) {
+		b = pw_mempool_alloc(pool,
+				PW_MEMBLOCK_FLAG_READWRITE |
+				PW_MEMBLOCK_FLAG_SEAL |
+				PW_MEMBLOCK_FLAG_MAP |
+				PW_MEMBLOCK_FLAG_SLAB,
+				SPA_DATA_MemFd, BLOCK_SIZE * (1 + i % 16));
+		if (b == NULL) {
+			fprintf(stderr, "can't allocate block %u: %m\n", i);
+			exit(-1);
+		}
+		memset(b->map->ptr, i, b->size);
+		pw_memblock_unref(b);
+	}
+	t2 = get_time_ns();
+
+	pw_mempool_get_stats(pool, &stats);
+	fprintf(stderr, "%s: %u alloc/free: %f us per block, "
+			"%"PRIu64" memfd %"PRIu64" slab allocs, %u slabs\n",
+			name, N_CHURN, (t2 - t1) / 1000.0 / N_CHURN,
+			stats.n_memfd_allocs, stats.n_slab_allocs, stats.n_slabs);
+
+	pw_mempool_destroy(pool);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0, };
+
+	pw_init(&argc, &argv);
+
+	data.n_blocks = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_BLOCKS;
+	data.n_blocks = max_blocks(data.n_blocks);
+
+	data.pool = pw_mempool_new(NULL);
+	data.client = pw_mempool_new(NULL);
+	data.blocks = calloc(data.n_blocks, sizeof(struct pw_memblock *));
+	data.maps = calloc(data.n_blocks, sizeof(struct pw_memmap *));
+	if (data.pool == NULL || data.client == NULL ||
+	    data.blocks == NULL || data.maps == NULL) {
+		fprintf(stderr, "can't allocate: %m\n");
+		return -1;
+	}
+
+	make_blocks(&data);
+	import_blocks(&data);
+	find_blocks(&data);
+	free_blocks(&data);
+
+	churn_blocks("memfd", NULL);
+	churn_blocks("slab", pw_properties_new("mem.slab-size", SLAB_SIZE, NULL));
+	churn_blocks("slab prefault", pw_properties_new("mem.slab-size", SLAB_SIZE,
+				"mem.slab-prefault", "true", NULL));
+
+	free(data.blocks);
+	free(data.maps);
+	pw_mempool_destroy(data.client);
+	pw_mempool_destroy(data.pool);
+
+	pw_deinit();
+
+	return 0;
+}
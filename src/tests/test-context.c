@@ -236,6 +236,87 @@ static void test_support(void)
 	pw_main_loop_destroy(loop);
 }
 
+static uint32_t node_data_loop(struct pw_impl_node *node)
+{
+	const char *str;
+	str = pw_properties_get(pw_impl_node_get_properties(node), PW_KEY_NODE_DATA_LOOP);
+	spa_assert(str != NULL);
+	return atoi(str);
+}
+
+static struct pw_impl_node *create_adapter(struct pw_context *context,
+		struct pw_impl_node *follower)
+{
+	struct pw_impl_factory *factory;
+	struct pw_properties *props;
+
+	factory = pw_context_find_factory(context, "adapter");
+	spa_assert(factory != NULL);
+
+	props = pw_properties_new(
+			SPA_KEY_FACTORY_NAME, "support.null-audio-sink",
+			SPA_KEY_LIBRARY_NAME, "support/libspa-support",
+			PW_KEY_MEDIA_CLASS, "Audio/Sink",
+			PW_KEY_NODE_NAME, "test",
+			NULL);
+	if (follower != NULL)
+		pw_properties_setf(props, "adapt.follower.node", "pointer:%p", follower);
+
+	return pw_impl_factory_create_object(factory, NULL, PW_TYPE_INTERFACE_Node,
+			PW_VERSION_NODE, props, 0);
+}
+
+static void test_adapter_data_loop(void)
+{
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct pw_impl_node *adapter[4], *follower;
+	struct pw_properties *props;
+	struct spa_handle *handle;
+	void *iface;
+	uint32_t i, used = 0;
+
+	loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(loop),
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				"context.num-data-loops", "4",
+				NULL), 0);
+	spa_assert(context != NULL);
+	spa_assert(pw_context_load_module(context,
+				"libpipewire-module-adapter", NULL, NULL) != NULL);
+
+	/* the follower is loaded by the factory, the pair takes one loop */
+	for (i = 0; i < SPA_N_ELEMENTS(adapter); i++) {
+		adapter[i] = create_adapter(context, NULL);
+		spa_assert(adapter[i] != NULL);
+		used |= 1u << node_data_loop(adapter[i]);
+	}
+	spa_assert(used == 0xf);
+
+	/* a given follower keeps its loop */
+	props = pw_properties_new(
+			SPA_KEY_LIBRARY_NAME, "support/libspa-support",
+			PW_KEY_NODE_DATA_LOOP, "2",
+			NULL);
+	handle = pw_context_load_spa_handle(context, "support.null-audio-sink", &props->dict);
+	spa_assert(handle != NULL);
+	spa_assert(spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+	follower = pw_context_create_node(context, props, 0);
+	spa_assert(follower != NULL);
+	spa_assert(pw_impl_node_set_implementation(follower, iface) >= 0);
+
+	adapter[0] = create_adapter(context, follower);
+	spa_assert(adapter[0] != NULL);
+	spa_assert(node_data_loop(adapter[0]) == 2);
+
+	/* destroys the follower as well */
+	pw_impl_node_destroy(adapter[0]);
+	pw_unload_spa_handle(handle);
+	pw_context_destroy(context);
+	pw_main_loop_destroy(loop);
+}
+
 int main(int argc, char *argv[])
 {
 	pw_init(&argc, &argv);
@@ -244,6 +325,7 @@ int main(int argc, char *argv[])
 	test_create();
 	test_properties();
 	test_support();
+	test_adapter_data_loop();
 
 	return 0;
 }
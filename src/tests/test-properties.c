@@ -23,6 +23,7 @@
  */
 
 #include <pipewire/properties.h>
+#include <pipewire/keys.h>
 
 static void test_abi(void)
 {
@@ -347,6 +348,229 @@ static void test_new_json(void)
 	pw_properties_free(props);
 }
 
+static void check_sorted(const struct pw_properties *props)
+{
+	const char *key, *prev = NULL;
+	void *state = NULL;
+	uint32_t i, n_keys = 0;
+
+	spa_assert(SPA_FLAG_IS_SET(props->dict.flags, SPA_DICT_FLAG_SORTED));
+
+	for (i = 1; i < props->dict.n_items; i++)
+		spa_assert(strcmp(props->dict.items[i - 1].key, props->dict.items[i].key) < 0);
+
+	while ((key = pw_properties_iterate(props, &state)) != NULL) {
+		spa_assert(prev == NULL || strcmp(prev, key) < 0);
+		prev = key;
+		n_keys++;
+	}
+	spa_assert(n_keys == props->dict.n_items);
+}
+
+static void test_sorted(void)
+{
+	struct pw_properties *props;
+	const char *str;
+	void *state = NULL;
+
+	props = pw_properties_new("him", "too", "foo", "bar", "bar", "baz", NULL);
+	spa_assert(props != NULL);
+	spa_assert(props->dict.n_items == 3);
+	check_sorted(props);
+
+	str = pw_properties_iterate(props, &state);
+	spa_assert(str != NULL && !strcmp(str, "bar"));
+	str = pw_properties_iterate(props, &state);
+	spa_assert(str != NULL && !strcmp(str, "foo"));
+	str = pw_properties_iterate(props, &state);
+	spa_assert(str != NULL && !strcmp(str, "him"));
+	str = pw_properties_iterate(props, &state);
+	spa_assert(str == NULL);
+
+	spa_assert(pw_properties_set(props, "a", "first") == 1);
+	spa_assert(pw_properties_set(props, "zz", "last") == 1);
+	spa_assert(pw_properties_set(props, "cat", "middle") == 1);
+	spa_assert(props->dict.n_items == 6);
+	check_sorted(props);
+	spa_assert(!strcmp(props->dict.items[0].key, "a"));
+	spa_assert(!strcmp(props->dict.items[5].key, "zz"));
+
+	spa_assert(pw_properties_set(props, "cat", NULL) == 1);
+	spa_assert(pw_properties_set(props, "a", NULL) == 1);
+	spa_assert(props->dict.n_items == 4);
+	check_sorted(props);
+
+	pw_properties_free(props);
+}
+
+static void test_dict_lookup(void)
+{
+	struct pw_properties *props;
+	const struct spa_dict_item *item;
+	char key[32], value[32];
+	int i;
+
+	props = pw_properties_new(NULL, NULL);
+	spa_assert(props != NULL);
+
+	/* add in an order that is not sorted */
+	for (i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "key.%d", (i * 37) % 100);
+		snprintf(value, sizeof(value), "%d", (i * 37) % 100);
+		spa_assert(pw_properties_set(props, key, value) == 1);
+	}
+	spa_assert(props->dict.n_items == 100);
+	check_sorted(props);
+
+	/* spa_dict_lookup() bisects the items of a sorted dict */
+	for (i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "key.%d", i);
+		snprintf(value, sizeof(value), "%d", i);
+		item = spa_dict_lookup_item(&props->dict, key);
+		spa_assert(item != NULL);
+		spa_assert(!strcmp(item->key, key));
+		spa_assert(!strcmp(item->value, value));
+		spa_assert(item->value == pw_properties_get(props, key));
+	}
+	spa_assert(spa_dict_lookup(&props->dict, "key.100") == NULL);
+	spa_assert(spa_dict_lookup(&props->dict, "a") == NULL);
+	spa_assert(spa_dict_lookup(&props->dict, "zz") == NULL);
+
+	pw_properties_free(props);
+}
+
+static void test_new_duplicate(void)
+{
+	struct pw_properties *props;
+
+	props = pw_properties_new("foo", "bar", "bar", "baz", "foo", "fuz", NULL);
+	spa_assert(props != NULL);
+	spa_assert(props->dict.n_items == 2);
+	spa_assert(!strcmp(pw_properties_get(props, "foo"), "fuz"));
+	spa_assert(!strcmp(pw_properties_get(props, "bar"), "baz"));
+	spa_assert(!strcmp(spa_dict_lookup(&props->dict, "foo"), "fuz"));
+	check_sorted(props);
+
+	pw_properties_free(props);
+}
+
+static void check_keys(const struct pw_properties *props, int n_keys, int removed)
+{
+	char key[32], value[32];
+	int i;
+
+	for (i = 0; i < n_keys; i++) {
+		const char *str;
+
+		snprintf(key, sizeof(key), "key.%d", i);
+		snprintf(value, sizeof(value), "%d", i);
+		str = pw_properties_get(props, key);
+		if (i % 3 == removed) {
+			spa_assert(str == NULL);
+			spa_assert(spa_dict_lookup(&props->dict, key) == NULL);
+		} else {
+			spa_assert(str != NULL && !strcmp(str, value));
+			spa_assert(spa_dict_lookup(&props->dict, key) == str);
+		}
+	}
+}
+
+static void test_remove_copy(void)
+{
+	struct pw_properties *props, *copy;
+	char key[32], value[32];
+	int i;
+
+	props = pw_properties_new(NULL, NULL);
+	spa_assert(props != NULL);
+
+	/* enough keys to grow the hash a few times */
+	for (i = 0; i < 200; i++) {
+		snprintf(key, sizeof(key), "key.%d", i);
+		snprintf(value, sizeof(value), "%d", i);
+		spa_assert(pw_properties_set(props, key, value) == 1);
+	}
+	for (i = 0; i < 200; i += 3) {
+		snprintf(key, sizeof(key), "key.%d", i);
+		spa_assert(pw_properties_set(props, key, NULL) == 1);
+		spa_assert(pw_properties_set(props, key, NULL) == 0);
+	}
+	spa_assert(props->dict.n_items == 133);
+	check_keys(props, 200, 0);
+	check_sorted(props);
+
+	copy = pw_properties_copy(props);
+	spa_assert(copy != NULL);
+	spa_assert(copy->dict.n_items == 133);
+	check_keys(copy, 200, 0);
+	check_sorted(copy);
+
+	/* the hash of the copy can be changed without touching the original */
+	for (i = 0; i < 200; i++) {
+		snprintf(key, sizeof(key), "key.%d", i);
+		snprintf(value, sizeof(value), "%d", i);
+		if (i % 3 == 0)
+			spa_assert(pw_properties_set(copy, key, value) == 1);
+		else if (i % 3 == 1)
+			spa_assert(pw_properties_set(copy, key, NULL) == 1);
+	}
+	spa_assert(copy->dict.n_items == 133);
+	check_keys(copy, 200, 1);
+	check_sorted(copy);
+
+	check_keys(props, 200, 0);
+	check_sorted(props);
+
+	pw_properties_free(props);
+	pw_properties_free(copy);
+}
+
+static void test_interned(void)
+{
+	struct pw_properties *props1, *props2, *copy;
+	const struct spa_dict_item *it1, *it2;
+	char key[64];
+
+	/* the keys are not the same pointers as the interned keys */
+	snprintf(key, sizeof(key), "%s", PW_KEY_ACCESS);
+
+	props1 = pw_properties_new(PW_KEY_ACCESS, "unrestricted", "foo", "bar", NULL);
+	props2 = pw_properties_new(key, "restricted", "foo", "baz", NULL);
+	spa_assert(props1 != NULL && props2 != NULL);
+
+	/* well known keys are shared, other keys are copied */
+	it1 = spa_dict_lookup_item(&props1->dict, PW_KEY_ACCESS);
+	it2 = spa_dict_lookup_item(&props2->dict, PW_KEY_ACCESS);
+	spa_assert(it1 != NULL && it2 != NULL);
+	spa_assert(it1->key == it2->key);
+	spa_assert(it2->key != key);
+	spa_assert(!strcmp(it1->value, "unrestricted"));
+	spa_assert(!strcmp(it2->value, "restricted"));
+
+	it1 = spa_dict_lookup_item(&props1->dict, "foo");
+	it2 = spa_dict_lookup_item(&props2->dict, "foo");
+	spa_assert(it1 != NULL && it2 != NULL);
+	spa_assert(it1->key != it2->key);
+
+	copy = pw_properties_copy(props1);
+	spa_assert(copy != NULL);
+	it1 = spa_dict_lookup_item(&props1->dict, PW_KEY_ACCESS);
+	it2 = spa_dict_lookup_item(&copy->dict, PW_KEY_ACCESS);
+	spa_assert(it1 != NULL && it2 != NULL);
+	spa_assert(it1->key == it2->key);
+	spa_assert(it1->value != it2->value);
+
+	/* removing an interned key does not free it */
+	spa_assert(pw_properties_set(props1, PW_KEY_ACCESS, NULL) == 1);
+	spa_assert(pw_properties_get(props1, PW_KEY_ACCESS) == NULL);
+	spa_assert(!strcmp(pw_properties_get(props2, PW_KEY_ACCESS), "restricted"));
+	spa_assert(!strcmp(pw_properties_get(copy, PW_KEY_ACCESS), "unrestricted"));
+
+	pw_properties_free(props1);
+	pw_properties_free(props2);
+	pw_properties_free(copy);
+}
+
 int main(int argc, char *argv[])
 {
 	test_abi();
@@ -359,6 +583,11 @@ int main(int argc, char *argv[])
 	test_update();
 	test_parse();
 	test_new_json();
+	test_sorted();
+	test_dict_lookup();
+	test_new_duplicate();
+	test_remove_copy();
+	test_interned();
 
 	return 0;
 }
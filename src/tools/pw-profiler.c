@@ -67,6 +67,13 @@ struct data {
 
 	int n_followers;
 	struct follower followers[MAX_FOLLOWERS];
+
+	struct format_cache {
+		int64_t hits;
+		int64_t misses;
+		int64_t miss_time;
+		int64_t saved_time;
+	} format_cache;
 };
 
 struct measurement {
@@ -193,6 +200,18 @@ static int process_follower_block(struct data *d, const struct spa_pod *pod, str
 	return 0;
 }
 
+static int process_format_cache(struct data *d, const struct spa_pod *pod, struct point *point)
+{
+	struct format_cache *c = &d->format_cache;
+
+	spa_pod_parse_struct(pod,
+			SPA_POD_Long(&c->hits),
+			SPA_POD_Long(&c->misses),
+			SPA_POD_Long(&c->miss_time),
+			SPA_POD_Long(&c->saved_time));
+	return 0;
+}
+
 static void dump_point(struct data *d, struct point *point)
 {
 	int i;
@@ -421,6 +440,20 @@ static void dump_scripts(struct data *d)
 	fprintf(stderr, "run 'sh generate_timings.sh' and load Timings.html in a browser\n");
 }
 
+static void dump_format_cache(struct data *d)
+{
+	struct format_cache *c = &d->format_cache;
+	int64_t total = c->hits + c->misses;
+
+	if (total == 0)
+		return;
+
+	fprintf(stderr, "format cache: %"PRIi64" hits, %"PRIi64" misses (%.1f%% hit rate), "
+			"%.3f ms negotiating, %.3f ms saved\n",
+			c->hits, c->misses, c->hits * 100.0 / total,
+			c->miss_time / 1000000.0, c->saved_time / 1000000.0);
+}
+
 static void profiler_profile(void *data, const struct spa_pod *pod)
 {
         struct data *d = data;
@@ -448,6 +481,9 @@ static void profiler_profile(void *data, const struct spa_pod *pod)
 			case SPA_PROFILER_followerBlock:
 				process_follower_block(d, &p->value, &point);
 				break;
+			case SPA_PROFILER_formatCache:
+				process_format_cache(d, &p->value, &point);
+				break;
 			default:
 				break;
 			}
@@ -649,6 +685,7 @@ int main(int argc, char *argv[])
 	fclose(data.output);
 
 	dump_scripts(&data);
+	dump_format_cache(&data);
 
 	pw_deinit();
 